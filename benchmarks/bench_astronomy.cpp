@@ -0,0 +1,1197 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "bench_astronomy.h"
+#include "benchmark.h"
+
+#include "osgHimmel/astronomy.h"
+#include "osgHimmel/astronomy2.h"
+#include "osgHimmel/ephemeriscache.h"
+#include "osgHimmel/astronomyevents.h"
+#include "osgHimmel/juliantime.h"
+#include "osgHimmel/apparentstars.h"
+#include "osgHimmel/brightstars.h"
+#include "osgHimmel/starsindex.h"
+#include "osgHimmel/pagedstars.h"
+#include "osgHimmel/stars.h"
+#include "osgHimmel/siderealtime.h"
+#include "osgHimmel/timef.h"
+#include "osgHimmel/sun.h"
+#include "osgHimmel/moon.h"
+#include "osgHimmel/mathmacros.h"
+
+#include <OpenThreads/Thread>
+
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <cstdio>
+
+
+using namespace osgHimmel;
+
+void bench_batchedEphemeris();
+void bench_ephemerisCache();
+void bench_astronomySnapshot();
+void bench_precision();
+void bench_seriesTruncation();
+void bench_observers();
+void bench_events();
+void bench_timeLine();
+void bench_nutationCache();
+void bench_apparentStars();
+void bench_brightStars();
+void bench_starsIndex();
+void bench_starsLimit();
+void bench_pagedStars();
+
+void bench_astronomy()
+{
+    bench_batchedEphemeris();
+    bench_ephemerisCache();
+    bench_astronomySnapshot();
+    bench_precision();
+    bench_seriesTruncation();
+    bench_observers();
+    bench_events();
+    bench_timeLine();
+    bench_nutationCache();
+    bench_apparentStars();
+    bench_brightStars();
+    bench_starsIndex();
+    bench_starsLimit();
+    bench_pagedStars();
+}
+
+
+namespace
+{
+    // Largest absolute difference of the components of vectors and matrices.
+
+    const double deviation(
+        const float a
+    ,   const float b)
+    {
+        return fabs(static_cast<double>(a) - static_cast<double>(b));
+    }
+
+    const double deviation(
+        const osg::Vec3f &a
+    ,   const osg::Vec3f &b)
+    {
+        double d(0.0);
+        for(int i = 0; i < 3; ++i)
+            d = std::max(d, deviation(a[i], b[i]));
+
+        return d;
+    }
+
+    const double deviation(
+        const osg::Matrixf &a
+    ,   const osg::Matrixf &b)
+    {
+        double d(0.0);
+        for(int i = 0; i < 4; ++i)
+            for(int j = 0; j < 4; ++j)
+                d = std::max(d, deviation(a(i, j), b(i, j)));
+
+        return d;
+    }
+
+    // Sun and moon positions of count instants (one per minute) for one 
+    // observer each, per instant and batched.
+
+    void batchedEphemeris(
+        Benchmark &benchmark
+    ,   const AbstractAstronomy &astro
+    ,   const unsigned int count)
+    {
+        std::vector<t_aTime> aTimes(count);
+        std::vector<float> latitudes(count);
+        std::vector<float> longitudes(count);
+
+        for(unsigned int i = 0; i < count; ++i)
+        {
+            aTimes[i] = t_aTime(2012, 6, 21, i / 60 % 24, i % 60, 0);
+
+            latitudes[i]  = -60.f + (i % 121);
+            longitudes[i] = -180.f + (i % 361);
+        }
+
+        std::vector<float> x(count);
+        std::vector<float> y(count);
+        std::vector<float> z(count);
+
+        benchmark.start();
+        for(unsigned int i = 0; i < count; ++i)
+        {
+            astro.getSunPosition(aTimes[i], latitudes[i], longitudes[i], true);
+            astro.getMoonPosition(aTimes[i], latitudes[i], longitudes[i], true);
+        }
+        const double s = benchmark.stop("per instant", count);
+
+        benchmark.start();
+        astro.getSunPositions(&aTimes[0], &latitudes[0], &longitudes[0], count, true, &x[0], &y[0], &z[0]);
+        astro.getMoonPositions(&aTimes[0], &latitudes[0], &longitudes[0], count, true, &x[0], &y[0], &z[0]);
+        const double b = benchmark.stop("batched", count);
+
+        Benchmark::report("  speedup", s / b, "x");
+    }
+
+    // Astronomy queries of one frame, as issued by Himmel, its geodes, 
+    // HimmelAmbient, and HimmelOverlay, evaluated per query and read from 
+    // the snapshot of update.
+
+    void astronomySnapshot(
+        Benchmark &benchmark
+    ,   AbstractAstronomy &astro
+    ,   const unsigned int frames)
+    {
+        const float lat(astro.getLatitude());
+        const float lon(astro.getLongitude());
+
+        float sum(0.f); // keeps the queries from being optimized away
+
+        benchmark.start();
+        for(unsigned int i = 0; i < frames; ++i)
+        {
+            const t_aTime aTime(2012, 6, 21, i / 60 % 24, i % 60, 0);
+
+            // Himmel
+            sum += astro.getSunPosition(aTime, lat, lon, false)[2];
+            sum += astro.getSunPosition(aTime, lat, lon, true)[2];
+
+            // AtmosphereGeode
+            sum += astro.getAngularSunRadius(aTime);
+            sum += astro.getSunPosition(aTime, lat, lon, true)[2];
+
+            // MoonGeode
+            sum += astro.getMoonPosition(aTime, lat, lon, false)[2];
+            sum += astro.getSunPosition(aTime, lat, lon, false)[2];
+            sum += astro.getAngularMoonRadius(aTime);
+            sum += astro.getMoonPosition(aTime, lat, lon, true)[2];
+            sum += astro.getMoonOrientation(aTime, lat, lon)(0, 0);
+            sum += astro.getEarthShineIntensity(aTime, lat, lon);
+            sum += astro.getMoonRadius() / astro.getMoonDistance(aTime);
+            sum += astro.getSunDistance(aTime) * 1e-8f;
+
+            // MoonGlareGeode
+            sum += astro.getMoonPosition(aTime, lat, lon, false)[2];
+            sum += astro.getSunPosition(aTime, lat, lon, false)[2];
+
+            // StarMapGeode and StarsGeode
+            sum += astro.getEquToHorTransform(aTime, lat, lon)(0, 0);
+            sum += astro.getEquToHorTransform(aTime, lat, lon)(0, 0);
+
+            // HimmelAmbient
+            sum += astro.getSunPosition(aTime, lat, lon, true)[2];
+            sum += astro.getMoonPosition(aTime, lat, lon, true)[2];
+            sum += astro.getAngularMoonRadius(aTime);
+
+            // HimmelOverlay
+            sum += astro.getSunPosition(aTime, lat, lon, false)[2];
+        }
+        const double q = benchmark.stop("per query", frames);
+
+        benchmark.start();
+        for(unsigned int i = 0; i < frames; ++i)
+        {
+            astro.update(t_aTime(2012, 6, 21, i / 60 % 24, i % 60, 0));
+            const t_astronomySnapshot &snapshot(astro.getSnapshot());
+
+            sum += snapshot.sun[2] + snapshot.sunRefracted[2] 
+                + snapshot.angularSunRadius + snapshot.sunRefracted[2]
+                + snapshot.moon[2] + snapshot.sun[2] + snapshot.angularMoonRadius 
+                + snapshot.moonRefracted[2] + snapshot.moonOrientation(0, 0)
+                + snapshot.earthShineIntensity + snapshot.moonRadius / snapshot.moonDistance
+                + snapshot.sunDistance * 1e-8f 
+                + snapshot.moon[2] + snapshot.sun[2]
+                + snapshot.equToHorTransform(0, 0) * 2.f
+                + snapshot.sunRefracted[2] + snapshot.moonRefracted[2] + snapshot.angularMoonRadius
+                + snapshot.sun[2];
+        }
+        const double s = benchmark.stop("snapshot", frames);
+
+        Benchmark::report("  speedup", q / s, "x");
+
+        // the snapshot has to match the getters (cf. test_snapshot)
+
+        double positions(0.0);
+        double radii(0.0);
+        double distances(0.0);
+        double earthShine(0.0);
+        double transforms(0.0);
+
+        for(unsigned int i = 0; i < frames; ++i)
+        {
+            const t_aTime aTime(2012, 6, 21, i / 60 % 24, i % 60, 0);
+
+            astro.update(aTime);
+            const t_astronomySnapshot &snapshot(astro.getSnapshot());
+
+            positions = std::max(positions, std::max(
+                deviation(astro.getSunPosition(aTime, lat, lon, false), snapshot.sun)
+            ,   deviation(astro.getSunPosition(aTime, lat, lon, true), snapshot.sunRefracted)));
+            positions = std::max(positions, std::max(
+                deviation(astro.getMoonPosition(aTime, lat, lon, false), snapshot.moon)
+            ,   deviation(astro.getMoonPosition(aTime, lat, lon, true), snapshot.moonRefracted)));
+
+            radii = std::max(radii, std::max(
+                deviation(astro.getAngularSunRadius(aTime), snapshot.angularSunRadius)
+            ,   deviation(astro.getAngularMoonRadius(aTime), snapshot.angularMoonRadius)));
+
+            distances = std::max(distances, std::max(
+                deviation(astro.getSunDistance(aTime) / snapshot.sunDistance, 1.f)
+            ,   deviation(astro.getMoonDistance(aTime) / snapshot.moonDistance, 1.f)));
+
+            earthShine = std::max(earthShine
+            ,   deviation(astro.getEarthShineIntensity(aTime, lat, lon), snapshot.earthShineIntensity));
+
+            transforms = std::max(transforms, std::max(
+                deviation(astro.getMoonOrientation(aTime, lat, lon), snapshot.moonOrientation)
+            ,   deviation(astro.getEquToHorTransform(aTime, lat, lon), snapshot.equToHorTransform)));
+        }
+        Benchmark::report("  max deviation positions", positions);
+        Benchmark::report("  max deviation angular radii", radii);
+        Benchmark::report("  max deviation distances (relative)", distances);
+        Benchmark::report("  max deviation earth shine", earthShine);
+        Benchmark::report("  max deviation transforms", transforms);
+
+        Benchmark::report("  checksum", sum);
+    }
+
+    // Sun and moon positions of one instant for count observers, per 
+    // observer and with the time dependent terms evaluated once.
+
+    void observers(
+        Benchmark &benchmark
+    ,   const AbstractAstronomy &astro
+    ,   const unsigned int count)
+    {
+        const t_aTime aTime(2012, 6, 21, 12, 0, 0);
+
+        std::vector<float> latitudes(count);
+        std::vector<float> longitudes(count);
+
+        for(unsigned int i = 0; i < count; ++i)
+        {
+            latitudes[i]  = -60.f + (i % 121);
+            longitudes[i] = -180.f + (i % 361);
+        }
+
+        std::vector<float> x(count);
+        std::vector<float> y(count);
+        std::vector<float> z(count);
+
+        std::stringstream label;
+        label << count << " observers";
+
+        benchmark.start();
+        for(unsigned int i = 0; i < count; ++i)
+        {
+            astro.getSunPosition(aTime, latitudes[i], longitudes[i], true);
+            astro.getMoonPosition(aTime, latitudes[i], longitudes[i], true);
+        }
+        const double s = benchmark.stop(label.str() + " per observer", count);
+
+        benchmark.start();
+        astro.getSunPositions(aTime, &latitudes[0], &longitudes[0], count, true, &x[0], &y[0], &z[0]);
+        astro.getMoonPositions(aTime, &latitudes[0], &longitudes[0], count, true, &x[0], &y[0], &z[0]);
+        const double b = benchmark.stop(label.str() + " shared", count);
+
+        Benchmark::report("  speedup", s / b, "x");
+    }
+
+    // Apparent positions and distances of sun and moon for count instants 
+    // (one per hour), evaluated in the precision t_real.
+
+    template<typename t_real>
+    const double apparentPositions(
+        Benchmark &benchmark
+    ,   const char *label
+    ,   const unsigned int count
+    ,   double &sum)
+    {
+        const t_julianDay begin(jd(t_aTime(2012, 1, 1.0)));
+
+        benchmark.start();
+        for(unsigned int i = 0; i < count; ++i)
+        {
+            const t_julianDay t(begin + i / 24.0);
+
+            sum += SunT<t_real>::apparentPosition(t).right_ascension
+                + MoonT<t_real>::apparentPosition(t).right_ascension
+                + MoonT<t_real>::distance(t) * 1e-5;
+        }
+        return benchmark.stop(label, count);
+    }
+
+    // Events of sun and moon in Berlin for a number of days, found by the
+    // solver and by sampling the altitudes once a minute per instant (the
+    // sampling only detects rises and sets, to the minute).
+
+    void events(
+        Benchmark &benchmark
+    ,   const AbstractAstronomy &astro
+    ,   const unsigned int days
+    ,   const unsigned int sampledDays)
+    {
+        const t_julianDay begin(jd(t_aTime(2012, 1, 1.0)));
+
+        const AstronomyEvents solver(astro);
+        AstronomyEvents::t_events events;
+
+        std::stringstream label;
+        label << days << " days solved";
+
+        benchmark.start();
+        solver.events(AstronomyEvents::B_Sun, begin, begin + days, 52.5f, 13.4f, events);
+        solver.events(AstronomyEvents::B_Moon, begin, begin + days, 52.5f, 13.4f, events);
+        const double s = benchmark.stop(label.str());
+
+        Benchmark::report("  events", static_cast<double>(events.size()));
+
+        unsigned int crossings(0);
+        float previous[2] = { 0.f, 0.f };
+
+        benchmark.start();
+        for(unsigned int i = 0; i < sampledDays * 1440; ++i)
+        {
+            const t_aTime aTime(makeTime(begin + i / 1440.0));
+
+            const float sun(astro.getSunPosition(aTime, 52.5f, 13.4f, false)[2]);
+            const float moon(astro.getMoonPosition(aTime, 52.5f, 13.4f, false)[2]);
+
+            if(i > 0)
+                crossings += (sun > -0.0145f) != (previous[0] > -0.0145f)
+                    || (moon > 0.0023f) != (previous[1] > 0.0023f);
+
+            previous[0] = sun;
+            previous[1] = moon;
+        }
+        label.str("");
+        label << sampledDays << " days sampled per minute";
+
+        const double b = benchmark.stop(label.str());
+
+        Benchmark::report("  rises and sets", static_cast<double>(crossings));
+        Benchmark::report("  speedup per day", b / sampledDays * days / s, "x");
+    }
+}
+
+
+void bench_batchedEphemeris()
+{
+    static const unsigned int count(10000);
+
+    {
+        Benchmark benchmark("Astronomy batched ephemeris");
+        batchedEphemeris(benchmark, Astronomy(), count);
+    }
+    {
+        Benchmark benchmark("Astronomy2 batched ephemeris");
+        batchedEphemeris(benchmark, Astronomy2(), count);
+    }
+}
+
+
+void bench_astronomySnapshot()
+{
+    static const unsigned int frames(2000);
+
+    {
+        Astronomy astro;
+        astro.setLatitude(52.5f);
+        astro.setLongitude(13.4f);
+
+        Benchmark benchmark("Astronomy frame snapshot");
+        astronomySnapshot(benchmark, astro, frames);
+    }
+    {
+        Astronomy2 astro;
+        astro.setLatitude(52.5f);
+        astro.setLongitude(13.4f);
+
+        Benchmark benchmark("Astronomy2 frame snapshot");
+        astronomySnapshot(benchmark, astro, frames);
+    }
+}
+
+
+// Fits, stores, and loads a cache of one year, and compares queries of 
+// the apparent positions with the direct series.
+
+void bench_ephemerisCache()
+{
+    Benchmark benchmark("EphemerisCache");
+
+    const t_julianDay begin(jd(t_aTime(2012, 1, 1.0)));
+    const t_julianDay end(begin + 365.25);
+
+    osg::ref_ptr<EphemerisCache> cache(new EphemerisCache);
+
+    benchmark.start();
+    cache->build(begin, end);
+    benchmark.stop("build (one year)");
+
+    for(int q = 0; q < EphemerisCache::NUM_QUANTITIES; ++q)
+    {
+        const EphemerisCache::e_Quantity quantity(static_cast<EphemerisCache::e_Quantity>(q));
+
+        std::stringstream label;
+        label << "  quantity " << q << " (degree " << cache->getDegree(quantity) << ") max error";
+
+        Benchmark::report(label.str(), cache->getMaxError(quantity)
+            , q == EphemerisCache::Q_SunDistance || q == EphemerisCache::Q_MoonDistance ? "km" : "\"");
+    }
+
+    const std::string filePath("ephemeriscache.bin");
+
+    benchmark.start();
+    cache->save(filePath);
+    benchmark.stop("save");
+
+    osg::ref_ptr<EphemerisCache> loaded(new EphemerisCache);
+
+    benchmark.start();
+    loaded->load(filePath);
+    benchmark.stop("load");
+
+    std::remove(filePath.c_str());
+
+    static const int count(100000);
+
+    double sum(0.0); // keeps the queries from being optimized away
+
+    benchmark.start();
+    for(int i = 0; i < count; ++i)
+    {
+        const t_julianDay t(begin + 365.0 * i / count);
+        sum += Moon::apparentPosition(t).right_ascension + Sun::apparentPosition(t).right_ascension;
+    }
+    const double d = benchmark.stop("series", count);
+
+    benchmark.start();
+    for(int i = 0; i < count; ++i)
+    {
+        const t_julianDay t(begin + 365.0 * i / count);
+        sum -= cache->moonApparentPosition(t).right_ascension + cache->sunApparentPosition(t).right_ascension;
+    }
+    const double c = benchmark.stop("cached", count);
+
+    Benchmark::report("  speedup", d / c, "x");
+    Benchmark::report("  checksum", sum);
+
+    // largest deviation of the cached right ascensions from the series
+
+    double sun(0.0);
+    double moon(0.0);
+
+    for(int i = 0; i < count; ++i)
+    {
+        const t_julianDay t(begin + 365.0 * i / count);
+
+        const double s(Sun::apparentPosition(t).right_ascension - cache->sunApparentPosition(t).right_ascension);
+        const double m(Moon::apparentPosition(t).right_ascension - cache->moonApparentPosition(t).right_ascension);
+
+        // over the wrap at 360 degrees
+        sun  = std::max(sun,  fabs(s - 360.0 * floor(s / 360.0 + 0.5)) * 3600.0);
+        moon = std::max(moon, fabs(m - 360.0 * floor(m / 360.0 + 0.5)) * 3600.0);
+    }
+    Benchmark::report("  max deviation sun", sun, "\"");
+    Benchmark::report("  max deviation moon", moon, "\"");
+}
+
+
+
+// Throughput of the precision policies of the astronomy.
+
+void bench_precision()
+{
+    static const unsigned int count(20000);
+
+    Benchmark benchmark("Astronomy precision policies");
+
+    double sum(0.0); // keeps the queries from being optimized away
+
+    const double l = apparentPositions<long double>(benchmark, "long double", count, sum);
+    const double d = apparentPositions<double>(benchmark, "double", count, sum);
+    const double f = apparentPositions<float>(benchmark, "float", count, sum);
+
+    Benchmark::report("  speedup double", l / d, "x");
+    Benchmark::report("  speedup float", l / f, "x");
+    Benchmark::report("  checksum", sum);
+}
+
+
+// Apparent positions and distance of the moon and apparent positions of
+// the sun, with series truncated to maximum errors.
+
+void bench_seriesTruncation()
+{
+    static const int count(20000);
+
+    Benchmark benchmark("Astronomy series truncation");
+
+    const t_julianDay begin(jd(t_aTime(2012, 1, 1.0)));
+
+    const double maxErrors[] = { 0.0, 1e-4, 1e-3, 1e-2, 1e-1 };
+
+    double complete(0.0);
+    double sum(0.0); // keeps the queries from being optimized away
+
+    for(int k = 0; k < 5; ++k)
+    {
+        const SeriesTruncation truncation(maxErrors[k]);
+        const SeriesTruncation *series(k > 0 ? &truncation : NULL);
+
+        unsigned int numTerms(0);
+        for(int s = 0; s < SeriesTruncation::NUM_SERIES; ++s)
+            numTerms += truncation.series(static_cast<SeriesTruncation::e_Series>(s)).numTerms;
+
+        benchmark.start();
+        for(int i = 0; i < count; ++i)
+        {
+            const t_julianDay t(begin + i / 24.0);
+
+            const t_equd moon(Moon::apparentPosition(t, series));
+            const t_equd sun(Sun::apparentPosition(t, series));
+
+            sum += moon.declination + sun.declination + Moon::distance(t, series) * 1e-5;
+        }
+
+        std::stringstream label;
+        label << "max error " << maxErrors[k] << " deg (" << numTerms << " terms)";
+
+        const double d = benchmark.stop(label.str(), count);
+
+        if(0 == k)
+            complete = d;
+        else
+            Benchmark::report("  speedup", complete / d, "x");
+    }
+    Benchmark::report("  checksum", sum);
+
+    // actual errors of the moons apparent declination
+
+    for(int k = 1; k < 5; ++k)
+    {
+        const SeriesTruncation truncation(maxErrors[k]);
+
+        double maxError(0.0);
+        for(int i = 0; i < count; i += 10)
+        {
+            const t_julianDay t(begin + i / 24.0);
+            maxError = std::max(maxError, static_cast<double>(_abs(Moon::apparentPosition(t).declination 
+                - Moon::apparentPosition(t, &truncation).declination)));
+        }
+
+        std::stringstream label;
+        label << "  declination error at " << maxErrors[k];
+
+        Benchmark::report(label.str(), maxError * 3600.0, "\"");
+    }
+}
+
+
+void bench_observers()
+{
+    static const unsigned int counts[] = { 1, 10, 100, 1000, 10000 };
+
+    {
+        Benchmark benchmark("Astronomy observers");
+        for(int i = 0; i < 5; ++i)
+            observers(benchmark, Astronomy(), counts[i]);
+    }
+    {
+        Benchmark benchmark("Astronomy2 observers");
+        for(int i = 0; i < 5; ++i)
+            observers(benchmark, Astronomy2(), counts[i]);
+    }
+}
+
+// A year of rise, set, transit, and twilights of sun and moon.
+
+void bench_events()
+{
+    {
+        Benchmark benchmark("Astronomy events");
+        events(benchmark, Astronomy(), 366, 7);
+    }
+    {
+        const t_julianDay begin(jd(t_aTime(2012, 1, 1.0)));
+
+        osg::ref_ptr<EphemerisCache> cache(new EphemerisCache);
+        cache->build(begin, begin + 366.0);
+
+        Astronomy astro;
+        astro.setEphemerisCache(cache.get());
+
+        Benchmark benchmark("Astronomy events (cached)");
+        events(benchmark, astro, 366, 7);
+    }
+    {
+        Benchmark benchmark("Astronomy2 events");
+        events(benchmark, Astronomy2(), 366, 7);
+    }
+}
+
+
+// Per frame conversion of a running TimeF to the time of the astronomy, 
+// and the motion of the sun within one second at 60 frames per second.
+
+void bench_timeLine()
+{
+    static const unsigned int frames(100000);
+
+    Benchmark benchmark("Time line");
+
+    TimeF timef(static_cast<time_t>(1340280000), 7200, 60.0);
+    timef.start();
+
+    t_longf sum(0.0);
+
+    benchmark.start();
+    for(unsigned int i = 0; i < frames; ++i)
+    {
+        timef.update();
+
+        const t_aTime aTime(t_aTime::fromTimeF(timef));
+        sum += jd(aTime) - jdUT(aTime);
+    }
+    const double c = benchmark.stop("via t_aTime", frames);
+
+    benchmark.start();
+    for(unsigned int i = 0; i < frames; ++i)
+    {
+        timef.update();
+
+        const t_julianTime time(t_julianTime::fromTimeF(timef));
+        sum += time.jd() - time.jdUT();
+    }
+    const double j = benchmark.stop("t_julianTime", frames);
+
+    Benchmark::report("  speedup", c / j, "x");
+    Benchmark::report("  checksum", static_cast<double>(sum));
+
+    // both agree up to the fraction of the second t_aTime drops
+
+    double deviation(0.0);
+
+    for(unsigned int i = 0; i < frames; ++i)
+    {
+        timef.update();
+
+        const t_julianTime time(t_julianTime::fromTimeF(timef));
+        const t_julianTime whole(t_aTime::fromTimeF(timef));
+
+        deviation = std::max(deviation, fabs(time - whole));
+    }
+    Benchmark::report("  max deviation", deviation, "s");
+
+    Astronomy astro;
+
+    const t_julianTime time(t_aTime(2012, 6, 21, 7, 0, 0));
+
+    unsigned int distinct[2] = { 0, 0 };
+    float previous[2] = { 0.f, 0.f };
+
+    for(unsigned int i = 0; i < 60; ++i)
+    {
+        const t_julianTime frame(time + i / 60.0);
+
+        const float z[2] =
+        {
+            astro.getSunPosition(frame.toATime(), 52.5f, 13.4f, false)[2]
+        ,   astro.getSunPosition(frame, 52.5f, 13.4f, false)[2]
+        };
+
+        for(int k = 0; k < 2; ++k)
+        {
+            distinct[k] += 0 == i || z[k] != previous[k];
+            previous[k] = z[k];
+        }
+    }
+    Benchmark::report("  sun positions per second via t_aTime", distinct[0]);
+    Benchmark::report("  sun positions per second", distinct[1]);
+}
+
+
+// Frame snapshots and per frame positions of sun and moon at 60 frames 
+// per second, with the nutations evaluated and interpolated.
+
+void bench_nutationCache()
+{
+    static const unsigned int frames(2000);
+
+    const double tolerances[] = { 0.0, 1e-5 };
+
+    Astronomy astro[2];
+    for(int k = 0; k < 2; ++k)
+    {
+        astro[k].setLatitude(52.5f);
+        astro[k].setLongitude(13.4f);
+        astro[k].setNutationTolerance(tolerances[k]);
+    }
+
+    Benchmark benchmark("Astronomy nutation cache");
+
+    double d[2];
+    for(int k = 0; k < 2; ++k)
+    {
+        std::stringstream label;
+        label << "frame snapshot, tolerance " << tolerances[k] << " deg";
+
+        benchmark.start();
+        for(unsigned int i = 0; i < frames; ++i)
+            astro[k].update(t_julianTime(t_aTime(2012, 6, 21, 7, 0, 0)) + i / 60.0);
+        d[k] = benchmark.stop(label.str(), frames);
+    }
+    Benchmark::report("  speedup", d[0] / d[1], "x");
+
+    const t_julianTime time(t_aTime(2012, 6, 21, 7, 0, 0));
+
+    float sum(0.f); // keeps the queries from being optimized away
+
+    for(int k = 0; k < 2; ++k)
+    {
+        std::stringstream label;
+        label << "sun and moon, tolerance " << tolerances[k] << " deg";
+
+        benchmark.start();
+        for(unsigned int i = 0; i < frames; ++i)
+        {
+            const t_julianTime frame(time + i / 60.0);
+
+            sum += astro[k].getSunPosition(frame, 52.5f, 13.4f, true)[2];
+            sum += astro[k].getMoonPosition(frame, 52.5f, 13.4f, true)[2];
+        }
+        d[k] = benchmark.stop(label.str(), frames);
+    }
+    Benchmark::report("  speedup", d[0] / d[1], "x");
+    Benchmark::report("  checksum", sum);
+
+    // deviation over a year of hourly positions
+
+    float maxError(0.f);
+    for(unsigned int i = 0; i < 366 * 24; ++i)
+    {
+        const t_julianTime hour(time + i * 3600.0);
+
+        const osg::Vec3f m0(astro[0].getMoonPosition(hour, 52.5f, 13.4f, false));
+        const osg::Vec3f m1(astro[1].getMoonPosition(hour, 52.5f, 13.4f, false));
+
+        maxError = std::max(maxError, (m0 - m1).length());
+    }
+    Benchmark::report("  moon position error", _deg(maxError) * 3600.0, "\"");
+}
+
+
+// Apparent places of a catalogue of the size of the bright star catalogue,
+// per star, propagated at once, and kept within the tolerance per frame.
+
+void bench_apparentStars()
+{
+    static const unsigned int count(9093);
+    static const unsigned int frames(600);
+
+    std::vector<BrightStars::s_BrightStar> stars(count);
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        BrightStars::s_BrightStar &star(stars[i]);
+
+        star.Vmag = 6.f;
+        star.RA = (i * 7919 % count) * 24.f / count;
+        star.DE = _deg(asin(2.0 * (i * 104729 % count) / count - 1.0));
+        star.pmRA = 0.001f * (i % 400) - 0.2f;
+        star.pmDE = 0.001f * (i % 300) - 0.15f;
+    }
+
+    Benchmark benchmark("Apparent stars");
+
+    const t_julianDay t(jd(t_aTime(2012, 6, 21, 22, 0, 0)));
+
+    std::vector<osg::Vec3f> scalar(count);
+
+    benchmark.start();
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        const BrightStars::s_BrightStar &star(stars[i]);
+
+        const t_longf a(_rightascd(star.RA, 0, 0));
+
+        const t_equd equ(Stars::apparentPosition(t, a, star.DE
+            , star.pmRA / 3600.0 / _cosd(star.DE), star.pmDE / 3600.0));
+        scalar[i] = equ.toEuclidean();
+    }
+    const double s = benchmark.stop("per star (Stars::apparentPosition)", 1);
+
+    ApparentStars apparent;
+    apparent.setStars(&stars[0], count);
+
+    benchmark.start();
+    apparent.propagate(t);
+    const double p = benchmark.stop("all stars (ApparentStars::propagate)", 1);
+
+    Benchmark::report("  speedup", s / p, "x");
+
+    double maxError(0.0);
+    for(unsigned int i = 0; i < count; ++i)
+        maxError = std::max(maxError, static_cast<double>((apparent.positions()[i] - scalar[i]).length()));
+    Benchmark::report("  max deviation", _deg(maxError) * 3600.0, "\"");
+
+    // an hour of frames at 60 fps, and a year of frames every 12 hours
+
+    unsigned int propagations(0);
+
+    benchmark.start();
+    for(unsigned int i = 0; i < frames; ++i)
+        propagations += apparent.update(t + i / 60.0 / 86400.0);
+    benchmark.stop("per frame, tolerance 1\"", frames);
+
+    Benchmark::report("  propagations", propagations);
+
+    propagations = 0;
+    for(unsigned int i = 0; i < 730; ++i)
+        propagations += apparent.update(t + i * 0.5);
+
+    Benchmark::report("  propagations in a year", propagations);
+}
+
+
+// Loading catalogues of the size of the bright star, Hipparcos, and
+// Tycho-2 catalogues, copied from raw files and mapped, each followed by
+// one pass over all stars (which faults the mapped pages in).
+
+void bench_brightStars()
+{
+    static const unsigned int counts[] = { 9093, 118218, 2539913 };
+
+    Benchmark benchmark("Bright stars loading");
+
+    for(int k = 0; k < 3; ++k)
+    {
+        const unsigned int count(counts[k]);
+
+        {
+            std::vector<BrightStars::s_BrightStar> stars(count);
+            for(unsigned int i = 0; i < count; ++i)
+            {
+                stars[i].Vmag = (i % 1300) * 0.01f - 1.5f;
+                stars[i].RA = (i % 2400) * 0.01f;
+                stars[i].DE = (i % 1800) * 0.1f - 90.f;
+            }
+            std::ofstream raw("bench_brightstars.raw", std::ios::binary);
+            raw.write(reinterpret_cast<const char*>(&stars[0]), count * sizeof(BrightStars::s_BrightStar));
+        }
+        BrightStars::convert("bench_brightstars.raw", "bench_brightstars.bin");
+
+        const char *files[] = { "bench_brightstars.raw", "bench_brightstars.bin" };
+        const char *labels[] = { "raw (copied)", "versioned (mapped)" };
+
+        double d[2];
+        for(int f = 0; f < 2; ++f)
+        {
+            float sum(0.f); // keeps the pass from being optimized away
+
+            benchmark.start();
+
+            const BrightStars stars(files[f]);
+            for(unsigned int i = 0; i < stars.numStars(); ++i)
+                sum += stars.stars()[i].Vmag;
+
+            std::stringstream label;
+            label << count << " stars, " << labels[f];
+
+            d[f] = benchmark.stop(label.str(), 1);
+
+            if(sum < 0.f)
+                Benchmark::report("  checksum", sum);
+        }
+        Benchmark::report("  speedup", d[0] / d[1], "x");
+    }
+
+    std::remove("bench_brightstars.raw");
+    std::remove("bench_brightstars.bin");
+}
+
+
+// Building the index of catalogues of the size of the bright star, 
+// Hipparcos, and Tycho-2 catalogues, and culling its cells for views of
+// 60 and 5 degrees (of the diagonal) with and without a limiting magnitude
+// of the naked eye. The draw cost follows the vertices submitted (and the
+// number of draw calls, one per visible cell), against all of them.
+
+void bench_starsIndex()
+{
+    static const unsigned int counts[] = { 9093, 118218, 2539913 };
+    static const unsigned int views(1000);
+
+    Benchmark benchmark("Stars index");
+
+    for(int k = 0; k < 3; ++k)
+    {
+        const unsigned int count(counts[k]);
+
+        // magnitudes increase in number by about 3 per magnitude, as in 
+        // the catalogues
+
+        std::vector<BrightStars::s_BrightStar> stars(count);
+        for(unsigned int i = 0; i < count; ++i)
+        {
+            const float f((i * 7919 % count + 0.5f) / count);
+
+            stars[i].Vmag = static_cast<float>(-1.5 + log(1.0 + f * (pow(3.0, 13.0) - 1.0)) / log(3.0));
+            stars[i].RA = (i * 104729 % count) * 24.f / count;
+            stars[i].DE = _deg(asin(2.0 * (i * 7907 % count + 0.5) / count - 1.0));
+        }
+
+        StarsIndex index;
+
+        std::stringstream label;
+        label << count << " stars, build";
+
+        benchmark.start();
+        index.build(&stars[0], count);
+        benchmark.stop(label.str(), 1);
+
+        Benchmark::report("  cells", index.numCells());
+
+        static const float fovs[] = { 60.f, 5.f };
+        static const float limits[] = { 99.f, 6.5f };
+
+        std::vector<unsigned int> visible;
+
+        for(int f = 0; f < 2; ++f)
+            for(int l = 0; l < 2; ++l)
+            {
+                double submitted(0.0);
+                double calls(0.0);
+
+                benchmark.start();
+                for(unsigned int v = 0; v < views; ++v)
+                {
+                    t_equf equ;
+                    equ.right_ascension = v * 137.508f;
+                    equ.declination = _deg(asin(2.f * (v + 0.5f) / views - 1.f));
+
+                    submitted += index.cull(equ.toEuclidean(), _rad(fovs[f] * 0.5f), limits[l], visible);
+                    calls += visible.size();
+                }
+
+                std::stringstream label;
+                label << "  cull, fov " << fovs[f] << (limits[l] < 99.f ? ", limit 6.5" : "");
+
+                benchmark.stop(label.str(), views);
+
+                Benchmark::report("    vertices submitted", 100.0 * submitted / views / count, "%");
+                Benchmark::report("    draw calls", calls / views);
+            }
+    }
+}
+
+
+// Vertices submitted per frame for a catalogue of the size of Tycho-2 by
+// the limiting magnitude of sky brightness levels, from a moonless night
+// to the day, for a view of 60 degrees at 1080 pixels, and the cost of
+// deriving the counts of the draw arrays per frame.
+
+void bench_starsLimit()
+{
+    static const unsigned int count(2539913);
+    static const unsigned int frames(100);
+
+    std::vector<BrightStars::s_BrightStar> stars(count);
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        const float f((i * 7919 % count + 0.5f) / count);
+
+        stars[i].Vmag = static_cast<float>(-1.5 + log(1.0 + f * (pow(3.0, 13.0) - 1.0)) / log(3.0));
+        stars[i].RA = (i * 104729 % count) * 24.f / count;
+        stars[i].DE = _deg(asin(2.0 * (i * 7907 % count + 0.5) / count - 1.0));
+    }
+
+    StarsIndex index;
+    index.build(&stars[0], count);
+
+    Benchmark benchmark("Stars limiting magnitude");
+
+    const float q(4.f * tan(_rad(30.f)) / 1080.f);
+
+    // the default apparent magnitude of StarsGeode
+    const float apparentMagnitude(7.f);
+
+    // sun altitude, and moon altitude and elongation (180 is full)
+
+    static const float levels[][3] =
+    {
+        { -30.f, -30.f,   0.f }
+    ,   { -30.f,  45.f,  90.f }
+    ,   { -30.f,  45.f, 180.f }
+    ,   { -12.f, -30.f,   0.f }
+    ,   {  -6.f, -30.f,   0.f }
+    ,   {  -3.f, -30.f,   0.f }
+    ,   {   0.f, -30.f,   0.f }
+    ,   {  30.f, -30.f,   0.f }
+    };
+    static const char *labels[] = { "night, new moon", "night, quarter moon", "night, full moon"
+        , "sun at -12", "sun at -6", "sun at -3", "sunset", "day" };
+
+    for(int l = 0; l < 8; ++l)
+    {
+        const osg::Vec3f sun(0.f, _cosd(levels[l][0]), _sind(levels[l][0]));
+
+        // the moon at the elongation from the sun, within the vertical of the sun
+        const float a(_rad(levels[l][0] + levels[l][2]));
+        const osg::Vec3f moon(levels[l][2] ? osg::Vec3f(0.f, cos(a), sin(a)) : osg::Vec3f(0.f, 0.f, -1.f));
+
+        unsigned int submitted(0);
+        float limit(0.f);
+
+        benchmark.start();
+        for(unsigned int f = 0; f < frames; ++f)
+        {
+            const float moonlight(Stars::moonlight(sun, moon));
+            limit = Stars::limitingMagnitude(apparentMagnitude - moonlight, q, sun);
+
+            submitted = 0;
+            for(unsigned int c = 0; c < index.numCells(); ++c)
+                submitted += index.numBrighter(c, limit);
+        }
+        benchmark.stop(labels[l], frames);
+
+        Benchmark::report("  limiting magnitude", limit);
+        Benchmark::report("  vertices submitted", submitted);
+        Benchmark::report("  of all", 100.0 * submitted / count, "%");
+    }
+}
+
+
+// Streaming a paged catalogue of ten million stars (magnitudes to 17) 
+// within the default budget, at 60 frames per second: zooming in from a
+// view of 60 to 1 degree (at 1080 pixels, 16:9), then panning at 5 degree.
+// Per view, the frames until all requested tiles are resident, the 
+// resident memory, and the latency of the tiles (since the start). The 
+// file was just written, thus the tiles are read from the cache of the 
+// system, rather than from disk.
+
+void bench_pagedStars()
+{
+    static const unsigned int count(10000000);
+    static const unsigned int maxFrames(600);
+
+    Benchmark benchmark("Paged stars");
+
+    {
+        // magnitudes increase in number by about 2.5 per magnitude
+
+        std::vector<BrightStars::s_BrightStar> stars(count);
+        for(unsigned int i = 0; i < count; ++i)
+        {
+            const double f((fmod(i * 7919.0, count) + 0.5) / count);
+
+            BrightStars::s_BrightStar &star(stars[i]);
+
+            star.Vmag = static_cast<float>(-1.5 + log(1.0 + f * (pow(2.5, 18.5) - 1.0)) / log(2.5));
+            star.RA = static_cast<float>(fmod(i * 104729.0, count) * 24.0 / count);
+            star.DE = static_cast<float>(_deg(asin(2.0 * (fmod(i * 7907.0, count) + 0.5) / count - 1.0)));
+            star.pmRA = star.pmDE = 0.f;
+            star.sRGB_R = star.sRGB_G = star.sRGB_B = 1.f;
+        }
+
+        benchmark.start();
+        PagedStars::toFile(&stars[0], count, "bench_pagedstars.bin");
+        benchmark.stop("10000000 stars, paged file written", 1);
+    }
+
+    PagedStars paged("bench_pagedstars.bin");
+
+    Benchmark::report("  tiles", paged.numTiles());
+    Benchmark::report("  budget", paged.getBudget() / 1048576.0, "MiB");
+
+    const osg::Vec3f night(0.f, 0.f, -1.f);
+
+    static const float fovs[] = { 60.f, 20.f, 5.f, 1.f, 5.f, 5.f, 5.f, 5.f };
+    static const float ras[]  = {  0.f,  0.f, 0.f, 0.f, 45.f, 90.f, 135.f, 180.f };
+
+    std::vector<unsigned int> loaded;
+    std::vector<unsigned int> evicted;
+
+    for(int v = 0; v < 8; ++v)
+    {
+        t_equf equ;
+        equ.right_ascension = ras[v];
+        equ.declination = 20.f;
+
+        const osg::Vec3f direction(equ.toEuclidean());
+
+        const float ty(tan(_rad(fovs[v] * 0.5f)));
+        const float tx(ty * 16.f / 9.f);
+
+        const float halfAngle(atan(sqrt(tx * tx + ty * ty)));
+        const float limit(Stars::limitingMagnitude(7.f, 4.f * ty / 1080.f, night));
+
+        unsigned int frames(0);
+        double update(0.0);
+
+        do
+        {
+            paged.request(direction, halfAngle, limit);
+
+            const osg::Timer_t start(osg::Timer::instance()->tick());
+            paged.update(loaded, evicted);
+            update += osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+            ++frames;
+
+            if(0 == paged.statistics().pendingTiles)
+                break;
+
+            OpenThreads::Thread::microSleep(16667);
+        }
+        while(frames < maxFrames);
+
+        const PagedStars::t_statistics &statistics(paged.statistics());
+
+        std::stringstream label;
+        label << "view of " << fovs[v] << " deg at RA " << ras[v] << ", limit " << limit;
+
+        Benchmark::report(label.str(), frames, "frames");
+        Benchmark::report("  update", update * 1000.0 / frames, "ms/frame");
+        Benchmark::report("  resident", statistics.residentBytes / 1048576.0, "MiB");
+        Benchmark::report("  resident tiles", statistics.residentTiles);
+        Benchmark::report("  dropped tiles", statistics.droppedTiles);
+        Benchmark::report("  evicted tiles", statistics.evictedTiles);
+        Benchmark::report("  mean latency", statistics.meanLatency * 1000.0, "ms");
+        Benchmark::report("  max latency", statistics.maxLatency * 1000.0, "ms");
+    }
+
+    std::remove("bench_pagedstars.bin");
+}
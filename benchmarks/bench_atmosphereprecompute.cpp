@@ -0,0 +1,491 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "bench_atmosphereprecompute.h"
+#include "benchmark.h"
+
+#include "osgHimmel/cpuatmosphereprecompute.h"
+#include "osgHimmel/atmospherequery.h"
+#include "osgHimmel/atmosphereformat.h"
+#include "osgHimmel/atmosphereatlas.h"
+#include "osgHimmel/mathmacros.h"
+
+#include <osg/Image>
+#include <OpenThreads/Thread>
+
+#include <sstream>
+#include <vector>
+#include <cstdio>
+
+
+using namespace osgHimmel;
+
+void bench_cpuPrecomputeScaling();
+void bench_precomputeCache();
+void bench_incrementalPrecompute();
+void bench_progressivePrecompute();
+void bench_precomputePipeline();
+void bench_skyQuery();
+void bench_inscatterFormats();
+void bench_presetAtlas();
+void bench_adaptiveIntegration();
+
+void bench_atmosphereprecompute()
+{
+    bench_cpuPrecomputeScaling();
+    bench_precomputeCache();
+    bench_incrementalPrecompute();
+    bench_progressivePrecompute();
+    bench_precomputePipeline();
+    bench_skyQuery();
+    bench_inscatterFormats();
+    bench_presetAtlas();
+    bench_adaptiveIntegration();
+}
+
+
+// Runs the complete cpu precompute (all passes and scattering 
+// orders) with 1 to N threads, N being the number of processors.
+
+void bench_cpuPrecomputeScaling()
+{
+    Benchmark benchmark("CpuAtmospherePrecompute scaling");
+
+    const int processors = OpenThreads::GetNumberOfProcessors();
+
+    osg::ref_ptr<CpuAtmospherePrecompute> precompute(new CpuAtmospherePrecompute);
+    precompute->setCacheDirectory("");
+
+    double single = 0.0;
+
+    for(int threads = 1; threads <= processors; ++threads)
+    {
+        precompute->setNumThreads(threads);
+
+        std::stringstream label;
+        label << threads << " thread(s)";
+
+        benchmark.start();
+        precompute->compute(false);
+        const double s = benchmark.stop(label.str());
+
+        if(threads == 1)
+            single = s;
+        else
+            Benchmark::report("  speedup", single / s, "x");
+    }
+}
+
+
+// Compares a cold start (precompute and store) with a warm start 
+// (mapping the cached tables) of a new precompute instance each.
+
+void bench_precomputeCache()
+{
+    Benchmark benchmark("AtmospherePrecompute cache");
+
+    const std::string directory("atmospherecache");
+
+    osg::ref_ptr<CpuAtmospherePrecompute> cold(new CpuAtmospherePrecompute);
+    cold->setCacheDirectory(directory);
+
+    const std::string path(cold->getCacheFilePath());
+
+    std::remove(path.c_str());
+
+    benchmark.start();
+    cold->compute();
+    const double c = benchmark.stop("cold start (compute and store)");
+
+    osg::ref_ptr<CpuAtmospherePrecompute> warm(new CpuAtmospherePrecompute);
+    warm->setCacheDirectory(directory);
+
+    benchmark.start();
+    warm->compute();
+    const double w = benchmark.stop("warm start (load)");
+
+    Benchmark::report("  speedup", c / w, "x");
+
+    std::remove(path.c_str());
+}
+
+
+// Compares a full precompute with the incremental recomputes after 
+// changing parameters that are read by fewer stages.
+
+void bench_incrementalPrecompute()
+{
+    Benchmark benchmark("AtmospherePrecompute incremental");
+
+    osg::ref_ptr<CpuAtmospherePrecompute> precompute(new CpuAtmospherePrecompute);
+    precompute->setCacheDirectory("");
+
+    benchmark.start();
+    precompute->compute();
+    const double full = benchmark.stop("full");
+
+    precompute->getModelConfig().avgGroundReflectance += 0.05f;
+    precompute->dirty();
+
+    benchmark.start();
+    precompute->compute();
+    const double r = benchmark.stop("avgGroundReflectance");
+
+    Benchmark::report("  speedup", full / r, "x");
+
+    precompute->getModelConfig().betaMSca *= 1.1f;
+    precompute->dirty();
+
+    benchmark.start();
+    precompute->compute();
+    const double m = benchmark.stop("betaMSca");
+
+    Benchmark::report("  speedup", full / m, "x");
+}
+
+
+// Runs the progressive precompute with a budget of 4 ms per call (frame)
+// and reports the longest call, which is bound by the longest task, and
+// the calls required until single scattering and all orders are available.
+
+void bench_progressivePrecompute()
+{
+    Benchmark benchmark("AtmospherePrecompute progressive");
+
+    osg::ref_ptr<CpuAtmospherePrecompute> precompute(new CpuAtmospherePrecompute);
+    precompute->setCacheDirectory("");
+
+    benchmark.start();
+    precompute->compute();
+    benchmark.stop("blocking");
+
+    precompute->dirty();
+
+    osg::Timer *timer(osg::Timer::instance());
+
+    int calls = 0;
+    int singleScattering = 0;
+
+    double longest = 0.0;
+
+    benchmark.start();
+    do
+    {
+        const osg::Timer_t t = timer->tick();
+        precompute->computeProgressive(0.004, false);
+        longest = _ma(longest, timer->delta_s(t, timer->tick()));
+
+        ++calls;
+
+        if(0 == singleScattering && precompute->getScatteringOrder() > 0)
+            singleScattering = calls;
+    }
+    while(precompute->isComputing());
+
+    benchmark.stop("progressive", calls);
+
+    Benchmark::report("  longest call", longest * 1e3, "ms");
+    Benchmark::report("  calls until single scattering", singleScattering);
+    Benchmark::report("  calls until all orders", calls);
+
+    for(int i = 0; i < AtmospherePrecompute::NUM_PASSES; ++i)
+    {
+        const AtmospherePrecompute::e_Pass pass(static_cast<AtmospherePrecompute::e_Pass>(i));
+        Benchmark::report(std::string("  ") + AtmospherePrecompute::passName(pass), precompute->getPassTime(pass) * 1e3, "ms");
+    }
+}
+
+
+// Sweeps the mie phase function parameter using the gpu precompute 
+// (requires a pbuffer context), once setting up the pipeline for each
+// compute (the former behavior) and once reusing it for all computes.
+
+void bench_precomputePipeline()
+{
+    Benchmark benchmark("AtmospherePrecompute pipeline (gpu)");
+
+    const int n = 8;
+
+    osg::ref_ptr<AtmospherePrecompute> precompute(new AtmospherePrecompute);
+    precompute->setCacheDirectory("");
+
+    const float mieG = precompute->getModelConfig().mieG;
+
+    benchmark.start();
+    for(int i = 0; i < n; ++i)
+    {
+        precompute->releasePipeline();
+
+        precompute->getModelConfig().mieG = mieG + i * 0.01f;
+        precompute->compute(false);
+    }
+    const double setup = benchmark.stop("setup per compute", n);
+
+    benchmark.start();
+    for(int i = 0; i < n; ++i)
+    {
+        precompute->getModelConfig().mieG = mieG + i * 0.01f;
+        precompute->compute(false);
+    }
+    const double retained = benchmark.stop("retained pipeline", n);
+
+    Benchmark::report("  speedup", setup / retained, "x");
+}
+
+
+// Evaluates the sky radiance on the cpu for a 64 x 32 grid of directions
+// (e.g., for an ambient light probe), one query per direction and one
+// batched query for all directions.
+
+void bench_skyQuery()
+{
+    Benchmark benchmark("AtmosphereQuery");
+
+    osg::ref_ptr<CpuAtmospherePrecompute> precompute(new CpuAtmospherePrecompute);
+    precompute->compute();
+
+    AtmosphereQuery query;
+    query.update(precompute.get());
+
+    const int w = 64;
+    const int h = 32;
+
+    std::vector<osg::Vec3f> directions(w * h);
+    std::vector<osg::Vec3f> radiances(w * h);
+
+    for(int y = 0; y < h; ++y)
+        for(int x = 0; x < w; ++x)
+        {
+            const float a = _PI2 * (x + 0.5f) / w;
+            const float e = _PI  * (y + 0.5f) / h - _PI_2;
+
+            directions[y * w + x] = osg::Vec3f(cos(a) * cos(e), sin(a) * cos(e), sin(e));
+        }
+
+    const osg::Vec3f sun(0.f, cos(0.3f), sin(0.3f));
+    const int n = 16;
+
+    benchmark.start();
+    for(int i = 0; i < n; ++i)
+        for(int j = 0; j < w * h; ++j)
+            radiances[j] = query.radiance(directions[j], sun, 0.2f);
+    const double single = benchmark.stop("single", n * w * h);
+
+    benchmark.start();
+    for(int i = 0; i < n; ++i)
+        query.radiance(&directions[0], &radiances[0], w * h, sun, 0.2f);
+    const double batched = benchmark.stop("batched", n * w * h);
+
+    Benchmark::report("  speedup", single / batched, "x");
+
+    benchmark.start();
+    osg::Vec3f t;
+    for(int i = 0; i < n * w * h; ++i)
+        t += query.sunTransmittance(0.2f, sun);
+    benchmark.stop("sunTransmittance", n * w * h);
+}
+
+
+// Encodes and decodes the inscatter table of the cpu precompute in each
+// storage format, and reports the memory and precision of the formats.
+
+void bench_inscatterFormats()
+{
+    Benchmark benchmark("AtmosphereFormat");
+
+    osg::ref_ptr<CpuAtmospherePrecompute> precompute(new CpuAtmospherePrecompute);
+    precompute->compute();
+
+    const osg::Image *source(precompute->getInscatterImage());
+    const int texels = source->s() * source->t() * source->r();
+
+    const int n = 4;
+
+    for(int f = 0; f < AtmosphereFormat::NUM_FORMATS; ++f)
+    {
+        const AtmosphereFormat::e_Format format(static_cast<AtmosphereFormat::e_Format>(f));
+        const std::string name(AtmosphereFormat::name(format));
+
+        osg::ref_ptr<osg::Image> color(new osg::Image);
+        osg::ref_ptr<osg::Image> mie(new osg::Image);
+        osg::ref_ptr<osg::Image> decoded(new osg::Image);
+
+        AtmosphereFormat::t_logRange colorRange;
+        AtmosphereFormat::t_logRange mieRange;
+
+        benchmark.start();
+        for(int i = 0; i < n; ++i)
+            AtmosphereFormat::encode(format, source, color.get(), mie.get(), colorRange, mieRange);
+        benchmark.stop(name + " encode", n);
+
+        benchmark.start();
+        for(int i = 0; i < n; ++i)
+            AtmosphereFormat::decode(format, color.get(), mie.get(), colorRange, mieRange, decoded.get());
+        benchmark.stop(name + " decode", n);
+
+        const AtmosphereFormat::t_errorReport report(AtmosphereFormat::errorReport(format, source));
+
+        Benchmark::report("  memory", texels * report.bytesPerTexel / (1024.0 * 1024.0), "MiB");
+        Benchmark::report("  max relative error", report.maxRelativeError * 100.0, "%");
+        Benchmark::report("  mean relative error", report.meanRelativeError * 100.0, "%");
+    }
+}
+
+
+// Computes three presets (clear, hazy, and clear with a stronger forward
+// scattering) into an atlas, compared to a full compute per preset. The
+// clear presets differ in multiple scattering only.
+
+void bench_presetAtlas()
+{
+    Benchmark benchmark("AtmosphereAtlas");
+
+    osg::ref_ptr<CpuAtmospherePrecompute> precompute(new CpuAtmospherePrecompute);
+    precompute->setCacheDirectory("");
+
+    const AtmosphereAtlas::t_modelCfg clear(precompute->getModelConfig());
+
+    AtmosphereAtlas::t_modelCfg hazy(clear);
+    hazy.betaMSca *= 2.f;
+    hazy.betaMEx = hazy.betaMSca / 0.9f;
+
+    AtmosphereAtlas::t_modelCfg forward(clear);
+    forward.mieG = 0.76f;
+
+    AtmosphereAtlas::t_modelCfgs presets;
+    presets.push_back(clear);
+    presets.push_back(hazy);
+    presets.push_back(forward);
+
+    const int n = static_cast<int>(presets.size());
+
+    benchmark.start();
+    for(int i = 0; i < n; ++i)
+    {
+        osg::ref_ptr<CpuAtmospherePrecompute> single(new CpuAtmospherePrecompute);
+        single->setCacheDirectory("");
+
+        single->getModelConfig() = presets[i];
+        single->compute();
+    }
+    const double separate = benchmark.stop("compute per preset", n);
+
+    AtmosphereAtlas atlas;
+
+    benchmark.start();
+    atlas.compute(precompute.get(), presets);
+    const double batched = benchmark.stop("atlas", n);
+
+    Benchmark::report("  speedup", separate / batched, "x");
+    Benchmark::report("  transmittance layers", atlas.getNumTransmittanceLayers());
+}
+
+
+namespace
+{
+    // Max and mean difference of the rgb channels per texel, relative to
+    // the largest channel of the reference texel (or 1e-4 of the tables
+    // maximum).
+
+    void reportDifference(
+        const std::string &label
+    ,   const osg::Image *image
+    ,   const osg::Image *reference)
+    {
+        const int components = osg::Image::computeNumComponents(reference->getPixelFormat());
+        const int size = reference->getTotalSizeInBytes() / sizeof(float) / components;
+
+        const float *a(reinterpret_cast<const float*>(image->data()));
+        const float *b(reinterpret_cast<const float*>(reference->data()));
+
+        double maximum = 0.0;
+        for(int i = 0; i < size * components; ++i)
+            maximum = _ma(maximum, static_cast<double>(_abs(b[i])));
+
+        double max = 0.0;
+        double mean = 0.0;
+
+        for(int i = 0; i < size; ++i)
+        {
+            double value = 1e-4 * maximum;
+            double difference = 0.0;
+
+            for(int c = 0; c < _mi(components, 3); ++c)
+            {
+                value = _ma(value, static_cast<double>(_abs(b[i * components + c])));
+                difference = _ma(difference, static_cast<double>(_abs(a[i * components + c] - b[i * components + c])));
+            }
+            max = _ma(max, difference / value);
+            mean += difference / value;
+        }
+        Benchmark::report("  " + label + " max difference", max * 100.0, "%");
+        Benchmark::report("  " + label + " mean difference", mean / size * 100.0, "%");
+    }
+}
+
+
+// Compares the complete cpu precompute with fixed sample counts to the
+// adaptive integration with a tolerance of 1e-3, reporting the pass times
+// of both and the relative differences of the tables.
+
+void bench_adaptiveIntegration()
+{
+    Benchmark benchmark("AtmospherePrecompute adaptive integration");
+
+    osg::ref_ptr<CpuAtmospherePrecompute> fixed(new CpuAtmospherePrecompute);
+    fixed->setCacheDirectory("");
+
+    osg::ref_ptr<CpuAtmospherePrecompute> adaptive(new CpuAtmospherePrecompute);
+    adaptive->setCacheDirectory("");
+    adaptive->setIntegralTolerance(1e-3f);
+
+    benchmark.start();
+    fixed->compute(false);
+    const double f = benchmark.stop("fixed samples");
+
+    benchmark.start();
+    adaptive->compute(false);
+    const double a = benchmark.stop("adaptive (1e-3)");
+
+    Benchmark::report("  speedup", f / a, "x");
+
+    for(int i = 0; i < AtmospherePrecompute::NUM_PASSES; ++i)
+    {
+        const AtmospherePrecompute::e_Pass pass(static_cast<AtmospherePrecompute::e_Pass>(i));
+        const std::string name(AtmospherePrecompute::passName(pass));
+
+        Benchmark::report("  " + name + " fixed", fixed->getPassTime(pass) * 1e3, "ms");
+        Benchmark::report("  " + name + " adaptive", adaptive->getPassTime(pass) * 1e3, "ms");
+    }
+
+    reportDifference("transmittance", adaptive->getTransmittanceImage(), fixed->getTransmittanceImage());
+    reportDifference("irradiance", adaptive->getIrradianceImage(), fixed->getIrradianceImage());
+    reportDifference("inscatter", adaptive->getInscatterImage(), fixed->getInscatterImage());
+}
@@ -0,0 +1,90 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "benchmark.h"
+
+#include <iostream>
+#include <iomanip>
+#include <math.h>
+
+
+Benchmark::Benchmark(const std::string &name)
+:   m_start(osg::Timer::instance()->tick())
+{
+    std::cout << std::endl << "---- Benchmark " << name << std::endl << std::endl;
+}
+
+
+Benchmark::~Benchmark()
+{
+    std::cout << std::endl;
+}
+
+
+void Benchmark::start()
+{
+    m_start = osg::Timer::instance()->tick();
+}
+
+
+const double Benchmark::stop(
+    const std::string &label
+,   const int iterations)
+{
+    const double s = osg::Timer::instance()->delta_s(m_start, osg::Timer::instance()->tick());
+
+    std::cout << std::setw(40) << std::left << label << std::right
+        << std::fixed << std::setprecision(4) << std::setw(12) << s << " s";
+
+    if(iterations > 1)
+        std::cout << std::setprecision(6) << std::setw(16) << s * 1000.0 / iterations << " ms/it";
+
+    std::cout << std::endl;
+
+    return s;
+}
+
+
+void Benchmark::report(
+    const std::string &label
+,   const double value
+,   const std::string &unit)
+{
+    std::cout << std::setw(40) << std::left << label << std::right;
+
+    // small deviations would read as zero in fixed notation
+
+    if(0.0 != value && fabs(value) < 1e-3)
+        std::cout << std::scientific << std::setprecision(2);
+    else
+        std::cout << std::fixed << std::setprecision(4);
+
+    std::cout << std::setw(12) << value << " " << unit << std::endl;
+}
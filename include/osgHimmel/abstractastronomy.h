@@ -33,7 +33,8 @@
 
 #include "declspec.h"
 #include "atime.h"
-#include "julianday.h"
+#include "juliantime.h"
+#include "coords.h"
 
 #include <osg/Vec3>
 #include <osg/Matrix>
@@ -42,6 +43,54 @@
 namespace osgHimmel
 {
 
+// Everything the geodes take from the astronomy per frame, computed once
+// by AbstractAstronomy::update for its time and observer.
+
+typedef struct AstronomySnapshot
+{
+    AstronomySnapshot();
+
+    t_julianTime time;
+    t_julianDay t;
+    t_julianDay siderealTime;
+
+    float latitude;
+    float longitude;
+
+    // apparent positions in degrees
+    t_equd sunEquatorial;
+    t_equd moonEquatorial;
+
+    // normalized horizontal positions (as of getSunPosition)
+
+    osg::Vec3f sun;
+    osg::Vec3f sunRefracted;
+    osg::Vec3f moon;
+    osg::Vec3f moonRefracted;
+
+    float sunDistance;
+    float angularSunRadius;
+
+    float moonRadius;
+    float moonDistance;
+    float angularMoonRadius;
+
+    osg::Matrixf moonOrientation;
+    float earthShineIntensity;
+
+    osg::Matrixf equToHorTransform;
+
+} t_astronomySnapshot;
+
+
+// The getters taking a time (and observer), the batched getters and 
+// computeSnapshot are pure functions of their arguments: they neither read
+// nor write the time and observer of update and the setters, and can be 
+// called from any number of threads, also while the update traversal runs.
+// The configuration of subclasses (e.g., ephemeris cache or series error)
+// must not change meanwhile. The getters without time and observer return
+// the snapshot of the last update and belong to the updating thread.
+
 class OSGH_API AbstractAstronomy
 {
 public:
@@ -50,13 +99,31 @@ public:
     virtual ~AbstractAstronomy();
 
 
-    void update(const t_aTime &aTime);
+    void update(const t_julianTime &time);
 
-    inline const t_aTime &getATime() const
+    inline const t_julianTime &getTime() const
     {
-        return m_aTime;
+        return m_time;
     }
 
+    inline const t_aTime getATime() const
+    {
+        return m_time.toATime();
+    }
+
+    // Snapshot of the last update, which the getters without time and
+    // observer return from.
+    inline const t_astronomySnapshot &getSnapshot() const
+    {
+        return m_snapshot;
+    }
+
+    // Snapshot of the given time and observer (reentrant, see above).
+    const t_astronomySnapshot computeSnapshot(
+        const t_julianTime &time
+    ,   const float latitude
+    ,   const float longitude) const;
+
 
     const float setLatitude(const float latitude);
     const float getLatitude() const;
@@ -67,72 +134,208 @@ public:
 
     const osg::Matrixf getMoonOrientation() const;
     const osg::Matrixf getMoonOrientation(
-        const t_aTime &aTime
+        const t_julianTime &time
     ,   const float latitude
     ,   const float longitude) const;
 
     const osg::Vec3f getMoonPosition(const bool refractionCorrected) const;
     const osg::Vec3f getMoonPosition(
-        const t_aTime &aTime
+        const t_julianTime &time
     ,   const float latitude
     ,   const float longitude
     ,   const bool refractionCorrected) const;
 
     const osg::Vec3f getSunPosition(const bool refractionCorrected) const;
     const osg::Vec3f getSunPosition(
-        const t_aTime &aTime
+        const t_julianTime &time
     ,   const float latitude
     ,   const float longitude
     ,   const bool refractionCorrected) const;
 
+    // Positions of count instants and observers at once, as components of
+    // the normalized vectors of getSunPosition and getMoonPosition. The 
+    // series of the ephemerides are evaluated over all instants at once,
+    // which is much faster than calling the above per instant.
+
+    void getSunPositions(
+        const t_julianTime *times
+    ,   const float *latitudes
+    ,   const float *longitudes
+    ,   const unsigned int count
+    ,   const bool refractionCorrected
+    ,   float *x
+    ,   float *y
+    ,   float *z) const;
+
+    void getMoonPositions(
+        const t_julianTime *times
+    ,   const float *latitudes
+    ,   const float *longitudes
+    ,   const unsigned int count
+    ,   const bool refractionCorrected
+    ,   float *x
+    ,   float *y
+    ,   float *z) const;
+
+    // Convert the instants first.
+
+    void getSunPositions(
+        const t_aTime *aTimes
+    ,   const float *latitudes
+    ,   const float *longitudes
+    ,   const unsigned int count
+    ,   const bool refractionCorrected
+    ,   float *x
+    ,   float *y
+    ,   float *z) const;
+
+    void getMoonPositions(
+        const t_aTime *aTimes
+    ,   const float *latitudes
+    ,   const float *longitudes
+    ,   const unsigned int count
+    ,   const bool refractionCorrected
+    ,   float *x
+    ,   float *y
+    ,   float *z) const;
+
+    // Positions of one instant for count observers. The apparent position 
+    // and the sidereal time are evaluated once, and only transformed into
+    // the horizontal frame of each observer.
+
+    void getSunPositions(
+        const t_julianTime &time
+    ,   const float *latitudes
+    ,   const float *longitudes
+    ,   const unsigned int count
+    ,   const bool refractionCorrected
+    ,   float *x
+    ,   float *y
+    ,   float *z) const;
+
+    void getMoonPositions(
+        const t_julianTime &time
+    ,   const float *latitudes
+    ,   const float *longitudes
+    ,   const unsigned int count
+    ,   const bool refractionCorrected
+    ,   float *x
+    ,   float *y
+    ,   float *z) const;
+
     const float getEarthShineIntensity() const;
     const float getEarthShineIntensity(
-        const t_aTime &aTime
+        const t_julianTime &time
     ,   const float latitude
     ,   const float longitude) const;
 
     const float getSunDistance() const;
-    const float getSunDistance(const t_aTime &aTime) const;
+    const float getSunDistance(const t_julianTime &time) const;
 
     const float getAngularSunRadius() const;
-    const float getAngularSunRadius(const t_aTime &aTime) const;
+    const float getAngularSunRadius(const t_julianTime &time) const;
 
     const float getMoonDistance() const;
-    const float getMoonDistance(const t_aTime &aTime) const;
+    const float getMoonDistance(const t_julianTime &time) const;
 
     const float getMoonRadius() const;
 
     const float getAngularMoonRadius() const;
-    const float getAngularMoonRadius(const t_aTime &aTime) const;
+    const float getAngularMoonRadius(const t_julianTime &time) const;
 
     const osg::Matrixf getEquToHorTransform() const;
     const osg::Matrixf getEquToHorTransform(
-        const t_aTime &aTime
+        const t_julianTime &time
     ,   const float latitude
     ,   const float longitude) const;
 
 
 protected:
 
+    // Computes the snapshot of a time and observer. Calls the virtuals 
+    // below once each by default, subclasses should compute terms shared
+    // by several quantities only once.
+    virtual void snapshot(
+        const t_julianTime &time
+    ,   const float latitude
+    ,   const float longitude
+    ,   t_astronomySnapshot &snapshot) const;
+
     virtual const osg::Vec3f moonPosition(
-        const t_aTime &aTime
+        const t_julianTime &time
     ,   const float latitude
     ,   const float longitude
     ,   const bool refractionCorrected) const = 0;
 
     virtual const osg::Vec3f sunPosition(
-        const t_aTime &aTime
+        const t_julianTime &time
     ,   const float latitude
     ,   const float longitude
     ,   const bool refractionCorrected) const = 0;
 
+    // Calls sunPosition and moonPosition per instant by default (count 
+    // is greater than 0).
+
+    virtual void sunPositions(
+        const t_julianTime *times
+    ,   const float *latitudes
+    ,   const float *longitudes
+    ,   const unsigned int count
+    ,   const bool refractionCorrected
+    ,   float *x
+    ,   float *y
+    ,   float *z) const;
+
+    virtual void moonPositions(
+        const t_julianTime *times
+    ,   const float *latitudes
+    ,   const float *longitudes
+    ,   const unsigned int count
+    ,   const bool refractionCorrected
+    ,   float *x
+    ,   float *y
+    ,   float *z) const;
+
+    // Transforms apparent equatorial positions in degrees to normalized
+    // horizontal vectors (see s_EquatorialCoords::toHorizontal and 
+    // s_HorizontalCoords::toEuclidean), without converting to angles.
+
+    static void horizontalPositions(
+        const t_julianTime *times
+    ,   const double *rightAscensions
+    ,   const double *declinations
+    ,   const float *latitudes
+    ,   const float *longitudes
+    ,   const unsigned int count
+    ,   const bool refractionCorrected
+    ,   float *x
+    ,   float *y
+    ,   float *z);
+
+    // Transforms one apparent equatorial position for count observers.
+    static void horizontalPositions(
+        const t_julianDay siderealTime
+    ,   const t_equd &equ
+    ,   const float *latitudes
+    ,   const float *longitudes
+    ,   const unsigned int count
+    ,   const bool refractionCorrected
+    ,   float *x
+    ,   float *y
+    ,   float *z);
+
+    // Apparent equatorial positions in degrees. These are restored from 
+    // the horizontal positions of an observer by default.
+    virtual const t_equd sunApparentPosition(const t_julianTime &time) const;
+    virtual const t_equd moonApparentPosition(const t_julianTime &time) const;
+
     virtual const osg::Matrixf moonOrientation(
-        const t_aTime &aTime
+        const t_julianTime &time
     ,   const float latitude
     ,   const float longitude) const = 0;
 
     virtual const float earthShineIntensity(
-        const t_aTime &aTime
+        const t_julianTime &time
     ,   const float latitude
     ,   const float longitude) const = 0;
 
@@ -144,7 +347,7 @@ protected:
     virtual const float angularMoonRadius(const t_julianDay t) const = 0;
 
     virtual const osg::Matrixf equToHorTransform(
-        const t_aTime &aTime
+        const t_julianTime &time
     ,   const float latitude
     ,   const float longitude) const = 0;
 
@@ -155,9 +358,11 @@ protected:
 
 protected:
 
-    t_aTime m_aTime;
+    t_julianTime m_time;
     t_julianDay m_t;
 
+    t_astronomySnapshot m_snapshot;
+
     float m_latitude;
     float m_longitude;
 };
@@ -0,0 +1,122 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#ifndef __APPARENTSTARS_H__
+#define __APPARENTSTARS_H__
+
+#include "declspec.h"
+#include "brightstars.h"
+#include "stars.h"
+
+#include <osg/Vec3f>
+
+#include <vector>
+
+
+namespace osgHimmel
+{
+
+// Apparent places of all stars of a catalogue (see Stars::apparentPosition).
+// The J2000 positions and proper motions are converted to vectors once.
+// Propagating to an epoch derives its rotation and aberration once (see
+// t_starsEpoch) and takes a handful of multiply-adds per star, in one
+// loop over arrays of floats.
+//
+// The positions are kept for their epoch. update propagates again only if
+// the julian day drifts from it by more than the interval within which no
+// star moves by more than the tolerance (from bounds of the rates of 
+// aberration, precession, nutation, and the fastest proper motion).
+
+class OSGH_API ApparentStars
+{
+public:
+
+    ApparentStars(const double tolerance = defaultTolerance());
+
+    // Copies positions and proper motions, and drops the positions.
+    void setStars(
+        const BrightStars::s_BrightStar *stars
+    ,   const unsigned int numStars);
+
+    const unsigned int numStars() const;
+
+    // Maximum displacement of a star in arcseconds, until the positions
+    // are propagated again.
+    const double setTolerance(const double arcsecs);
+    const double getTolerance() const;
+    static const double defaultTolerance();
+
+    // Drift of the epoch in julian days within the tolerance.
+    const double getInterval() const;
+
+    // Propagates all stars, if the epoch of the positions is more than the
+    // interval off or there are no positions. Returns true if propagated.
+    const bool update(const t_julianDay t);
+
+    // Propagates all stars to t.
+    void propagate(const t_julianDay t);
+
+    const bool isValid() const;
+    const t_julianDay epoch() const;
+
+    // Unit vectors in the true equatorial frame of the epoch, as of 
+    // s_EquatorialCoords::toEuclidean. NULL without positions.
+    const osg::Vec3f *positions() const;
+
+protected:
+
+    void updateInterval();
+
+protected:
+
+    double m_tolerance;
+    double m_interval;
+
+    // fastest proper motion in arcseconds per year
+    double m_maxProperMotion;
+
+    // J2000 positions and proper motions per julian year
+
+    std::vector<float> m_x;
+    std::vector<float> m_y;
+    std::vector<float> m_z;
+    std::vector<float> m_px;
+    std::vector<float> m_py;
+    std::vector<float> m_pz;
+
+    bool m_valid;
+    t_julianDay m_epoch;
+
+    std::vector<osg::Vec3f> m_positions;
+};
+
+} // namespace osgHimmel
+
+#endif // __APPARENTSTARS_H__
@@ -33,43 +33,123 @@
 
 #include "declspec.h"
 #include "abstractastronomy.h"
+#include "ephemeriscache.h"
+#include "periodicterms.h"
+#include "nutationcache.h"
+#include "coords.h"
+
+#include <osg/ref_ptr>
 
 
 namespace osgHimmel
 {
 
-class OSGH_API Astronomy : public AbstractAstronomy
+// Evaluates SunT, MoonT, and EarthT of precision t_real, instantiated for
+// float, double, and long double (Astronomy, see precision.h).
+
+template<typename t_real>
+class OSGH_API AstronomyT : public AbstractAstronomy
 {
 public:
 
-    Astronomy();
+    AstronomyT();
+
+    // Positions and distances of sun and moon are taken from the cache for
+    // julian days it covers (NULL disables it). A cache can be shared by 
+    // several instances (of any precision).
+    void setEphemerisCache(EphemerisCache *cache);
+    EphemerisCache *getEphemerisCache() const;
+
+    // Truncates the periodic series of MoonT and EarthT to a maximum error
+    // in degrees per series, trading accuracy for speed (zero evaluates 
+    // all terms, see SeriesTruncation). Cached quantities are not affected.
+    const double setMaxSeriesError(const double maxError);
+    const double getMaxSeriesError() const;
+
+    // Interpolates the nutations, the slowly varying terms of the series,
+    // within a tolerance in degrees, so that per frame only the fast 
+    // varying terms of sun and moon are evaluated (zero evaluates the 
+    // series, see NutationCache). The batched getters are not affected.
+    const double setNutationTolerance(const double tolerance);
+    const double getNutationTolerance() const;
 
 protected:
 
+    virtual void snapshot(
+        const t_julianTime &time
+    ,   const float latitude
+    ,   const float longitude
+    ,   t_astronomySnapshot &snapshot) const;
+
+    const bool isCached(const t_julianDay t) const;
+
+    // NULL if the series are complete
+    const SeriesTruncation *truncation() const;
+
+    // Nutations in degrees, interpolated if a tolerance is set.
+    const t_real longitudeNutation(const t_julianDay t) const;
+    const t_real obliquityNutation(const t_julianDay t) const;
+
+    // Apparent positions of the series (with the above nutations).
+    const s_EquatorialCoords<t_real> sunEquatorial(const t_julianDay t) const;
+    const s_EquatorialCoords<t_real> moonEquatorial(const t_julianDay t) const;
+
+    // Apparent positions from the cache where covered, and from the 
+    // batched series otherwise.
+    void apparentPositions(
+        const bool moon
+    ,   const double *t
+    ,   const unsigned int count
+    ,   double *rightAscensions
+    ,   double *declinations) const;
+
     virtual const osg::Vec3f moonPosition(
-        const t_aTime &aTime
+        const t_julianTime &time
     ,   const float latitude
     ,   const float longitude
     ,   const bool refractionCorrected) const;
 
     virtual const osg::Vec3f sunPosition(
-        const t_aTime &aTime
+        const t_julianTime &time
     ,   const float latitude
     ,   const float longitude
     ,   const bool refractionCorrected) const;
 
+    virtual void sunPositions(
+        const t_julianTime *times
+    ,   const float *latitudes
+    ,   const float *longitudes
+    ,   const unsigned int count
+    ,   const bool refractionCorrected
+    ,   float *x
+    ,   float *y
+    ,   float *z) const;
+
+    virtual void moonPositions(
+        const t_julianTime *times
+    ,   const float *latitudes
+    ,   const float *longitudes
+    ,   const unsigned int count
+    ,   const bool refractionCorrected
+    ,   float *x
+    ,   float *y
+    ,   float *z) const;
+
+    virtual const t_equd sunApparentPosition(const t_julianTime &time) const;
+    virtual const t_equd moonApparentPosition(const t_julianTime &time) const;
+
     virtual const osg::Matrixf moonOrientation(
-        const t_aTime &aTime
+        const t_julianTime &time
     ,   const float latitude
     ,   const float longitude) const;
 
     virtual const float earthShineIntensity(
-        const t_aTime &aTime
+        const t_julianTime &time
     ,   const float latitude
     ,   const float longitude) const;
 
     virtual const osg::Matrixf equToHorTransform(
-        const t_aTime &aTime
+        const t_julianTime &time
     ,   const float latitude
     ,   const float longitude) const;
 
@@ -80,8 +160,16 @@ protected:
 
     virtual const float moonDistance(const t_julianDay t) const;
     virtual const float angularMoonRadius(const t_julianDay t) const;
+
+protected:
+
+    osg::ref_ptr<EphemerisCache> m_cache;
+    SeriesTruncation m_truncation;
+    NutationCache m_nutations;
 };
 
+typedef AstronomyT<t_longf> Astronomy;
+
 } // namespace osgHimmel
 
 #endif // __ASTRONOMY_H__
\ No newline at end of file
@@ -47,29 +47,32 @@ public:
 protected:
 
     virtual const osg::Vec3f moonPosition(
-        const t_aTime &aTime
+        const t_julianTime &time
     ,   const float latitude
     ,   const float longitude
     ,   const bool refractionCorrected) const;
 
     virtual const osg::Vec3f sunPosition(
-        const t_aTime &aTime
+        const t_julianTime &time
     ,   const float latitude
     ,   const float longitude
     ,   const bool refractionCorrected) const;
 
+    virtual const t_equd sunApparentPosition(const t_julianTime &time) const;
+    virtual const t_equd moonApparentPosition(const t_julianTime &time) const;
+
     virtual const osg::Matrixf moonOrientation(
-        const t_aTime &aTime
+        const t_julianTime &time
     ,   const float latitude
     ,   const float longitude) const;
 
     virtual const float earthShineIntensity(
-        const t_aTime &aTime
+        const t_julianTime &time
     ,   const float latitude
     ,   const float longitude) const;
 
     virtual const osg::Matrixf equToHorTransform(
-        const t_aTime &aTime
+        const t_julianTime &time
     ,   const float latitude
     ,   const float longitude) const;
 
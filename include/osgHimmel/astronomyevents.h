@@ -0,0 +1,133 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#ifndef __ASTRONOMYEVENTS_H__
+#define __ASTRONOMYEVENTS_H__
+
+#include "declspec.h"
+#include "julianday.h"
+
+#include <vector>
+
+
+namespace osgHimmel
+{
+
+class AbstractAstronomy;
+
+
+// Finds rise, set, and transit of sun and moon, as well as the twilights,
+// for an observer and range of julian days. The apparent positions are 
+// taken from the batched getters of an astronomy a few times a day and 
+// interpolated, the horizontal positions are derived from those. The 
+// altitudes are sampled at a fixed step, and every sign change of the 
+// altitude above the altitude of an event is refined by regula falsi 
+// (Illinois) to about a millisecond. Transits are found likewise as sign
+// changes of the hour angle. Event times agree with the positions of the
+// astronomy to a fraction of a second.
+//
+// Altitudes are geometric, as usual for tables: rise and set of the sun 
+// refer to its upper limb at -0.8333 degrees (standard refraction), the
+// moon additionally accounts for its horizontal parallax (AA.15.1). Events
+// closer than the step (e.g., a sun grazing the horizon) might be missed.
+
+class OSGH_API AstronomyEvents
+{
+public:
+
+    enum e_Body
+    {
+        B_Sun
+    ,   B_Moon
+    };
+
+    enum e_Event
+    {
+        E_Rise
+    ,   E_Set
+    ,   E_Transit           // upper culmination
+    ,   E_CivilDawn         // sun only, -6 degrees
+    ,   E_CivilDusk
+    ,   E_NauticalDawn      // sun only, -12 degrees
+    ,   E_NauticalDusk
+    ,   E_AstronomicalDawn  // sun only, -18 degrees
+    ,   E_AstronomicalDusk
+    ,   NUM_EVENTS
+    };
+
+    typedef struct Event
+    {
+        e_Body body;
+        e_Event event;
+
+        // as of jd
+        t_julianDay t;
+
+    } t_event;
+
+    typedef std::vector<t_event> t_events;
+
+public:
+
+    // The astronomy has to outlive this.
+    AstronomyEvents(const AbstractAstronomy &astro);
+
+    // Appends all events of a body within [begin; end[ to events, sorted
+    // by time. Returns the number of events appended. Reentrant, as are 
+    // the getters of the astronomy taking a time.
+    const unsigned int events(
+        const e_Body body
+    ,   const t_julianDay begin
+    ,   const t_julianDay end
+    ,   const float latitude
+    ,   const float longitude
+    ,   t_events &events) const;
+
+    // Interval of the altitude samples in seconds.
+    const unsigned int setStep(const unsigned int seconds);
+    const unsigned int getStep() const;
+    static const unsigned int defaultStep();
+
+    // Geometric altitude of an event in degrees (not defined for transits, 
+    // and depending on the distance of the moon).
+    static const double altitude(
+        const e_Body body
+    ,   const e_Event event
+    ,   const double distance = 0.0);
+
+protected:
+
+    const AbstractAstronomy &m_astro;
+    unsigned int m_step;
+};
+
+} // namespace osgHimmel
+
+#endif // __ASTRONOMYEVENTS_H__
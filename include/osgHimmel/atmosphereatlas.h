@@ -0,0 +1,155 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#ifndef __ATMOSPHEREATLAS_H__
+#define __ATMOSPHEREATLAS_H__
+
+#include "declspec.h"
+#include "atmosphereprecompute.h"
+
+#include <osg/Referenced>
+#include <osg/ref_ptr>
+
+#include <vector>
+
+namespace osg
+{
+    class Texture2DArray;
+    class Texture3D;
+    class Image;
+}
+
+
+namespace osgHimmel
+{
+
+// Tables of several model configs (presets, e.g., clear, hazy, polluted,
+// or a fictional planet), computed in one batch and bound at once, so
+// that AtmosphereGeode switches or blends presets by uniforms only.
+//
+// Transmittance and irradiance tables are layers of array textures, and
+// presets of equal transmittance parameters share a layer. The inscatter
+// tables are stacked in r (depth) of a single 3d texture, which keeps
+// filtering within a preset (see glsl_bruneton_texture4D).
+
+class OSGH_API AtmosphereAtlas : public osg::Referenced
+{
+public:
+
+    typedef AtmospherePrecompute::t_preTexCfg t_preTexCfg;
+    typedef AtmospherePrecompute::t_modelCfg  t_modelCfg;
+
+    typedef std::vector<t_modelCfg> t_modelCfgs;
+
+public:
+
+    AtmosphereAtlas();
+    virtual ~AtmosphereAtlas();
+
+    // Computes the tables of all presets (blocking). The presets are run
+    // in an order that keeps the retained stages of the precompute valid
+    // for as long as possible, so passes that do not read parameters
+    // differing between presets run once (see AtmospherePrecompute::
+    // e_Stage). The model config of the precompute is restored, and
+    // marked dirty, afterwards. Returns false if a compute failed.
+    const bool compute(
+        AtmospherePrecompute *precompute
+    ,   const t_modelCfgs &presets);
+
+    const bool isValid() const;
+
+    const int getNumPresets() const;
+    const t_modelCfg &getPreset(const int preset) const;
+
+    // Texture config all presets were computed with.
+    const t_preTexCfg &getTextureConfig() const;
+
+    // Stages (mask of 1 << e_Stage) run for a preset.
+    const unsigned int getComputedStages(const int preset) const;
+
+    const int getNumTransmittanceLayers() const;
+    const int getTransmittanceLayer(const int preset) const;
+
+    osg::Texture2DArray *getTransmittanceTexture();
+    osg::Texture2DArray *getIrradianceTexture();
+    osg::Texture3D *getInscatterTexture();
+
+    // Tables of a preset, e.g., for AtmosphereQuery (the inscatter image
+    // refers to the layers of the preset in the stacked image).
+
+    osg::Image *getTransmittanceImage(const int preset);
+    osg::Image *getIrradianceImage(const int preset);
+    osg::Image *getInscatterImage(const int preset);
+
+    // Inscatter tables of all presets, stacked in r.
+    osg::Image *getInscatterImage();
+
+    // Linear blend of the parameters of two presets, as used for the
+    // phase functions while blending their tables.
+    static const t_modelCfg blend(
+        const t_modelCfg &a
+    ,   const t_modelCfg &b
+    ,   const float t);
+
+protected:
+
+    typedef std::vector<osg::ref_ptr<osg::Image> > t_images;
+
+    void clear();
+
+    // Preset indices in order of computation.
+    static void computeOrder(
+        const t_modelCfgs &presets
+    ,   std::vector<int> &order);
+
+    void setupTextures();
+
+protected:
+
+    t_preTexCfg m_preTexCfg;
+    t_modelCfgs m_presets;
+
+    std::vector<unsigned int> m_computedStages;
+    std::vector<int> m_transmittanceLayers;
+
+    t_images m_transmittanceImages; // per layer
+    t_images m_irradianceImages;
+    t_images m_inscatterImages;     // views into m_inscatterImage
+
+    osg::ref_ptr<osg::Image> m_inscatterImage;
+
+    osg::ref_ptr<osg::Texture2DArray> m_transmittanceTexture;
+    osg::ref_ptr<osg::Texture2DArray> m_irradianceTexture;
+    osg::ref_ptr<osg::Texture3D> m_inscatterTexture;
+};
+
+} // namespace osgHimmel
+
+#endif // __ATMOSPHEREATLAS_H__
@@ -0,0 +1,115 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#ifndef __ATMOSPHERECACHE_H__
+#define __ATMOSPHERECACHE_H__
+
+#include "declspec.h"
+#include "atmosphereprecompute.h"
+
+#include <string>
+
+
+namespace osg
+{
+    class Image;
+}
+
+
+namespace osgHimmel
+{
+
+class MemoryMappedFile;
+
+// Content addressed on-disk cache for the precomputed transmittance, 
+// irradiance, and inscatter tables. Each configuration is stored in 
+// its own file, named by a hash of the texture and model config. The 
+// file starts with a versioned header, followed by the raw float tables
+// (each aligned to 64 bytes), and is memory mapped on load.
+
+class OSGH_API AtmosphereCache
+{
+public:
+
+    typedef AtmospherePrecompute::t_preTexCfg t_preTexCfg;
+    typedef AtmospherePrecompute::t_modelCfg  t_modelCfg;
+
+    typedef unsigned long long t_hash;
+
+public:
+
+    AtmosphereCache(const std::string &directory);
+
+    const std::string &directory() const;
+
+    // 64 bit FNV-1a of both configs, the earth and atmosphere radii, 
+    // and the file format version.
+    static const t_hash hash(
+        const t_preTexCfg &preTexCfg
+    ,   const t_modelCfg &modelCfg);
+
+    static const unsigned int version();
+
+    // directory/atmosphere_<hash in hex>.bin
+    const std::string filePath(
+        const t_preTexCfg &preTexCfg
+    ,   const t_modelCfg &modelCfg) const;
+
+    // Maps the file of the given configuration (copy on write) and lets 
+    // the images refer to the mapped tables, without copying any data. The
+    // images need to be allocated with the table dimensions and formats,
+    // and must not be used after the returned mapping is released. Returns
+    // NULL on a miss and leaves the images untouched if the file is 
+    // invalid or of another version.
+    MemoryMappedFile *load(
+        const t_preTexCfg &preTexCfg
+    ,   const t_modelCfg &modelCfg
+    ,   osg::Image *transmittance
+    ,   osg::Image *irradiance
+    ,   osg::Image *inscatter) const;
+
+    // Writes the tables to a temporary file (unique per process and call)
+    // that replaces the cached file when complete, see 
+    // MemoryMappedFile::replace. Creates the directory if required.
+    const bool store(
+        const t_preTexCfg &preTexCfg
+    ,   const t_modelCfg &modelCfg
+    ,   const osg::Image *transmittance
+    ,   const osg::Image *irradiance
+    ,   const osg::Image *inscatter) const;
+
+protected:
+
+    const std::string m_directory;
+};
+
+} // namespace osgHimmel
+
+#endif // __ATMOSPHERECACHE_H__
@@ -0,0 +1,189 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#ifndef __ATMOSPHEREFORMAT_H__
+#define __ATMOSPHEREFORMAT_H__
+
+#include "declspec.h"
+
+#include <osg/GL>
+
+namespace osg
+{
+    class Image;
+}
+
+
+namespace osgHimmel
+{
+
+// Storage formats of the inscatter table (rayleigh rgb and mie red as
+// alpha), trading memory for precision. The packed rgb formats store the
+// mie channel in a second 8 bit log encoded table. Log encoded channels
+// are decoded by exp2(mix(min, max, c)) on the GPU, with c the filtered
+// texel in [0;1] and the range of log2 values of the encoded table.
+//
+// The texel codecs process arrays and are written branch free, in
+// integer and float arithmetic only, so that compilers vectorize them.
+
+class OSGH_API AtmosphereFormat
+{
+public:
+
+    enum e_Format
+    {
+        F_RGBA16F       // half floats (8 bytes per texel)
+    ,   F_RGB9E5        // shared exponent rgb (5 bytes with mie)
+    ,   F_R11G11B10F    // packed unsigned floats rgb (5 bytes with mie)
+    ,   F_Log8          // 8 bit log rgba (4 bytes)
+    ,   NUM_FORMATS
+    };
+
+    typedef struct LogRange
+    {
+        float min;
+        float max;
+
+    } t_logRange;
+
+    typedef struct ErrorReport
+    {
+        // relative to the full precision values, per channel (values
+        // below 1e-4 of the tables maximum are compared to that instead)
+        double maxRelativeError;
+        double meanRelativeError;
+
+        unsigned int bytesPerTexel;
+
+    } t_errorReport;
+
+public:
+
+    static const char *name(const e_Format format);
+
+    // Size on the GPU, including the mie table.
+    static const unsigned int bytesPerTexel(const e_Format format);
+
+    // True if the mie channel is stored in a second table.
+    static const bool hasMieTable(const e_Format format);
+
+    // texel codecs (rgba are 4 floats per texel, decoders of rgb formats
+    // leave the alpha untouched)
+
+    static void encodeRGBA16F(
+        const float *rgba
+    ,   unsigned short *encoded
+    ,   const unsigned int count);
+
+    static void decodeRGBA16F(
+        const unsigned short *encoded
+    ,   float *rgba
+    ,   const unsigned int count);
+
+    static void encodeRGB9E5(
+        const float *rgba
+    ,   unsigned int *encoded
+    ,   const unsigned int count);
+
+    static void decodeRGB9E5(
+        const unsigned int *encoded
+    ,   float *rgba
+    ,   const unsigned int count);
+
+    static void encodeR11G11B10F(
+        const float *rgba
+    ,   unsigned int *encoded
+    ,   const unsigned int count);
+
+    static void decodeR11G11B10F(
+        const unsigned int *encoded
+    ,   float *rgba
+    ,   const unsigned int count);
+
+    // Encodes the channels [first; first + channels) of each texel into
+    // channels bytes per texel.
+
+    static void encodeLog8(
+        const float *rgba
+    ,   unsigned char *encoded
+    ,   const unsigned int count
+    ,   const int first
+    ,   const int channels
+    ,   const t_logRange &range);
+
+    static void decodeLog8(
+        const unsigned char *encoded
+    ,   float *rgba
+    ,   const unsigned int count
+    ,   const int first
+    ,   const int channels
+    ,   const t_logRange &range);
+
+    // Range of log2 values of the channels [first; first + channels),
+    // spanning at most maxStops.
+    static const t_logRange logRange(
+        const float *rgba
+    ,   const unsigned int count
+    ,   const int first
+    ,   const int channels
+    ,   const float maxStops = 24.f);
+
+    // Encodes a float rgba image (e.g., the inscatter image of
+    // AtmospherePrecompute) into color and, if required, mie images of
+    // the format, that can be assigned to textures as is.
+
+    static void encode(
+        const e_Format format
+    ,   const osg::Image *source
+    ,   osg::Image *color
+    ,   osg::Image *mie
+    ,   t_logRange &colorRange
+    ,   t_logRange &mieRange);
+
+    // Decodes into a float rgba image of the same size.
+
+    static void decode(
+        const e_Format format
+    ,   const osg::Image *color
+    ,   const osg::Image *mie
+    ,   const t_logRange &colorRange
+    ,   const t_logRange &mieRange
+    ,   osg::Image *target);
+
+    // Encodes and decodes a float rgba image and compares the result
+    // with the source, e.g., to choose a format per platform.
+    static const t_errorReport errorReport(
+        const e_Format format
+    ,   const osg::Image *source);
+};
+
+} // namespace osgHimmel
+
+#endif // __ATMOSPHEREFORMAT_H__
@@ -32,6 +32,8 @@
 #define __ATMOSPHEREGEODE_H__
 
 #include "declspec.h"
+#include "atmosphereformat.h"
+#include "atmosphereatlas.h"
 
 #include <osg/Geode>
 
@@ -46,6 +48,7 @@ namespace osgHimmel
 {
 
 class AtmospherePrecompute;
+class AtmosphereQuery;
 class Himmel;
 class HimmelQuad;
 
@@ -84,6 +87,58 @@ public:
     void setScatteringMie(const float coefficient); 
     void setPhaseG(const float g);  // [-1;+1]
 
+    // Precomputed tables are cached per configuration in this directory,
+    // so that revisiting a configuration skips the precompute (defaults 
+    // to $OSGHIMMEL_ATMOSPHERE_CACHE, see AtmospherePrecompute).
+    void setCacheDirectory(const std::string &directory);
+    const std::string getCacheDirectory() const;
+
+    // Spreads the precompute over several updates, spending about budget
+    // seconds per update (see AtmospherePrecompute::computeProgressive). 
+    // The sky shows single scattering early and gains the higher orders
+    // of scattering within the following frames.
+    void setProgressive(
+        const bool progressive
+    ,   const double budget = 0.004);
+    const bool isProgressive() const;
+
+    // Storage format of the inscatter table on the GPU (defaults to 
+    // RGBA16F). Other formats are encoded on the CPU whenever the tables
+    // are updated, and trade precision for memory and bandwidth.
+    void setInscatterFormat(const AtmosphereFormat::e_Format format);
+    const AtmosphereFormat::e_Format getInscatterFormat() const;
+
+    // Computes the tables of several model configs (e.g., clear, hazy, 
+    // and polluted) into an AtmosphereAtlas (blocking). Afterwards presets
+    // are switched or blended by uniforms only, without any compute. The
+    // tables of the model config are not updated while presets are set,
+    // and an empty vector returns to them.
+    const bool setPresets(const AtmosphereAtlas::t_modelCfgs &presets);
+    const int getNumPresets() const;
+
+    void setPreset(const int preset);
+
+    // Blends from preset a (t = 0) to preset b (t = 1).
+    void blendPresets(
+        const int a
+    ,   const int b
+    ,   const float t);
+
+    const AtmosphereAtlas *getAtlas() const;
+
+    // e.g., for progress and timings
+    const AtmospherePrecompute *getPrecompute() const;
+
+    // The sky as rendered for the altitude and sun of the last update, 
+    // evaluated on the CPU (e.g., for scene lighting). Use the query 
+    // directly for other observers or batches of directions.
+
+    const osg::Vec3f getSkyRadiance(const osg::Vec3f &direction) const;
+    const osg::Vec3f getSunColor() const;       // transmitted sun light
+    const osg::Vec3f getSkyIrradiance() const;  // of a horizontal surface
+
+    const AtmosphereQuery *getQuery() const;
+
 protected:
 
     void precompute();
@@ -94,19 +149,32 @@ protected:
     void setupShader  (osg::StateSet* stateSet);
     void updateShader (osg::StateSet* stateSet);
 
+    void updateTables   (osg::StateSet* stateSet);
+    void updateInscatter(osg::StateSet* stateSet);
+
     const std::string getVertexShaderSource();
     const std::string getFragmentShaderSource();
+    const std::string getInscatterShaderSource() const;
 
 protected:
 
     HimmelQuad *m_hquad;
 
     AtmospherePrecompute *m_precompute;
+    AtmosphereQuery *m_query;
 
     osg::Texture2D *m_transmittance;
     osg::Texture2D *m_irradiance;
     osg::Texture3D *m_inscatter;
 
+    // encoded inscatter, if not RGBA16F
+    AtmosphereFormat::e_Format m_inscatterFormat;
+    osg::ref_ptr<osg::Texture3D> m_inscatterColor;
+    osg::ref_ptr<osg::Texture3D> m_inscatterMie;
+
+    osg::ref_ptr<AtmosphereAtlas> m_atlas;
+    int m_queryPreset; // preset the query refers to
+
     osg::Program *m_program;
     osg::Shader *m_vShader;
     osg::Shader *m_fShader;
@@ -114,9 +182,21 @@ protected:
     osg::ref_ptr<osg::Uniform> u_sunScale;
     osg::ref_ptr<osg::Uniform> u_exposure;
     osg::ref_ptr<osg::Uniform> u_lheurebleue;
+    osg::ref_ptr<osg::Uniform> u_inscatterRanges;
+
+    osg::ref_ptr<osg::Uniform> u_atlasLayers;
+    osg::ref_ptr<osg::Uniform> u_atlasBlend;
+    osg::ref_ptr<osg::Uniform> u_atlasSize;
 
     float m_scale;
 
+    bool m_progressive;
+    double m_budget;
+
+    // of the last update
+    float m_altitude;
+    osg::Vec3f m_sunr;
+
 
 #ifdef OSGHIMMEL_EXPOSE_SHADERS
 public:
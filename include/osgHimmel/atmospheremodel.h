@@ -0,0 +1,195 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#ifndef __ATMOSPHEREMODEL_H__
+#define __ATMOSPHEREMODEL_H__
+
+#include "declspec.h"
+#include "atmosphereprecompute.h"
+
+#include <osg/Vec2f>
+#include <osg/Vec3f>
+#include <osg/Vec4f>
+
+
+namespace osgHimmel
+{
+
+// C++ port of the parameterization and utility functions of the
+// glsl_bruneton_* shader fragments. All functions are const and may
+// be called concurrently. Table lookups emulate LINEAR filtering with
+// CLAMP_TO_EDGE wrapping as used for the precomputed textures.
+
+class OSGH_API AtmosphereModel
+{
+public:
+
+    typedef AtmospherePrecompute::t_preTexCfg t_preTexCfg;
+    typedef AtmospherePrecompute::t_modelCfg  t_modelCfg;
+
+    // Non owning view of tightly packed float texel data,
+    // laid out like osg::Image (x fastest, then y, then z).
+
+    typedef struct FloatTable
+    {
+        FloatTable();
+        FloatTable(
+            float *data
+        ,   const int width
+        ,   const int height
+        ,   const int depth
+        ,   const int components);
+
+        float *texel(
+            const int x
+        ,   const int y
+        ,   const int z = 0) const;
+
+        const osg::Vec4f sample2D(
+            const float u
+        ,   const float v) const;
+
+        const osg::Vec4f sample3D(
+            const float u
+        ,   const float v
+        ,   const float w) const;
+
+        float *data;
+
+        int width;
+        int height;
+        int depth;
+        int components;
+
+    } t_table;
+
+public:
+
+    AtmosphereModel(
+        const t_preTexCfg &preTexCfg
+    ,   const t_modelCfg &modelCfg);
+
+    const t_preTexCfg &preTexCfg() const;
+    const t_modelCfg &modelCfg() const;
+
+    // ground and top of atmosphere radius in km (cmn[1] and cmn[2])
+    const float Rg() const;
+    const float Rt() const;
+
+    // parameterization functions
+
+    const osg::Vec2f transmittanceUV(
+        const float r
+    ,   const float mu) const;
+
+    void transmittanceRMu(
+        const int x
+    ,   const int y
+    ,   float &r
+    ,   float &muS) const;
+
+    const osg::Vec2f irradianceUV(
+        const float r
+    ,   const float muS) const;
+
+    void irradianceRMuS(
+        const int x
+    ,   const int y
+    ,   float &r
+    ,   float &muS) const;
+
+    void muMuSNu(
+        const int x
+    ,   const int y
+    ,   const float r
+    ,   const osg::Vec4f &dhdH
+    ,   float &mu
+    ,   float &muS
+    ,   float &nu) const;
+
+    // r and dhdH of a layer within the inscatter table (as passed per
+    // layer to the inscatter passes by AtmospherePrecompute)
+
+    void layerRDhdH(
+        const int layer
+    ,   float &r
+    ,   osg::Vec4f &dhdH) const;
+
+    // utility functions
+
+    const osg::Vec4f texture4D(
+        const t_table &table
+    ,   const float r
+    ,   const float mu
+    ,   const float muS
+    ,   const float nu) const;
+
+    const osg::Vec3f transmittance(
+        const t_table &transmittance
+    ,   const float r
+    ,   const float mu) const;
+
+    const osg::Vec3f transmittance(
+        const t_table &transmittance
+    ,   const float r
+    ,   const float mu
+    ,   const float d) const;
+
+    const osg::Vec3f transmittanceWithShadow(
+        const t_table &transmittance
+    ,   const float r
+    ,   const float mu) const;
+
+    const osg::Vec3f irradiance(
+        const t_table &irradiance
+    ,   const float r
+    ,   const float muS) const;
+
+    const float limit(
+        const float r
+    ,   const float mu) const;
+
+    const float phaseFunctionR(const float mu) const;
+    const float phaseFunctionM(const float mu) const;
+
+    const osg::Vec3f mie(const osg::Vec4f &rayMie) const;
+
+protected:
+
+    const t_preTexCfg m_preTexCfg;
+    const t_modelCfg m_modelCfg;
+
+    const float m_Rg;
+    const float m_Rt;
+};
+
+} // namespace osgHimmel
+
+#endif // __ATMOSPHEREMODEL_H__
\ No newline at end of file
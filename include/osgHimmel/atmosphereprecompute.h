@@ -31,10 +31,13 @@
 #ifndef __ATMOSPHEREPRECOMPUTE_H__
 #define __ATMOSPHEREPRECOMPUTE_H__
 
+#include "declspec.h"
+
 #include <osg/Referenced>
 #include <osg/GL>
 #include <osg/ref_ptr>
 #include <osg/Vec3f>
+#include <osg/Timer>
 
 #include <map>
 #include <vector>
@@ -64,7 +67,10 @@ namespace osgViewer
 namespace osgHimmel
 {
 
-class AtmospherePrecompute : public osg::Referenced
+class MemoryMappedFile;
+
+
+class OSGH_API AtmospherePrecompute : public osg::Referenced
 {
 public:
     
@@ -86,6 +92,9 @@ public:
         int irradianceIntegralSamples;
         int inscatterSphericalIntegralSamples;
 
+        // see setIntegralTolerance
+        float integralTolerance;
+
     } t_preTexCfg;
 
     typedef struct PhysicalModelConfig
@@ -107,6 +116,75 @@ public:
         return m_modelCfg;
     }
 
+    // Stages of the precompute in order of execution (algorithm 4.1). 
+    // The results of the transmittance and single scattering stages are
+    // retained, so that a change of the model config reruns only the 
+    // stages that read a changed field, directly or via another stage.
+
+    enum e_Stage
+    {
+        S_Transmittance         // line 1
+    ,   S_Irradiance1           // line 2
+    ,   S_Inscatter1            // line 3
+    ,   S_MultipleScattering    // lines 4 to 11
+    ,   NUM_STAGES
+    };
+
+    // Fields of t_modelCfg, as substituted into the passes.
+
+    enum e_ModelParameter
+    {
+        MP_AvgGroundReflectance = 1 << 0
+    ,   MP_HR                   = 1 << 1
+    ,   MP_BetaR                = 1 << 2
+    ,   MP_HM                   = 1 << 3
+    ,   MP_BetaMSca             = 1 << 4
+    ,   MP_BetaMEx              = 1 << 5
+    ,   MP_MieG                 = 1 << 6
+    };
+
+    // Model parameters (e_ModelParameter mask) read by the passes of a stage.
+    static const unsigned int stageParameters(const e_Stage stage);
+    // Stages (mask of 1 << e_Stage) whose results are read by a stage.
+    static const unsigned int stageInputs(const e_Stage stage);
+
+    // Model parameters that differ between both configs.
+    static const unsigned int changedParameters(
+        const t_modelCfg &a
+    ,   const t_modelCfg &b);
+
+    // Sets the model parameters as uniforms, as declared by the
+    // glsl_bruneton_const_* fragments if modelUniforms is enabled.
+    static void setupModelUniforms(
+        osg::StateSet *stateSet
+    ,   const t_modelCfg &modelCfg);
+
+    // Stages (mask of 1 << e_Stage) rerun by the last compute.
+    const unsigned int getComputedStages() const;
+
+    // Configs the current tables were computed with (e.g., for sampling
+    // the images, see AtmosphereQuery).
+    const t_preTexCfg &getComputedTextureConfig() const;
+    const t_modelCfg &getComputedModelConfig() const;
+
+    // Passes of the precompute (algorithm 4.1).
+
+    enum e_Pass
+    {
+        P_Transmittance     // line 1 in algorithm 4.1
+    ,   P_Irradiance1       // line 2
+    ,   P_Inscatter1        // line 3
+    ,   P_CopyIrradiance    // lines 4 and 10
+    ,   P_CopyInscatter1    // line 5
+    ,   P_InscatterS        // line 7
+    ,   P_IrradianceN       // line 8
+    ,   P_InscatterN        // line 9
+    ,   P_CopyInscatterN    // line 11
+    ,   NUM_PASSES
+    };
+
+    static const char *passName(const e_Pass pass);
+
 protected:
 
     t_preTexCfg &getTextureConfig()
@@ -121,6 +199,34 @@ protected:
 
     typedef std::vector<osg::Uniform*> t_uniforms;
 
+    // A pass of a scattering order, restricted to the layers [begin, end) 
+    // for 3d passes.
+
+    typedef struct Task
+    {
+        e_Pass pass;
+        int order;
+
+        int begin;
+        int end;
+
+    } t_task;
+
+    typedef std::vector<t_task> t_tasks;
+
+    // Scene graph of a pass, built once and reused by all computes: a 
+    // group with the pass program and one fbo camera per target layer.
+
+    typedef struct PassPipeline
+    {
+        osg::ref_ptr<osg::Group> group;
+        std::vector<osg::ref_ptr<osg::Camera> > cameras;
+
+        // data of the image targets the cameras are attached to
+        std::vector<const unsigned char*> data;
+
+    } t_pipeline;
+
 public:
 
     AtmospherePrecompute();
@@ -130,15 +236,127 @@ public:
     osg::Texture2D *getIrradianceTexture();
     osg::Texture3D *getInscatterTexture();
 
+    osg::Image *getTransmittanceImage();
+    osg::Image *getIrradianceImage();
+    osg::Image *getInscatterImage();
+
+    // Returns false if nothing was computed, either because the tables 
+    // are up to date already (see isUpToDate) or on failure.
     const bool compute(const bool ifDirtyOnly = true);
     void dirty();
 
+    // True if the tables are computed for the current configs.
+    const bool isUpToDate() const;
+
+    // Spreads the compute over several calls (e.g., one per frame), each 
+    // running tasks until the budget (in seconds) is exceeded, but at 
+    // least one. A task is a pass or setLayersPerTask layers of a 3d pass.
+    // The tables are published as soon as transmittance and each order of
+    // scattering are complete, so single scattering is available after a
+    // fraction of the compute and higher orders are added subsequently.
+    // Returns true if the tables were updated. A dirty config restarts 
+    // the compute, keeping the stages it completed.
+
+    const bool computeProgressive(
+        const double budget
+    ,   const bool ifDirtyOnly = true);
+
+    const bool isComputing() const;
+
+    // Tasks completed by the current compute [0;1].
+    const float getProgress() const;
+
+    // Highest order of scattering published by the current compute.
+    const int getScatteringOrder() const;
+
+    // Time in seconds spent in a pass by the current (or last) compute.
+    const double getPassTime(const e_Pass pass) const;
+
+    void setLayersPerTask(const int layers);
+    const int getLayersPerTask() const;
+
+    // The pbuffer context, the programs, and the fbo cameras of all passes
+    // are retained for subsequent computes, so that these only draw. 
+    // The pipeline is rebuilt if the texture config changes, and might be
+    // released explicitly (e.g., after the last compute). The single 
+    // scattering results are kept by the context only, so the next 
+    // compute after a release reruns their stages.
+    void releasePipeline();
+
+    // Integrates per texel until the estimated relative error is within
+    // tolerance, taking the configured numbers of samples at most. Path
+    // integrals double a 16th of the samples (trapezoidal rule with 
+    // Richardson extrapolation) until two successive error estimates are
+    // within tolerance, so that smooth integrands (high altitude, 
+    // high sun) take fewer samples than paths along the horizon. Ground
+    // irradiance takes all azimuths only if a quarter and the half of them
+    // disagree. The spherical integral of the inscatterS pass keeps its 
+    // fixed samples, since subsets rarely agree at its phase function 
+    // peaks. 0 (default) takes the fixed numbers of samples everywhere.
+
+    const float setIntegralTolerance(const float tolerance);
+    const float getIntegralTolerance() const;
+
     void substituteMacros(std::string &source);
 
+    // Directory of the on-disk table cache (see AtmosphereCache). On a 
+    // hit, compute maps the cached tables instead of running any pass, 
+    // on a miss the computed tables are stored. An empty directory 
+    // disables the cache. Defaults to $OSGHIMMEL_ATMOSPHERE_CACHE.
+
+    void setCacheDirectory(const std::string &directory);
+    const std::string &getCacheDirectory() const;
+
+    // cache file of the current configuration (empty if disabled)
+    const std::string getCacheFilePath() const;
+
 protected:
 
+    // Backend interface: beginTables prepares a compute, computeTask runs
+    // a task and updates the transmittance, irradiance, and inscatter 
+    // images if it completes them, and endTables releases all resources
+    // (also on abort). The default implementation renders the 
+    // glsl_bruneton_* fragments using a pbuffer context.
+
+    virtual const bool beginTables();
+    virtual void computeTask(const t_task &task);
+    virtual void endTables();
+
+    const bool beginCompute(
+        const bool ifDirtyOnly
+    ,   const int layersPerTask);
+
+    // Runs the next task, returns true if the tables were updated.
+    const bool computeStep();
+
+    void endCompute();
+    void abortCompute();
+
+    void setupTasks(const int layersPerTask);
+
+    void addTask(
+        const e_Pass pass
+    ,   const int order
+    ,   const int begin = 0
+    ,   const int end = 0);
+
+    void completeStage(const e_Stage stage);
+
+    const bool loadFromCache();
+    void storeToCache();
+
+    // Stages reading parameters changed since their results were computed
+    // or results of other required stages, including the stages that 
+    // provide inputs to them but have no retained results.
+    const unsigned int requiredStages() const;
+
+    // Valid while computing.
+    const bool isStageRequired(const e_Stage stage) const;
+
     osg::Texture2D *getDeltaETexture();
+    osg::Texture2D *getDeltaE1Texture();
     osg::Texture3D *getDeltaSRTexture();
+    osg::Texture3D *getDeltaSR1Texture();
     osg::Texture3D *getDeltaSMTexture();
     osg::Texture3D *getDeltaJTexture();
 
@@ -177,17 +395,21 @@ protected:
     osg::Program *setupProgram(
         const std::string &fragmentShaderSource);
 
+    void substituteMacros(
+        std::string &source
+    ,   const t_modelCfg &modelCfg);
+
     osg::Camera *setupCamera(
         const int viewportWidth
     ,   const int viewportHeight
     ,   osg::Geode *geode
     ,   const int orderNum);
 
-    osg::Group *setupGroup(
-        osgViewer::CompositeViewer *viewer);
+    t_pipeline &setupPipeline(
+        const e_Pass pass
+    ,   const char *fragmentShaderSource);
 
-    void cleanUp(
-        osgViewer::CompositeViewer *viewer);
+    void renderPipeline(t_pipeline &pipeline);
 
     void assignUniforms(
         osg::StateSet *stateSet
@@ -202,8 +424,7 @@ protected:
     void dirtyTargets(t_tex3DsByUnit &targets3D);
 
     void render2D(
-        osgViewer::CompositeViewer *viewer
-    ,   osg::Geode *geode
+        const e_Pass pass
     ,   t_tex2DsByUnit &targets2D
     ,   t_tex2DsByUnit &samplers2D
     ,   t_tex3DsByUnit &samplers3D
@@ -211,13 +432,14 @@ protected:
     ,   const char* fragmentShaderSource);
 
     void render3D(
-        osgViewer::CompositeViewer *viewer
-    ,   osg::Geode *geode
+        const e_Pass pass
     ,   t_tex3DsByUnit &targets3D
     ,   t_tex2DsByUnit &samplers2D
     ,   t_tex3DsByUnit &samplers3D
     ,   t_uniforms &uniforms
-    ,   const char* fragmentShaderSource);
+    ,   const char* fragmentShaderSource
+    ,   const int begin
+    ,   const int end);
 
 protected:
 
@@ -228,7 +450,9 @@ protected:
 
     osg::ref_ptr<osg::Texture2D> m_transmittanceTexture;
     osg::ref_ptr<osg::Texture2D> m_deltaETexture;
+    osg::ref_ptr<osg::Texture2D> m_deltaE1Texture;
     osg::ref_ptr<osg::Texture3D> m_deltaSRTexture;
+    osg::ref_ptr<osg::Texture3D> m_deltaSR1Texture;
     osg::ref_ptr<osg::Texture3D> m_deltaSMTexture;
     osg::ref_ptr<osg::Texture2D> m_irradianceTexture;
     osg::ref_ptr<osg::Texture3D> m_inscatterTexture;
@@ -237,6 +461,39 @@ protected:
     osg::ref_ptr<osg::Image> m_transmittanceImage;
     osg::ref_ptr<osg::Image> m_irradianceImage;
     osg::ref_ptr<osg::Image> m_inscatterImage;
+
+    unsigned int m_stages;      // stages run by the current compute
+    unsigned int m_validStages; // stages with retained results
+
+    t_preTexCfg m_computedPreTexCfg;
+    // configs the retained results of each stage were computed with
+    t_modelCfg m_stageModelCfgs[NUM_STAGES];
+
+    // valid while computing
+
+    bool m_computing;
+    t_modelCfg m_computeModelCfg; // snapshot of m_modelCfg
+
+    t_tasks m_tasks;
+    unsigned int m_nextTask;
+
+    int m_layersPerTask;
+    int m_order;
+
+    osg::Timer_t m_computeStart;
+    double m_passTimes[NUM_PASSES];
+
+    // retained pipeline (see releasePipeline)
+
+    osg::ref_ptr<osgViewer::CompositeViewer> m_viewer;
+    osg::ref_ptr<osg::Geode> m_quad;
+
+    t_pipeline m_pipelines[NUM_PASSES];
+    t_preTexCfg m_pipelineTexCfg;
+
+    std::string m_cacheDirectory;
+    // tables loaded from cache refer to this mapping
+    osg::ref_ptr<MemoryMappedFile> m_cacheFile;
 };
 
 } // namespace osgHimmel
@@ -0,0 +1,147 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#ifndef __ATMOSPHEREQUERY_H__
+#define __ATMOSPHEREQUERY_H__
+
+#include "declspec.h"
+#include "atmospheremodel.h"
+
+#include <osg/ref_ptr>
+#include <osg/Vec3f>
+
+namespace osg
+{
+    class Image;
+}
+
+
+namespace osgHimmel
+{
+
+class AtmospherePrecompute;
+
+// Evaluates the sky of AtmosphereGeode on the CPU, e.g., for scene
+// lighting, by sampling the precomputed transmittance, irradiance, and
+// inscatter tables like the glsl_bruneton_* fragments do. Directions are
+// normalized and given in the horizontal frame of the observer (z up,
+// like sunr and the view rays of the shader), altitudes in km above the
+// ground. Radiance and irradiance are scaled by sunIntensity().
+// After update, all queries are const and may be called concurrently.
+
+class OSGH_API AtmosphereQuery
+{
+public:
+
+    typedef AtmosphereModel::t_preTexCfg t_preTexCfg;
+    typedef AtmosphereModel::t_modelCfg  t_modelCfg;
+
+public:
+
+    AtmosphereQuery();
+    virtual ~AtmosphereQuery();
+
+    // Refers to the tables of the last compute. Needs to be called
+    // whenever the precompute updated its tables (compute returned true).
+    const bool update(AtmospherePrecompute *precompute);
+
+    // Refers to the given tables (float data, laid out as read back by
+    // AtmospherePrecompute) computed with the given configs.
+    const bool update(
+        const t_preTexCfg &preTexCfg
+    ,   const t_modelCfg &modelCfg
+    ,   osg::Image *transmittance
+    ,   osg::Image *irradiance
+    ,   osg::Image *inscatter);
+
+    // Refers to copies of the tables of another query, e.g., for
+    // evaluation on another thread while the tables are updated.
+    const bool copy(const AtmosphereQuery &query);
+
+    const bool isValid() const;
+
+    // Number of updates, e.g., for detecting new tables.
+    const unsigned int getRevision() const;
+
+    // Sky radiance along direction without the sun disc (S[L] of the
+    // inscatter function in AtmosphereGeode).
+    const osg::Vec3f radiance(
+        const osg::Vec3f &direction
+    ,   const osg::Vec3f &sun
+    ,   const float altitude) const;
+
+    // Batched version for count directions of the same observer and sun.
+    void radiance(
+        const osg::Vec3f *directions
+    ,   osg::Vec3f *radiances
+    ,   const unsigned int count
+    ,   const osg::Vec3f &sun
+    ,   const float altitude) const;
+
+    // Transmittance of the atmosphere towards the sun [0;1] (zero if the
+    // sun is occluded by the earth). Multiplied with sunIntensity() this
+    // yields the transmitted sun color.
+    const osg::Vec3f sunTransmittance(
+        const float altitude
+    ,   const osg::Vec3f &sun) const;
+
+    // Batched version for count altitudes.
+    void sunTransmittance(
+        const float *altitudes
+    ,   osg::Vec3f *transmittances
+    ,   const unsigned int count
+    ,   const osg::Vec3f &sun) const;
+
+    // Sky irradiance of a horizontal surface, excluding direct sun light
+    // (E[L*], e.g., for ambient lighting).
+    const osg::Vec3f irradiance(
+        const float altitude
+    ,   const osg::Vec3f &sun) const;
+
+    // ISun of the atmosphere shader.
+    static const float sunIntensity();
+
+protected:
+
+    AtmosphereModel *m_model;
+    unsigned int m_revision;
+
+    osg::ref_ptr<osg::Image> m_transmittanceImage;
+    osg::ref_ptr<osg::Image> m_irradianceImage;
+    osg::ref_ptr<osg::Image> m_inscatterImage;
+
+    AtmosphereModel::t_table m_transmittance;
+    AtmosphereModel::t_table m_irradiance;
+    AtmosphereModel::t_table m_inscatter;
+};
+
+} // namespace osgHimmel
+
+#endif // __ATMOSPHEREQUERY_H__
@@ -33,13 +33,25 @@
 
 #include "declspec.h"
 
+#include <osg/ref_ptr>
+
 
 namespace osgHimmel
 {
 
+class MemoryMappedFile;
+
 // NOTE: Enabling this, slows down compilation a lot!
 //#define BRIGHTSTARS_INCLUDE_CATALOGUE
 
+// Catalogue files start with a versioned header (magic, version, byte 
+// order mark, record size, number of stars, and the offset of the first 
+// star, aligned to 64 bytes), followed by the stars as is. These files are
+// memory mapped read only, and stars() points into the mapping without 
+// copying. Files of the other byte order are copied and swapped. Headerless
+// files (the raw star arrays of former versions) are still read by copying
+// and can be converted.
+
 class OSGH_API BrightStars
 {
 public:
@@ -50,8 +62,8 @@ public:
         float Vmag;   // visual magnitude (mag)
         float RA;     // right ascension (decimal hours)
         float DE;     // declination (decimal degrees)
-        float pmRA;   // proper annual motion in right ascension (decimal hours)
-        float pmDE;   // proper annual motion in declination (decimal degrees)
+        float pmRA;   // proper annual motion in right ascension times cos DE (arcseconds)
+        float pmDE;   // proper annual motion in declination (arcseconds)
         float sRGB_R; // approximated color, red value   ]0;1[
         float sRGB_G; // approximated color, green value ]0;1[
         float sRGB_B; // approximated color, blue value  ]0;1[
@@ -64,15 +76,41 @@ public:
     BrightStars(const char *fileName);
     ~BrightStars();
 
+    // Valid as long as the catalogue is, NULL if loading failed.
     const s_BrightStar *stars() const;
     const unsigned int numStars() const;
 
+    // True if the stars refer to a memory mapped file.
+    const bool isMapped() const;
+
+    // Returns the number of stars read, or 0 if the file is missing, 
+    // truncated, or of an unknown version.
     unsigned int fromFile(const char *fileName);
+
+    // Writes the versioned format to a temporary file that replaces the
+    // file when complete, atomically on posix systems (even while it is 
+    // mapped), see MemoryMappedFile::replace. 
+    // Returns the number of stars written, or 0 on failure.
     unsigned int toFile(const char *fileName) const;
 
+    // Reads a catalogue (e.g., a raw file) and writes it in the current
+    // format. Returns the number of stars written.
+    static unsigned int convert(
+        const char *sourceFileName
+    ,   const char *targetFileName);
+
+    static const unsigned int version();
+
 protected:
 
-    s_BrightStar *m_stars;
+    void clear();
+
+protected:
+
+    s_BrightStar *m_stars; // owned (raw, swapped, or included catalogue)
+    osg::ref_ptr<MemoryMappedFile> m_file;
+
+    const s_BrightStar *m_data;
     unsigned int m_numStars;
 };
 
@@ -32,6 +32,7 @@
 #define __COORDS_H__
 
 #include "julianday.h"
+#include "precision.h"
 #include "pragmanote.h"
 
 #include <osg/Vec3>
@@ -61,6 +62,10 @@ struct s_EquatorialCoords
 {    
     s_EquatorialCoords();
 
+    // converts between precisions
+    template<typename U>
+    explicit s_EquatorialCoords(const s_EquatorialCoords<U> &coords);
+
     const s_EclipticalCoords<T> toEcliptical(const T obliquity) const;
 
     const s_HorizontalCoords<T> toHorizontal(
@@ -68,6 +73,17 @@ struct s_EquatorialCoords
     ,   const T observersLatitude      /* Φ   */
     ,   const T observersLongitude     /* L   */) const;
 
+    // Horizontal coordinates for count observers, with the terms of the
+    // position and sidereal time evaluated once. The loop over observers 
+    // is free of branches, so that compilers vectorize it.
+    void toHorizontal(
+        const t_julianDay siderealTime
+    ,   const T *observersLatitudes
+    ,   const T *observersLongitudes
+    ,   const unsigned int count
+    ,   T *altitudes
+    ,   T *azimuths) const;
+
     const osg::Vec3f toEuclidean() const;
 
 // Not required for now...
@@ -96,6 +112,9 @@ struct s_EclipticalCoords
 {    
     s_EclipticalCoords();
 
+    template<typename U>
+    explicit s_EclipticalCoords(const s_EclipticalCoords<U> &coords);
+
     const s_EquatorialCoords<T> toEquatorial(const T obliquity) const;
 
 
@@ -166,6 +185,16 @@ s_EquatorialCoords<T>::s_EquatorialCoords()
 }
 
 
+template<typename T>
+template<typename U>
+s_EquatorialCoords<T>::s_EquatorialCoords(const s_EquatorialCoords<U> &coords)
+:   right_ascension(static_cast<T>(coords.right_ascension))
+,   declination(static_cast<T>(coords.declination))
+,   r(static_cast<T>(coords.r))
+{
+}
+
+
 template<typename T>
 s_EclipticalCoords<T>::s_EclipticalCoords()
 :   longitude(0.0)
@@ -174,6 +203,15 @@ s_EclipticalCoords<T>::s_EclipticalCoords()
 }
 
 
+template<typename T>
+template<typename U>
+s_EclipticalCoords<T>::s_EclipticalCoords(const s_EclipticalCoords<U> &coords)
+:   longitude(static_cast<T>(coords.longitude))
+,   latitude(static_cast<T>(coords.latitude))
+{
+}
+
+
 template<typename T>
 s_HorizontalCoords<T>::s_HorizontalCoords()
 :   azimuth(0.0)
@@ -197,15 +235,15 @@ const s_EclipticalCoords<T> s_EquatorialCoords<T>::toEcliptical(const T obliquit
 {
     s_EclipticalCoords<T> ecl;
     
-    const T cose(cos(_rad(obliquity)));
-    const T sine(sin(_rad(obliquity)));
-    const T sina(sin(_rad(right_ascension)));
+    const T cose(cos(rad<T>(obliquity)));
+    const T sine(sin(rad<T>(obliquity)));
+    const T sina(sin(rad<T>(right_ascension)));
 
-    ecl.latitude = _deg(atan2(
-        sina * cose + tan(_rad(declination)) * sine, cos(_rad(right_ascension))));
+    ecl.latitude = deg<T>(atan2(
+        sina * cose + tan(rad<T>(declination)) * sine, cos(rad<T>(right_ascension))));
 
-    ecl.longitude = _deg(asin(
-        sin(_rad(declination)) * cose - cos(_rad(declination)) * sine * sina));
+    ecl.longitude = deg<T>(asin(
+        sin(rad<T>(declination)) * cose - cos(rad<T>(declination)) * sine * sina));
 
     return ecl;
 }
@@ -222,30 +260,59 @@ const s_HorizontalCoords<T> s_EquatorialCoords<T>::toHorizontal(
     s_HorizontalCoords<T> hor;
 
     // local hour angle: H = θ - α (AA.p88)
-    const T H = _rad(siderealTime + observersLongitude - right_ascension);
+    const T H = rad<T>(static_cast<T>(siderealTime) + observersLongitude - right_ascension);
 
     const T cosh(cos(H));
-    const T sinr(sin(_rad(observersLatitude)));
-    const T cosr(cos(_rad(observersLatitude)));
+    const T sinr(sin(rad<T>(observersLatitude)));
+    const T cosr(cos(rad<T>(observersLatitude)));
 
-    hor.altitude = _deg(asin(
-        sinr * sin(_rad(declination)) + cosr * cos(_rad(declination)) * cosh));
+    hor.altitude = deg<T>(asin(
+        sinr * sin(rad<T>(declination)) + cosr * cos(rad<T>(declination)) * cosh));
 
-    hor.azimuth = _deg(atan2(static_cast<T>(
-        sin(H)), static_cast<T>(cosh * sinr - tan(_rad(declination)) * cosr)));
+    hor.azimuth = deg<T>(atan2(static_cast<T>(
+        sin(H)), static_cast<T>(cosh * sinr - tan(rad<T>(declination)) * cosr)));
 
     return hor;
 }
 
 
+template<typename T>
+void s_EquatorialCoords<T>::toHorizontal(
+    const t_julianDay siderealTime
+,   const T *observersLatitudes
+,   const T *observersLongitudes
+,   const unsigned int count
+,   T *altitudes
+,   T *azimuths) const
+{
+    const T s(static_cast<T>(siderealTime) - right_ascension);
+
+    const T sind(sin(rad<T>(declination)));
+    const T cosd(cos(rad<T>(declination)));
+    const T tand(tan(rad<T>(declination)));
+
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        const T H = rad<T>(s + observersLongitudes[i]);
+
+        const T cosh(cos(H));
+        const T sinr(sin(rad<T>(observersLatitudes[i])));
+        const T cosr(cos(rad<T>(observersLatitudes[i])));
+
+        altitudes[i] = deg<T>(asin(sinr * sind + cosr * cosd * cosh));
+        azimuths[i] = deg<T>(atan2(static_cast<T>(sin(H)), static_cast<T>(cosh * sinr - tand * cosr)));
+    }
+}
+
+
 template<typename T>
 const osg::Vec3f s_EquatorialCoords<T>::toEuclidean() const
 {
-    const T cosd(cos(_rad(declination)));
+    const T cosd(cos(rad<T>(declination)));
 
-    const T x(r * sin(_rad(right_ascension)) * cosd);
-    const T y(r * cos(_rad(right_ascension)) * cosd);
-    const T z(r * sin(_rad(declination)));
+    const T x(r * sin(rad<T>(right_ascension)) * cosd);
+    const T y(r * cos(rad<T>(right_ascension)) * cosd);
+    const T z(r * sin(rad<T>(declination)));
 
     return osg::Vec3f(x, y, z);
 }
@@ -256,15 +323,15 @@ const s_EquatorialCoords<T> s_EclipticalCoords<T>::toEquatorial(const T obliquit
 {
     s_EquatorialCoords<T> equ;
 
-    const T cose(cos(_rad(obliquity)));
-    const T sine(sin(_rad(obliquity)));
+    const T cose(cos(rad<T>(obliquity)));
+    const T sine(sin(rad<T>(obliquity)));
 
-    const T sinl(sin(_rad(longitude)));
+    const T sinl(sin(rad<T>(longitude)));
 
-    equ.right_ascension = _deg(atan2(
-        sinl * cose - tan(_rad(latitude)) * sine, cos(_rad(longitude))));
+    equ.right_ascension = deg<T>(atan2(
+        sinl * cose - tan(rad<T>(latitude)) * sine, cos(rad<T>(longitude))));
 
-    equ.declination = _deg(asin(sin(_rad(latitude)) * cose + cos(_rad(latitude)) * sine * sinl));
+    equ.declination = deg<T>(asin(sin(rad<T>(latitude)) * cose + cos(rad<T>(latitude)) * sine * sinl));
 
     return equ;
 }
@@ -278,18 +345,18 @@ const s_EquatorialCoords<T> s_HorizontalCoords<T>::toEquatorial(
 {
     s_EquatorialCoords<T> equ;
 
-    const T cosa(cos(_rad(altitude)));
+    const T cosa(cos(rad<T>(altitude)));
 
-    const T sinr(sin(_rad(observersLatitude)));
-    const T cosr(cos(_rad(observersLatitude)));
+    const T sinr(sin(rad<T>(observersLatitude)));
+    const T cosr(cos(rad<T>(observersLatitude)));
 
-    const T H = _deg(atan2(
-        sin(_rad(altitude)), cosa * sinr + tan(_rad(azimuth)) * cosr));
+    const T H = deg<T>(atan2(
+        sin(rad<T>(altitude)), cosa * sinr + tan(rad<T>(azimuth)) * cosr));
 
     equ.right_ascension = _hours(siderealTime) - observersLongitude - H;
 
-    equ.declination = _deg(asin(
-        sinr * sin(_rad(azimuth)) - cosr * cos(_rad(azimuth)) * cosa));
+    equ.declination = deg<T>(asin(
+        sinr * sin(rad<T>(azimuth)) - cosr * cos(rad<T>(azimuth)) * cosa));
 
     return equ;
 }
@@ -298,11 +365,11 @@ const s_EquatorialCoords<T> s_HorizontalCoords<T>::toEquatorial(
 template<typename T>
 const osg::Vec3f s_HorizontalCoords<T>::toEuclidean() const
 {
-    const T cosa(cos(_rad(altitude)));
+    const T cosa(cos(rad<T>(altitude)));
 
-    const T x(sin(_rad(azimuth)) * cosa);
-    const T y(cos(_rad(azimuth)) * cosa);
-    const T z(sin(_rad(altitude)));
+    const T x(sin(rad<T>(azimuth)) * cosa);
+    const T y(cos(rad<T>(azimuth)) * cosa);
+    const T z(sin(rad<T>(altitude)));
 
     return osg::Vec3f(x, y, z);
 }
@@ -0,0 +1,140 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#ifndef __CPUATMOSPHEREPRECOMPUTE_H__
+#define __CPUATMOSPHEREPRECOMPUTE_H__
+
+#include "declspec.h"
+#include "atmosphereprecompute.h"
+#include "atmospheremodel.h"
+
+#include <vector>
+
+
+namespace osgHimmel
+{
+
+// Computes the same tables as AtmospherePrecompute without any graphics
+// context (e.g., for headless nodes). All passes of the glsl_bruneton_*
+// fragments are evaluated on the CPU and distributed over a number of
+// threads by rows (2D tables) or resR layers (3D tables). The resulting
+// images have the same layout as the ones read back from the GPU.
+
+class OSGH_API CpuAtmospherePrecompute : public AtmospherePrecompute
+{
+public:
+
+    // numThreads = 0 uses one thread per processor.
+    CpuAtmospherePrecompute(const int numThreads = 0);
+    virtual ~CpuAtmospherePrecompute();
+
+    void setNumThreads(const int numThreads);
+    const int getNumThreads() const;
+
+protected:
+
+    virtual const bool beginTables();
+    virtual void computeTask(const t_task &task);
+    virtual void endTables();
+
+    // Runs the slices [begin, end) of a pass, distributed over all threads.
+    void dispatch(
+        const e_Pass pass
+    ,   const int begin
+    ,   const int end);
+
+    const int numSlices(const e_Pass pass) const;
+
+    // Computes a single row (2D) or layer (3D) of a pass. Slices of
+    // the same pass are independent and may run concurrently.
+    void computeSlice(
+        const e_Pass pass
+    ,   const int slice);
+
+    void transmittance  (const int y);
+    void irradiance1    (const int y);
+    void inscatter1     (const int layer);
+    void copyIrradiance (const int y);
+    void copyInscatter1 (const int layer);
+    void inscatterS     (const int layer);
+    void irradianceN    (const int y);
+    void inscatterN     (const int layer);
+    void copyInscatterN (const int layer);
+
+    void allocateTables();
+
+    void copyToImage(
+        const AtmosphereModel::t_table &table
+    ,   osg::Image *image);
+
+    void copyFromImage(
+        const osg::Image *image
+    ,   AtmosphereModel::t_table &table);
+
+protected:
+
+    class Worker;
+
+    int m_numThreads;
+
+    // valid while computing
+    const AtmosphereModel *m_model;
+
+    // first scattering order (for inscatterS and irradianceN)
+    bool m_first;
+    // k factor of copyIrradiance (0 for line 4, 1 for line 10)
+    float m_k;
+
+    std::vector<float> m_transmittanceData;
+    std::vector<float> m_deltaEData;
+    std::vector<float> m_deltaE1Data;  // retained single scattering results
+    std::vector<float> m_deltaSRData;
+    std::vector<float> m_deltaSR1Data; // retained single scattering results
+    std::vector<float> m_deltaSMData;
+    std::vector<float> m_deltaJData;
+    std::vector<float> m_irradianceData;
+    std::vector<float> m_inscatterData;
+
+    AtmosphereModel::t_table m_transmittance;
+    AtmosphereModel::t_table m_deltaE;  // bound to m_deltaE1 or m_deltaEN per task
+    AtmosphereModel::t_table m_deltaSR; // bound to m_deltaSR1 or m_deltaSRN per task
+    AtmosphereModel::t_table m_deltaE1;
+    AtmosphereModel::t_table m_deltaEN;
+    AtmosphereModel::t_table m_deltaSR1;
+    AtmosphereModel::t_table m_deltaSRN;
+    AtmosphereModel::t_table m_deltaSM;
+    AtmosphereModel::t_table m_deltaJ;
+    AtmosphereModel::t_table m_irradiance;
+    AtmosphereModel::t_table m_inscatter;
+};
+
+} // namespace osgHimmel
+
+#endif // __CPUATMOSPHEREPRECOMPUTE_H__
\ No newline at end of file
@@ -34,39 +34,70 @@
 #include "declspec.h"
 #include "julianday.h"
 #include "typedefs.h"
+#include "precision.h"
+#include "periodicterms.h"
 
 
 namespace osgHimmel
 {
 
-class OSGH_API Earth
+// Instantiated for float, double, and long double (see precision.h). The
+// periodic series are truncated by truncation, if given.
+
+template<typename t_real>
+class OSGH_API EarthT
 {
 public:
 
-    static const t_longf orbitEccentricity(const t_julianDay t);
+    static const t_real orbitEccentricity(const t_julianDay t);
+
+    static const t_real apparentAngularSunDiameter(const t_julianDay t);
+    static const t_real apparentAngularMoonDiameter(
+        const t_julianDay t
+    ,   const SeriesTruncation *truncation = NULL);
+
+    static const t_real longitudeNutation(
+        const t_julianDay t
+    ,   const SeriesTruncation *truncation = NULL);
+
+    static const t_real obliquityNutation(
+        const t_julianDay t
+    ,   const SeriesTruncation *truncation = NULL);
 
-    static const t_longf apparentAngularSunDiameter(const t_julianDay t);
-    static const t_longf apparentAngularMoonDiameter(const t_julianDay t);
+    // Nutations in degrees of the instants of the arguments, evaluated
+    // per term over all instants (see addSines).
 
-    static const t_longf longitudeNutation(const t_julianDay t);
-    static const t_longf obliquityNutation(const t_julianDay t);
+    static void longitudeNutations(
+        const t_fundArgArrays &args
+    ,   double *nutations
+    ,   const SeriesTruncation *truncation = NULL);
 
-    static const t_longf meanObliquity(const t_julianDay t);
-    static const t_longf trueObliquity(const t_julianDay t);
+    static void obliquityNutations(
+        const t_fundArgArrays &args
+    ,   double *nutations
+    ,   const SeriesTruncation *truncation = NULL);
 
-    static const t_longf atmosphericRefraction(const t_longf altitude);
+    static const t_real meanObliquity(const t_julianDay t);
 
-    static const t_longf viewDistanceWithinAtmosphere(
-        const t_longf y /* height component of the view direction on ground into the sky */
+    static const t_real trueObliquity(
+        const t_julianDay t
+    ,   const SeriesTruncation *truncation = NULL);
+
+    static const t_real atmosphericRefraction(const t_real altitude);
+
+    static const t_real viewDistanceWithinAtmosphere(
+        const t_real y /* height component of the view direction on ground into the sky */
     ,   const bool refractionCorrected = false);
 
-    static const t_longf meanRadius();
-    static const t_longf atmosphereThickness(); // if its density were uniform...
-    static const t_longf atmosphereThicknessNonUniform();
+    static const t_real meanRadius();
+    static const t_real atmosphereThickness(); // if its density were uniform...
+    static const t_real atmosphereThicknessNonUniform();
 
-    static const t_longf apparentMagnitudeLimit();
+    static const t_real apparentMagnitudeLimit();
 };
 
+typedef EarthT<t_longf> Earth;
+
 } // namespace osgHimmel
 
 #endif // __EARTH_H__
\ No newline at end of file
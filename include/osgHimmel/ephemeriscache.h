@@ -0,0 +1,163 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#ifndef __EPHEMERISCACHE_H__
+#define __EPHEMERISCACHE_H__
+
+#include "declspec.h"
+#include "typedefs.h"
+#include "julianday.h"
+#include "coords.h"
+
+#include <osg/Referenced>
+
+#include <string>
+#include <vector>
+
+
+namespace osgHimmel
+{
+
+// Piecewise Chebyshev approximations of the ephemerides of Sun, Moon, and
+// Earth as used by Astronomy, fitted for a range of julian days. Each 
+// quantity is split into spans of fixed length in days. Each span is fitted
+// at the Chebyshev nodes and truncated to the lowest degree whose omitted
+// coefficients stay below the tolerance (Numerical Recipes 5.8). A query
+// evaluates one series by Clenshaw's recurrence in O(degree), instead of
+// summing the periodic terms.
+//
+// After fitting, the error against the direct series is measured between
+// the nodes and reported per quantity. The cache can be stored to and 
+// loaded from a file, e.g., to skip the fitting at startup.
+
+class OSGH_API EphemerisCache : public osg::Referenced
+{
+public:
+
+    enum e_Quantity
+    {
+        Q_SunLongitude      // Sun::apparentLongitude
+    ,   Q_SunObliquity      // Sun::apparentObliquity
+    ,   Q_SunDistance       // Sun::distance
+    ,   Q_MoonLongitude     // Moon::position
+    ,   Q_MoonLatitude      // Moon::position
+    ,   Q_MoonDistance      // Moon::distance
+    ,   Q_LongitudeNutation // Earth::longitudeNutation
+    ,   Q_ObliquityNutation // Earth::obliquityNutation
+    ,   Q_MeanObliquity     // Earth::meanObliquity
+    ,   NUM_QUANTITIES
+    };
+
+public:
+
+    EphemerisCache();
+
+    // Fits all quantities for [begin; end]. Returns true if all measured
+    // errors are within the tolerance.
+    const bool build(
+        const t_julianDay begin
+    ,   const t_julianDay end);
+
+    const bool isValid() const;
+    const bool covers(const t_julianDay t) const;
+
+    const t_julianDay begin() const;
+    const t_julianDay end() const;
+
+    // Maximum error of angles in arcseconds. Distances are kept within
+    // the same relative error (the tolerance in radians). Takes effect on
+    // the next build.
+    const double setTolerance(const double arcsecs);
+    const double getTolerance() const;
+    static const double defaultTolerance();
+
+    // Length of the spans of a quantity in days (the degree rises with the
+    // length). Takes effect on the next build.
+    const double setSpan(
+        const e_Quantity quantity
+    ,   const double days);
+    const double getSpan(const e_Quantity quantity) const;
+    static const double defaultSpan(const e_Quantity quantity);
+
+    // Highest degree of all spans of a quantity, and the largest error
+    // measured (in arcseconds, and kilometers for distances).
+
+    const unsigned int getDegree(const e_Quantity quantity) const;
+    const double getMaxError(const e_Quantity quantity) const;
+
+    // Value of a quantity in degrees (longitudes within [0;360[) or 
+    // kilometers. The julian day has to be covered.
+    const double value(
+        const e_Quantity quantity
+    ,   const t_julianDay t) const;
+
+    // Positions as by Moon::position, Moon::apparentPosition, and 
+    // Sun::apparentPosition.
+
+    const t_ecld moonPosition(const t_julianDay t) const;
+    const t_equd moonApparentPosition(const t_julianDay t) const;
+    const t_equd sunApparentPosition(const t_julianDay t) const;
+
+    const bool save(const std::string &filePath) const;
+    const bool load(const std::string &filePath);
+
+protected:
+
+    virtual ~EphemerisCache();
+
+    typedef struct Series
+    {
+        double span;
+        unsigned int degree;
+        double maxError;
+
+        // degree + 1 coefficients per span
+        std::vector<double> coefficients;
+
+    } t_series;
+
+    void fit(
+        const e_Quantity quantity
+    ,   t_series &series) const;
+
+protected:
+
+    t_series m_series[NUM_QUANTITIES];
+
+    double m_tolerance;
+    double m_spans[NUM_QUANTITIES];
+
+    double m_begin;
+    double m_end;
+};
+
+} // namespace osgHimmel
+
+#endif // __EPHEMERISCACHE_H__
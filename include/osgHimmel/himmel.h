@@ -33,7 +33,7 @@
 
 #include "declspec.h"
 #include "abstracthimmel.h"
-#include "atime.h"
+#include "juliantime.h"
 
 #ifdef OSGHIMMEL_EXPORTS
 
@@ -144,7 +144,7 @@ public:
 
 
     const osg::Vec3f getSunPosition() const;
-    const osg::Vec3f getSunPosition(const t_aTime &aTime) const;
+    const osg::Vec3f getSunPosition(const t_julianTime &time) const;
 
 protected:
 
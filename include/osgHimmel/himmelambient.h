@@ -0,0 +1,204 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#ifndef __HIMMELAMBIENT_H__
+#define __HIMMELAMBIENT_H__
+
+#include "declspec.h"
+
+#include <osg/Vec3f>
+
+#include <OpenThreads/Atomic>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/Condition>
+
+
+namespace osgHimmel
+{
+
+class Himmel;
+class AtmosphereQuery;
+
+
+// Projects the radiance of the sky into second order spherical harmonics
+// (SH9) for ambient lighting, without rendering and reading back an
+// environment map (see HimmelEnvMap). The sky is sampled on the CPU via
+// AtmosphereQuery, the moon is added as directional light, and the
+// starmap as uniform radiance of the upper hemisphere (if set). The sun
+// itself is omitted, since it is usually applied as directional light.
+//
+// The projection runs on a worker thread and is requested by update only
+// if the sun or moon moved by more than a threshold, the altitude changed,
+// or the atmosphere tables were updated. Results are published lock-free
+// to the update thread (triple buffered). Coefficients refer to the
+// horizontal frame of the observer (z up).
+
+class OSGH_API HimmelAmbient
+{
+public:
+
+    // Coefficients of the real SH basis in the order
+    // (l, m) = (0, 0), (1,-1), (1, 0), (1, 1), (2,-2), (2,-1), (2, 0), (2, 1), (2, 2).
+
+    typedef struct SphericalHarmonics
+    {
+        SphericalHarmonics();
+
+        osg::Vec3f coefficients[9];
+
+    } t_sh9;
+
+public:
+
+    // resolution is the number of samples in elevation (twice as
+    // many are taken in azimuth).
+    HimmelAmbient(const int resolution = 32);
+    virtual ~HimmelAmbient();
+
+    // Call after Himmel::update (from the same thread).
+    void update(const Himmel &himmel);
+
+    // Latest published coefficients (zero until the first projection).
+    const t_sh9 &getCoefficients();
+
+    // Number of published projections.
+    const unsigned int getRevision() const;
+
+    // Minimum angular distance in degrees the sun or moon has to move
+    // for a projection.
+    const float setThreshold(const float threshold);
+    const float getThreshold() const;
+    static const float defaultThreshold();
+
+    const bool setMoonEnabled(const bool enabled);
+    const bool isMoonEnabled() const;
+
+    // Night sky radiance of the starmap (zero disables it).
+    const osg::Vec3f setStarMapRadiance(const osg::Vec3f &radiance);
+    const osg::Vec3f getStarMapRadiance() const;
+
+    // Irradiance of a surface with the given normal (cosine convolution
+    // of the radiance, Ramamoorthi and Hanrahan 2001).
+    static const osg::Vec3f irradiance(
+        const t_sh9 &sh
+    ,   const osg::Vec3f &normal);
+
+    // Radiance in the given direction.
+    static const osg::Vec3f radiance(
+        const t_sh9 &sh
+    ,   const osg::Vec3f &direction);
+
+    // Adds a directional light of radiance times solid angle.
+    static void addDirectional(
+        t_sh9 &sh
+    ,   const osg::Vec3f &direction
+    ,   const osg::Vec3f &intensity);
+
+    // Projects the sky of a query (without moon and stars).
+    static void project(
+        t_sh9 &sh
+    ,   const AtmosphereQuery &query
+    ,   const osg::Vec3f &sun
+    ,   const float altitude
+    ,   const int resolution);
+
+protected:
+
+    // Everything a projection depends on.
+
+    typedef struct Request
+    {
+        Request();
+
+        osg::Vec3f sun;
+        osg::Vec3f moon;
+        float altitude;
+
+        // radiance of the moon times its solid angle (zero if disabled)
+        osg::Vec3f moonIntensity;
+        osg::Vec3f starMapRadiance;
+
+        // tables to use from now on (owned by the worker once taken)
+        AtmosphereQuery *query;
+
+    } t_request;
+
+    class Worker;
+
+    const bool isRequired(const t_request &request) const;
+
+    // worker thread
+    void project(
+        t_sh9 &sh
+    ,   const t_request &request
+    ,   const AtmosphereQuery &query) const;
+
+    void publish(const t_sh9 &sh);
+
+protected:
+
+    const int m_resolution;
+
+    float m_threshold;
+    bool m_moonEnabled;
+    osg::Vec3f m_starMapRadiance;
+
+    Worker *m_worker;
+
+    // last requested
+    t_request m_last;
+    bool m_requested;
+    unsigned int m_tablesRevision;
+
+    // pending request (guarded by m_mutex)
+
+    OpenThreads::Mutex m_mutex;
+    OpenThreads::Condition m_condition;
+
+    t_request m_pending;
+    bool m_hasPending;
+    bool m_quit;
+
+    // Triple buffer: the worker writes m_buffers[m_back], exchanges it
+    // with m_middle (marked FRESH), and update exchanges m_front with
+    // a fresh m_middle.
+
+    t_sh9 m_buffers[3];
+
+    unsigned int m_back;        // worker thread
+    OpenThreads::Atomic m_middle;
+    unsigned int m_front;       // update thread
+
+    OpenThreads::Atomic m_revision;
+};
+
+} // namespace osgHimmel
+
+#endif // __HIMMELAMBIENT_H__
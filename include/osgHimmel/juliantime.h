@@ -0,0 +1,113 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#ifndef __JULIANTIME_H__
+#define __JULIANTIME_H__
+
+#include "declspec.h"
+#include "typedefs.h"
+#include "atime.h"
+#include "julianday.h"
+
+#include <time.h>
+
+
+namespace osgHimmel
+{
+
+class TimeF;
+
+
+// Continuous time line of the astronomy, as local julian day split into
+// the julian day at local midnight and the fraction of the day since. Both
+// are doubles, resolving better than a microsecond for any date, without
+// the whole seconds and calendar round trips of t_aTime. t_aTime converts
+// implicitly (exactly, jd() equals jd(aTime)).
+
+typedef struct OSGH_API s_JulianTime
+{
+    s_JulianTime();
+
+    explicit s_JulianTime(
+        const t_julianDay julianDate
+    ,   const long utcOffset = 0);
+
+    s_JulianTime(const t_aTime &aTime);
+
+    // Unlike t_aTime, the time zone of the system is not involved: the
+    // local time is the utc time plus utcOffset (without daylight saving).
+
+    static const s_JulianTime fromTimeT(
+        const time_t &time
+    ,   const long utcOffset
+    ,   const double fraction = 0.0); // Of a second, in [0;1).
+
+    // Converts the whole seconds as t_aTime::fromTimeF does (time zone and
+    // daylight saving of the system) and adds the fractions of seconds.
+    static const s_JulianTime fromTimeF(const TimeF &t);
+
+    // Whole seconds, rounded down.
+    const t_aTime toATime() const;
+
+    inline const t_julianDay jd() const
+    {
+        return static_cast<t_julianDay>(day) + fraction;
+    }
+
+    inline const t_julianDay jdUT() const
+    {
+        return static_cast<t_julianDay>(day) + (fraction - utcOffset / 86400.0);
+    }
+
+    // Time shifted by seconds.
+    const s_JulianTime operator+(const double seconds) const;
+
+    // Difference in seconds.
+    const double operator-(const s_JulianTime &other) const;
+
+    const bool operator==(const s_JulianTime &other) const
+    {
+        return other.day       == day
+            && other.fraction  == fraction
+            && other.utcOffset == utcOffset;
+    }
+
+public:
+
+    double day;      // Julian day at local midnight (x.5).
+    double fraction; // In [0;1).
+
+    long utcOffset;  // In seconds.
+
+} t_julianTime;
+
+} // namespace osgHimmel
+
+#endif // __JULIANTIME_H__
@@ -0,0 +1,93 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#ifndef __MEMORYMAPPEDFILE_H__
+#define __MEMORYMAPPEDFILE_H__
+
+#include "declspec.h"
+
+#include <osg/Referenced>
+
+#include <cstddef>
+
+
+namespace osgHimmel
+{
+
+// Maps a whole file into the address space of the process (mmap on 
+// posix systems, file mappings on windows). The mapping is released 
+// on close or destruction, so pointers into data() must not outlive it.
+
+class OSGH_API MemoryMappedFile : public osg::Referenced
+{
+public:
+
+    MemoryMappedFile();
+    virtual ~MemoryMappedFile();
+
+    // With copyOnWrite the mapped pages are writable, but changes are 
+    // private to the process and never written back to the file.
+    const bool open(
+        const char *fileName
+    ,   const bool copyOnWrite = false);
+
+    void close();
+
+    const bool isOpen() const;
+
+    // writing is only valid if opened with copyOnWrite
+    char *data();
+    const char *data() const;
+
+    const std::size_t size() const;
+
+    // Renames source to target, replacing target. On posix systems the 
+    // replacement is atomic, even if target is mapped (the mapping keeps 
+    // the former file). Windows cannot rename onto existing files, so the
+    // target is removed first (which fails while it is mapped), and is 
+    // missing in between.
+    static const bool replace(
+        const char *source
+    ,   const char *target);
+
+protected:
+
+    char *m_data;
+    std::size_t m_size;
+
+#ifdef _WIN32
+    void *m_file;    // HANDLE
+    void *m_mapping; // HANDLE
+#endif // _WIN32
+};
+
+} // namespace osgHimmel
+
+#endif // __MEMORYMAPPEDFILE_H__
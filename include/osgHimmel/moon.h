@@ -33,48 +33,120 @@
 
 #include "declspec.h"
 #include "typedefs.h"
-#include "julianday.h"
+#include "precision.h"
+#include "juliantime.h"
 #include "coords.h"
+#include "periodicterms.h"
 
 
 namespace osgHimmel
 {
 
-class OSGH_API Moon
+// Instantiated for float, double, and long double (see precision.h). The
+// periodic series are truncated by truncation, if given.
+
+template<typename t_real>
+class OSGH_API MoonT
 {
 public:
-    static const t_longf meanLongitude(const t_julianDay t); 
-    static const t_longf meanElongation(const t_julianDay t);
-    static const t_longf meanAnomaly(const t_julianDay t);
-    static const t_longf meanLatitude(const t_julianDay t);
+    static const t_real meanLongitude(const t_julianDay t); 
+    static const t_real meanElongation(const t_julianDay t);
+    static const t_real meanAnomaly(const t_julianDay t);
+    static const t_real meanLatitude(const t_julianDay t);
+
+    static const t_real meanOrbitLongitude(const t_julianDay t);
+
+    static const s_EclipticalCoords<t_real> position(
+        const t_julianDay t
+    ,   const SeriesTruncation *truncation = NULL);
+
+    static const s_EquatorialCoords<t_real> apparentPosition(
+        const t_julianDay t
+    ,   const SeriesTruncation *truncation = NULL);
 
-    static const t_longf meanOrbitLongitude(const t_julianDay t);
+    // Apparent positions in degrees of count instants (see Sun).
+    static void apparentPositions(
+        const double *t
+    ,   const unsigned int count
+    ,   double *rightAscensions
+    ,   double *declinations
+    ,   const SeriesTruncation *truncation = NULL);
 
-    static const t_ecld position(const t_julianDay t);
-    static const t_equd apparentPosition(const t_julianDay t);
+    static const s_HorizontalCoords<t_real> horizontalPosition(
+        const t_julianTime &time
+    ,   const t_real latitude
+    ,   const t_real longitude
+    ,   const SeriesTruncation *truncation = NULL);
 
-    static const t_hord horizontalPosition(
-        const t_aTime &aTime
-    ,   const t_longf latitude
-    ,   const t_longf longitude);
+    // Horizontal positions of one instant for count observers, with the 
+    // apparent position and sidereal time evaluated once.
+    static void horizontalPositions(
+        const t_julianTime &time
+    ,   const t_real *latitudes
+    ,   const t_real *longitudes
+    ,   const unsigned int count
+    ,   t_real *altitudes
+    ,   t_real *azimuths
+    ,   const SeriesTruncation *truncation = NULL);
 
-    static const t_longf distance(const t_julianDay t);
+    static const t_real distance(
+        const t_julianDay t
+    ,   const SeriesTruncation *truncation = NULL);
 
     static void opticalLibrations(
         const t_julianDay t
-    ,   t_longf &l /* librations in longitude */
-    ,   t_longf &b /* librations in latitude  */);
+    ,   t_real &l /* librations in longitude */
+    ,   t_real &b /* librations in latitude  */
+    ,   const SeriesTruncation *truncation = NULL);
 
-    static const t_longf parallacticAngle(
-        const t_aTime &aTime
-    ,   const t_longf latitude
-    ,   const t_longf longitude);
+    static const t_real parallacticAngle(
+        const t_julianTime &time
+    ,   const t_real latitude
+    ,   const t_real longitude
+    ,   const SeriesTruncation *truncation = NULL);
 
-    static const t_longf positionAngleOfAxis(const t_julianDay t);
+    static const t_real positionAngleOfAxis(
+        const t_julianDay t
+    ,   const SeriesTruncation *truncation = NULL);
 
-    static const t_longf meanRadius();
+    // Variants taking the position, apparent position, nutation, and 
+    // obliquity of the instant, e.g., if these are at hand already.
+
+    static const s_EclipticalCoords<t_real> position(
+        const t_julianDay t
+    ,   const t_real longitudeNutation
+    ,   const SeriesTruncation *truncation);
+
+    static const s_EquatorialCoords<t_real> apparentPosition(
+        const s_EclipticalCoords<t_real> &ecl
+    ,   const t_real longitudeNutation
+    ,   const t_real meanObliquity);
+
+    static void opticalLibrations(
+        const t_julianDay t
+    ,   const s_EclipticalCoords<t_real> &ecl
+    ,   const t_real longitudeNutation
+    ,   t_real &l
+    ,   t_real &b);
+
+    static const t_real parallacticAngle(
+        const s_EquatorialCoords<t_real> &pos
+    ,   const t_julianDay siderealTime
+    ,   const t_real latitude
+    ,   const t_real longitude);
+
+    static const t_real positionAngleOfAxis(
+        const t_julianDay t
+    ,   const s_EclipticalCoords<t_real> &ecl
+    ,   const s_EquatorialCoords<t_real> &pos
+    ,   const t_real longitudeNutation
+    ,   const t_real meanObliquity);
+
+    static const t_real meanRadius();
 };
 
+typedef MoonT<t_longf> Moon;
+
 } // namespace osgHimmel
 
 #endif // __MOON_H__
\ No newline at end of file
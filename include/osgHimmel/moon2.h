@@ -33,7 +33,7 @@
 
 #include "declspec.h"
 #include "typedefs.h"
-#include "julianday.h"
+#include "juliantime.h"
 #include "coords.h"
 
 
@@ -55,7 +55,7 @@ public:
     static const t_equf apparentPosition(const t_julianDay t);
 
     static const t_horf horizontalPosition(
-        const t_aTime &aTime
+        const t_julianTime &time
     ,   const float latitude
     ,   const float longitude);
 
@@ -67,7 +67,7 @@ public:
     ,   float &b /* librations in latitude  */);
 
     static const float parallacticAngle(
-        const t_aTime &aTime
+        const t_julianTime &time
     ,   const float latitude
     ,   const float longitude);
 
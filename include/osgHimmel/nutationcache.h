@@ -0,0 +1,119 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#ifndef __NUTATIONCACHE_H__
+#define __NUTATIONCACHE_H__
+
+#include "declspec.h"
+#include "julianday.h"
+
+#include <OpenThreads/Mutex>
+
+
+namespace osgHimmel
+{
+
+class SeriesTruncation;
+
+
+// The nutations in longitude and obliquity (AA.22.A) vary with periods
+// of days to years, negligibly within minutes, but their series are among
+// the costliest terms of the astronomy. NutationCache samples both at a
+// spacing derived from the tolerance and a bound of the second derivative
+// of the series, and interpolates linearly in between, which keeps the
+// error of both within the tolerance.
+//
+// The samples lie on a fixed grid of julian days, so that the results
+// depend on the instant only. The last samples are shared by all threads
+// (guarded by a mutex), the tolerance must not change meanwhile.
+
+class OSGH_API NutationCache
+{
+public:
+
+    NutationCache(const double tolerance = 0.0);
+
+    // Copies the tolerance, not the samples.
+    NutationCache(const NutationCache &other);
+    NutationCache &operator=(const NutationCache &other);
+
+    // Maximum error in degrees, zero disables the cache (getters evaluate
+    // the series).
+    const double setTolerance(const double tolerance);
+    const double getTolerance() const;
+
+    inline const bool isEnabled() const
+    {
+        return m_tolerance > 0.0;
+    }
+
+    // Interval of the samples in julian days.
+    const double getSpacing() const;
+
+    // Drops the samples, e.g., if the truncation of the series changed.
+    void clear();
+
+    // Nutations in longitude and obliquity in degrees.
+    void nutations(
+        const t_julianDay t
+    ,   const SeriesTruncation *truncation
+    ,   double &longitudeNutation
+    ,   double &obliquityNutation) const;
+
+    // Bound of the second derivative of both series in degrees per day
+    // squared (within a century of the standard equinox).
+    static const double curvatureBound();
+
+protected:
+
+    typedef struct Samples
+    {
+        Samples();
+
+        double node; // index of the first sample on the grid
+        bool valid;
+
+        double longitude[2];
+        double obliquity[2];
+
+    } t_samples;
+
+protected:
+
+    double m_tolerance;
+    double m_spacing;
+
+    mutable OpenThreads::Mutex m_mutex;
+    mutable t_samples m_samples;
+};
+
+} // namespace osgHimmel
+
+#endif // __NUTATIONCACHE_H__
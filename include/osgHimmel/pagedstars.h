@@ -0,0 +1,248 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#ifndef __PAGEDSTARS_H__
+#define __PAGEDSTARS_H__
+
+#include "declspec.h"
+#include "brightstars.h"
+
+#include <osg/Referenced>
+#include <osg/Timer>
+#include <osg/Vec3f>
+
+#include <OpenThreads/Mutex>
+#include <OpenThreads/Condition>
+
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <vector>
+
+
+namespace osgHimmel
+{
+
+// Streams star catalogues too large to be loaded at once (e.g., tens of
+// millions of stars derived from Gaia) from a paged file. The stars are
+// layered by visual magnitude (see layer), and the stars of each layer
+// are partitioned into tiles by the cells of a StarsIndex, sorted by 
+// magnitude within. The table of the tiles is read on construction, the
+// stars of the tiles by a background thread on request.
+//
+// Per frame, request the tiles of the views (cones and limiting magnitude,
+// which deepens as the field of view narrows, see Stars::limitingMagnitude),
+// then update. The tiles are queued by layer and angle to the view, the
+// fainter ones are dropped if all would exceed the memory budget. Tiles
+// not requested in the frame are evicted, least recently requested first,
+// as long as the resident ones exceed the budget.
+//
+// All but the loader must be called from one thread (e.g., on update).
+
+class OSGH_API PagedStars : public osg::Referenced
+{
+public:
+
+    typedef struct Tile
+    {
+        osg::Vec3f axis;     // bounding cone of the J2000 positions
+        float radius;        // half angle in radians
+
+        float brightest;     // visual magnitudes
+        float faintest;
+
+        unsigned int layer;
+
+        unsigned int first;  // index of the first star in the file
+        unsigned int count;
+
+    } t_tile;
+
+
+    typedef struct Statistics
+    {
+        Statistics();
+
+        std::size_t residentBytes;
+        unsigned int residentTiles;
+        unsigned int pendingTiles;   // queued or loading
+        unsigned int droppedTiles;   // beyond the budget, on the last update
+
+        unsigned int loadedTiles;    // in total
+        unsigned int evictedTiles;
+
+        // seconds from the first request of a tile until it is resident
+        double lastLatency;
+        double meanLatency;
+        double maxLatency;
+
+    } t_statistics;
+
+public:
+
+    PagedStars(
+        const char *fileName
+    ,   const std::size_t budget = defaultBudget());
+
+    virtual ~PagedStars();
+
+    const bool isOpen() const;
+
+    static const bool isPaged(const char *fileName);
+
+    // Writes the stars layered and tiled, in the byte order of the machine,
+    // to a temporary file that replaces the file when complete (see 
+    // MemoryMappedFile::replace). Returns the number of stars written.
+    static const unsigned int toFile(
+        const BrightStars::s_BrightStar *stars
+    ,   const unsigned int numStars
+    ,   const char *fileName
+    ,   const unsigned int maxStarsPerTile = defaultMaxStarsPerTile());
+
+    static const unsigned int convert(
+        const char *sourceFileName
+    ,   const char *targetFileName
+    ,   const unsigned int maxStarsPerTile = defaultMaxStarsPerTile());
+
+    static const unsigned int defaultMaxStarsPerTile();
+    static const std::size_t defaultBudget();
+
+    static const unsigned int version();
+
+    // Faintest visual magnitude of the stars of a layer (the last layer 
+    // takes all fainter stars).
+    static const unsigned int numLayers();
+    static const float layer(const unsigned int i);
+
+    // In bytes of the stars of the resident tiles.
+    const std::size_t setBudget(const std::size_t bytes);
+    const std::size_t getBudget() const;
+
+    const unsigned int numStars() const;
+    const unsigned int numTiles() const;
+
+    const t_tile &tile(const unsigned int i) const;
+
+    // Requests the tiles within the view cone (unit direction in J2000, 
+    // half angle in radians) with stars brighter than limitingMagnitude, 
+    // for the next update. Returns the number of these that are resident.
+    const unsigned int request(
+        const osg::Vec3f &direction
+    ,   const float halfAngle
+    ,   const float limitingMagnitude);
+
+    // Queues the requested tiles that are not resident (replacing the 
+    // queue of former frames), takes the tiles loaded since, and evicts 
+    // tiles beyond the budget. Returns the indices of the tiles that 
+    // became resident, and of the evicted ones (both are disjoint, tiles 
+    // that became resident are kept until the next update at least).
+    void update(
+        std::vector<unsigned int> &loaded
+    ,   std::vector<unsigned int> &evicted);
+
+    const bool isResident(const unsigned int i) const;
+
+    // Stars of a resident tile (valid until evicted), NULL otherwise.
+    const BrightStars::s_BrightStar *stars(const unsigned int i) const;
+
+    // Number of the stars of a resident tile not fainter than 
+    // limitingMagnitude, which are the first of the tile.
+    const unsigned int numBrighter(
+        const unsigned int i
+    ,   const float limitingMagnitude) const;
+
+    const t_statistics &statistics() const;
+
+    // Blocks until the queue is worked off (e.g., for tests).
+    void wait() const;
+
+protected:
+
+    class Loader;
+
+    void open(const char *fileName);
+
+    typedef struct Page
+    {
+        Page();
+
+        BrightStars::s_BrightStar *stars;
+
+        unsigned int used;       // frame of the last request
+        unsigned int applied;    // frame the tile became resident
+        osg::Timer_t requested;  // tick of the first request
+        
+        bool queued;             // or loading
+        bool failed;
+
+    } t_page;
+
+    typedef struct Candidate
+    {
+        unsigned int tile;
+        unsigned int layer;
+        float angle;
+
+        bool operator<(const Candidate &other) const;
+
+    } t_candidate;
+
+protected:
+
+    std::string m_fileName;
+    std::size_t m_offset;    // of the stars in the file
+
+    std::vector<t_tile> m_tiles;
+    std::vector<t_page> m_pages;
+
+    std::vector<t_candidate> m_candidates;
+
+    unsigned int m_frame;
+    std::size_t m_budget;
+
+    t_statistics m_statistics;
+
+    // shared with the loader
+
+    mutable OpenThreads::Mutex m_mutex;
+    mutable OpenThreads::Condition m_condition;
+
+    std::deque<unsigned int> m_queue;
+    std::vector<std::pair<unsigned int, BrightStars::s_BrightStar*> > m_loaded;
+
+    bool m_loading;
+    bool m_quit;
+
+    Loader *m_loader;
+};
+
+} // namespace osgHimmel
+
+#endif // __PAGEDSTARS_H__
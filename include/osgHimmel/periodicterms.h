@@ -0,0 +1,378 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#ifndef __PERIODICTERMS_H__
+#define __PERIODICTERMS_H__
+
+#include "declspec.h"
+#include "typedefs.h"
+#include "julianday.h"
+
+#include <vector>
+
+#include <math.h>
+
+
+namespace osgHimmel
+{
+
+// Periodic term of the lunar and nutation series (AA.22.A and AA.47.A/B),
+// a * sin(arg) or a * cos(arg) with arg = D * D' + M * M' + Mm * Mm' + 
+// F * F' + O * O', the sum of multiples of the fundamental arguments. The
+// amplitude a changes by b per julian century, and is multiplied by the 
+// e-th power of the eccentricity correction E (AA.47.6).
+
+typedef struct PeriodicTerm
+{
+    signed char D;  // mean elongation of the moon
+    signed char M;  // mean anomaly of the sun
+    signed char Mm; // mean anomaly of the moon
+    signed char F;  // argument of latitude of the moon
+    signed char O;  // longitude of the ascending node of the moons orbit
+
+    double a;
+    double b;
+
+    signed char e;
+
+} t_periodicTerm;
+
+
+typedef struct PeriodicSeries
+{
+    const t_periodicTerm *terms;
+    unsigned int numTerms;
+
+} t_periodicSeries;
+
+
+// Fundamental arguments of an instant in radians, with the julian 
+// centuries T since the standard equinox, and E^0, E^1, and E^2.
+
+template<typename T>
+struct s_FundamentalArguments
+{
+    T D;
+    T M;
+    T Mm;
+    T F;
+    T O;
+
+    T centuries;
+    T E[3];
+};
+
+typedef s_FundamentalArguments<t_longf> t_fundArgs;
+typedef s_FundamentalArguments<float> t_fundArgsf;
+
+
+// Fundamental arguments of many instants as structure of arrays.
+
+template<typename T>
+struct s_FundamentalArgumentArrays
+{
+    void resize(const unsigned int count);
+
+    std::vector<T> D;
+    std::vector<T> M;
+    std::vector<T> Mm;
+    std::vector<T> F;
+    std::vector<T> O;
+
+    std::vector<T> centuries;
+    std::vector<T> E[3];
+};
+
+typedef s_FundamentalArgumentArrays<double> t_fundArgArrays;
+
+
+// Fundamental arguments of Sun, Moon, and Earth (AA.22), and of Sun2, 
+// Moon2, and Earth2 respectively. The batched variants take julian days.
+// The template is instantiated for float, double, and long double, the 
+// arguments of SunT, MoonT, and EarthT (see precision.h).
+
+template<typename t_real>
+OSGH_API const s_FundamentalArguments<t_real> fundamentalArguments(const t_julianDay t);
+
+OSGH_API const t_fundArgs fundamentalArguments(const t_julianDay t);
+OSGH_API const t_fundArgsf fundamentalArguments2(const t_julianDay t);
+
+OSGH_API void fundamentalArguments(
+    const double *t
+,   const unsigned int count
+,   t_fundArgArrays &args);
+
+
+// Sum of the terms of an instant.
+
+template<typename T>
+const T sumSines(
+    const t_periodicTerm *terms
+,   const unsigned int numTerms
+,   const s_FundamentalArguments<T> &args);
+
+template<typename T>
+const T sumCosines(
+    const t_periodicTerm *terms
+,   const unsigned int numTerms
+,   const s_FundamentalArguments<T> &args);
+
+
+// Adds the sums of the terms of many instants to sums. The loops run per
+// term over all instants and are free of branches, so that compilers 
+// vectorize them (given a vector math library for sin and cos).
+
+template<typename T>
+void addSines(
+    const t_periodicTerm *terms
+,   const unsigned int numTerms
+,   const s_FundamentalArgumentArrays<T> &args
+,   T *sums);
+
+template<typename T>
+void addCosines(
+    const t_periodicTerm *terms
+,   const unsigned int numTerms
+,   const s_FundamentalArgumentArrays<T> &args
+,   T *sums);
+
+
+// The periodic series of MoonT and EarthT, truncated to a maximum error 
+// for speed: the smallest terms of a series are omitted, as long as the 
+// sum of their amplitudes remains below the maximum error. This bounds 
+// the error of each series within a century of the standard equinox. The 
+// remaining terms keep their order, thus a maximum error of zero sums up
+// exactly as the complete series.
+//
+// The maximum error is given in degrees. The distance of the moon is 
+// truncated to the displacement the angle spans at its mean distance.
+
+class OSGH_API SeriesTruncation
+{
+public:
+
+    enum e_Series
+    {
+        S_MoonLongitude     // (AA.47.A) in 0.001 degrees
+    ,   S_MoonLatitude      // (AA.47.B) in 0.001 degrees
+    ,   S_MoonDistance      // (AA.47.A) in kilometers
+    ,   S_LongitudeNutation // (AA.22.A) in arcseconds
+    ,   S_ObliquityNutation // (AA.22.A) in arcseconds
+    ,   NUM_SERIES
+    };
+
+public:
+
+    SeriesTruncation(const double maxError = 0.0);
+
+    const double setMaxError(const double maxError);
+    const double getMaxError() const;
+
+    const t_periodicSeries series(const e_Series s) const;
+
+    // Sum of the amplitudes of the omitted terms (in the unit of the series).
+    const double errorBound(const e_Series s) const;
+
+    // Series of a truncation, or the complete series if it is NULL.
+    static const t_periodicSeries series(
+        const SeriesTruncation *truncation
+    ,   const e_Series s);
+
+    static const t_periodicSeries completeSeries(const e_Series s);
+
+protected:
+
+    double m_maxError;
+
+    std::vector<t_periodicTerm> m_terms[NUM_SERIES];
+    double m_errorBounds[NUM_SERIES];
+};
+
+
+
+template<typename T>
+void s_FundamentalArgumentArrays<T>::resize(const unsigned int count)
+{
+    D.resize(count);
+    M.resize(count);
+    Mm.resize(count);
+    F.resize(count);
+    O.resize(count);
+
+    centuries.resize(count);
+
+    E[0].assign(count, static_cast<T>(1));
+    E[1].resize(count);
+    E[2].resize(count);
+}
+
+
+template<typename T>
+inline const T periodicArgument(
+    const t_periodicTerm &term
+,   const s_FundamentalArguments<T> &args)
+{
+    return term.D * args.D + term.M * args.M + term.Mm * args.Mm 
+        + term.F * args.F + term.O * args.O;
+}
+
+
+template<typename T>
+const T sumSines(
+    const t_periodicTerm *terms
+,   const unsigned int numTerms
+,   const s_FundamentalArguments<T> &args)
+{
+    T sum(0.0);
+
+    for(unsigned int i = 0; i < numTerms; ++i)
+    {
+        const t_periodicTerm &term(terms[i]);
+        sum += (static_cast<T>(term.a) + static_cast<T>(term.b) * args.centuries) 
+            * sin(periodicArgument(term, args)) * args.E[term.e];
+    }
+    return sum;
+}
+
+
+template<typename T>
+const T sumCosines(
+    const t_periodicTerm *terms
+,   const unsigned int numTerms
+,   const s_FundamentalArguments<T> &args)
+{
+    T sum(0.0);
+
+    for(unsigned int i = 0; i < numTerms; ++i)
+    {
+        const t_periodicTerm &term(terms[i]);
+        sum += (static_cast<T>(term.a) + static_cast<T>(term.b) * args.centuries) 
+            * cos(periodicArgument(term, args)) * args.E[term.e];
+    }
+    return sum;
+}
+
+
+template<typename T, bool cosine>
+void addPeriodicTerms(
+    const t_periodicTerm *terms
+,   const unsigned int numTerms
+,   const s_FundamentalArgumentArrays<T> &args
+,   T *sums)
+{
+    const unsigned int count = static_cast<unsigned int>(args.D.size());
+    if(0 == count)
+        return;
+
+    for(unsigned int j = 0; j < numTerms; ++j)
+    {
+        const t_periodicTerm &term(terms[j]);
+
+        const T D(term.D);
+        const T M(term.M);
+        const T Mm(term.Mm);
+        const T F(term.F);
+        const T O(term.O);
+
+        const T a(static_cast<T>(term.a));
+        const T b(static_cast<T>(term.b));
+
+        const T *E(&args.E[term.e][0]);
+
+        for(unsigned int i = 0; i < count; ++i)
+        {
+            const T arg = D * args.D[i] + M * args.M[i] + Mm * args.Mm[i] 
+                + F * args.F[i] + O * args.O[i];
+
+            sums[i] += (a + b * args.centuries[i]) * (cosine ? cos(arg) : sin(arg)) * E[i];
+        }
+    }
+}
+
+
+template<typename T>
+void addSines(
+    const t_periodicTerm *terms
+,   const unsigned int numTerms
+,   const s_FundamentalArgumentArrays<T> &args
+,   T *sums)
+{
+    addPeriodicTerms<T, false>(terms, numTerms, args, sums);
+}
+
+
+template<typename T>
+void addCosines(
+    const t_periodicTerm *terms
+,   const unsigned int numTerms
+,   const s_FundamentalArgumentArrays<T> &args
+,   T *sums)
+{
+    addPeriodicTerms<T, true>(terms, numTerms, args, sums);
+}
+
+
+template<typename T>
+inline const T sumSines(
+    const t_periodicSeries &series
+,   const s_FundamentalArguments<T> &args)
+{
+    return sumSines(series.terms, series.numTerms, args);
+}
+
+template<typename T>
+inline const T sumCosines(
+    const t_periodicSeries &series
+,   const s_FundamentalArguments<T> &args)
+{
+    return sumCosines(series.terms, series.numTerms, args);
+}
+
+template<typename T>
+inline void addSines(
+    const t_periodicSeries &series
+,   const s_FundamentalArgumentArrays<T> &args
+,   T *sums)
+{
+    addSines(series.terms, series.numTerms, args, sums);
+}
+
+template<typename T>
+inline void addCosines(
+    const t_periodicSeries &series
+,   const s_FundamentalArgumentArrays<T> &args
+,   T *sums)
+{
+    addCosines(series.terms, series.numTerms, args, sums);
+}
+
+} // namespace osgHimmel
+
+#endif // __PERIODICTERMS_H__
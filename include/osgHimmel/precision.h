@@ -0,0 +1,118 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#ifndef __PRECISION_H__
+#define __PRECISION_H__
+
+#include "typedefs.h"
+#include "julianday.h"
+#include "mathmacros.h"
+
+#include <math.h>
+
+
+namespace osgHimmel
+{
+
+// The astronomy (SunT, MoonT, EarthT, AstronomyT, and the coordinates) 
+// is templated on the floating point type t_real of its terms: float, 
+// double, or long double. The long double instantiations are the default 
+// (Sun, Moon, Earth, and Astronomy). On x86-64 long double runs on the 
+// x87 unit and never vectorizes, double and float trade accuracy for 
+// throughput (apparent positions deviate by about 1e-10 and 0.05 degrees).
+//
+// Julian days remain t_julianDay, since a float does not even resolve 
+// days in the julian period. Terms are evaluated from the julian 
+// centuries since the standard equinox, converted to t_real.
+//
+// The functions below are the typed counterparts of the mathmacros, which
+// promote to long double. For long double they compute the same.
+
+template<typename t_real>
+inline const t_real rad(const t_real deg)
+{
+    return deg * static_cast<t_real>(_PI) / static_cast<t_real>(180.0L);
+}
+
+template<typename t_real>
+inline const t_real deg(const t_real rad)
+{
+    return rad * static_cast<t_real>(180.0L) / static_cast<t_real>(_PI);
+}
+
+// normalizes an angle to between 0 and 2PI radians
+template<typename t_real>
+inline const t_real rev(const t_real rad)
+{
+    static const t_real PI2(static_cast<t_real>(_PI2));
+    return rad - floor(rad / PI2) * PI2;
+}
+
+// normalizes an angle to between 0 and 360 degrees
+template<typename t_real>
+inline const t_real revd(const t_real deg)
+{
+    return deg - floor(deg / static_cast<t_real>(360.0L)) * static_cast<t_real>(360.0L);
+}
+
+template<typename t_real>
+inline const t_real decimal(
+    const t_real d
+,   const t_real m
+,   const t_real s)
+{
+    return d + (m + s / static_cast<t_real>(60.0L)) / static_cast<t_real>(60.0L);
+}
+
+// Julian centuries since the standard equinox (see jCenturiesSinceSE).
+template<typename t_real>
+inline const t_real centuries(const t_julianDay t)
+{
+    return static_cast<t_real>(jCenturiesSinceSE(t));
+}
+
+// c[0] + x * (c[1] + x * (c[2] + ...)) by Horner's method, with the 
+// coefficients given as t_real, so that they do not promote x.
+template<typename t_real>
+inline const t_real polynomial(
+    const t_real x
+,   const t_real *c
+,   const unsigned int n)
+{
+    t_real p(c[n - 1]);
+    for(unsigned int i = n - 1; i > 0; --i)
+        p = c[i - 1] + x * p;
+
+    return p;
+}
+
+} // namespace osgHimmel
+
+#endif // __PRECISION_H__
@@ -33,15 +33,15 @@
 
 #include "declspec.h"
 #include "typedefs.h"
-#include "atime.h"
+#include "juliantime.h"
 
 
 namespace osgHimmel
 {
 
 // The mean sideral time, Greenwich hour angle of the mean vernal point.
-OSGH_API const t_longf siderealTime(const t_aTime &aTime);
-OSGH_API const t_longf siderealTime2(const t_aTime &aTime);
+OSGH_API const t_longf siderealTime(const t_julianTime &time);
+OSGH_API const t_longf siderealTime2(const t_julianTime &time);
 
 } // namespace osgHimmel
 
@@ -33,13 +33,45 @@
 
 #include "declspec.h"
 #include "typedefs.h"
-#include "julianday.h"
+#include "juliantime.h"
 #include "coords.h"
 
+#include <osg/Vec3d>
+#include <osg/Matrixf>
+
 
 namespace osgHimmel
 {
 
+// Everything the apparent places of all stars share at an epoch: the 
+// rotation from the mean equator and equinox J2000 to the true equator
+// and equinox of date, i.e., precession (AA.21.2-4) followed by nutation
+// (AA.23.1), and the annual aberration (AA.23.3). Both apply to unit 
+// vectors with x towards the equinox and z towards the pole, which 
+// s_EquatorialCoords::toEuclidean mirrors (x and y swapped).
+
+typedef struct OSGH_API s_StarsEpoch
+{
+    s_StarsEpoch(const t_julianDay t);
+
+    // Applies proper motion, rotation, and aberration to the unit vector
+    // of a J2000 position and its proper motion (radians per julian year
+    // as vector, see Stars::properMotion). The result is not normalized.
+    const osg::Vec3d apply(
+        const osg::Vec3d &p2000
+    ,   const osg::Vec3d &pm2000) const;
+
+public:
+
+    t_julianDay t;
+    double years; // julian years since J2000.0
+
+    double rotation[3][3];   // row major
+    double aberration[3];    // displacement in radians
+
+} t_starsEpoch;
+
+
 class OSGH_API Stars
 {
 public:
@@ -56,21 +88,74 @@ public:
     static const osg::Vec3f sRgbColor(const osg::Vec3f xyzTrisimulus);
 
 
+    // Unit vector of a J2000 position (x towards the equinox, see 
+    // t_starsEpoch), and the proper motion as vector tangential to it 
+    // in radians per julian year. The proper motions are in arcseconds per
+    // year, in RA already times cos DE (as in the bright star catalogue).
+
+    static const osg::Vec3d position(
+        const t_longf a2000   /* right_ascension (RA) in decimal degrees, equinox J2000 */
+    ,   const t_longf d2000   /* declination (DE) in decimal degrees, equinox J2000 */);
+
+    static const osg::Vec3d properMotion(
+        const t_longf a2000
+    ,   const t_longf d2000
+    ,   const t_longf pma2000 /* annual proper motion in RA times cos DE, arcseconds */
+    ,   const t_longf pmd2000 /* annual proper motion in DE, arcseconds */);
+
+    // Apparent position of date (AA.23), without parallax and the
+    // relativistic deflection. For many stars, see ApparentStars.
+
     static const t_equd apparentPosition(
         const t_julianDay t
     ,   const t_longf a2000   /* right_ascension (RA) in decimal degrees, equinox J2000 */
     ,   const t_longf d2000   /* declination (DE) in decimal degrees, equinox J2000 */
-    ,   const t_longf mpa2000 /* annual proper motion in RA J2000 */
-    ,   const t_longf mpd2000 /* annual proper motion in DE J2000 */);
+    ,   const t_longf mpa2000 /* annual proper motion in RA in decimal degrees (not times cos DE) */
+    ,   const t_longf mpd2000 /* annual proper motion in DE in decimal degrees */);
+
+    static const t_equd apparentPosition(
+        const t_starsEpoch &epoch
+    ,   const osg::Vec3d &p2000
+    ,   const osg::Vec3d &pm2000);
 
     static const t_hord horizontalPosition(
-        const t_aTime &aTime
+        const t_julianTime &time
     ,   const t_longf latitude
     ,   const t_longf longitude
     ,   const t_longf a2000   /* right_ascension (RA) in decimal degrees, equinox J2000 */
     ,   const t_longf d2000   /* declination (DE) in decimal degrees, equinox J2000 */
     ,   const t_longf mpa2000 /* annual proper motion in RA J2000 */
     ,   const t_longf mpd2000 /* annual proper motion in DE J2000 */);
+
+    // Transforms the true equator of date to the horizon (as 
+    // AbstractAstronomy::getEquToHorTransform without precession), in the
+    // frame of s_EquatorialCoords::toEuclidean.
+    static const osg::Matrixf equToHorTransform(
+        const t_longf siderealTime
+    ,   const t_longf latitude
+    ,   const t_longf longitude);
+
+
+    // Decrease of the limiting magnitude by the moonlight scattered in the
+    // sky, for horizontal unit vectors to sun and moon. The moon brightens 
+    // the sky by its flux (by the phase angle, relative to full) times the 
+    // sine of its altitude, up to 25 times the dark sky for a full moon in 
+    // the zenith (scale 1). The magnitude decreases by 1.25 log10 of that.
+    static const float moonlight(
+        const osg::Vec3f &sun
+    ,   const osg::Vec3f &moon
+    ,   const float scale = 1.f);
+
+    // Faintest visual magnitude (of the catalogue, without the 0.4 of the
+    // atmosphere) of the stars that StarsGeode renders at an intensity of
+    // at least 0.01, before the scattering, which only dims them further.
+    // The intensity is of the apparent magnitude (decreased by moonlight),
+    // the resolution (q), and the altitude of the sun (horizontal unit 
+    // vector), as in the vertex shader of StarsGeode.
+    static const float limitingMagnitude(
+        const float apparentMagnitude
+    ,   const float q
+    ,   const osg::Vec3f &sun);
 };
 
 } // namespace osgHimmel
@@ -33,8 +33,22 @@
 
 #include "declspec.h"
 #include "brightstars.h"
+#include "apparentstars.h"
+#include "starsindex.h"
+#include "pagedstars.h"
 
 #include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Array>
+#include <osg/Drawable>
+#include <osg/PrimitiveSet>
+#include <osg/NodeCallback>
+#include <osg/Matrixf>
+
+#include <OpenThreads/Mutex>
+
+#include <map>
+#include <vector>
 
 
 namespace osgHimmel
@@ -45,8 +59,61 @@ class Himmel;
 
 class OSGH_API StarsGeode : public osg::Geode
 {
+protected:
+
+    // Culls the drawable of a cell of the index on the cpu.
+
+    class CellCullCallback : public osg::Drawable::CullCallback
+    {
+    public:
+        CellCullCallback(
+            const StarsGeode *stars
+        ,   const unsigned int cell);
+
+        virtual bool cull(
+            osg::NodeVisitor *nv
+        ,   osg::Drawable *drawable
+        ,   osg::RenderInfo *renderInfo) const;
+
+    protected:
+        const StarsGeode *m_stars;
+        const unsigned int m_cell;
+    };
+
+    // Culls the drawable of a tile of a paged catalogue on the cpu.
+
+    class TileCullCallback : public osg::Drawable::CullCallback
+    {
+    public:
+        TileCullCallback(
+            const StarsGeode *stars
+        ,   const unsigned int tile);
+
+        virtual bool cull(
+            osg::NodeVisitor *nv
+        ,   osg::Drawable *drawable
+        ,   osg::RenderInfo *renderInfo) const;
+
+    protected:
+        const StarsGeode *m_stars;
+        const unsigned int m_tile;
+    };
+
+    // Records the views of the culls, to request the tiles of a paged 
+    // catalogue on the next update.
+
+    class ViewCallback : public osg::NodeCallback
+    {
+    public:
+        virtual void operator()(
+            osg::Node *node
+        ,   osg::NodeVisitor *nv);
+    };
+
 public:
 
+    // Catalogues in the paged format (see PagedStars) are streamed by 
+    // tiles, all others are loaded at once (see BrightStars).
     StarsGeode(const char *brightStarsFilePath);
     virtual ~StarsGeode();
 
@@ -83,8 +150,57 @@ public:
     const float setScale(const float scale);
     const float getScale() const;
 
+    // Scales the brightening of the sky by the moon (see Stars::moonlight),
+    // zero disables it.
+    const float setMoonlightScale(const float scale);
+    const float getMoonlightScale() const;
+    static const float defaultMoonlightScale();
+
+    // Maximum displacement of the stars in arcseconds, before their 
+    // apparent places are propagated again (see ApparentStars).
+    const double setPositionTolerance(const double arcsecs);
+    const double getPositionTolerance() const;
+
+    // Visual magnitude (of the catalogue) of the faintest stars that 
+    // contribute to the image, as of the last update (of the sun, the moon,
+    // and the apparent magnitude, see Stars::limitingMagnitude). Only the
+    // stars brighter are drawn, and cells without such stars are culled.
+    const float getLimitingMagnitude() const;
+
+    const StarsIndex &index() const;
+
+    // The streamed catalogue (e.g., for its budget and statistics), NULL
+    // if the stars were loaded at once.
+    PagedStars *pagedStars();
+
 protected:
 
+    // View cone of a cull in the frame of the stars (of date), false if 
+    // the cull does not restrict the view (e.g., orthographic projections).
+    const bool view(
+        osg::NodeVisitor *nv
+    ,   osg::Vec3f &direction
+    ,   float &halfAngle) const;
+
+    const bool isVisible(
+        const osg::Vec3f &axis
+    ,   const float radius
+    ,   const float brightest
+    ,   osg::NodeVisitor *nv) const;
+
+    const bool isVisible(
+        const unsigned int cell
+    ,   osg::NodeVisitor *nv) const;
+
+    const bool isTileVisible(
+        const unsigned int tile
+    ,   osg::NodeVisitor *nv) const;
+
+    void recordView(osg::NodeVisitor *nv);
+
+    void updatePagedTiles(const t_julianDay t);
+    void createPagedTile(const unsigned int i);
+
     void setupUniforms(osg::StateSet* stateSet);
 
     void setupNode(
@@ -108,6 +224,50 @@ protected:
     osg::Shader *m_gShader;
     osg::Shader *m_fShader;
 
+    ApparentStars m_apparentStars;
+
+    // Per cell of the index, one drawable with the stars sorted by their 
+    // visual magnitude, drawing the ones brighter than the limit only.
+    StarsIndex m_index;
+    std::vector<osg::ref_ptr<osg::Vec4Array> > m_vertices;
+    std::vector<osg::ref_ptr<osg::DrawArrays> > m_drawArrays;
+
+    osg::Matrixf m_equToHor;
+    float m_limitingMagnitude;
+    float m_moonlightScale;
+
+    // Per resident tile of a paged catalogue, one drawable with the stars
+    // sorted by their visual magnitude, and the cone of their apparent 
+    // places.
+
+    typedef struct PagedTile
+    {
+        osg::ref_ptr<osg::Geometry> geometry;
+        osg::ref_ptr<osg::Vec4Array> vertices;
+        osg::ref_ptr<osg::DrawArrays> drawArrays;
+
+        ApparentStars apparentStars;
+
+        osg::Vec3f axis;
+        float radius;
+        float brightest;
+
+    } t_pagedTile;
+
+    typedef struct View
+    {
+        osg::Vec3f direction;
+        float halfAngle;
+
+    } t_view;
+
+    osg::ref_ptr<PagedStars> m_paged;
+    std::map<unsigned int, t_pagedTile> m_pagedTiles;
+
+    // of the culls since the last update
+    OpenThreads::Mutex m_viewsMutex;
+    std::vector<t_view> m_views;
+
     osg::ref_ptr<osg::Uniform> u_R;
     osg::ref_ptr<osg::Uniform> u_q;
     osg::ref_ptr<osg::Uniform> u_noise1;
@@ -116,6 +276,7 @@ protected:
     osg::ref_ptr<osg::Uniform> u_glareIntensity;
     osg::ref_ptr<osg::Uniform> u_glareScale;
     osg::ref_ptr<osg::Uniform> u_apparentMagnitude;
+    osg::ref_ptr<osg::Uniform> u_moonlight;
     osg::ref_ptr<osg::Uniform> u_scattering;
     osg::ref_ptr<osg::Uniform> u_scintillations;
     osg::ref_ptr<osg::Uniform> u_scale;    
@@ -0,0 +1,143 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#ifndef __STARSINDEX_H__
+#define __STARSINDEX_H__
+
+#include "declspec.h"
+#include "brightstars.h"
+
+#include <osg/Vec3f>
+
+#include <vector>
+
+
+namespace osgHimmel
+{
+
+// Partitions a star catalogue into cells of a quadtree on each face of a 
+// cube around the celestial sphere. Cells with more than maxStarsPerCell
+// stars are split into four, up to maxLevel. The stars of each cell are 
+// contiguous in order() and sorted by visual magnitude, so that a cell is
+// drawn as one range of points, the brightest first.
+//
+// Each cell is bounded by a cone around the mean direction of its stars.
+// cull (and isVisible) compare these cones with the cone of a view and 
+// the magnitude of the brightest star of a cell with a limiting magnitude,
+// conservatively: a star within the view cone and brighter than the limit
+// always lies in a visible cell.
+
+class OSGH_API StarsIndex
+{
+public:
+
+    typedef struct Cell
+    {
+        unsigned int first; // index into order()
+        unsigned int count;
+
+        unsigned int face;  // 0 to 5 for +x, -x, +y, -y, +z, and -z
+        unsigned int level;
+
+        float brightest;    // smallest visual magnitude
+
+        osg::Vec3f axis;    // bounding cone (unit vector and half angle in radians)
+        float radius;
+
+    } t_cell;
+
+public:
+
+    StarsIndex();
+
+    // Positions are taken as of s_EquatorialCoords::toEuclidean (J2000).
+    void build(
+        const BrightStars::s_BrightStar *stars
+    ,   const unsigned int numStars
+    ,   const unsigned int maxStarsPerCell = defaultMaxStarsPerCell()
+    ,   const unsigned int maxLevel = defaultMaxLevel());
+
+    static const unsigned int defaultMaxStarsPerCell();
+    static const unsigned int defaultMaxLevel();
+
+    const unsigned int numStars() const;
+    const unsigned int numCells() const;
+
+    const t_cell &cell(const unsigned int i) const;
+
+    // Catalogue indices of the stars, grouped by cell.
+    const unsigned int *order() const;
+
+    // Number of the stars of a cell not fainter than limitingMagnitude, 
+    // which are the first of the cell.
+    const unsigned int numBrighter(
+        const unsigned int i
+    ,   const float limitingMagnitude) const;
+
+    // Fits the cones to positions of the stars (in catalogue order, 
+    // e.g., ApparentStars::positions).
+    void bound(const osg::Vec3f *positions);
+
+    // True if the cell intersects the view cone (unit direction and half
+    // angle in radians) and has a star brighter than limitingMagnitude.
+    const bool isVisible(
+        const unsigned int i
+    ,   const osg::Vec3f &direction
+    ,   const float halfAngle
+    ,   const float limitingMagnitude) const;
+
+    // Indices of all visible cells, returns the number of their stars.
+    const unsigned int cull(
+        const osg::Vec3f &direction
+    ,   const float halfAngle
+    ,   const float limitingMagnitude
+    ,   std::vector<unsigned int> &cells) const;
+
+protected:
+
+    void split(
+        const unsigned int *keys
+    ,   const unsigned int first
+    ,   const unsigned int count
+    ,   const unsigned int face
+    ,   const unsigned int level
+    ,   const unsigned int maxStarsPerCell
+    ,   const unsigned int maxLevel);
+
+protected:
+
+    std::vector<unsigned int> m_order;
+    std::vector<float> m_vmags;      // in catalogue order
+    std::vector<t_cell> m_cells;
+};
+
+} // namespace osgHimmel
+
+#endif // __STARSINDEX_H__
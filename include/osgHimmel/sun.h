@@ -33,36 +33,81 @@
 
 #include "declspec.h"
 #include "typedefs.h"
-#include "julianday.h"
+#include "precision.h"
+#include "juliantime.h"
 #include "coords.h"
+#include "periodicterms.h"
 
 
 namespace osgHimmel
 {
 
-class OSGH_API Sun
+// Instantiated for float, double, and long double (see precision.h). The
+// nutation series are truncated by truncation, if given.
+
+template<typename t_real>
+class OSGH_API SunT
 {
 public:
 
-    static const t_longf meanAnomaly(const t_julianDay t);
-    static const t_longf meanLongitude(const t_julianDay t);
+    static const t_real meanAnomaly(const t_julianDay t);
+    static const t_real meanLongitude(const t_julianDay t);
+
+    static const t_real center(const t_julianDay t);
+
+    static const t_real trueAnomaly(const t_julianDay t);
+    static const t_real trueLongitude(const t_julianDay t);
+
+    static const t_real apparentLongitude(const t_julianDay t);
 
-    static const t_longf center(const t_julianDay t);
+    static const t_real apparentObliquity(
+        const t_julianDay t
+    ,   const SeriesTruncation *truncation = NULL);
 
-    static const t_longf trueAnomaly(const t_julianDay t);
-    static const t_longf trueLongitude(const t_julianDay t);
+    static const s_EquatorialCoords<t_real> apparentPosition(
+        const t_julianDay t
+    ,   const SeriesTruncation *truncation = NULL);
 
-    static const t_equd apparentPosition(const t_julianDay t);
-    static const t_hord horizontalPosition(
-        const t_aTime &aTime
-    ,   const t_longf latitude
-    ,   const t_longf longitude);
+    // Variant taking the mean obliquity and the nutation in obliquity of 
+    // the instant, e.g., if these are at hand already.
+    static const s_EquatorialCoords<t_real> apparentPosition(
+        const t_julianDay t
+    ,   const t_real meanObliquity
+    ,   const t_real obliquityNutation);
 
-    static const t_longf distance(const t_julianDay t);
+    // Apparent positions in degrees of count instants. The periodic terms
+    // are summed over all instants at once, in double precision.
+    static void apparentPositions(
+        const double *t
+    ,   const unsigned int count
+    ,   double *rightAscensions
+    ,   double *declinations
+    ,   const SeriesTruncation *truncation = NULL);
 
-    static const t_longf meanRadius();
+    static const s_HorizontalCoords<t_real> horizontalPosition(
+        const t_julianTime &time
+    ,   const t_real latitude
+    ,   const t_real longitude
+    ,   const SeriesTruncation *truncation = NULL);
+
+    // Horizontal positions of one instant for count observers, with the 
+    // apparent position and sidereal time evaluated once.
+    static void horizontalPositions(
+        const t_julianTime &time
+    ,   const t_real *latitudes
+    ,   const t_real *longitudes
+    ,   const unsigned int count
+    ,   t_real *altitudes
+    ,   t_real *azimuths
+    ,   const SeriesTruncation *truncation = NULL);
+
+    static const t_real distance(const t_julianDay t);
+
+    static const t_real meanRadius();
 };
 
+typedef SunT<t_longf> Sun;
+
 } // namespace osgHimmel
 
 #endif // __SUN_H__
\ No newline at end of file
@@ -117,6 +117,15 @@ public:
     }
 
     const time_t gett(const bool updateFirst);
+
+    // Time in seconds including the fractions of seconds.
+    inline const t_longf gettf() const
+    {
+        return m_seconds + utcOffset();
+    }
+
+    const t_longf gettf(const bool updateFirst);
+
     const time_t sett(
         const time_t &time
     ,   const bool forceUpdate = false);
@@ -140,6 +149,7 @@ protected:
     time_t m_utcOffset;
 
     time_t m_time[3];       // [2] is for stop
+    t_longf m_seconds;      // m_time[1] with fractions
     t_longf m_timef[3]; // [2] is for stop
 
     t_longf m_offset;
@@ -29,12 +29,101 @@
 
 #include "abstractastronomy.h"
 
+#include "earth.h"
+#include "siderealtime.h"
 #include "mathmacros.h"
 
+#include <vector>
+
+#include <assert.h>
+
 
 namespace osgHimmel
 {
 
+namespace
+{
+    // Inverse of horizontalPositions for unrefracted positions.
+
+    const t_equd equatorial(
+        const osg::Vec3f &v
+    ,   const t_julianDay siderealTime
+    ,   const float latitude
+    ,   const float longitude)
+    {
+        const t_longf sinr(sin(_rad(latitude)));
+        const t_longf cosr(cos(_rad(latitude)));
+
+        const t_longf H = atan2(v[0], v[1] * sinr + v[2] * cosr);
+
+        t_equd equ;
+
+        equ.right_ascension = _revd(siderealTime + longitude - _deg(H));
+        equ.declination = _deg(asin(_clamp(-1.0, 1.0, v[2] * sinr - v[1] * cosr)));
+
+        return equ;
+    }
+
+
+    // Normalized horizontal vector of a local hour angle H in radians, 
+    // for the sine and cosine of latitude and declination.
+
+    inline void horizontal(
+        const double H
+    ,   const double sinr
+    ,   const double cosr
+    ,   const double sind
+    ,   const double cosd
+    ,   const bool refractionCorrected
+    ,   float &x
+    ,   float &y
+    ,   float &z)
+    {
+        const double cosh(cos(H));
+
+        // (AA.12.5) and (AA.12.6) scaled by the cosine of the declination, which is the unit 
+        // vector of azimuth and altitude in the frame of toEuclidean
+
+        double hx = cosd * sin(H);
+        double hy = cosd * cosh * sinr - sind * cosr;
+        double hz = sinr * sind + cosr * cosd * cosh;
+
+        if(refractionCorrected)
+        {
+            const double a(asin(_clamp(-1.0, 1.0, hz)));
+            const double ra(a + _rad(Earth::atmosphericRefraction(_deg(a))));
+
+            // scale the horizontal components to the refracted altitude
+            const double h(sqrt(hx * hx + hy * hy));
+            const double f(h > 0.0 ? cos(ra) / h : 0.0);
+
+            hx *= f;
+            hy *= f;
+            hz  = sin(ra);
+        }
+
+        x = static_cast<float>(hx);
+        y = static_cast<float>(hy);
+        z = static_cast<float>(hz);
+    }
+}
+
+
+AstronomySnapshot::AstronomySnapshot()
+:   t(0.0)
+,   siderealTime(0.0)
+,   latitude(0.f)
+,   longitude(0.f)
+,   sunDistance(0.f)
+,   angularSunRadius(0.f)
+,   moonRadius(0.f)
+,   moonDistance(0.f)
+,   angularMoonRadius(0.f)
+,   earthShineIntensity(0.f)
+{
+}
+
+
 AbstractAstronomy::AbstractAstronomy()
 :
     m_latitude(0.f)
@@ -48,18 +137,71 @@ AbstractAstronomy::~AbstractAstronomy()
 }
 
 
-void AbstractAstronomy::update(const t_aTime &aTime)
+void AbstractAstronomy::update(const t_julianTime &time)
+{
+    m_time = time;
+    m_t = time.jd();
+
+    snapshot(m_time, m_latitude, m_longitude, m_snapshot);
+}
+
+
+const t_astronomySnapshot AbstractAstronomy::computeSnapshot(
+    const t_julianTime &time
+,   const float latitude
+,   const float longitude) const
 {
-    m_aTime = aTime;
-    m_t = jd(aTime);
+    t_astronomySnapshot s;
+    snapshot(time, latitude, longitude, s);
+
+    return s;
 }
 
 
+void AbstractAstronomy::snapshot(
+    const t_julianTime &time
+,   const float latitude
+,   const float longitude
+,   t_astronomySnapshot &snapshot) const
+{
+    snapshot.time = time;
+    snapshot.t = time.jd();
+    snapshot.siderealTime = siderealTime(time);
+
+    snapshot.latitude = latitude;
+    snapshot.longitude = longitude;
+
+    snapshot.sun = sunPosition(time, latitude, longitude, false);
+    snapshot.sunRefracted = sunPosition(time, latitude, longitude, true);
+    snapshot.moon = moonPosition(time, latitude, longitude, false);
+    snapshot.moonRefracted = moonPosition(time, latitude, longitude, true);
+
+    snapshot.sunEquatorial = equatorial(snapshot.sun, snapshot.siderealTime, latitude, longitude);
+    snapshot.moonEquatorial = equatorial(snapshot.moon, snapshot.siderealTime, latitude, longitude);
+
+    snapshot.sunDistance = sunDistance(snapshot.t);
+    snapshot.angularSunRadius = angularSunRadius(snapshot.t);
+
+    snapshot.moonRadius = moonRadius();
+    snapshot.moonDistance = moonDistance(snapshot.t);
+    snapshot.angularMoonRadius = angularMoonRadius(snapshot.t);
+
+    snapshot.moonOrientation = moonOrientation(time, latitude, longitude);
+    snapshot.earthShineIntensity = earthShineIntensity(time, latitude, longitude);
+
+    snapshot.equToHorTransform = equToHorTransform(time, latitude, longitude);
+}
+
+
+// The snapshot follows the observer.
+
 const float AbstractAstronomy::setLatitude(const float latitude)
 {
     if(latitude != m_latitude)
+    {
         m_latitude = _clamp(-90, +90, latitude);
-
+        snapshot(m_time, m_latitude, m_longitude, m_snapshot);
+    }
     return getLatitude();
 }
 
@@ -72,8 +214,10 @@ const float AbstractAstronomy::getLatitude() const
 const float AbstractAstronomy::setLongitude(const float longitude)
 {
     if(longitude != m_longitude)
+    {
         m_longitude = _clamp(-180, +180, longitude);
-
+        snapshot(m_time, m_latitude, m_longitude, m_snapshot);
+    }
     return getLongitude();
 }
 
@@ -85,94 +229,300 @@ const float AbstractAstronomy::getLongitude() const
 
 const osg::Matrixf AbstractAstronomy::getMoonOrientation() const
 {
-    return moonOrientation(getATime(), getLatitude(), getLongitude());
+    return m_snapshot.moonOrientation;
 }
 
 const osg::Matrixf AbstractAstronomy::getMoonOrientation(
-    const t_aTime &aTime
+    const t_julianTime &time
 ,   const float latitude
 ,   const float longitude) const
 {
-    return moonOrientation(aTime, latitude, longitude);
+    return moonOrientation(time, latitude, longitude);
 }
 
 
 const osg::Vec3f AbstractAstronomy::getMoonPosition(
     const bool refractionCorrected) const
 {
-    return moonPosition(getATime(), getLatitude(), getLongitude(), refractionCorrected);
+    return refractionCorrected ? m_snapshot.moonRefracted : m_snapshot.moon;
 }
 
 const osg::Vec3f AbstractAstronomy::getMoonPosition(
-    const t_aTime &aTime
+    const t_julianTime &time
 ,   const float latitude
 ,   const float longitude
 ,   const bool refractionCorrected) const
 {
-    return moonPosition(aTime, latitude, longitude, refractionCorrected);
+    return moonPosition(time, latitude, longitude, refractionCorrected);
 }
 
 
 const osg::Vec3f AbstractAstronomy::getSunPosition(
     const bool refractionCorrected) const
 {
-    return sunPosition(getATime(), getLatitude(), getLongitude(), refractionCorrected);
+    return refractionCorrected ? m_snapshot.sunRefracted : m_snapshot.sun;
 }
 
 const osg::Vec3f AbstractAstronomy::getSunPosition(
-    const t_aTime &aTime
+    const t_julianTime &time
 ,   const float latitude
 ,   const float longitude
 ,   const bool refractionCorrected) const
 {
-    return sunPosition(aTime, latitude, longitude, refractionCorrected);
+    return sunPosition(time, latitude, longitude, refractionCorrected);
+}
+
+
+void AbstractAstronomy::getSunPositions(
+    const t_julianTime *times
+,   const float *latitudes
+,   const float *longitudes
+,   const unsigned int count
+,   const bool refractionCorrected
+,   float *x
+,   float *y
+,   float *z) const
+{
+    if(0 == count)
+        return;
+
+    sunPositions(times, latitudes, longitudes, count, refractionCorrected, x, y, z);
+}
+
+void AbstractAstronomy::getMoonPositions(
+    const t_julianTime *times
+,   const float *latitudes
+,   const float *longitudes
+,   const unsigned int count
+,   const bool refractionCorrected
+,   float *x
+,   float *y
+,   float *z) const
+{
+    if(0 == count)
+        return;
+
+    moonPositions(times, latitudes, longitudes, count, refractionCorrected, x, y, z);
+}
+
+
+void AbstractAstronomy::getSunPositions(
+    const t_aTime *aTimes
+,   const float *latitudes
+,   const float *longitudes
+,   const unsigned int count
+,   const bool refractionCorrected
+,   float *x
+,   float *y
+,   float *z) const
+{
+    if(0 == count)
+        return;
+
+    const std::vector<t_julianTime> times(aTimes, aTimes + count);
+    sunPositions(&times[0], latitudes, longitudes, count, refractionCorrected, x, y, z);
+}
+
+void AbstractAstronomy::getMoonPositions(
+    const t_aTime *aTimes
+,   const float *latitudes
+,   const float *longitudes
+,   const unsigned int count
+,   const bool refractionCorrected
+,   float *x
+,   float *y
+,   float *z) const
+{
+    if(0 == count)
+        return;
+
+    const std::vector<t_julianTime> times(aTimes, aTimes + count);
+    moonPositions(&times[0], latitudes, longitudes, count, refractionCorrected, x, y, z);
+}
+
+
+void AbstractAstronomy::getSunPositions(
+    const t_julianTime &time
+,   const float *latitudes
+,   const float *longitudes
+,   const unsigned int count
+,   const bool refractionCorrected
+,   float *x
+,   float *y
+,   float *z) const
+{
+    if(0 == count)
+        return;
+
+    horizontalPositions(siderealTime(time), sunApparentPosition(time)
+        , latitudes, longitudes, count, refractionCorrected, x, y, z);
+}
+
+void AbstractAstronomy::getMoonPositions(
+    const t_julianTime &time
+,   const float *latitudes
+,   const float *longitudes
+,   const unsigned int count
+,   const bool refractionCorrected
+,   float *x
+,   float *y
+,   float *z) const
+{
+    if(0 == count)
+        return;
+
+    horizontalPositions(siderealTime(time), moonApparentPosition(time)
+        , latitudes, longitudes, count, refractionCorrected, x, y, z);
+}
+
+
+const t_equd AbstractAstronomy::sunApparentPosition(const t_julianTime &time) const
+{
+    return equatorial(sunPosition(time, 0.f, 0.f, false), siderealTime(time), 0.f, 0.f);
+}
+
+const t_equd AbstractAstronomy::moonApparentPosition(const t_julianTime &time) const
+{
+    return equatorial(moonPosition(time, 0.f, 0.f, false), siderealTime(time), 0.f, 0.f);
+}
+
+
+void AbstractAstronomy::sunPositions(
+    const t_julianTime *times
+,   const float *latitudes
+,   const float *longitudes
+,   const unsigned int count
+,   const bool refractionCorrected
+,   float *x
+,   float *y
+,   float *z) const
+{
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        const osg::Vec3f p(sunPosition(times[i], latitudes[i], longitudes[i], refractionCorrected));
+
+        x[i] = p[0];
+        y[i] = p[1];
+        z[i] = p[2];
+    }
+}
+
+void AbstractAstronomy::moonPositions(
+    const t_julianTime *times
+,   const float *latitudes
+,   const float *longitudes
+,   const unsigned int count
+,   const bool refractionCorrected
+,   float *x
+,   float *y
+,   float *z) const
+{
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        const osg::Vec3f p(moonPosition(times[i], latitudes[i], longitudes[i], refractionCorrected));
+
+        x[i] = p[0];
+        y[i] = p[1];
+        z[i] = p[2];
+    }
+}
+
+
+void AbstractAstronomy::horizontalPositions(
+    const t_julianTime *times
+,   const double *rightAscensions
+,   const double *declinations
+,   const float *latitudes
+,   const float *longitudes
+,   const unsigned int count
+,   const bool refractionCorrected
+,   float *x
+,   float *y
+,   float *z)
+{
+    const double rad(static_cast<double>(_rad(1.0)));
+
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        // local hour angle: H = s - ra (AA.p88)
+        const double s(static_cast<double>(siderealTime(times[i])));
+        const double H((s + longitudes[i] - rightAscensions[i]) * rad);
+
+        horizontal(H, sin(latitudes[i] * rad), cos(latitudes[i] * rad)
+            , sin(declinations[i] * rad), cos(declinations[i] * rad)
+            , refractionCorrected, x[i], y[i], z[i]);
+    }
+}
+
+
+void AbstractAstronomy::horizontalPositions(
+    const t_julianDay siderealTime
+,   const t_equd &equ
+,   const float *latitudes
+,   const float *longitudes
+,   const unsigned int count
+,   const bool refractionCorrected
+,   float *x
+,   float *y
+,   float *z)
+{
+    const double rad(static_cast<double>(_rad(1.0)));
+
+    const double s(static_cast<double>(siderealTime - equ.right_ascension));
+
+    const double sind(static_cast<double>(sin(_rad(equ.declination))));
+    const double cosd(static_cast<double>(cos(_rad(equ.declination))));
+
+    for(unsigned int i = 0; i < count; ++i)
+        horizontal((s + longitudes[i]) * rad, sin(latitudes[i] * rad), cos(latitudes[i] * rad)
+            , sind, cosd, refractionCorrected, x[i], y[i], z[i]);
 }
 
 
 const float AbstractAstronomy::getEarthShineIntensity() const
 {
-    return earthShineIntensity(getATime(), getLatitude(), getLongitude());
+    return m_snapshot.earthShineIntensity;
 }
 
 const float AbstractAstronomy::getEarthShineIntensity(
-    const t_aTime &aTime
+    const t_julianTime &time
 ,   const float latitude
 ,   const float longitude) const
 {
-    return earthShineIntensity(aTime, latitude, longitude);
+    return earthShineIntensity(time, latitude, longitude);
 }
 
 
 const float AbstractAstronomy::getSunDistance() const
 {
-    return sunDistance(t());
+    return m_snapshot.sunDistance;
 }
 
-const float AbstractAstronomy::getSunDistance(const t_aTime &aTime) const
+const float AbstractAstronomy::getSunDistance(const t_julianTime &time) const
 {
-    return sunDistance(jd(aTime));
+    return sunDistance(time.jd());
 }
 
 
 const float AbstractAstronomy::getAngularSunRadius() const
 {
-    return angularSunRadius(t());
+    return m_snapshot.angularSunRadius;
 }
 
-const float AbstractAstronomy::getAngularSunRadius(const t_aTime &aTime) const
+const float AbstractAstronomy::getAngularSunRadius(const t_julianTime &time) const
 {
-    return angularSunRadius(jd(aTime));
+    return angularSunRadius(time.jd());
 }
 
 
 const float AbstractAstronomy::getMoonDistance() const
 {
-    return moonDistance(t());
+    return m_snapshot.moonDistance;
 }
 
-const float AbstractAstronomy::getMoonDistance(const t_aTime &aTime) const
+const float AbstractAstronomy::getMoonDistance(const t_julianTime &time) const
 {
-    return moonDistance(jd(aTime));
+    return moonDistance(time.jd());
 }
 
 
@@ -184,26 +534,26 @@ const float AbstractAstronomy::getMoonRadius() const
 
 const float AbstractAstronomy::getAngularMoonRadius() const
 {
-    return angularMoonRadius(t());
+    return m_snapshot.angularMoonRadius;
 }
 
-const float AbstractAstronomy::getAngularMoonRadius(const t_aTime &aTime) const
+const float AbstractAstronomy::getAngularMoonRadius(const t_julianTime &time) const
 {
-    return angularMoonRadius(jd(aTime));
+    return angularMoonRadius(time.jd());
 }
 
 
 const osg::Matrixf AbstractAstronomy::getEquToHorTransform() const
 {
-    return equToHorTransform(getATime(), getLatitude(), getLongitude());
+    return m_snapshot.equToHorTransform;
 }
  
 const osg::Matrixf AbstractAstronomy::getEquToHorTransform(
-    const t_aTime &aTime
+    const t_julianTime &time
 ,   const float latitude
 ,   const float longitude) const
 {
-    return equToHorTransform(aTime, latitude, longitude);
+    return equToHorTransform(time, latitude, longitude);
 }
 
 } // namespace osgHimmel
\ No newline at end of file
@@ -0,0 +1,212 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "apparentstars.h"
+
+#include "mathmacros.h"
+
+#include <math.h>
+
+
+namespace osgHimmel
+{
+
+namespace
+{
+    // Bounds of the displacement of stars in arcseconds per day by annual
+    // aberration (20.5" over a year of an eccentric orbit), precession
+    // (50.3" per year about the ecliptic pole), and nutation (dominated by
+    // the semiannual and fortnightly terms).
+
+    const double ABERRATION_RATE(0.37);
+    const double PRECESSION_RATE(0.14);
+    const double NUTATION_RATE(0.25);
+
+    const double DAYS_PER_YEAR(365.25);
+}
+
+
+ApparentStars::ApparentStars(const double tolerance)
+:   m_tolerance(0.0)
+,   m_interval(0.0)
+,   m_maxProperMotion(0.0)
+,   m_valid(false)
+,   m_epoch(0.0)
+{
+    setTolerance(tolerance);
+}
+
+
+void ApparentStars::setStars(
+    const BrightStars::s_BrightStar *stars
+,   const unsigned int numStars)
+{
+    m_x.resize(numStars);
+    m_y.resize(numStars);
+    m_z.resize(numStars);
+    m_px.resize(numStars);
+    m_py.resize(numStars);
+    m_pz.resize(numStars);
+
+    m_positions.resize(numStars);
+
+    m_maxProperMotion = 0.0;
+
+    for(unsigned int i = 0; i < numStars; ++i)
+    {
+        const BrightStars::s_BrightStar &star(stars[i]);
+
+        const t_longf a(_rightascd(star.RA, 0, 0));
+
+        const osg::Vec3d p(Stars::position(a, star.DE));
+        const osg::Vec3d pm(Stars::properMotion(a, star.DE, star.pmRA, star.pmDE));
+
+        m_x[i] = p.x();
+        m_y[i] = p.y();
+        m_z[i] = p.z();
+
+        m_px[i] = pm.x();
+        m_py[i] = pm.y();
+        m_pz[i] = pm.z();
+
+        m_maxProperMotion = _ma(m_maxProperMotion
+            , sqrt(star.pmRA * star.pmRA + star.pmDE * star.pmDE));
+    }
+
+    m_valid = false;
+    updateInterval();
+}
+
+
+const unsigned int ApparentStars::numStars() const
+{
+    return m_positions.size();
+}
+
+
+const double ApparentStars::setTolerance(const double arcsecs)
+{
+    m_tolerance = _ma(arcsecs, 0.0);
+    updateInterval();
+
+    return getTolerance();
+}
+
+const double ApparentStars::getTolerance() const
+{
+    return m_tolerance;
+}
+
+const double ApparentStars::defaultTolerance()
+{
+    return 1.0;
+}
+
+
+const double ApparentStars::getInterval() const
+{
+    return m_interval;
+}
+
+
+void ApparentStars::updateInterval()
+{
+    const double rate(ABERRATION_RATE + PRECESSION_RATE + NUTATION_RATE
+        + m_maxProperMotion / DAYS_PER_YEAR);
+
+    m_interval = m_tolerance / rate;
+}
+
+
+const bool ApparentStars::update(const t_julianDay t)
+{
+    if(m_valid && _abs(t - m_epoch) <= m_interval)
+        return false;
+
+    propagate(t);
+    return true;
+}
+
+
+void ApparentStars::propagate(const t_julianDay t)
+{
+    const t_starsEpoch epoch(t);
+
+    const float years(static_cast<float>(epoch.years));
+
+    float R[3][3];
+    for(int i = 0; i < 3; ++i)
+        for(int j = 0; j < 3; ++j)
+            R[i][j] = static_cast<float>(epoch.rotation[i][j]);
+
+    const float ax(static_cast<float>(epoch.aberration[0]));
+    const float ay(static_cast<float>(epoch.aberration[1]));
+    const float az(static_cast<float>(epoch.aberration[2]));
+
+    const unsigned int size(numStars());
+
+    for(unsigned int i = 0; i < size; ++i)
+    {
+        const float x(m_x[i] + m_px[i] * years);
+        const float y(m_y[i] + m_py[i] * years);
+        const float z(m_z[i] + m_pz[i] * years);
+
+        const float u(R[0][0] * x + R[0][1] * y + R[0][2] * z + ax);
+        const float v(R[1][0] * x + R[1][1] * y + R[1][2] * z + ay);
+        const float w(R[2][0] * x + R[2][1] * y + R[2][2] * z + az);
+
+        const float l(1.f / sqrtf(u * u + v * v + w * w));
+
+        // mirrored as by s_EquatorialCoords::toEuclidean
+        m_positions[i].set(v * l, u * l, w * l);
+    }
+
+    m_epoch = t;
+    m_valid = true;
+}
+
+
+const bool ApparentStars::isValid() const
+{
+    return m_valid;
+}
+
+
+const t_julianDay ApparentStars::epoch() const
+{
+    return m_epoch;
+}
+
+
+const osg::Vec3f *ApparentStars::positions() const
+{
+    return m_positions.empty() ? NULL : &m_positions[0];
+}
+
+} // namespace osgHimmel
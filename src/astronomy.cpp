@@ -34,136 +34,503 @@
 #include "moon.h"
 #include "stars.h"
 #include "siderealtime.h"
+#include "mathmacros.h"
+
+#include <vector>
 
 
 namespace osgHimmel
 {
 
-Astronomy::Astronomy()
+namespace
+{
+    template<typename t_real>
+    const osg::Vec3f euclidean(
+        s_HorizontalCoords<t_real> hor
+    ,   const bool refractionCorrected)
+    {
+        if(refractionCorrected)
+            hor.altitude += EarthT<t_real>::atmosphericRefraction(hor.altitude);
+
+        osg::Vec3f v = hor.toEuclidean();
+        v.normalize();
+
+        return v;
+    }
+
+    // librations and angles in degrees
+
+    template<typename t_real>
+    const osg::Matrixf orientation(
+        const t_real l
+    ,   const t_real b
+    ,   const t_real positionAngleOfAxis
+    ,   const t_real parallacticAngle)
+    {
+        const osg::Matrixf libLat = osg::Matrixf::rotate(rad(b), -1, 0, 0);
+        const osg::Matrixf libLon = osg::Matrixf::rotate(rad(l),  0, 1, 0);
+
+        const float a = rad(positionAngleOfAxis);
+        const float p = rad(parallacticAngle);
+
+        const osg::Matrixf zenith = osg::Matrixf::rotate(p - a, 0, 0, 1);
+
+        // finalOrientationWithLibrations
+        const osg::Matrixf R(libLat * libLon * zenith);
+
+        return R;
+    }
+
+    const float earthShine(
+        const osg::Vec3f &m
+    ,   const osg::Vec3f &s)
+    {
+        // ("Multiple Light Scattering" - 1980 - Van de Hulst) and 
+        // ("A Physically-Based Night Sky Model" - 2001 - Wann Jensen et al.) -> the 0.19 is the earth full intensity
+    
+        const float ep  = (_PI - acos(s * (-m))) * 0.5;
+        const float Eem = 0.19 * 0.5 * (1.0 - sin(ep) * tan(ep) * log(1.0 / tan(ep * 0.5)));
+
+        return Eem;
+    }
+
+    const osg::Matrixf equToHor(
+        const t_julianDay t
+    ,   const float s
+    ,   const float latitude
+    ,   const float longitude)
+    {
+        const t_julianDay T(jCenturiesSinceSE(t));
+
+        return osg::Matrixf::scale(-1, 1, 1)
+            * osg::Matrixf::rotate( _rad(latitude)  - _PI_2, 1, 0, 0)
+            * osg::Matrixf::rotate(-_rad(s + longitude)    , 0, 0, 1)
+            // precession as suggested in (Jensen et al. 2001)
+            * osg::Matrixf::rotate( 0.01118 * T, 0, 0, 1)
+            * osg::Matrixf::rotate(-0.00972 * T, 1, 0, 0)
+            * osg::Matrixf::rotate( 0.01118 * T, 0, 0, 1);
+    }
+}
+
+
+template<typename t_real>
+AstronomyT<t_real>::AstronomyT()
+{
+}
+
+
+// Evaluates each series once (or takes it from the cache), and derives
+// all quantities from these.
+
+template<typename t_real>
+void AstronomyT<t_real>::snapshot(
+    const t_julianTime &time
+,   const float latitude
+,   const float longitude
+,   t_astronomySnapshot &snapshot) const
+{
+    const t_julianDay t(time.jd());
+    const t_julianDay s(siderealTime(time));
+
+    snapshot.time = time;
+    snapshot.t = t;
+    snapshot.siderealTime = s;
+
+    snapshot.latitude = latitude;
+    snapshot.longitude = longitude;
+
+    const bool cached(isCached(t));
+
+    const t_real Dr(cached ? m_cache->value(EphemerisCache::Q_LongitudeNutation, t) : longitudeNutation(t));
+    const t_real e0(cached ? m_cache->value(EphemerisCache::Q_MeanObliquity, t) : EarthT<t_real>::meanObliquity(t));
+
+    const s_EclipticalCoords<t_real> ecl(cached 
+        ? s_EclipticalCoords<t_real>(m_cache->moonPosition(t)) : MoonT<t_real>::position(t, Dr, truncation()));
+
+    const s_EquatorialCoords<t_real> moonEqu(MoonT<t_real>::apparentPosition(ecl, Dr, e0));
+    const s_EquatorialCoords<t_real> sunEqu(cached 
+        ? s_EquatorialCoords<t_real>(m_cache->sunApparentPosition(t)) : SunT<t_real>::apparentPosition(t, e0, obliquityNutation(t)));
+
+    snapshot.moonEquatorial = t_equd(moonEqu);
+    snapshot.sunEquatorial = t_equd(sunEqu);
+
+    const s_HorizontalCoords<t_real> sun(sunEqu.toHorizontal(s, latitude, longitude));
+    const s_HorizontalCoords<t_real> moon(moonEqu.toHorizontal(s, latitude, longitude));
+
+    snapshot.sun = euclidean(sun, false);
+    snapshot.sunRefracted = euclidean(sun, true);
+    snapshot.moon = euclidean(moon, false);
+    snapshot.moonRefracted = euclidean(moon, true);
+
+    const t_real ds(cached ? m_cache->value(EphemerisCache::Q_SunDistance, t) : SunT<t_real>::distance(t));
+    const t_real dm(cached ? m_cache->value(EphemerisCache::Q_MoonDistance, t) : MoonT<t_real>::distance(t, truncation()));
+
+    snapshot.sunDistance = ds;
+    snapshot.angularSunRadius = _adiameter(ds, SunT<t_real>::meanRadius()) * 0.5;
+
+    snapshot.moonRadius = MoonT<t_real>::meanRadius();
+    snapshot.moonDistance = dm;
+    snapshot.angularMoonRadius = _adiameter(dm, MoonT<t_real>::meanRadius()) * 0.5;
+
+    t_real l, b;
+    MoonT<t_real>::opticalLibrations(t, ecl, Dr, l, b);
+
+    snapshot.moonOrientation = orientation(l, b
+        , MoonT<t_real>::positionAngleOfAxis(t, ecl, moonEqu, Dr, e0)
+        , MoonT<t_real>::parallacticAngle(moonEqu, s, latitude, longitude));
+
+    snapshot.earthShineIntensity = earthShine(snapshot.moon, snapshot.sun);
+    snapshot.equToHorTransform = equToHor(t, s, latitude, longitude);
+}
+
+
+template<typename t_real>
+void AstronomyT<t_real>::setEphemerisCache(EphemerisCache *cache)
+{
+    m_cache = cache;
+}
+
+template<typename t_real>
+EphemerisCache *AstronomyT<t_real>::getEphemerisCache() const
+{
+    return m_cache.get();
+}
+
+
+template<typename t_real>
+const double AstronomyT<t_real>::setMaxSeriesError(const double maxError)
+{
+    m_truncation.setMaxError(maxError);
+    m_nutations.clear();
+
+    return getMaxSeriesError();
+}
+
+template<typename t_real>
+const double AstronomyT<t_real>::getMaxSeriesError() const
+{
+    return m_truncation.getMaxError();
+}
+
+
+template<typename t_real>
+const double AstronomyT<t_real>::setNutationTolerance(const double tolerance)
+{
+    m_nutations.setTolerance(tolerance);
+    return getNutationTolerance();
+}
+
+template<typename t_real>
+const double AstronomyT<t_real>::getNutationTolerance() const
+{
+    return m_nutations.getTolerance();
+}
+
+
+template<typename t_real>
+const SeriesTruncation *AstronomyT<t_real>::truncation() const
+{
+    return m_truncation.getMaxError() > 0.0 ? &m_truncation : NULL;
+}
+
+
+template<typename t_real>
+const t_real AstronomyT<t_real>::longitudeNutation(const t_julianDay t) const
+{
+    if(!m_nutations.isEnabled())
+        return EarthT<t_real>::longitudeNutation(t, truncation());
+
+    double Dr, De;
+    m_nutations.nutations(t, truncation(), Dr, De);
+
+    return static_cast<t_real>(Dr);
+}
+
+template<typename t_real>
+const t_real AstronomyT<t_real>::obliquityNutation(const t_julianDay t) const
 {
+    if(!m_nutations.isEnabled())
+        return EarthT<t_real>::obliquityNutation(t, truncation());
+
+    double Dr, De;
+    m_nutations.nutations(t, truncation(), Dr, De);
+
+    return static_cast<t_real>(De);
 }
 
 
-const float Astronomy::sunDistance(const t_julianDay t) const
+template<typename t_real>
+const s_EquatorialCoords<t_real> AstronomyT<t_real>::sunEquatorial(const t_julianDay t) const
 {
-    return Sun::distance(t);
+    return SunT<t_real>::apparentPosition(t, EarthT<t_real>::meanObliquity(t), obliquityNutation(t));
 }
 
-const float Astronomy::angularSunRadius(const t_julianDay t) const
+template<typename t_real>
+const s_EquatorialCoords<t_real> AstronomyT<t_real>::moonEquatorial(const t_julianDay t) const
 {
-    return Earth::apparentAngularSunDiameter(t) * 0.5;
+    const t_real Dr(longitudeNutation(t));
+
+    return MoonT<t_real>::apparentPosition(MoonT<t_real>::position(t, Dr, truncation())
+        , Dr, EarthT<t_real>::meanObliquity(t));
 }
 
 
-const float Astronomy::moonRadius() const
+template<typename t_real>
+const bool AstronomyT<t_real>::isCached(const t_julianDay t) const
 {
-    return Moon::meanRadius();
+    return m_cache.valid() && m_cache->covers(t);
 }
 
 
-const float Astronomy::moonDistance(const t_julianDay t) const
+template<typename t_real>
+const float AstronomyT<t_real>::sunDistance(const t_julianDay t) const
 {
-    return Moon::distance(t);
+    if(isCached(t))
+        return m_cache->value(EphemerisCache::Q_SunDistance, t);
+
+    return SunT<t_real>::distance(t);
 }
 
-const float Astronomy::angularMoonRadius(const t_julianDay t) const
+template<typename t_real>
+const float AstronomyT<t_real>::angularSunRadius(const t_julianDay t) const
 {
-    return Earth::apparentAngularMoonDiameter(t) * 0.5;
+    if(isCached(t))
+        return _adiameter(m_cache->value(EphemerisCache::Q_SunDistance, t), SunT<t_real>::meanRadius()) * 0.5;
+
+    return EarthT<t_real>::apparentAngularSunDiameter(t) * 0.5;
 }
 
 
-const osg::Vec3f Astronomy::moonPosition(
-    const t_aTime &aTime
+template<typename t_real>
+const float AstronomyT<t_real>::moonRadius() const
+{
+    return MoonT<t_real>::meanRadius();
+}
+
+
+template<typename t_real>
+const float AstronomyT<t_real>::moonDistance(const t_julianDay t) const
+{
+    if(isCached(t))
+        return m_cache->value(EphemerisCache::Q_MoonDistance, t);
+
+    return MoonT<t_real>::distance(t, truncation());
+}
+
+template<typename t_real>
+const float AstronomyT<t_real>::angularMoonRadius(const t_julianDay t) const
+{
+    if(isCached(t))
+        return _adiameter(m_cache->value(EphemerisCache::Q_MoonDistance, t), MoonT<t_real>::meanRadius()) * 0.5;
+
+    return EarthT<t_real>::apparentAngularMoonDiameter(t, truncation()) * 0.5;
+}
+
+
+template<typename t_real>
+const osg::Vec3f AstronomyT<t_real>::moonPosition(
+    const t_julianTime &time
 ,   const float latitude
 ,   const float longitude
 ,   const bool refractionCorrected) const
 {
-    t_hord moon = Moon::horizontalPosition(aTime, latitude, longitude);
-    if(refractionCorrected)
-        moon.altitude += Earth::atmosphericRefraction(moon.altitude);
+    const t_julianDay t(time.jd());
 
-    osg::Vec3f moonv  = moon.toEuclidean();
-    moonv.normalize();
+    const s_EquatorialCoords<t_real> equ(isCached(t) 
+        ? s_EquatorialCoords<t_real>(m_cache->moonApparentPosition(t)) : moonEquatorial(t));
 
-    return moonv;
+    return euclidean(equ.toHorizontal(siderealTime(time), latitude, longitude), refractionCorrected);
 }
 
 
-const osg::Vec3f Astronomy::sunPosition(
-    const t_aTime &aTime
+template<typename t_real>
+const osg::Vec3f AstronomyT<t_real>::sunPosition(
+    const t_julianTime &time
 ,   const float latitude
 ,   const float longitude
 ,   const bool refractionCorrected) const
 {
-    t_hord sun = Sun::horizontalPosition(aTime, latitude, longitude);
-    if(refractionCorrected)
-        sun.altitude += Earth::atmosphericRefraction(sun.altitude);
+    const t_julianDay t(time.jd());
+
+    const s_EquatorialCoords<t_real> equ(isCached(t) 
+        ? s_EquatorialCoords<t_real>(m_cache->sunApparentPosition(t)) : sunEquatorial(t));
+
+    return euclidean(equ.toHorizontal(siderealTime(time), latitude, longitude), refractionCorrected);
+}
+
+
+template<typename t_real>
+void AstronomyT<t_real>::sunPositions(
+    const t_julianTime *times
+,   const float *latitudes
+,   const float *longitudes
+,   const unsigned int count
+,   const bool refractionCorrected
+,   float *x
+,   float *y
+,   float *z) const
+{
+    std::vector<double> t(count);
+    for(unsigned int i = 0; i < count; ++i)
+        t[i] = times[i].jd();
 
-    osg::Vec3f sunv  = sun.toEuclidean();
-    sunv.normalize();
+    std::vector<double> ra(count);
+    std::vector<double> dec(count);
 
-    return sunv;
+    apparentPositions(false, &t[0], count, &ra[0], &dec[0]);
+
+    horizontalPositions(times, &ra[0], &dec[0], latitudes, longitudes
+        , count, refractionCorrected, x, y, z);
+}
+
+
+template<typename t_real>
+void AstronomyT<t_real>::moonPositions(
+    const t_julianTime *times
+,   const float *latitudes
+,   const float *longitudes
+,   const unsigned int count
+,   const bool refractionCorrected
+,   float *x
+,   float *y
+,   float *z) const
+{
+    std::vector<double> t(count);
+    for(unsigned int i = 0; i < count; ++i)
+        t[i] = times[i].jd();
+
+    std::vector<double> ra(count);
+    std::vector<double> dec(count);
+
+    apparentPositions(true, &t[0], count, &ra[0], &dec[0]);
+
+    horizontalPositions(times, &ra[0], &dec[0], latitudes, longitudes
+        , count, refractionCorrected, x, y, z);
 }
 
 
-const osg::Matrixf Astronomy::moonOrientation(
-    const t_aTime &aTime
+template<typename t_real>
+void AstronomyT<t_real>::apparentPositions(
+    const bool moon
+,   const double *t
+,   const unsigned int count
+,   double *rightAscensions
+,   double *declinations) const
+{
+    std::vector<unsigned int> uncached;
+    uncached.reserve(count);
+
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        if(!isCached(t[i]))
+        {
+            uncached.push_back(i);
+            continue;
+        }
+
+        const s_EquatorialCoords<t_real> equ(moon 
+            ? m_cache->moonApparentPosition(t[i]) : m_cache->sunApparentPosition(t[i]));
+
+        rightAscensions[i] = static_cast<double>(equ.right_ascension);
+        declinations[i] = static_cast<double>(equ.declination);
+    }
+
+    const unsigned int n(static_cast<unsigned int>(uncached.size()));
+    if(0 == n)
+        return;
+
+    std::vector<double> ut(n);
+    std::vector<double> ura(n);
+    std::vector<double> udec(n);
+
+    for(unsigned int j = 0; j < n; ++j)
+        ut[j] = t[uncached[j]];
+
+    if(moon)
+        MoonT<t_real>::apparentPositions(&ut[0], n, &ura[0], &udec[0], truncation());
+    else
+        SunT<t_real>::apparentPositions(&ut[0], n, &ura[0], &udec[0], truncation());
+
+    for(unsigned int j = 0; j < n; ++j)
+    {
+        rightAscensions[uncached[j]] = ura[j];
+        declinations[uncached[j]] = udec[j];
+    }
+}
+
+
+template<typename t_real>
+const t_equd AstronomyT<t_real>::sunApparentPosition(const t_julianTime &time) const
+{
+    const t_julianDay t(time.jd());
+
+    if(isCached(t))
+        return m_cache->sunApparentPosition(t);
+
+    return t_equd(sunEquatorial(t));
+}
+
+template<typename t_real>
+const t_equd AstronomyT<t_real>::moonApparentPosition(const t_julianTime &time) const
+{
+    const t_julianDay t(time.jd());
+
+    if(isCached(t))
+        return m_cache->moonApparentPosition(t);
+
+    return t_equd(moonEquatorial(t));
+}
+
+
+template<typename t_real>
+const osg::Matrixf AstronomyT<t_real>::moonOrientation(
+    const t_julianTime &time
 ,   const float latitude
 ,   const float longitude) const
 {    
-    const t_julianDay t(jd(aTime));
-
-    t_longf l, b;
-    Moon::opticalLibrations(t, l, b);
+    const t_julianDay t(time.jd());
 
-    const osg::Matrixf libLat = osg::Matrixf::rotate(_rad(b), -1, 0, 0);
-    const osg::Matrixf libLon = osg::Matrixf::rotate(_rad(l),  0, 1, 0);
+    // (see snapshot)
 
-    const float a = _rad(Moon::positionAngleOfAxis(t));
-    const float p = _rad(Moon::parallacticAngle(aTime, latitude, longitude));
+    const t_real Dr(longitudeNutation(t));
+    const t_real e0(EarthT<t_real>::meanObliquity(t));
 
-    const osg::Matrixf zenith = osg::Matrixf::rotate(p - a, 0, 0, 1);
+    const s_EclipticalCoords<t_real> ecl(MoonT<t_real>::position(t, Dr, truncation()));
+    const s_EquatorialCoords<t_real> equ(MoonT<t_real>::apparentPosition(ecl, Dr, e0));
 
-    // finalOrientationWithLibrations
-    const osg::Matrixf R(libLat * libLon * zenith);
+    t_real l, b;
+    MoonT<t_real>::opticalLibrations(t, ecl, Dr, l, b);
 
-    return R;
+    return orientation(l, b, MoonT<t_real>::positionAngleOfAxis(t, ecl, equ, Dr, e0)
+        , MoonT<t_real>::parallacticAngle(equ, siderealTime(time), latitude, longitude));
 }
 
 
-const float Astronomy::earthShineIntensity(
-    const t_aTime &aTime
+template<typename t_real>
+const float AstronomyT<t_real>::earthShineIntensity(
+    const t_julianTime &time
 ,   const float latitude
 ,   const float longitude) const
 {
-    const osg::Vec3f m = moonPosition(aTime, latitude, longitude, false);
-    const osg::Vec3f s = sunPosition(aTime, latitude, longitude, false);
-
-    // ("Multiple Light Scattering" - 1980 - Van de Hulst) and 
-    // ("A Physically-Based Night Sky Model" - 2001 - Wann Jensen et al.) -> the 0.19 is the earth full intensity
-    
-    const float ep  = (_PI - acos(s * (-m))) * 0.5;
-    const float Eem = 0.19 * 0.5 * (1.0 - sin(ep) * tan(ep) * log(1.0 / tan(ep * 0.5)));
+    const osg::Vec3f m = moonPosition(time, latitude, longitude, false);
+    const osg::Vec3f s = sunPosition(time, latitude, longitude, false);
 
-    return Eem;
+    return earthShine(m, s);
 }
 
 
-const osg::Matrixf Astronomy::equToHorTransform(
-    const t_aTime &aTime
+template<typename t_real>
+const osg::Matrixf AstronomyT<t_real>::equToHorTransform(
+    const t_julianTime &time
 ,   const float latitude
 ,   const float longitude) const
 {
-    const t_julianDay T(jCenturiesSinceSE(jd(aTime)));
-    const float s = siderealTime(aTime);
-
-    return osg::Matrixf::scale(-1, 1, 1)
-        * osg::Matrixf::rotate( _rad(latitude)  - _PI_2, 1, 0, 0)
-        * osg::Matrixf::rotate(-_rad(s + longitude)    , 0, 0, 1)
-        // precession as suggested in (Jensen et al. 2001)
-        * osg::Matrixf::rotate( 0.01118 * T, 0, 0, 1)
-        * osg::Matrixf::rotate(-0.00972 * T, 1, 0, 0)
-        * osg::Matrixf::rotate( 0.01118 * T, 0, 0, 1);
+    return equToHor(time.jd(), siderealTime(time), latitude, longitude);
 }
 
+
+template class AstronomyT<float>;
+template class AstronomyT<double>;
+template class AstronomyT<long double>;
+
 } // namespace osgHimmel
\ No newline at end of file
@@ -74,12 +74,12 @@ const float Astronomy2::angularMoonRadius(const t_julianDay t) const
 
 
 const osg::Vec3f Astronomy2::moonPosition(
-    const t_aTime &aTime
+    const t_julianTime &time
 ,   const float latitude
 ,   const float longitude
 ,   const bool refractionCorrected) const
 {
-    t_horf moon = Moon2::horizontalPosition(aTime, latitude, longitude);
+    t_horf moon = Moon2::horizontalPosition(time, latitude, longitude);
     if(refractionCorrected)
         moon.altitude += Earth2::atmosphericRefraction(moon.altitude);
 
@@ -91,12 +91,12 @@ const osg::Vec3f Astronomy2::moonPosition(
 
 
 const osg::Vec3f Astronomy2::sunPosition(
-    const t_aTime &aTime
+    const t_julianTime &time
 ,   const float latitude
 ,   const float longitude
 ,   const bool refractionCorrected) const
 {
-    t_horf sun = Sun2::horizontalPosition(aTime, latitude, longitude);
+    t_horf sun = Sun2::horizontalPosition(time, latitude, longitude);
 
     if(refractionCorrected)
         sun.altitude += Earth2::atmosphericRefraction(sun.altitude);
@@ -108,12 +108,23 @@ const osg::Vec3f Astronomy2::sunPosition(
 }
 
 
+const t_equd Astronomy2::sunApparentPosition(const t_julianTime &time) const
+{
+    return t_equd(Sun2::apparentPosition(time.jd()));
+}
+
+const t_equd Astronomy2::moonApparentPosition(const t_julianTime &time) const
+{
+    return t_equd(Moon2::apparentPosition(time.jd()));
+}
+
+
 const osg::Matrixf Astronomy2::moonOrientation(
-    const t_aTime &aTime
+    const t_julianTime &time
 ,   const float latitude
 ,   const float longitude) const
 {    
-    const t_julianDay t(jd(aTime));
+    const t_julianDay t(time.jd());
 
     float l, b;
     Moon2::opticalLibrations(t, l, b);
@@ -122,7 +133,7 @@ const osg::Matrixf Astronomy2::moonOrientation(
     const osg::Matrixf libLon = osg::Matrixf::rotate(_rad(l),  0, 1, 0);
 
     const float a = _rad(Moon2::positionAngleOfAxis(t));
-    const float p = _rad(Moon2::parallacticAngle(aTime, latitude, longitude));
+    const float p = _rad(Moon2::parallacticAngle(time, latitude, longitude));
 
     const osg::Matrixf zenith = osg::Matrixf::rotate(a - p, 0, 0, 1);
 
@@ -134,12 +145,12 @@ const osg::Matrixf Astronomy2::moonOrientation(
 
 
 const float Astronomy2::earthShineIntensity(
-    const t_aTime &aTime
+    const t_julianTime &time
 ,   const float latitude
 ,   const float longitude) const
 {
-    const osg::Vec3f m = moonPosition(aTime, latitude, longitude, false);
-    const osg::Vec3f s = sunPosition(aTime, latitude, longitude, false);
+    const osg::Vec3f m = moonPosition(time, latitude, longitude, false);
+    const osg::Vec3f s = sunPosition(time, latitude, longitude, false);
 
     // ("Multiple Light Scattering" - 1980 - Van de Hulst) and 
     // ("A Physically-Based Night Sky Model" - 2001 - Wann Jensen et al.) -> the 0.19 is the earth full intensity
@@ -162,11 +173,11 @@ const float Astronomy2::earthShineIntensity(
 
 
 const osg::Matrixf Astronomy2::equToHorTransform(
-        const t_aTime &aTime
+        const t_julianTime &time
     ,   const float latitude
     ,   const float longitude) const
 {
-    const float s = siderealTime2(aTime);
+    const float s = siderealTime2(time);
 
     return osg::Matrixf::scale(-1, 1, 1)
         * osg::Matrixf::rotate( _rad(latitude) -  _PI_2, 1, 0, 0)
@@ -0,0 +1,487 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "astronomyevents.h"
+
+#include "abstractastronomy.h"
+#include "mathmacros.h"
+
+#include <vector>
+#include <algorithm>
+
+#include <assert.h>
+#include <math.h>
+
+
+namespace osgHimmel
+{
+
+namespace
+{
+    const double SECONDS_PER_DAY(86400.0);
+
+    // rate of the mean sidereal time in degrees per day (AA.11.4)
+    const double SIDEREAL_RATE(360.98564736629);
+
+    // equatorial radius of the earth in kilometers (AA.15.1)
+    const double EARTH_RADIUS(6378.14);
+
+    // spacing of the interpolated positions and distances in days
+    const double SUN_SPACING(1.0);
+    const double MOON_SPACING(0.25);
+    const double DISTANCE_SPACING(1.0);
+
+    // refinement stops at brackets of about a millisecond
+    const double TOLERANCE(1e-3);
+    const unsigned int MAX_ITERATIONS(64);
+
+
+    // Altitude events of a body, found as sign changes of the sine of the
+    // altitude above that of the event.
+
+    typedef struct Crossing
+    {
+        AstronomyEvents::e_Event rising;
+        AstronomyEvents::e_Event falling;
+
+    } t_crossing;
+
+    const t_crossing sunCrossings[] =
+    {
+        { AstronomyEvents::E_Rise,              AstronomyEvents::E_Set }
+    ,   { AstronomyEvents::E_CivilDawn,         AstronomyEvents::E_CivilDusk }
+    ,   { AstronomyEvents::E_NauticalDawn,      AstronomyEvents::E_NauticalDusk }
+    ,   { AstronomyEvents::E_AstronomicalDawn,  AstronomyEvents::E_AstronomicalDusk }
+    };
+    const unsigned int numSunCrossings(sizeof(sunCrossings) / sizeof(t_crossing));
+
+    const t_crossing moonCrossings[] =
+    {
+        { AstronomyEvents::E_Rise,              AstronomyEvents::E_Set }
+    };
+    const unsigned int numMoonCrossings(sizeof(moonCrossings) / sizeof(t_crossing));
+
+
+    // Four point Lagrange interpolation of equally spaced values v[-1], 
+    // v[0], v[1], and v[2], at u within [0;1].
+
+    inline const double cubic(
+        const double *v
+    ,   const double u)
+    {
+        return v[-1] * (-u * (u - 1.0) * (u - 2.0) / 6.0)
+            + v[0] * ((u + 1.0) * (u - 1.0) * (u - 2.0) / 2.0)
+            + v[1] * (-(u + 1.0) * u * (u - 2.0) / 2.0)
+            + v[2] * ((u + 1.0) * u * (u - 1.0) / 6.0);
+    }
+
+
+    // Interpolates a quantity sampled every spacing days, from one before
+    // t0 to two after end.
+
+    class Nodes
+    {
+    public:
+
+        Nodes()
+        :   m_spacing(1.0)
+        {
+        }
+
+        // Seconds of the nodes after t0.
+        void setup(
+            const double spacing
+        ,   const double days)
+        {
+            m_spacing = spacing * SECONDS_PER_DAY;
+            m_seconds.resize(static_cast<unsigned int>(ceil(days / spacing)) + 4);
+
+            for(unsigned int i = 0; i < m_seconds.size(); ++i)
+                m_seconds[i] = (static_cast<double>(i) - 1.0) * m_spacing;
+
+            m_values.resize(m_seconds.size());
+        }
+
+        inline const std::vector<double> &seconds() const
+        {
+            return m_seconds;
+        }
+
+        inline std::vector<double> &values()
+        {
+            return m_values;
+        }
+
+        const double operator()(const double second) const
+        {
+            const double s(second / m_spacing);
+            const unsigned int i(static_cast<unsigned int>(_mi(_ma(floor(s), 0.0), m_values.size() - 3.0)) + 1);
+
+            return cubic(&m_values[i], s - (i - 1.0));
+        }
+
+    protected:
+
+        double m_spacing;
+
+        std::vector<double> m_seconds;
+        std::vector<double> m_values;
+    };
+
+
+    // Horizontal positions of a body for an observer, interpolated from
+    // the apparent positions of the astronomy. These are taken from the 
+    // positions seen from the north pole: the declination is its altitude
+    // and the hour angle its azimuth, which differs from that of the 
+    // observer by the longitude only. The hour angle is interpolated 
+    // without the sidereal rotation.
+
+    class Ephemeris
+    {
+    public:
+
+        Ephemeris(
+            const AbstractAstronomy &astro
+        ,   const AstronomyEvents::e_Body body
+        ,   const t_julianDay t0
+        ,   const double days
+        ,   const float latitude
+        ,   const float longitude)
+        :   m_body(body)
+        ,   m_t0(t0)
+        ,   m_time0(t0)
+        ,   m_sinr(sin(_rad(latitude)))
+        ,   m_cosr(cos(_rad(latitude)))
+        ,   m_longitude(longitude)
+        {
+            const bool moon(AstronomyEvents::B_Moon == body);
+
+            m_hourAngles.setup(moon ? MOON_SPACING : SUN_SPACING, days);
+            m_declinations.setup(moon ? MOON_SPACING : SUN_SPACING, days);
+
+            const std::vector<double> &seconds(m_hourAngles.seconds());
+            const unsigned int count(seconds.size());
+
+            std::vector<t_julianTime> times(count);
+            for(unsigned int i = 0; i < count; ++i)
+                times[i] = time(seconds[i]);
+
+            const std::vector<float> latitudes(count, 90.f);
+            const std::vector<float> longitudes(count, 0.f);
+
+            std::vector<float> x(count);
+            std::vector<float> y(count);
+            std::vector<float> z(count);
+
+            if(moon)
+                astro.getMoonPositions(&times[0], &latitudes[0], &longitudes[0], count, false, &x[0], &y[0], &z[0]);
+            else
+                astro.getSunPositions(&times[0], &latitudes[0], &longitudes[0], count, false, &x[0], &y[0], &z[0]);
+
+            std::vector<double> &H(m_hourAngles.values());
+            std::vector<double> &d(m_declinations.values());
+
+            for(unsigned int i = 0; i < count; ++i)
+            {
+                H[i] = _deg(atan2(x[i], y[i])) - SIDEREAL_RATE * seconds[i] / SECONDS_PER_DAY;
+                d[i] = atan2(z[i], sqrt(x[i] * x[i] + y[i] * y[i]));
+
+                // unwrapped, for the interpolation
+                if(i > 0)
+                    H[i] -= 360.0 * floor((H[i] - H[i - 1]) / 360.0 + 0.5);
+            }
+
+            if(!moon)
+                return;
+
+            m_distances.setup(DISTANCE_SPACING, days);
+
+            const std::vector<double> &ds(m_distances.seconds());
+            for(unsigned int i = 0; i < ds.size(); ++i)
+                m_distances.values()[i] = astro.getMoonDistance(time(ds[i]));
+        }
+
+        inline const t_julianDay t(const double second) const
+        {
+            return m_t0 + second / SECONDS_PER_DAY;
+        }
+
+        inline const t_julianTime time(const double second) const
+        {
+            return m_time0 + second;
+        }
+
+        // East component, proportional to the sine of the local hour 
+        // angle, and sine of the altitude (AA.13.6).
+        void horizontal(
+            const double second
+        ,   double &x
+        ,   double &z) const
+        {
+            const double H(_rad(m_hourAngles(second) + SIDEREAL_RATE * second / SECONDS_PER_DAY + m_longitude));
+            const double d(m_declinations(second));
+
+            const double cosd(cos(d));
+
+            x = cosd * sin(H);
+            z = m_sinr * sin(d) + m_cosr * cosd * cos(H);
+        }
+
+        // Sine of the altitude of an event.
+        inline const double offset(
+            const double second
+        ,   const AstronomyEvents::e_Event event) const
+        {
+            const double distance(AstronomyEvents::B_Moon == m_body ? m_distances(second) : 0.0);
+            return sin(_rad(AstronomyEvents::altitude(m_body, event, distance)));
+        }
+
+        // East component for transits, and the sine of the altitude above 
+        // that of the event otherwise.
+        const double value(
+            const double second
+        ,   const AstronomyEvents::e_Event event) const
+        {
+            double x, z;
+            horizontal(second, x, z);
+
+            return AstronomyEvents::E_Transit == event ? x : z - offset(second, event);
+        }
+
+    protected:
+
+        const AstronomyEvents::e_Body m_body;
+        const t_julianDay m_t0;
+        const t_julianTime m_time0;
+
+        const double m_sinr;
+        const double m_cosr;
+        const double m_longitude;
+
+        Nodes m_hourAngles;     // degrees
+        Nodes m_declinations;   // radians
+        Nodes m_distances;      // kilometers
+    };
+
+
+    // Refines a root bracketed by the seconds a and b with the Illinois
+    // variant of regula falsi.
+
+    const double refine(
+        const Ephemeris &ephemeris
+    ,   const AstronomyEvents::e_Event event
+    ,   double a
+    ,   double fa
+    ,   double b
+    ,   double fb)
+    {
+        assert((fa >= 0.0) != (fb >= 0.0));
+
+        int side(0);
+
+        for(unsigned int i = 0; i < MAX_ITERATIONS && b - a > TOLERANCE; ++i)
+        {
+            const double c(a + fa / (fa - fb) * (b - a));
+            const double fc(ephemeris.value(c, event));
+
+            if(0.0 == fc)
+                return c;
+
+            if((fc >= 0.0) == (fa >= 0.0))
+            {
+                a  = c;
+                fa = fc;
+
+                if(-1 == side)
+                    fb *= 0.5;
+                side = -1;
+            }
+            else
+            {
+                b  = c;
+                fb = fc;
+
+                if(+1 == side)
+                    fa *= 0.5;
+                side = +1;
+            }
+        }
+        return a + fa / (fa - fb) * (b - a);
+    }
+
+
+    const bool earlier(
+        const AstronomyEvents::t_event &a
+    ,   const AstronomyEvents::t_event &b)
+    {
+        return a.t < b.t;
+    }
+}
+
+
+AstronomyEvents::AstronomyEvents(const AbstractAstronomy &astro)
+:   m_astro(astro)
+,   m_step(defaultStep())
+{
+}
+
+
+const unsigned int AstronomyEvents::events(
+    const e_Body body
+,   const t_julianDay begin
+,   const t_julianDay end
+,   const float latitude
+,   const float longitude
+,   t_events &events) const
+{
+    const unsigned int size(events.size());
+
+    if(end <= begin)
+        return 0;
+
+    const double last(static_cast<double>((end - begin) * SECONDS_PER_DAY));
+
+    const Ephemeris ephemeris(m_astro, body, begin, last / SECONDS_PER_DAY, latitude, longitude);
+
+    const bool moon(B_Moon == body);
+
+    const t_crossing *crossings(moon ? moonCrossings : sunCrossings);
+    const unsigned int numCrossings(moon ? numMoonCrossings : numSunCrossings);
+
+    // samples of the previous and current step
+
+    double a(0.0);
+    double xa, za;
+    ephemeris.horizontal(a, xa, za);
+
+    // sines of the altitudes of the crossings (the moon's change)
+
+    double oa[NUM_EVENTS];
+    double ob[NUM_EVENTS];
+
+    for(unsigned int c = 0; c < numCrossings; ++c)
+        oa[c] = ob[c] = ephemeris.offset(a, crossings[c].rising);
+
+    t_event event;
+    event.body = body;
+
+    while(a < last)
+    {
+        const double b(a + m_step);
+
+        double xb, zb;
+        ephemeris.horizontal(b, xb, zb);
+
+        if(xa < 0.0 && xb >= 0.0)
+        {
+            event.event = E_Transit;
+            event.t = ephemeris.t(refine(ephemeris, E_Transit, a, xa, b, xb));
+
+            if(event.t >= begin && event.t < end)
+                events.push_back(event);
+        }
+
+        for(unsigned int c = 0; c < numCrossings; ++c)
+        {
+            if(moon)
+                ob[c] = ephemeris.offset(b, crossings[c].rising);
+
+            const double fa(za - oa[c]);
+            const double fb(zb - ob[c]);
+
+            oa[c] = ob[c];
+
+            if((fa >= 0.0) == (fb >= 0.0))
+                continue;
+
+            event.event = fa < 0.0 ? crossings[c].rising : crossings[c].falling;
+            event.t = ephemeris.t(refine(ephemeris, crossings[c].rising, a, fa, b, fb));
+
+            if(event.t >= begin && event.t < end)
+                events.push_back(event);
+        }
+
+        a  = b;
+        xa = xb;
+        za = zb;
+    }
+
+    std::sort(events.begin() + size, events.end(), earlier);
+
+    return events.size() - size;
+}
+
+
+const unsigned int AstronomyEvents::setStep(const unsigned int seconds)
+{
+    m_step = _mi(_ma(seconds, 1u), 86400u);
+    return getStep();
+}
+
+const unsigned int AstronomyEvents::getStep() const
+{
+    return m_step;
+}
+
+const unsigned int AstronomyEvents::defaultStep()
+{
+    return 3600;
+}
+
+
+const double AstronomyEvents::altitude(
+    const e_Body body
+,   const e_Event event
+,   const double distance)
+{
+    switch(event)
+    {
+    case E_Rise:
+    case E_Set:
+        if(B_Sun == body)
+            return -0.8333;
+        // (AA.15.1) with the horizontal parallax of the moon
+        return 0.7275 * _deg(asin(EARTH_RADIUS / distance)) - 0.5667;
+
+    case E_CivilDawn:
+    case E_CivilDusk:
+        return -6.0;
+    case E_NauticalDawn:
+    case E_NauticalDusk:
+        return -12.0;
+    case E_AstronomicalDawn:
+    case E_AstronomicalDusk:
+        return -18.0;
+
+    default:
+        return 0.0;
+    }
+}
+
+} // namespace osgHimmel
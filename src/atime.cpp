@@ -96,7 +96,8 @@ const s_AstronomicalTime s_AstronomicalTime::fromTimeT(
     // Daylight saving time should not be concidered here -> julian time functions ignore this.
 
 #ifdef __GNUC__
-    struct tm lcl(*localtime(&time));
+    struct tm lcl;
+    localtime_r(&time, &lcl);
 #else // __GNUC__
     struct tm lcl;
     localtime_s(&lcl, &time);
@@ -129,7 +130,8 @@ const time_t s_AstronomicalTime::toTime_t() const
     time_t t = 0;
 
 #ifdef __GNUC__
-    struct tm lcl(*localtime(&t));
+    struct tm lcl;
+    localtime_r(&t, &lcl);
 #else // __GNUC__
     struct tm lcl;
     localtime_s(&lcl, &t);
@@ -0,0 +1,414 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "atmosphereatlas.h"
+
+#include "mathmacros.h"
+
+#include <osg/Image>
+#include <osg/Texture2DArray>
+#include <osg/Texture3D>
+
+#include <algorithm>
+
+#include <assert.h>
+#include <cstring>
+
+
+namespace osgHimmel
+{
+
+namespace
+{
+    typedef AtmosphereAtlas::t_modelCfg  t_modelCfg;
+    typedef AtmosphereAtlas::t_modelCfgs t_modelCfgs;
+
+    typedef std::vector<osg::ref_ptr<osg::Image> > t_images;
+
+    // Parameters ordered by the first stage reading them, so that sorted
+    // presets sharing the results of early stages are adjacent.
+
+    const int NUM_KEYS(13);
+
+    void sortKey(
+        const t_modelCfg &mc
+    ,   float key[NUM_KEYS])
+    {
+        // transmittance (and all subsequent stages)
+
+        key[ 0] = mc.HR;
+        key[ 1] = mc.betaR[0];
+        key[ 2] = mc.betaR[1];
+        key[ 3] = mc.betaR[2];
+        key[ 4] = mc.HM;
+        key[ 5] = mc.betaMEx[0];
+        key[ 6] = mc.betaMEx[1];
+        key[ 7] = mc.betaMEx[2];
+
+        // single scattering
+
+        key[ 8] = mc.betaMSca[0];
+        key[ 9] = mc.betaMSca[1];
+        key[10] = mc.betaMSca[2];
+
+        // multiple scattering
+
+        key[11] = mc.mieG;
+        key[12] = mc.avgGroundReflectance;
+    }
+
+    class PresetOrder
+    {
+    public:
+
+        PresetOrder(const t_modelCfgs &presets)
+        :   m_presets(presets)
+        {
+        }
+
+        bool operator()(
+            const int a
+        ,   const int b) const
+        {
+            float ka[NUM_KEYS];
+            float kb[NUM_KEYS];
+
+            sortKey(m_presets[a], ka);
+            sortKey(m_presets[b], kb);
+
+            return std::lexicographical_compare(ka, ka + NUM_KEYS, kb, kb + NUM_KEYS);
+        }
+
+    protected:
+
+        const t_modelCfgs &m_presets;
+    };
+
+
+    osg::Image *copyImage(const osg::Image *image)
+    {
+        osg::Image *copy(new osg::Image);
+
+        copy->setInternalTextureFormat(image->getInternalTextureFormat());
+        copy->allocateImage(image->s(), image->t(), image->r()
+            , image->getPixelFormat(), image->getDataType());
+
+        memcpy(copy->data(), image->data(), image->getTotalSizeInBytes());
+        return copy;
+    }
+
+    osg::Texture2DArray *setupTexture2DArray(const t_images &layers)
+    {
+        assert(!layers.empty());
+
+        osg::Texture2DArray *texture(new osg::Texture2DArray);
+        texture->setTextureSize(layers[0]->s(), layers[0]->t(), static_cast<int>(layers.size()));
+
+        for(unsigned int i = 0; i < layers.size(); ++i)
+            texture->setImage(i, layers[i].get());
+
+        texture->setFilter(osg::Texture::MIN_FILTER, osg::Texture::LINEAR);
+        texture->setFilter(osg::Texture::MAG_FILTER, osg::Texture::LINEAR);
+        texture->setWrap(osg::Texture::WRAP_S, osg::Texture::CLAMP_TO_EDGE);
+        texture->setWrap(osg::Texture::WRAP_T, osg::Texture::CLAMP_TO_EDGE);
+
+        return texture;
+    }
+
+    template<typename T>
+    inline const T mix(
+        const T &a
+    ,   const T &b
+    ,   const float t)
+    {
+        return a * (1.f - t) + b * t;
+    }
+}
+
+
+AtmosphereAtlas::AtmosphereAtlas()
+{
+}
+
+
+AtmosphereAtlas::~AtmosphereAtlas()
+{
+}
+
+
+void AtmosphereAtlas::clear()
+{
+    m_presets.clear();
+
+    m_computedStages.clear();
+    m_transmittanceLayers.clear();
+
+    m_transmittanceImages.clear();
+    m_irradianceImages.clear();
+    m_inscatterImages.clear();
+
+    m_inscatterImage = NULL;
+
+    m_transmittanceTexture = NULL;
+    m_irradianceTexture = NULL;
+    m_inscatterTexture = NULL;
+}
+
+
+void AtmosphereAtlas::computeOrder(
+    const t_modelCfgs &presets
+,   std::vector<int> &order)
+{
+    order.resize(presets.size());
+
+    for(unsigned int i = 0; i < presets.size(); ++i)
+        order[i] = i;
+
+    std::stable_sort(order.begin(), order.end(), PresetOrder(presets));
+}
+
+
+const bool AtmosphereAtlas::compute(
+    AtmospherePrecompute *precompute
+,   const t_modelCfgs &presets)
+{
+    assert(precompute);
+
+    clear();
+
+    if(presets.empty())
+        return false;
+
+    const int n = static_cast<int>(presets.size());
+
+    std::vector<int> order;
+    computeOrder(presets, order);
+
+    m_computedStages.resize(n, 0);
+    m_transmittanceLayers.resize(n, 0);
+    m_irradianceImages.resize(n);
+
+    const t_modelCfg restore(precompute->getModelConfig());
+    const unsigned int transmittanceParameters(AtmospherePrecompute::stageParameters(AtmospherePrecompute::S_Transmittance));
+
+    bool succeeded = true;
+
+    for(int i = 0; i < n && succeeded; ++i)
+    {
+        const int preset = order[i];
+
+        precompute->getModelConfig() = presets[preset];
+        precompute->dirty();
+
+        // presets equal to the current tables (e.g., duplicates) require
+        // no compute
+
+        succeeded = precompute->compute() || precompute->isUpToDate();
+        if(!succeeded)
+            break;
+
+        const osg::Image *inscatter(precompute->getInscatterImage());
+
+        m_computedStages[preset] = precompute->getComputedStages();
+
+        if(0 == i)
+        {
+            m_preTexCfg = precompute->getComputedTextureConfig();
+
+            // the inscatter tables of all presets stacked in r
+
+            m_inscatterImage = new osg::Image;
+            m_inscatterImage->setInternalTextureFormat(inscatter->getInternalTextureFormat());
+            m_inscatterImage->allocateImage(inscatter->s(), inscatter->t(), inscatter->r() * n
+                , inscatter->getPixelFormat(), inscatter->getDataType());
+        }
+        memcpy(m_inscatterImage->data(0, 0, preset * m_preTexCfg.resR), inscatter->data(), inscatter->getTotalSizeInBytes());
+
+        // presets with equal transmittance parameters are adjacent in order
+
+        if(i > 0 && !(AtmospherePrecompute::changedParameters(presets[order[i - 1]], presets[preset]) & transmittanceParameters))
+            m_transmittanceLayers[preset] = m_transmittanceLayers[order[i - 1]];
+        else
+        {
+            m_transmittanceLayers[preset] = static_cast<int>(m_transmittanceImages.size());
+            m_transmittanceImages.push_back(copyImage(precompute->getTransmittanceImage()));
+        }
+        m_irradianceImages[preset] = copyImage(precompute->getIrradianceImage());
+    }
+
+    precompute->getModelConfig() = restore;
+    precompute->dirty();
+
+    if(!succeeded)
+    {
+        clear();
+        return false;
+    }
+    m_presets = presets;
+
+    const int resR = m_preTexCfg.resR;
+
+    for(int i = 0; i < n; ++i)
+    {
+        osg::Image *view(new osg::Image);
+
+        view->setImage(m_inscatterImage->s(), m_inscatterImage->t(), resR
+            , m_inscatterImage->getInternalTextureFormat(), m_inscatterImage->getPixelFormat()
+            , m_inscatterImage->getDataType(), m_inscatterImage->data(0, 0, i * resR), osg::Image::NO_DELETE);
+
+        m_inscatterImages.push_back(view);
+    }
+
+    setupTextures();
+
+    return true;
+}
+
+
+void AtmosphereAtlas::setupTextures()
+{
+    m_transmittanceTexture = setupTexture2DArray(m_transmittanceImages);
+    m_irradianceTexture = setupTexture2DArray(m_irradianceImages);
+
+    m_inscatterTexture = new osg::Texture3D;
+    m_inscatterTexture->setTextureSize(m_inscatterImage->s(), m_inscatterImage->t(), m_inscatterImage->r());
+    m_inscatterTexture->setImage(m_inscatterImage.get());
+
+    m_inscatterTexture->setFilter(osg::Texture::MIN_FILTER, osg::Texture::LINEAR);
+    m_inscatterTexture->setFilter(osg::Texture::MAG_FILTER, osg::Texture::LINEAR);
+    m_inscatterTexture->setWrap(osg::Texture::WRAP_S, osg::Texture::CLAMP_TO_EDGE);
+    m_inscatterTexture->setWrap(osg::Texture::WRAP_T, osg::Texture::CLAMP_TO_EDGE);
+    m_inscatterTexture->setWrap(osg::Texture::WRAP_R, osg::Texture::CLAMP_TO_EDGE);
+}
+
+
+const bool AtmosphereAtlas::isValid() const
+{
+    return !m_presets.empty();
+}
+
+
+const int AtmosphereAtlas::getNumPresets() const
+{
+    return static_cast<int>(m_presets.size());
+}
+
+
+const AtmosphereAtlas::t_modelCfg &AtmosphereAtlas::getPreset(const int preset) const
+{
+    assert(preset >= 0 && preset < getNumPresets());
+    return m_presets[preset];
+}
+
+
+const AtmosphereAtlas::t_preTexCfg &AtmosphereAtlas::getTextureConfig() const
+{
+    return m_preTexCfg;
+}
+
+
+const unsigned int AtmosphereAtlas::getComputedStages(const int preset) const
+{
+    assert(preset >= 0 && preset < getNumPresets());
+    return m_computedStages[preset];
+}
+
+
+const int AtmosphereAtlas::getNumTransmittanceLayers() const
+{
+    return static_cast<int>(m_transmittanceImages.size());
+}
+
+const int AtmosphereAtlas::getTransmittanceLayer(const int preset) const
+{
+    assert(preset >= 0 && preset < getNumPresets());
+    return m_transmittanceLayers[preset];
+}
+
+
+osg::Texture2DArray *AtmosphereAtlas::getTransmittanceTexture()
+{
+    return m_transmittanceTexture.get();
+}
+
+osg::Texture2DArray *AtmosphereAtlas::getIrradianceTexture()
+{
+    return m_irradianceTexture.get();
+}
+
+osg::Texture3D *AtmosphereAtlas::getInscatterTexture()
+{
+    return m_inscatterTexture.get();
+}
+
+
+osg::Image *AtmosphereAtlas::getTransmittanceImage(const int preset)
+{
+    return m_transmittanceImages[getTransmittanceLayer(preset)].get();
+}
+
+osg::Image *AtmosphereAtlas::getIrradianceImage(const int preset)
+{
+    assert(preset >= 0 && preset < getNumPresets());
+    return m_irradianceImages[preset].get();
+}
+
+osg::Image *AtmosphereAtlas::getInscatterImage(const int preset)
+{
+    assert(preset >= 0 && preset < getNumPresets());
+    return m_inscatterImages[preset].get();
+}
+
+osg::Image *AtmosphereAtlas::getInscatterImage()
+{
+    return m_inscatterImage.get();
+}
+
+
+const AtmosphereAtlas::t_modelCfg AtmosphereAtlas::blend(
+    const t_modelCfg &a
+,   const t_modelCfg &b
+,   const float t)
+{
+    t_modelCfg mc;
+
+    mc.avgGroundReflectance = mix(a.avgGroundReflectance, b.avgGroundReflectance, t);
+
+    mc.HR    = mix(a.HR, b.HR, t);
+    mc.betaR = mix(a.betaR, b.betaR, t);
+
+    mc.HM       = mix(a.HM, b.HM, t);
+    mc.betaMSca = mix(a.betaMSca, b.betaMSca, t);
+    mc.betaMEx  = mix(a.betaMEx, b.betaMEx, t);
+    mc.mieG     = mix(a.mieG, b.mieG, t);
+
+    return mc;
+}
+
+} // namespace osgHimmel
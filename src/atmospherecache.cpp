@@ -0,0 +1,343 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "atmospherecache.h"
+
+#include "memorymappedfile.h"
+#include "earth.h"
+
+#include <osg/Image>
+#include <osgDB/FileUtils>
+#include <osgDB/FileNameUtils>
+
+#include <OpenThreads/Atomic>
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <process.h>
+#else // _WIN32
+#include <unistd.h>
+#endif // _WIN32
+
+
+namespace
+{
+    const char MAGIC[4] = { 'O', 'H', 'A', 'T' };
+    const unsigned int VERSION(4);
+
+    const std::size_t ALIGNMENT(64);
+
+    const int NUM_TABLES(3);
+
+    typedef struct TableHeader
+    {
+        unsigned int width;
+        unsigned int height;
+        unsigned int depth;
+        unsigned int components;
+
+        unsigned int offset; // in bytes from the beginning of the file
+        unsigned int size;   // in bytes
+
+    } t_tableHeader;
+
+    typedef struct FileHeader
+    {
+        char magic[4];
+        unsigned int version;
+
+        osgHimmel::AtmosphereCache::t_hash hash;
+
+        // stored for validation (a hash collision should not load wrong tables)
+        osgHimmel::AtmosphereCache::t_preTexCfg preTexCfg;
+        osgHimmel::AtmosphereCache::t_modelCfg modelCfg;
+
+        t_tableHeader tables[NUM_TABLES];
+
+    } t_fileHeader;
+
+
+    const std::size_t align(const std::size_t offset)
+    {
+        return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    void fnv1a(
+        osgHimmel::AtmosphereCache::t_hash &hash
+    ,   const void *data
+    ,   const std::size_t size)
+    {
+        const unsigned char *bytes = static_cast<const unsigned char*>(data);
+
+        for(std::size_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;
+        }
+    }
+
+    // float tables only (as setup by AtmospherePrecompute)
+
+    const unsigned int tableSize(const osg::Image *image)
+    {
+        return image->s() * image->t() * image->r()
+            * osg::Image::computeNumComponents(image->getPixelFormat()) * sizeof(float);
+    }
+
+    // Unique per process and per store, so concurrent writers (threads or
+    // processes sharing the directory) never write into the same file.
+
+    const std::string tempPath(const std::string &path)
+    {
+        static OpenThreads::Atomic counter;
+
+#ifdef _WIN32
+        const int pid(_getpid());
+#else // _WIN32
+        const int pid(static_cast<int>(getpid()));
+#endif // _WIN32
+
+        std::ostringstream stream;
+        stream << path << "." << pid << "." << static_cast<unsigned int>(++counter) << ".tmp";
+
+        return stream.str();
+    }
+
+    const bool matches(
+        const t_tableHeader &table
+    ,   const osg::Image *image
+    ,   const std::size_t fileSize)
+    {
+        if(!image || GL_FLOAT != image->getDataType())
+            return false;
+
+        return table.width  == static_cast<unsigned int>(image->s())
+            && table.height == static_cast<unsigned int>(image->t())
+            && table.depth  == static_cast<unsigned int>(image->r())
+            && table.components == osg::Image::computeNumComponents(image->getPixelFormat())
+            && table.size   == tableSize(image)
+            && table.offset % ALIGNMENT == 0
+            && static_cast<std::size_t>(table.offset) + table.size <= fileSize;
+    }
+}
+
+
+namespace osgHimmel
+{
+
+AtmosphereCache::AtmosphereCache(const std::string &directory)
+:   m_directory(directory)
+{
+}
+
+
+const std::string &AtmosphereCache::directory() const
+{
+    return m_directory;
+}
+
+
+const AtmosphereCache::t_hash AtmosphereCache::hash(
+    const t_preTexCfg &preTexCfg
+,   const t_modelCfg &modelCfg)
+{
+    t_hash hash(14695981039346656037ULL);
+
+    // both configs consist of 4 byte members only, so there is no padding
+
+    fnv1a(hash, &preTexCfg, sizeof(t_preTexCfg));
+    fnv1a(hash, &modelCfg,  sizeof(t_modelCfg));
+
+    const double Rg = Earth::meanRadius();
+    const double Rt = Earth::meanRadius() + Earth::atmosphereThicknessNonUniform();
+
+    fnv1a(hash, &Rg, sizeof(double));
+    fnv1a(hash, &Rt, sizeof(double));
+
+    fnv1a(hash, &VERSION, sizeof(unsigned int));
+
+    return hash;
+}
+
+
+const unsigned int AtmosphereCache::version()
+{
+    return VERSION;
+}
+
+
+const std::string AtmosphereCache::filePath(
+    const t_preTexCfg &preTexCfg
+,   const t_modelCfg &modelCfg) const
+{
+    std::stringstream name;
+    name << "atmosphere_" << std::hex << std::setw(16) << std::setfill('0')
+        << hash(preTexCfg, modelCfg) << ".bin";
+
+    return osgDB::concatPaths(m_directory, name.str());
+}
+
+
+MemoryMappedFile *AtmosphereCache::load(
+    const t_preTexCfg &preTexCfg
+,   const t_modelCfg &modelCfg
+,   osg::Image *transmittance
+,   osg::Image *irradiance
+,   osg::Image *inscatter) const
+{
+    if(m_directory.empty())
+        return NULL;
+
+    osg::ref_ptr<MemoryMappedFile> file(new MemoryMappedFile);
+
+    if(!file->open(filePath(preTexCfg, modelCfg).c_str(), true))
+        return NULL;
+
+    if(file->size() < sizeof(t_fileHeader))
+        return NULL;
+
+    const t_fileHeader *header(reinterpret_cast<const t_fileHeader*>(file->data()));
+
+    if(memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0
+    || header->version != VERSION
+    || header->hash != hash(preTexCfg, modelCfg)
+    || memcmp(&header->preTexCfg, &preTexCfg, sizeof(t_preTexCfg)) != 0
+    || memcmp(&header->modelCfg,  &modelCfg,  sizeof(t_modelCfg))  != 0)
+        return NULL;
+
+    osg::Image *images[NUM_TABLES] = { transmittance, irradiance, inscatter };
+
+    for(int i = 0; i < NUM_TABLES; ++i)
+        if(!matches(header->tables[i], images[i], file->size()))
+            return NULL;
+
+    for(int i = 0; i < NUM_TABLES; ++i)
+    {
+        osg::Image *image(images[i]);
+        unsigned char *data(reinterpret_cast<unsigned char*>(file->data() + header->tables[i].offset));
+
+        image->setImage(image->s(), image->t(), image->r()
+            , image->getInternalTextureFormat()
+            , image->getPixelFormat()
+            , image->getDataType()
+            , data, osg::Image::NO_DELETE, image->getPacking());
+
+        image->dirty();
+    }
+    return file.release();
+}
+
+
+const bool AtmosphereCache::store(
+    const t_preTexCfg &preTexCfg
+,   const t_modelCfg &modelCfg
+,   const osg::Image *transmittance
+,   const osg::Image *irradiance
+,   const osg::Image *inscatter) const
+{
+    if(m_directory.empty())
+        return false;
+
+    const osg::Image *images[NUM_TABLES] = { transmittance, irradiance, inscatter };
+
+    t_fileHeader header = t_fileHeader();
+
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version   = VERSION;
+    header.hash      = hash(preTexCfg, modelCfg);
+    header.preTexCfg = preTexCfg;
+    header.modelCfg  = modelCfg;
+
+    std::size_t offset = align(sizeof(t_fileHeader));
+
+    for(int i = 0; i < NUM_TABLES; ++i)
+    {
+        const osg::Image *image(images[i]);
+
+        if(!image || !image->data() || GL_FLOAT != image->getDataType())
+            return false;
+
+        t_tableHeader &table(header.tables[i]);
+
+        table.width      = image->s();
+        table.height     = image->t();
+        table.depth      = image->r();
+        table.components = osg::Image::computeNumComponents(image->getPixelFormat());
+        table.offset     = static_cast<unsigned int>(offset);
+        table.size       = tableSize(image);
+
+        offset = align(offset + table.size);
+    }
+
+    if(!osgDB::makeDirectory(m_directory))
+        return false;
+
+    const std::string path(filePath(preTexCfg, modelCfg));
+    const std::string temp(tempPath(path));
+
+    std::ofstream stream(temp.c_str(), std::ios::binary);
+    if(!stream)
+        return false;
+
+    const char padding[ALIGNMENT] = { 0 };
+
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(t_fileHeader));
+    std::size_t written = sizeof(t_fileHeader);
+
+    for(int i = 0; i < NUM_TABLES; ++i)
+    {
+        const t_tableHeader &table(header.tables[i]);
+
+        stream.write(padding, table.offset - written);
+        stream.write(reinterpret_cast<const char*>(images[i]->data()), table.size);
+
+        written = table.offset + table.size;
+    }
+    stream.close();
+
+    if(stream.fail())
+    {
+        std::remove(temp.c_str());
+        return false;
+    }
+
+    if(!MemoryMappedFile::replace(temp.c_str(), path.c_str()))
+    {
+        std::remove(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace osgHimmel
@@ -0,0 +1,540 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "atmosphereformat.h"
+
+#include "mathmacros.h"
+
+#include <osg/Image>
+#include <osg/Texture>
+
+#include <assert.h>
+#include <math.h>
+
+
+#ifndef GL_RGB9_E5_EXT
+#define GL_RGB9_E5_EXT                      0x8C3D
+#define GL_UNSIGNED_INT_5_9_9_9_REV_EXT     0x8C3E
+#endif
+
+#ifndef GL_R11F_G11F_B10F_EXT
+#define GL_R11F_G11F_B10F_EXT               0x8C3A
+#define GL_UNSIGNED_INT_10F_11F_11F_REV_EXT 0x8C3B
+#endif
+
+#ifndef GL_HALF_FLOAT
+#define GL_HALF_FLOAT                       0x140B
+#endif
+
+
+namespace osgHimmel
+{
+
+namespace
+{
+    const char *FORMAT_NAMES[AtmosphereFormat::NUM_FORMATS] =
+    {
+        "RGBA16F"
+    ,   "RGB9E5"
+    ,   "R11G11B10F"
+    ,   "Log8"
+    };
+
+    const unsigned int FORMAT_BYTES[AtmosphereFormat::NUM_FORMATS] = { 8, 5, 5, 4 };
+
+    // 2^-112 and 2^112 map between the exponent bias of floats (127)
+    // and the one of the small floats (15), including denormals
+
+    const float TO_SMALL(1.925929944387236e-34f);
+    const float FROM_SMALL(5.192296858534828e+33f);
+
+    const float MAX_HALF(65504.f);
+    const float MAX_11F(65024.f);
+    const float MAX_10F(64512.f);
+    const float MAX_RGB9E5(65408.f);
+
+    typedef union FloatBits
+    {
+        float f;
+        unsigned int u;
+
+    } t_floatBits;
+
+    inline const unsigned int bitsOf(const float f)
+    {
+        t_floatBits b;
+        b.f = f;
+
+        return b.u;
+    }
+
+    inline const float floatOf(const unsigned int u)
+    {
+        t_floatBits b;
+        b.u = u;
+
+        return b.f;
+    }
+
+    // clamps into [0;max], mapping nan to max
+    inline const float clampUnsigned(
+        const float v
+    ,   const float max)
+    {
+        const float c = v < 0.f ? 0.f : v;
+        return c < max ? c : max;
+    }
+
+    // unsigned small float with the given number of mantissa bits (rounded)
+    inline const unsigned int toSmallFloat(
+        const float v
+    ,   const float max
+    ,   const int mantissa)
+    {
+        const unsigned int shift = 23 - mantissa;
+        return (bitsOf(clampUnsigned(v, max) * TO_SMALL) + (1u << (shift - 1))) >> shift;
+    }
+
+    inline const float fromSmallFloat(
+        const unsigned int v
+    ,   const int mantissa)
+    {
+        return floatOf(v << (23 - mantissa)) * FROM_SMALL;
+    }
+
+    // log2 by exponent and the series of atanh (error below 2e-4)
+    inline const float fastLog2(const float v)
+    {
+        const unsigned int bits = bitsOf(v);
+
+        const float e = static_cast<float>(static_cast<int>((bits >> 23) & 0xff) - 127);
+        const float m = floatOf((bits & 0x7fffff) | 0x3f800000);
+
+        const float t  = (m - 1.f) / (m + 1.f);
+        const float t2 = t * t;
+
+        return e + 2.885390082f * t * (1.f + t2 * (1.f / 3.f + t2 * (1.f / 5.f)));
+    }
+
+    // smallest value with a log encoding
+    const float MIN_LOG(1e-30f);
+
+
+    osg::Image *allocate(
+        osg::Image *image
+    ,   const osg::Image *source
+    ,   const GLint internalFormat
+    ,   const GLenum pixelFormat
+    ,   const GLenum dataType)
+    {
+        image->allocateImage(source->s(), source->t(), source->r(), pixelFormat, dataType);
+        image->setInternalTextureFormat(internalFormat);
+
+        return image;
+    }
+
+    const bool isFloatRGBA(const osg::Image *image)
+    {
+        return image && image->data()
+            && GL_FLOAT == image->getDataType() && GL_RGBA == image->getPixelFormat();
+    }
+
+    const unsigned int numTexels(const osg::Image *image)
+    {
+        return static_cast<unsigned int>(image->s() * image->t() * image->r());
+    }
+}
+
+
+const char *AtmosphereFormat::name(const e_Format format)
+{
+    assert(format < NUM_FORMATS);
+    return FORMAT_NAMES[format];
+}
+
+
+const unsigned int AtmosphereFormat::bytesPerTexel(const e_Format format)
+{
+    assert(format < NUM_FORMATS);
+    return FORMAT_BYTES[format];
+}
+
+
+const bool AtmosphereFormat::hasMieTable(const e_Format format)
+{
+    return F_RGB9E5 == format || F_R11G11B10F == format;
+}
+
+
+void AtmosphereFormat::encodeRGBA16F(
+    const float *rgba
+,   unsigned short *encoded
+,   const unsigned int count)
+{
+    for(unsigned int i = 0; i < count * 4; ++i)
+    {
+        const unsigned int sign = (bitsOf(rgba[i]) >> 16) & 0x8000;
+        encoded[i] = static_cast<unsigned short>(sign | toSmallFloat(_abs(rgba[i]), MAX_HALF, 10));
+    }
+}
+
+
+void AtmosphereFormat::decodeRGBA16F(
+    const unsigned short *encoded
+,   float *rgba
+,   const unsigned int count)
+{
+    for(unsigned int i = 0; i < count * 4; ++i)
+    {
+        const float v = fromSmallFloat(encoded[i] & 0x7fff, 10);
+        rgba[i] = encoded[i] & 0x8000 ? -v : v;
+    }
+}
+
+
+// EXT_texture_shared_exponent (N = 9 mantissa bits, B = 15 exponent bias)
+
+void AtmosphereFormat::encodeRGB9E5(
+    const float *rgba
+,   unsigned int *encoded
+,   const unsigned int count)
+{
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        const float r = clampUnsigned(rgba[i * 4 + 0], MAX_RGB9E5);
+        const float g = clampUnsigned(rgba[i * 4 + 1], MAX_RGB9E5);
+        const float b = clampUnsigned(rgba[i * 4 + 2], MAX_RGB9E5);
+
+        const float maxc = _ma(r, _ma(g, b));
+
+        // floor(log2(maxc)), clamped to -B - 1
+        const int floorLog2 = _ma(static_cast<int>((bitsOf(maxc) >> 23) & 0xff) - 127, -16);
+
+        int e = floorLog2 + 1 + 15;
+
+        // 2^(e - B - N)
+        float denom = floatOf(static_cast<unsigned int>(e - 24 + 127) << 23);
+
+        const int over = static_cast<int>(floor(maxc / denom + 0.5f)) == 512 ? 1 : 0;
+
+        denom *= static_cast<float>(1 + over);
+        e += over;
+
+        const unsigned int rm = static_cast<unsigned int>(floor(r / denom + 0.5f));
+        const unsigned int gm = static_cast<unsigned int>(floor(g / denom + 0.5f));
+        const unsigned int bm = static_cast<unsigned int>(floor(b / denom + 0.5f));
+
+        encoded[i] = rm | gm << 9 | bm << 18 | static_cast<unsigned int>(e) << 27;
+    }
+}
+
+
+void AtmosphereFormat::decodeRGB9E5(
+    const unsigned int *encoded
+,   float *rgba
+,   const unsigned int count)
+{
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        const unsigned int v = encoded[i];
+        const float scale = floatOf(((v >> 27) - 24 + 127) << 23);
+
+        rgba[i * 4 + 0] = static_cast<float>(v         & 0x1ff) * scale;
+        rgba[i * 4 + 1] = static_cast<float>((v >>  9) & 0x1ff) * scale;
+        rgba[i * 4 + 2] = static_cast<float>((v >> 18) & 0x1ff) * scale;
+    }
+}
+
+
+// EXT_packed_float (red in the lowest bits)
+
+void AtmosphereFormat::encodeR11G11B10F(
+    const float *rgba
+,   unsigned int *encoded
+,   const unsigned int count)
+{
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        encoded[i] = toSmallFloat(rgba[i * 4 + 0], MAX_11F, 6)
+            | toSmallFloat(rgba[i * 4 + 1], MAX_11F, 6) << 11
+            | toSmallFloat(rgba[i * 4 + 2], MAX_10F, 5) << 22;
+    }
+}
+
+
+void AtmosphereFormat::decodeR11G11B10F(
+    const unsigned int *encoded
+,   float *rgba
+,   const unsigned int count)
+{
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        const unsigned int v = encoded[i];
+
+        rgba[i * 4 + 0] = fromSmallFloat(v         & 0x7ff, 6);
+        rgba[i * 4 + 1] = fromSmallFloat((v >> 11) & 0x7ff, 6);
+        rgba[i * 4 + 2] = fromSmallFloat((v >> 22) & 0x3ff, 5);
+    }
+}
+
+
+void AtmosphereFormat::encodeLog8(
+    const float *rgba
+,   unsigned char *encoded
+,   const unsigned int count
+,   const int first
+,   const int channels
+,   const t_logRange &range)
+{
+    assert(first >= 0 && channels > 0 && first + channels <= 4);
+
+    const float scale = 255.f / _ma(range.max - range.min, 1e-6f);
+
+    for(unsigned int i = 0; i < count; ++i)
+        for(int c = 0; c < channels; ++c)
+        {
+            const float l = fastLog2(_ma(rgba[i * 4 + first + c], MIN_LOG));
+            encoded[i * channels + c] = static_cast<unsigned char>(_clamp(0.f, 255.f, (l - range.min) * scale) + 0.5f);
+        }
+}
+
+
+void AtmosphereFormat::decodeLog8(
+    const unsigned char *encoded
+,   float *rgba
+,   const unsigned int count
+,   const int first
+,   const int channels
+,   const t_logRange &range)
+{
+    assert(first >= 0 && channels > 0 && first + channels <= 4);
+
+    float table[256];
+    for(int i = 0; i < 256; ++i)
+        table[i] = static_cast<float>(pow(2.0, range.min + (range.max - range.min) * i / 255.0));
+
+    for(unsigned int i = 0; i < count; ++i)
+        for(int c = 0; c < channels; ++c)
+            rgba[i * 4 + first + c] = table[encoded[i * channels + c]];
+}
+
+
+const AtmosphereFormat::t_logRange AtmosphereFormat::logRange(
+    const float *rgba
+,   const unsigned int count
+,   const int first
+,   const int channels
+,   const float maxStops)
+{
+    float min = MAX_HALF;
+    float max = 0.f;
+
+    for(unsigned int i = 0; i < count; ++i)
+        for(int c = 0; c < channels; ++c)
+        {
+            const float v = rgba[i * 4 + first + c];
+
+            if(v > 0.f)
+                min = _mi(min, v);
+            max = _ma(max, v);
+        }
+
+    t_logRange range;
+
+    if(max <= 0.f)
+    {
+        range.min = -1.f;
+        range.max =  0.f;
+
+        return range;
+    }
+
+    // exact powers of two, via the binary exponents of min and max
+
+    int e;
+
+    const float m = static_cast<float>(frexp(max, &e));
+    range.max = static_cast<float>(m > 0.5f ? e : e - 1);
+
+    frexp(min, &e);
+    range.min = _ma(static_cast<float>(e - 1), range.max - maxStops);
+
+    return range;
+}
+
+
+void AtmosphereFormat::encode(
+    const e_Format format
+,   const osg::Image *source
+,   osg::Image *color
+,   osg::Image *mie
+,   t_logRange &colorRange
+,   t_logRange &mieRange)
+{
+    assert(isFloatRGBA(source));
+    assert(color);
+    assert(mie || !hasMieTable(format));
+
+    const float *rgba = reinterpret_cast<const float*>(source->data());
+    const unsigned int count = numTexels(source);
+
+    colorRange = logRange(rgba, count, 0, 3);
+    mieRange = logRange(rgba, count, 3, 1);
+
+    switch(format)
+    {
+    case F_RGBA16F:
+        allocate(color, source, GL_RGBA16F_ARB, GL_RGBA, GL_HALF_FLOAT);
+        encodeRGBA16F(rgba, reinterpret_cast<unsigned short*>(color->data()), count);
+        break;
+
+    case F_RGB9E5:
+        allocate(color, source, GL_RGB9_E5_EXT, GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV_EXT);
+        encodeRGB9E5(rgba, reinterpret_cast<unsigned int*>(color->data()), count);
+        break;
+
+    case F_R11G11B10F:
+        allocate(color, source, GL_R11F_G11F_B10F_EXT, GL_RGB, GL_UNSIGNED_INT_10F_11F_11F_REV_EXT);
+        encodeR11G11B10F(rgba, reinterpret_cast<unsigned int*>(color->data()), count);
+        break;
+
+    case F_Log8:
+        // a single range for all channels, as passed to the shader
+        colorRange.min = _mi(colorRange.min, mieRange.min);
+        colorRange.max = _ma(colorRange.max, mieRange.max);
+
+        allocate(color, source, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+        encodeLog8(rgba, color->data(), count, 0, 4, colorRange);
+        break;
+
+    default:
+        assert(false);
+    }
+
+    if(!hasMieTable(format))
+        return;
+
+    allocate(mie, source, GL_LUMINANCE8, GL_LUMINANCE, GL_UNSIGNED_BYTE);
+    encodeLog8(rgba, mie->data(), count, 3, 1, mieRange);
+}
+
+
+void AtmosphereFormat::decode(
+    const e_Format format
+,   const osg::Image *color
+,   const osg::Image *mie
+,   const t_logRange &colorRange
+,   const t_logRange &mieRange
+,   osg::Image *target)
+{
+    assert(color && color->data());
+    assert(target);
+
+    allocate(target, color, GL_RGBA16F_ARB, GL_RGBA, GL_FLOAT);
+
+    float *rgba = reinterpret_cast<float*>(target->data());
+    const unsigned int count = numTexels(color);
+
+    switch(format)
+    {
+    case F_RGBA16F:
+        decodeRGBA16F(reinterpret_cast<const unsigned short*>(color->data()), rgba, count);
+        break;
+
+    case F_RGB9E5:
+        decodeRGB9E5(reinterpret_cast<const unsigned int*>(color->data()), rgba, count);
+        break;
+
+    case F_R11G11B10F:
+        decodeR11G11B10F(reinterpret_cast<const unsigned int*>(color->data()), rgba, count);
+        break;
+
+    case F_Log8:
+        decodeLog8(color->data(), rgba, count, 0, 4, colorRange);
+        break;
+
+    default:
+        assert(false);
+    }
+
+    if(!hasMieTable(format))
+        return;
+
+    assert(mie && mie->data());
+    decodeLog8(mie->data(), rgba, count, 3, 1, mieRange);
+}
+
+
+const AtmosphereFormat::t_errorReport AtmosphereFormat::errorReport(
+    const e_Format format
+,   const osg::Image *source)
+{
+    assert(isFloatRGBA(source));
+
+    osg::ref_ptr<osg::Image> color(new osg::Image);
+    osg::ref_ptr<osg::Image> mie(new osg::Image);
+    osg::ref_ptr<osg::Image> decoded(new osg::Image);
+
+    t_logRange colorRange, mieRange;
+
+    encode(format, source, color.get(), mie.get(), colorRange, mieRange);
+    decode(format, color.get(), mie.get(), colorRange, mieRange, decoded.get());
+
+    const float *s = reinterpret_cast<const float*>(source->data());
+    const float *d = reinterpret_cast<const float*>(decoded->data());
+
+    const unsigned int size = numTexels(source) * 4;
+
+    float max = 0.f;
+    for(unsigned int i = 0; i < size; ++i)
+        max = _ma(max, s[i]);
+
+    const float minimum = _ma(max * 1e-4f, 1e-30f);
+
+    t_errorReport report;
+
+    report.maxRelativeError = 0.0;
+    report.meanRelativeError = 0.0;
+    report.bytesPerTexel = bytesPerTexel(format);
+
+    for(unsigned int i = 0; i < size; ++i)
+    {
+        const double e = _abs(d[i] - s[i]) / _ma(_abs(s[i]), minimum);
+
+        report.maxRelativeError = _ma(report.maxRelativeError, e);
+        report.meanRelativeError += e;
+    }
+
+    if(size > 0)
+        report.meanRelativeError /= size;
+
+    return report;
+}
+
+} // namespace osgHimmel
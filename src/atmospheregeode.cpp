@@ -33,6 +33,8 @@
 #include "himmelquad.h"
 #include "abstractastronomy.h"
 #include "atmosphereprecompute.h"
+#include "atmospherequery.h"
+#include "mathmacros.h"
 
 #include "shaderfragment/common.h"
 #include "shaderfragment/bruneton_common.h"
@@ -40,6 +42,7 @@
 #include "shaderfragment/dither.h"
 
 #include <osg/Texture2D>
+#include <osg/Texture2DArray>
 #include <osg/Texture3D>
 #include <osg/Depth>
 #include <osg/BlendFunc>
@@ -51,10 +54,32 @@
 namespace osgHimmel
 {
 
+namespace
+{
+    osg::Texture3D *setupCompactTexture3D(osg::Image *image)
+    {
+        osg::Texture3D *texture(new osg::Texture3D);
+
+        texture->setFilter(osg::Texture::MIN_FILTER, osg::Texture::LINEAR);
+        texture->setFilter(osg::Texture::MAG_FILTER, osg::Texture::LINEAR);
+
+        texture->setWrap(osg::Texture::WRAP_S, osg::Texture::CLAMP_TO_EDGE);
+        texture->setWrap(osg::Texture::WRAP_T, osg::Texture::CLAMP_TO_EDGE);
+        texture->setWrap(osg::Texture::WRAP_R, osg::Texture::CLAMP_TO_EDGE);
+
+        texture->setTextureSize(image->s(), image->t(), image->r());
+        texture->setImage(image);
+
+        return texture;
+    }
+}
+
+
 AtmosphereGeode::AtmosphereGeode()
 :   osg::Geode()
 
 ,   m_precompute(NULL)
+,   m_query(new AtmosphereQuery())
 
 ,   m_program(new osg::Program)
 ,   m_vShader(new osg::Shader(osg::Shader::VERTEX))
@@ -66,9 +91,23 @@ AtmosphereGeode::AtmosphereGeode()
 ,   m_irradiance(NULL)
 ,   m_inscatter(NULL)
 
+,   m_inscatterFormat(AtmosphereFormat::F_RGBA16F)
+
+,   m_queryPreset(-1)
+
 ,   u_sunScale(NULL)
 ,   u_lheurebleue(NULL)
 ,   u_exposure(NULL)
+,   u_inscatterRanges(NULL)
+
+,   u_atlasLayers(NULL)
+,   u_atlasBlend(NULL)
+,   u_atlasSize(NULL)
+
+,   m_progressive(false)
+,   m_budget(0.0)
+
+,   m_altitude(0.f)
 {
     setName("Atmosphere");
 
@@ -83,7 +122,7 @@ AtmosphereGeode::AtmosphereGeode()
     setupShader(stateSet);
     setupTextures(stateSet);
 
-    precompute();
+    // the tables are computed by the first update (blocking or progressive)
 
     addDrawable(m_hquad);
 };
@@ -91,15 +130,23 @@ AtmosphereGeode::AtmosphereGeode()
 
 AtmosphereGeode::~AtmosphereGeode()
 {
+    delete m_query;
     delete m_precompute;
 };
 
 
 void AtmosphereGeode::update(const Himmel &himmel)
 {
-    u_sunScale->set(himmel.astro()->getAngularSunRadius() * m_scale);
+    const t_astronomySnapshot &snapshot(himmel.astro()->getSnapshot());
+
+    u_sunScale->set(snapshot.angularSunRadius * m_scale);
+
+    m_altitude = himmel.getAltitude();
+    m_sunr = snapshot.sunRefracted;
 
-    precompute();
+    // presets replace the tables of the model config
+    if(!m_atlas.valid())
+        precompute();
 }
 
 
@@ -131,7 +178,9 @@ void AtmosphereGeode::updateShader(osg::StateSet*)
     std::string fSource(getFragmentShaderSource());
     m_precompute->substituteMacros(fSource);
 
-    m_fShader->setShaderSource(fSource);
+    // progressive computes update the tables several times
+    if(fSource != m_fShader->getShaderSource())
+        m_fShader->setShaderSource(fSource);
 }
 
 
@@ -147,7 +196,16 @@ void AtmosphereGeode::setupUniforms(osg::StateSet* stateSet)
 
     u_lheurebleue = new osg::Uniform("lheurebleue", osg::Vec4f(hb[0], hb[1], hb[2], defaultLHeureBleueIntensity()));
     stateSet->addUniform(u_lheurebleue);
-    
+
+    u_inscatterRanges = new osg::Uniform("inscatterRanges", osg::Vec4f(-1.f, 0.f, -1.f, 0.f));
+    stateSet->addUniform(u_inscatterRanges);
+
+    u_atlasLayers = new osg::Uniform("atlasLayers", osg::Vec4f(0.f, 0.f, 0.f, 0.f));
+    stateSet->addUniform(u_atlasLayers);
+    u_atlasBlend = new osg::Uniform("atlasBlend", 0.f);
+    stateSet->addUniform(u_atlasBlend);
+    u_atlasSize = new osg::Uniform("atlasSize", 1.f);
+    stateSet->addUniform(u_atlasSize);
 }
 
 
@@ -167,13 +225,75 @@ void AtmosphereGeode::setupTextures(osg::StateSet* stateSet)
     stateSet->addUniform(new osg::Uniform("transmittanceSampler", 0));
     stateSet->addUniform(new osg::Uniform("irradianceSampler", 1));
     stateSet->addUniform(new osg::Uniform("inscatterSampler", 2));
+    stateSet->addUniform(new osg::Uniform("inscatterMieSampler", 3));
+}
+
+
+void AtmosphereGeode::updateTables(osg::StateSet* stateSet)
+{
+    if(m_atlas.valid())
+    {
+        stateSet->setTextureAttributeAndModes(0, m_atlas->getTransmittanceTexture());
+        stateSet->setTextureAttributeAndModes(1, m_atlas->getIrradianceTexture());
+    }
+    else
+    {
+        stateSet->setTextureAttributeAndModes(0, m_transmittance);
+        stateSet->setTextureAttributeAndModes(1, m_irradiance);
+    }
+    updateInscatter(stateSet);
+}
+
+
+void AtmosphereGeode::updateInscatter(osg::StateSet* stateSet)
+{
+    m_inscatterColor = NULL;
+    m_inscatterMie = NULL;
+
+    osg::Texture3D *inscatter(m_atlas.valid() ? m_atlas->getInscatterTexture() : m_inscatter);
+    osg::Image *source(m_atlas.valid() ? m_atlas->getInscatterImage() : m_precompute->getInscatterImage());
+
+    if(AtmosphereFormat::F_RGBA16F == m_inscatterFormat || !source || !source->data())
+    {
+        stateSet->setTextureAttributeAndModes(2, inscatter);
+        stateSet->removeTextureAttribute(3, osg::StateAttribute::TEXTURE);
+        return;
+    }
+
+    osg::ref_ptr<osg::Image> color(new osg::Image);
+    osg::ref_ptr<osg::Image> mie(new osg::Image);
+
+    AtmosphereFormat::t_logRange colorRange;
+    AtmosphereFormat::t_logRange mieRange;
+
+    AtmosphereFormat::encode(m_inscatterFormat, source, color.get(), mie.get(), colorRange, mieRange);
+
+    m_inscatterColor = setupCompactTexture3D(color.get());
+    stateSet->setTextureAttributeAndModes(2, m_inscatterColor.get());
+
+    if(AtmosphereFormat::hasMieTable(m_inscatterFormat))
+    {
+        m_inscatterMie = setupCompactTexture3D(mie.get());
+        stateSet->setTextureAttributeAndModes(3, m_inscatterMie.get());
+    }
+    else
+        stateSet->removeTextureAttribute(3, osg::StateAttribute::TEXTURE);
+    u_inscatterRanges->set(osg::Vec4f(colorRange.min, colorRange.max, mieRange.min, mieRange.max));
 }
 
 
 void AtmosphereGeode::precompute()
 {   
-    if(m_precompute->compute())
-        updateShader(getOrCreateStateSet());
+    const bool updated = m_progressive ? 
+        m_precompute->computeProgressive(m_budget) : m_precompute->compute();
+
+    if(!updated)
+        return;
+
+    updateShader(getOrCreateStateSet());
+    updateInscatter(getOrCreateStateSet());
+
+    m_query->update(m_precompute);
 }
 
 
@@ -308,6 +428,157 @@ void AtmosphereGeode::setPhaseG(const float g)
 }
 
 
+void AtmosphereGeode::setCacheDirectory(const std::string &directory)
+{
+    m_precompute->setCacheDirectory(directory);
+}
+
+const std::string AtmosphereGeode::getCacheDirectory() const
+{
+    return m_precompute->getCacheDirectory();
+}
+
+
+void AtmosphereGeode::setProgressive(
+    const bool progressive
+,   const double budget)
+{
+    m_progressive = progressive;
+    m_budget = budget;
+}
+
+const bool AtmosphereGeode::isProgressive() const
+{
+    return m_progressive;
+}
+
+
+void AtmosphereGeode::setInscatterFormat(const AtmosphereFormat::e_Format format)
+{
+    assert(format < AtmosphereFormat::NUM_FORMATS);
+
+    if(format == m_inscatterFormat)
+        return;
+
+    m_inscatterFormat = format;
+
+    osg::StateSet *stateSet(getOrCreateStateSet());
+
+    updateInscatter(stateSet);
+    updateShader(stateSet);
+}
+
+const AtmosphereFormat::e_Format AtmosphereGeode::getInscatterFormat() const
+{
+    return m_inscatterFormat;
+}
+
+
+const bool AtmosphereGeode::setPresets(const AtmosphereAtlas::t_modelCfgs &presets)
+{
+    m_atlas = NULL;
+    m_queryPreset = -1;
+
+    if(!presets.empty())
+    {
+        osg::ref_ptr<AtmosphereAtlas> atlas(new AtmosphereAtlas);
+
+        if(atlas->compute(m_precompute, presets))
+            m_atlas = atlas;
+    }
+
+    osg::StateSet *stateSet(getOrCreateStateSet());
+
+    updateTables(stateSet);
+    updateShader(stateSet);
+
+    if(!m_atlas.valid())
+        return presets.empty();
+
+    u_atlasSize->set(static_cast<float>(m_atlas->getNumPresets()));
+    setPreset(0);
+
+    return true;
+}
+
+const int AtmosphereGeode::getNumPresets() const
+{
+    return m_atlas.valid() ? m_atlas->getNumPresets() : 0;
+}
+
+
+void AtmosphereGeode::setPreset(const int preset)
+{
+    blendPresets(preset, preset, 0.f);
+}
+
+
+void AtmosphereGeode::blendPresets(
+    const int a
+,   const int b
+,   const float t)
+{
+    assert(m_atlas.valid());
+    if(!m_atlas.valid())
+        return;
+
+    assert(a >= 0 && a < m_atlas->getNumPresets());
+    assert(b >= 0 && b < m_atlas->getNumPresets());
+
+    const float blend = a == b ? 0.f : _clamp(0.f, 1.f, t);
+
+    u_atlasLayers->set(osg::Vec4f(m_atlas->getTransmittanceLayer(a), m_atlas->getTransmittanceLayer(b), a, b));
+    u_atlasBlend->set(blend);
+
+    // phase functions and mie extraction read the blended parameters
+    AtmospherePrecompute::setupModelUniforms(getOrCreateStateSet()
+        , AtmosphereAtlas::blend(m_atlas->getPreset(a), m_atlas->getPreset(b), blend));
+
+    // the query refers to the tables of the dominant preset
+
+    const int preset = blend < 0.5f ? a : b;
+    if(preset == m_queryPreset)
+        return;
+
+    m_query->update(m_atlas->getTextureConfig(), m_atlas->getPreset(preset)
+        , m_atlas->getTransmittanceImage(preset), m_atlas->getIrradianceImage(preset), m_atlas->getInscatterImage(preset));
+
+    m_queryPreset = preset;
+}
+
+
+const AtmosphereAtlas *AtmosphereGeode::getAtlas() const
+{
+    return m_atlas.get();
+}
+
+
+const AtmospherePrecompute *AtmosphereGeode::getPrecompute() const
+{
+    return m_precompute;
+}
+
+
+const osg::Vec3f AtmosphereGeode::getSkyRadiance(const osg::Vec3f &direction) const
+{
+    return m_query->radiance(direction, m_sunr, m_altitude);
+}
+
+const osg::Vec3f AtmosphereGeode::getSunColor() const
+{
+    return m_query->sunTransmittance(m_altitude, m_sunr) * AtmosphereQuery::sunIntensity();
+}
+
+const osg::Vec3f AtmosphereGeode::getSkyIrradiance() const
+{
+    return m_query->irradiance(m_altitude, m_sunr);
+}
+
+
+const AtmosphereQuery *AtmosphereGeode::getQuery() const
+{
+    return m_query;
+}
 
 
 const std::string AtmosphereGeode::getVertexShaderSource()
@@ -335,6 +606,10 @@ const std::string AtmosphereGeode::getFragmentShaderSource()
 {
     return glsl_version_150()
 
+        // presets blend the model parameters (see blendPresets)
+    +   ENABLE_IF(atlas, m_atlas.valid())
+    +   ENABLE_IF(modelUniforms, m_atlas.valid())
+
     +   glsl_cmn_uniform()
     +   
         "uniform vec3 sun;\n"
@@ -347,6 +622,7 @@ const std::string AtmosphereGeode::getFragmentShaderSource()
     +   glsl_bruneton_const_R()
     +   glsl_bruneton_const_M()
     +   glsl_bruneton_const_PI()
+    +   glsl_bruneton_atlas()
 
 
     +   "in vec4 m_ray;\n"
@@ -361,7 +637,9 @@ const std::string AtmosphereGeode::getFragmentShaderSource()
         "\n"
 
         //"uniform sampler2D reflectanceSampler;\n" // ground reflectance texture
-        "uniform sampler2D irradianceSampler;\n"    // precomputed skylight irradiance (E table)
+    +   IF_ELSE_ENABLED(atlas,
+        "uniform sampler2DArray irradianceSampler;",
+        "uniform sampler2D irradianceSampler;")   // precomputed skylight irradiance (E table)
         "uniform sampler3D inscatterSampler;\n"     // precomputed inscattered light (S table)
         "\n"
 
@@ -373,6 +651,7 @@ const std::string AtmosphereGeode::getFragmentShaderSource()
     +   glsl_bruneton_irradianceUV()
     +   glsl_bruneton_irradiance()
     +   glsl_bruneton_texture4D()
+    +   getInscatterShaderSource()
     +   glsl_bruneton_phaseFunctionR()
     +   glsl_bruneton_phaseFunctionM()
     +   glsl_bruneton_mie()
@@ -397,7 +676,7 @@ const std::string AtmosphereGeode::getFragmentShaderSource()
         "        float muS = dot(x, s) / r;\n"
         "        float phaseR = phaseFunctionR(nu);\n"
         "        float phaseM = phaseFunctionM(nu);\n"
-        "        vec4 inscatter = max(texture4D(inscatterSampler, r, mu, muS, nu), 0.0);\n"
+        "        vec4 inscatter = max(inscatter4D(r, mu, muS, nu), 0.0);\n"
         "        if (t > 0.0) {\n"
         "            vec3 x0 = x + t * v;\n"
         "            float r0 = length(x0);\n"
@@ -412,7 +691,7 @@ const std::string AtmosphereGeode::getFragmentShaderSource()
         //"#endif\n"
         "            if (r0 > cmn[1] + 0.01) {\n"
                         // computes S[L]-T(x,x0)S[L]|x0
-        "                inscatter = max(inscatter - attenuation.rgbr * texture4D(inscatterSampler, r0, mu0, muS0, nu), 0.0);\n"
+        "                inscatter = max(inscatter - attenuation.rgbr * inscatter4D(r0, mu0, muS0, nu), 0.0);\n"
         //"#ifdef FIX\n"
         /*                // avoids imprecision problems near horizon by interpolating between two points above and below horizon
         "                const float EPS = 0.004;\n"
@@ -552,6 +831,59 @@ const std::string AtmosphereGeode::getFragmentShaderSource()
 }
 
 
+const std::string AtmosphereGeode::getInscatterShaderSource() const
+{
+    // lookup of the inscatter table of a preset, decoding its storage format
+
+    std::string source;
+
+    switch(m_inscatterFormat)
+    {
+    case AtmosphereFormat::F_RGB9E5:
+    case AtmosphereFormat::F_R11G11B10F:
+        source =
+            "uniform sampler3D inscatterMieSampler;\n"  // log encoded mie (red only)
+            "uniform vec4 inscatterRanges;\n"           // log2 ranges of rgb (xy) and mie (zw)
+            "\n"
+            "vec4 inscatterLayer(float r, float mu, float muS, float nu, float layer) {\n"
+            "    vec3 rgb = texture4D(inscatterSampler, r, mu, muS, nu, layer, atlasSize).rgb;\n"
+            "    float mie = texture4D(inscatterMieSampler, r, mu, muS, nu, layer, atlasSize).r;\n"
+            "    return vec4(rgb, exp2(mix(inscatterRanges.z, inscatterRanges.w, mie)));\n"
+            "}\n"
+            "\n";
+        break;
+
+    case AtmosphereFormat::F_Log8:
+        source =
+            "uniform vec4 inscatterRanges;\n"           // log2 range of rgba (xy)
+            "\n"
+            "vec4 inscatterLayer(float r, float mu, float muS, float nu, float layer) {\n"
+            "    vec4 l = texture4D(inscatterSampler, r, mu, muS, nu, layer, atlasSize);\n"
+            "    return exp2(mix(vec4(inscatterRanges.x), vec4(inscatterRanges.y), l));\n"
+            "}\n"
+            "\n";
+        break;
+
+    default:
+        source =
+            "vec4 inscatterLayer(float r, float mu, float muS, float nu, float layer) {\n"
+            "    return texture4D(inscatterSampler, r, mu, muS, nu, layer, atlasSize);\n"
+            "}\n"
+            "\n";
+        break;
+    }
+
+    // blend of the layers of two presets (see blendPresets)
+
+    return source +
+        "vec4 inscatter4D(float r, float mu, float muS, float nu) {\n"
+        "    vec4 a = inscatterLayer(r, mu, muS, nu, atlasLayers.z);\n"
+        "    return atlasBlend > 0.0 ? mix(a, inscatterLayer(r, mu, muS, nu, atlasLayers.w), atlasBlend) : a;\n"
+        "}\n"
+        "\n";
+}
+
+
 
 
 #ifdef OSGHIMMEL_EXPOSE_SHADERS
@@ -0,0 +1,486 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+// based on Brunetons free code (http://www-evasion.imag.fr/Members/Eric.Bruneton/PrecomputedAtmosphericScattering2.zip)
+
+// The functions mirror the glsl_bruneton_* shader fragments (see
+// shaderfragment/bruneton_common.cpp) and should be kept in sync.
+
+
+#include "atmospheremodel.h"
+
+#include "earth.h"
+#include "mathmacros.h"
+
+#include <assert.h>
+#include <math.h>
+
+
+namespace osgHimmel
+{
+
+namespace
+{
+    inline const int clampi(const int i, const int max)
+    {
+        return i < 0 ? 0 : (i > max ? max : i);
+    }
+
+    inline const float minf(const float a, const float b)
+    {
+        return a < b ? a : b;
+    }
+
+    inline const float maxf(const float a, const float b)
+    {
+        return a > b ? a : b;
+    }
+
+    inline const float mixf(const float a, const float b, const float t)
+    {
+        return a + (b - a) * t;
+    }
+
+    // clamps texture coordinates like CLAMP_TO_EDGE, mapping nan to 0
+
+    inline const float saturate(const float v)
+    {
+        return v > 0.f ? (v < 1.f ? v : 1.f) : 0.f;
+    }
+
+    // min(a / b, 1.0) of glsl, with 0 / 0 resolved to 0
+
+    inline const float ratio(const float a, const float b)
+    {
+        return b > 0.f ? minf(a / b, 1.f) : (a > 0.f ? 1.f : 0.f);
+    }
+}
+
+
+AtmosphereModel::FloatTable::FloatTable()
+:   data(NULL)
+,   width(0)
+,   height(0)
+,   depth(0)
+,   components(0)
+{
+}
+
+
+AtmosphereModel::FloatTable::FloatTable(
+    float *data
+,   const int width
+,   const int height
+,   const int depth
+,   const int components)
+:   data(data)
+,   width(width)
+,   height(height)
+,   depth(depth)
+,   components(components)
+{
+    assert(components > 0 && components <= 4);
+}
+
+
+float *AtmosphereModel::FloatTable::texel(
+    const int x
+,   const int y
+,   const int z) const
+{
+    assert(data);
+    assert(x >= 0 && x < width && y >= 0 && y < height && z >= 0 && z < depth);
+
+    return data + ((z * height + y) * width + x) * components;
+}
+
+
+const osg::Vec4f AtmosphereModel::FloatTable::sample2D(
+    const float u
+,   const float v) const
+{
+    const float x = saturate(u) * width  - 0.5f;
+    const float y = saturate(v) * height - 0.5f;
+
+    const float fx = floor(x);
+    const float fy = floor(y);
+
+    const float ax = x - fx;
+    const float ay = y - fy;
+
+    const int x0 = clampi(static_cast<int>(fx)    , width  - 1);
+    const int x1 = clampi(static_cast<int>(fx) + 1, width  - 1);
+    const int y0 = clampi(static_cast<int>(fy)    , height - 1);
+    const int y1 = clampi(static_cast<int>(fy) + 1, height - 1);
+
+    const float *t00 = texel(x0, y0);
+    const float *t10 = texel(x1, y0);
+    const float *t01 = texel(x0, y1);
+    const float *t11 = texel(x1, y1);
+
+    osg::Vec4f result;
+    for(int c = 0; c < components; ++c)
+        result[c] = mixf(mixf(t00[c], t10[c], ax), mixf(t01[c], t11[c], ax), ay);
+
+    return result;
+}
+
+
+const osg::Vec4f AtmosphereModel::FloatTable::sample3D(
+    const float u
+,   const float v
+,   const float w) const
+{
+    const float x = saturate(u) * width  - 0.5f;
+    const float y = saturate(v) * height - 0.5f;
+    const float z = saturate(w) * depth  - 0.5f;
+
+    const float fx = floor(x);
+    const float fy = floor(y);
+    const float fz = floor(z);
+
+    const float ax = x - fx;
+    const float ay = y - fy;
+    const float az = z - fz;
+
+    const int x0 = clampi(static_cast<int>(fx)    , width  - 1);
+    const int x1 = clampi(static_cast<int>(fx) + 1, width  - 1);
+    const int y0 = clampi(static_cast<int>(fy)    , height - 1);
+    const int y1 = clampi(static_cast<int>(fy) + 1, height - 1);
+    const int z0 = clampi(static_cast<int>(fz)    , depth  - 1);
+    const int z1 = clampi(static_cast<int>(fz) + 1, depth  - 1);
+
+    const float *t000 = texel(x0, y0, z0);
+    const float *t100 = texel(x1, y0, z0);
+    const float *t010 = texel(x0, y1, z0);
+    const float *t110 = texel(x1, y1, z0);
+    const float *t001 = texel(x0, y0, z1);
+    const float *t101 = texel(x1, y0, z1);
+    const float *t011 = texel(x0, y1, z1);
+    const float *t111 = texel(x1, y1, z1);
+
+    osg::Vec4f result;
+    for(int c = 0; c < components; ++c)
+    {
+        const float a = mixf(mixf(t000[c], t100[c], ax), mixf(t010[c], t110[c], ax), ay);
+        const float b = mixf(mixf(t001[c], t101[c], ax), mixf(t011[c], t111[c], ax), ay);
+
+        result[c] = mixf(a, b, az);
+    }
+    return result;
+}
+
+
+AtmosphereModel::AtmosphereModel(
+    const t_preTexCfg &preTexCfg
+,   const t_modelCfg &modelCfg)
+:   m_preTexCfg(preTexCfg)
+,   m_modelCfg(modelCfg)
+,   m_Rg(static_cast<float>(Earth::meanRadius()))
+,   m_Rt(static_cast<float>(Earth::meanRadius() + Earth::atmosphereThicknessNonUniform()))
+{
+}
+
+
+const AtmosphereModel::t_preTexCfg &AtmosphereModel::preTexCfg() const
+{
+    return m_preTexCfg;
+}
+
+const AtmosphereModel::t_modelCfg &AtmosphereModel::modelCfg() const
+{
+    return m_modelCfg;
+}
+
+
+const float AtmosphereModel::Rg() const
+{
+    return m_Rg;
+}
+
+const float AtmosphereModel::Rt() const
+{
+    return m_Rt;
+}
+
+
+const osg::Vec2f AtmosphereModel::transmittanceUV(
+    const float r
+,   const float mu) const
+{
+    const float uR  = sqrt(maxf(0.f, (r - m_Rg) / (m_Rt - m_Rg)));
+    const float uMu = atan((mu + 0.15f) / (1.0f + 0.15f) * tan(1.5f)) / 1.5f;
+
+    return osg::Vec2f(uMu, uR);
+}
+
+
+void AtmosphereModel::transmittanceRMu(
+    const int x
+,   const int y
+,   float &r
+,   float &muS) const
+{
+    r   = (y + 0.5f) / static_cast<float>(m_preTexCfg.transmittanceHeight);
+    muS = (x + 0.5f) / static_cast<float>(m_preTexCfg.transmittanceWidth);
+
+    r   = m_Rg + (r * r) * (m_Rt - m_Rg);
+    muS = -0.15f + tan(1.5f * muS) / tan(1.5f) * (1.0f + 0.15f);
+}
+
+
+const osg::Vec2f AtmosphereModel::irradianceUV(
+    const float r
+,   const float muS) const
+{
+    const float uR   = (r - m_Rg) / (m_Rt - m_Rg);
+    const float uMuS = (muS + 0.2f) / (1.0f + 0.2f);
+
+    return osg::Vec2f(uMuS, uR);
+}
+
+
+void AtmosphereModel::irradianceRMuS(
+    const int x
+,   const int y
+,   float &r
+,   float &muS) const
+{
+    r   = m_Rg + y / (m_preTexCfg.skyHeight - 1.f) * (m_Rt - m_Rg);
+    muS = -0.2f + x / (m_preTexCfg.skyWidth - 1.f) * (1.0f + 0.2f);
+}
+
+
+void AtmosphereModel::muMuSNu(
+    const int x
+,   const int y
+,   const float r
+,   const osg::Vec4f &dhdH
+,   float &mu
+,   float &muS
+,   float &nu) const
+{
+    const float resMu  = static_cast<float>(m_preTexCfg.resMu);
+    const float resMuS = static_cast<float>(m_preTexCfg.resMuS);
+    const float resNu  = static_cast<float>(m_preTexCfg.resNu);
+
+    if(y < resMu / 2.f)
+    {
+        float d = 1.f - y / (resMu / 2.f - 1.f);
+        d = minf(maxf(dhdH[2], d * dhdH[3]), dhdH[3] * 0.999f);
+        mu = (m_Rg * m_Rg - r * r - d * d) / (2.f * r * d);
+        mu = minf(mu, -sqrt(maxf(0.f, 1.f - (m_Rg / r) * (m_Rg / r))) - 0.001f);
+    }
+    else
+    {
+        float d = (y - resMu / 2.f) / (resMu / 2.f - 1.f);
+        d = minf(maxf(dhdH[0], d * dhdH[1]), dhdH[1] * 0.999f);
+        mu = (m_Rt * m_Rt - r * r - d * d) / (2.f * r * d);
+    }
+
+    muS = fmod(static_cast<float>(x), resMuS) / (resMuS - 1.f);
+    muS = tan((2.f * muS - 1.f + 0.26f) * 1.1f) / tan(1.26f * 1.1f);
+    nu  = -1.f + floor(x / resMuS) / (resNu - 1.f) * 2.f;
+}
+
+
+void AtmosphereModel::layerRDhdH(
+    const int layer
+,   float &r
+,   osg::Vec4f &dhdH) const
+{
+    const int depth = m_preTexCfg.resR;
+
+    const double Rg = m_Rg;
+    const double Rt = m_Rt;
+
+    const double Rg2 = Rg * Rg;
+    const double Rt2 = Rt * Rt;
+
+    double rd = layer / (depth - 1.0);
+    rd *= rd;
+    rd = sqrt(Rg2 + rd * (Rt2 - Rg2)) + (layer == 0 ? 0.01 : (layer == depth - 1 ? -0.001 : 0.0));
+
+    r = static_cast<float>(rd);
+
+    dhdH[0] = static_cast<float>(Rt - rd);
+    dhdH[1] = static_cast<float>(sqrt(rd * rd - Rg2) + sqrt(Rt2 - Rg2));
+    dhdH[2] = static_cast<float>(rd - Rg);
+    dhdH[3] = static_cast<float>(sqrt(rd * rd - Rg2));
+}
+
+
+const osg::Vec4f AtmosphereModel::texture4D(
+    const t_table &table
+,   const float r
+,   const float mu
+,   const float muS
+,   const float nu) const
+{
+    const float resR   = static_cast<float>(m_preTexCfg.resR);
+    const float resMu  = static_cast<float>(m_preTexCfg.resMu);
+    const float resMuS = static_cast<float>(m_preTexCfg.resMuS);
+    const float resNu  = static_cast<float>(m_preTexCfg.resNu);
+
+    const float H   = sqrt(m_Rt * m_Rt - m_Rg * m_Rg);
+    const float rho = sqrt(maxf(0.f, r * r - m_Rg * m_Rg));
+
+    const float rmu   = r * mu;
+    const float delta = rmu * rmu - r * r + m_Rg * m_Rg;
+
+    const bool below = rmu < 0.f && delta > 0.f;
+
+    const float cstX = below ?  1.f : -1.f;
+    const float cstY = below ?  0.f :  H * H;
+    const float cstZ = below ?  0.f :  H;
+    const float cstW = below ?  0.5f - 0.5f / resMu : 0.5f + 0.5f / resMu;
+
+    const float uR   = 0.5f / resR + rho / H * (1.f - 1.f / resR);
+    const float uMu  = cstW + (rmu * cstX + sqrt(maxf(0.f, delta + cstY))) / (rho + cstZ) * (0.5f - 1.f / resMu);
+    const float uMuS = 0.5f / resMuS + (atan(maxf(muS, -0.1975f) * tan(1.26f * 1.1f)) / 1.1f + (1.f - 0.26f)) * 0.5f * (1.f - 1.f / resMuS);
+
+    float lerp = (nu + 1.f) / 2.f * (resNu - 1.f);
+    const float uNu = floor(lerp);
+    lerp = lerp - uNu;
+
+    const osg::Vec4f a = table.sample3D((uNu + uMuS) / resNu, uMu, uR);
+    const osg::Vec4f b = table.sample3D((uNu + uMuS + 1.f) / resNu, uMu, uR);
+
+    return osg::Vec4f(
+        mixf(a[0], b[0], lerp)
+    ,   mixf(a[1], b[1], lerp)
+    ,   mixf(a[2], b[2], lerp)
+    ,   mixf(a[3], b[3], lerp));
+}
+
+
+const osg::Vec3f AtmosphereModel::transmittance(
+    const t_table &transmittance
+,   const float r
+,   const float mu) const
+{
+    const osg::Vec2f uv(transmittanceUV(r, mu));
+    const osg::Vec4f t(transmittance.sample2D(uv[0], uv[1]));
+
+    return osg::Vec3f(t[0], t[1], t[2]);
+}
+
+
+const osg::Vec3f AtmosphereModel::transmittance(
+    const t_table &transmittance
+,   const float r
+,   const float mu
+,   const float d) const
+{
+    const float r1  = sqrt(maxf(0.f, r * r + d * d + 2.f * r * mu * d));
+    const float mu1 = (r * mu + d) / r1;
+
+    osg::Vec3f a, b;
+
+    if(mu > 0.f)
+    {
+        a = this->transmittance(transmittance, r, mu);
+        b = this->transmittance(transmittance, r1, mu1);
+    }
+    else
+    {
+        a = this->transmittance(transmittance, r1, -mu1);
+        b = this->transmittance(transmittance, r, -mu);
+    }
+    return osg::Vec3f(ratio(a[0], b[0]), ratio(a[1], b[1]), ratio(a[2], b[2]));
+}
+
+
+const osg::Vec3f AtmosphereModel::transmittanceWithShadow(
+    const t_table &transmittance
+,   const float r
+,   const float mu) const
+{
+    return mu < -sqrt(maxf(0.f, 1.f - (m_Rg / r) * (m_Rg / r))) ? osg::Vec3f() : this->transmittance(transmittance, r, mu);
+}
+
+
+const osg::Vec3f AtmosphereModel::irradiance(
+    const t_table &irradiance
+,   const float r
+,   const float muS) const
+{
+    const osg::Vec2f uv(irradianceUV(r, muS));
+    const osg::Vec4f e(irradiance.sample2D(uv[0], uv[1]));
+
+    return osg::Vec3f(e[0], e[1], e[2]);
+}
+
+
+const float AtmosphereModel::limit(
+    const float r
+,   const float mu) const
+{
+    const float RL = m_Rt + 1.f;
+
+    float dout = -r * mu + sqrt(maxf(0.f, r * r * (mu * mu - 1.f) + RL * RL));
+    const float delta2 = r * r * (mu * mu - 1.f) + m_Rg * m_Rg;
+
+    if(delta2 >= 0.f)
+    {
+        const float din = -r * mu - sqrt(delta2);
+        if(din >= 0.f)
+            dout = minf(dout, din);
+    }
+    return dout;
+}
+
+
+const float AtmosphereModel::phaseFunctionR(const float mu) const
+{
+    return (3.f / (16.f * static_cast<float>(_PI))) * (1.f + mu * mu);
+}
+
+
+const float AtmosphereModel::phaseFunctionM(const float mu) const
+{
+    const float g = m_modelCfg.mieG;
+
+    return 1.5f * 1.f / (4.f * static_cast<float>(_PI)) * (1.f - g * g) * pow(1.f + (g * g) - 2.f * g * mu, -3.f / 2.f) * (1.f + mu * mu) / (2.f + g * g);
+}
+
+
+const osg::Vec3f AtmosphereModel::mie(const osg::Vec4f &rayMie) const
+{
+    const osg::Vec3f &betaR(m_modelCfg.betaR);
+    const float s = rayMie[3] / maxf(rayMie[0], 1e-4f);
+
+    return osg::Vec3f(
+        rayMie[0] * s
+    ,   rayMie[1] * s * betaR[0] / betaR[1]
+    ,   rayMie[2] * s * betaR[0] / betaR[2]);
+}
+
+} // namespace osgHimmel
@@ -39,10 +39,14 @@
 
 #include "atmosphereprecompute.h"
 
+#include "atmospherecache.h"
+#include "memorymappedfile.h"
 #include "himmel.h"
 #include "earth.h"
 #include "strutils.h"
+#include "mathmacros.h"
 
+#include "shaderfragment/common.h"
 #include "shaderfragment/bruneton_common.h"
 #include "shaderfragment/bruneton_inscatter.h"
 #include "shaderfragment/bruneton_irradiance.h"
@@ -56,6 +60,54 @@
 
 #include <assert.h>
 #include <cstring>
+#include <cstdlib>
+
+
+namespace
+{
+    typedef osgHimmel::AtmospherePrecompute t_precompute;
+
+    const unsigned int ALL_STAGES((1 << t_precompute::NUM_STAGES) - 1);
+
+    // highest order of scattering (line 6 in algorithm 4.1)
+    const int NUM_ORDERS(4);
+
+    const char *PASS_NAMES[t_precompute::NUM_PASSES] =
+    {
+        "transmittance"
+    ,   "irradiance1"
+    ,   "inscatter1"
+    ,   "copyIrradiance"
+    ,   "copyInscatter1"
+    ,   "inscatterS"
+    ,   "irradianceN"
+    ,   "inscatterN"
+    ,   "copyInscatterN"
+    };
+
+    // Model parameters and stages read by the passes of each stage (see 
+    // the glsl_bruneton_f_* fragments, keep in sync). The multiple scattering
+    // stage reads the ground reflectance and mieG (via phaseFunctionM) in 
+    // inscatterS and irradianceN. Note that the constants of const_M are 
+    // substituted into all passes, but are not read by all of them.
+
+    const unsigned int STAGE_PARAMETERS[t_precompute::NUM_STAGES] =
+    {
+        t_precompute::MP_HR | t_precompute::MP_BetaR | t_precompute::MP_HM | t_precompute::MP_BetaMEx
+    ,   0
+    ,   t_precompute::MP_HR | t_precompute::MP_BetaR | t_precompute::MP_HM | t_precompute::MP_BetaMSca
+    ,   t_precompute::MP_HR | t_precompute::MP_BetaR | t_precompute::MP_HM | t_precompute::MP_BetaMSca
+            | t_precompute::MP_AvgGroundReflectance | t_precompute::MP_MieG
+    };
+
+    const unsigned int STAGE_INPUTS[t_precompute::NUM_STAGES] =
+    {
+        0
+    ,   1 << t_precompute::S_Transmittance
+    ,   1 << t_precompute::S_Transmittance
+    ,   1 << t_precompute::S_Transmittance | 1 << t_precompute::S_Irradiance1 | 1 << t_precompute::S_Inscatter1
+    };
+}
 
 
 namespace osgHimmel
@@ -66,6 +118,13 @@ AtmospherePrecompute::AtmospherePrecompute()
 ,   m_irradianceImage(new osg::Image)
 ,   m_inscatterImage(new osg::Image)
 ,   m_dirty(true)
+,   m_stages(0)
+,   m_validStages(0)
+,   m_computing(false)
+,   m_nextTask(0)
+,   m_layersPerTask(4)
+,   m_order(0)
+,   m_computeStart(0)
 {
     m_preTexCfg.transmittanceWidth  = 256;
     m_preTexCfg.transmittanceHeight =  64;
@@ -83,6 +142,8 @@ AtmospherePrecompute::AtmospherePrecompute()
     m_preTexCfg.irradianceIntegralSamples         =  32;
     m_preTexCfg.inscatterSphericalIntegralSamples =  16;
 
+    m_preTexCfg.integralTolerance = 0.f;
+
     m_modelCfg.avgGroundReflectance = 0.1f;
 
     m_modelCfg.HR = 8.f;
@@ -93,12 +154,27 @@ AtmospherePrecompute::AtmospherePrecompute()
     m_modelCfg.betaMEx = m_modelCfg.betaMSca / 0.9f;
     m_modelCfg.mieG = 0.6; //0.76;
 
+    const char *cacheDirectory = getenv("OSGHIMMEL_ATMOSPHERE_CACHE");
+    if(cacheDirectory)
+        m_cacheDirectory = cacheDirectory;
+
+    m_computedPreTexCfg = m_preTexCfg;
+    m_computeModelCfg   = m_modelCfg;
+
+    for(int i = 0; i < NUM_STAGES; ++i)
+        m_stageModelCfgs[i] = m_modelCfg;
+
+    for(int i = 0; i < NUM_PASSES; ++i)
+        m_passTimes[i] = 0.0;
+
 
     // Setup Textures
 
     m_transmittanceTexture = getTransmittanceTexture();
     m_deltaETexture        = getDeltaETexture();
+    m_deltaE1Texture       = getDeltaE1Texture();
     m_deltaSRTexture       = getDeltaSRTexture();
+    m_deltaSR1Texture      = getDeltaSR1Texture();
     m_deltaSMTexture       = getDeltaSMTexture();
     m_irradianceTexture    = getIrradianceTexture();
     m_inscatterTexture     = getInscatterTexture();
@@ -108,6 +184,7 @@ AtmospherePrecompute::AtmospherePrecompute()
 
 AtmospherePrecompute::~AtmospherePrecompute()
 {
+    releasePipeline();
 }
 
 
@@ -128,6 +205,20 @@ osg::Texture3D *AtmospherePrecompute::getInscatterTexture()
 }
 
 
+osg::Image *AtmospherePrecompute::getTransmittanceImage()
+{
+    return m_transmittanceImage;
+}
+osg::Image *AtmospherePrecompute::getIrradianceImage()
+{
+    return m_irradianceImage;
+}
+osg::Image *AtmospherePrecompute::getInscatterImage()
+{
+    return m_inscatterImage;
+}
+
+
 void AtmospherePrecompute::dirty()
 {
     if(!m_dirty)
@@ -142,152 +233,693 @@ const bool AtmospherePrecompute::compute(const bool ifDirtyOnly)
 
     m_dirty = false;
 
+    // a progressive compute is restarted with the current config
+    abortCompute();
 
-    osg::Timer_t t = osg::Timer::instance()->tick();
+    if(loadFromCache())
+        return true;
 
-    // Setup Viewer
+    // passes are not split
+    if(!beginCompute(ifDirtyOnly, m_preTexCfg.resR))
+        return false;
 
-    osgViewer::CompositeViewer *viewer = new osgViewer::CompositeViewer;
-    osgViewer::View *view = new osgViewer::View();
+    while(isComputing())
+        computeStep();
 
-    viewer->addView(view);
+    return true;
+}
+
+
+const bool AtmospherePrecompute::isUpToDate() const
+{
+    return !m_computing
+        && 0 == memcmp(&m_preTexCfg, &m_computedPreTexCfg, sizeof(t_preTexCfg))
+        && 0 == requiredStages();
+}
+
+
+const bool AtmospherePrecompute::computeProgressive(
+    const double budget
+,   const bool ifDirtyOnly)
+{
+    if(isComputing() && m_dirty)
+        abortCompute();
+
+    if(!isComputing())
+    {
+        if(ifDirtyOnly && !m_dirty)
+            return false;
+
+        m_dirty = false;
 
-    // Setup Context and Camera
+        if(loadFromCache())
+            return true;
 
-    osg::GraphicsContext *gc(setupContext());
+        if(!beginCompute(ifDirtyOnly, m_layersPerTask))
+            return false;
+    }
+
+    const osg::Timer_t t = osg::Timer::instance()->tick();
+
+    // runs at least one task, even if it exceeds the budget
 
-    if(!gc->valid())
+    bool changed = false;
+    do
     {
-        OSG_FATAL << "Initialize PBuffer graphics context failed" << std::endl;
+        changed |= computeStep();
+    }
+    while(isComputing() && osg::Timer::instance()->delta_s(t, osg::Timer::instance()->tick()) < budget);
+
+    return changed;
+}
+
+
+const bool AtmospherePrecompute::isComputing() const
+{
+    return m_computing;
+}
+
+
+const float AtmospherePrecompute::getProgress() const
+{
+    if(!m_computing)
+        return 1.f;
+
+    return static_cast<float>(m_nextTask) / static_cast<float>(m_tasks.size());
+}
+
+
+const int AtmospherePrecompute::getScatteringOrder() const
+{
+    return m_order;
+}
+
+
+const double AtmospherePrecompute::getPassTime(const e_Pass pass) const
+{
+    assert(pass < NUM_PASSES);
+    return m_passTimes[pass];
+}
+
+
+const char *AtmospherePrecompute::passName(const e_Pass pass)
+{
+    assert(pass < NUM_PASSES);
+    return PASS_NAMES[pass];
+}
+
+
+void AtmospherePrecompute::setLayersPerTask(const int layers)
+{
+    m_layersPerTask = layers;
+}
+
+const int AtmospherePrecompute::getLayersPerTask() const
+{
+    return m_layersPerTask;
+}
+
+
+const bool AtmospherePrecompute::beginCompute(
+    const bool ifDirtyOnly
+,   const int layersPerTask)
+{
+    assert(!m_computing);
+
+    if(memcmp(&m_preTexCfg, &m_computedPreTexCfg, sizeof(t_preTexCfg)) != 0)
+        m_validStages = 0;
+
+    m_computedPreTexCfg = m_preTexCfg;
+
+    m_stages = ifDirtyOnly ? requiredStages() : ALL_STAGES;
+
+    if(0 == m_stages)
+        return false;
+
+    m_computeModelCfg = m_modelCfg;
+
+    // results of rerun stages are invalid until their last task completes
+    m_validStages &= ~m_stages;
+
+    if(!beginTables())
+    {
+        m_validStages = 0;
         return false;
     }
 
+    setupTasks(layersPerTask);
+    m_order = 0;
+
+    for(int i = 0; i < NUM_PASSES; ++i)
+        m_passTimes[i] = 0.0;
+
+    m_computeStart = osg::Timer::instance()->tick();
+    m_computing = true;
+
+    return true;
+}
+
+
+void AtmospherePrecompute::setupTasks(const int layersPerTask)
+{
+    m_tasks.clear();
+    m_nextTask = 0;
+
+    const int resR = m_preTexCfg.resR;
+
+    const int layers = _ma(1, layersPerTask);
+
+    if(isStageRequired(S_Transmittance))
+        addTask(P_Transmittance, 1);
+
+    if(isStageRequired(S_Irradiance1))
+        addTask(P_Irradiance1, 1);
+
+    if(isStageRequired(S_Inscatter1))
+        for(int layer = 0; layer < resR; layer += layers)
+            addTask(P_Inscatter1, 1, layer, _mi(layer + layers, resR));
+
+    // all stages (directly or indirectly) affect multiple scattering
+    assert(isStageRequired(S_MultipleScattering));
+
+    addTask(P_CopyIrradiance, 1);
+    addTask(P_CopyInscatter1, 1, 0, resR);
+
+    for(int order = 2; order <= NUM_ORDERS; ++order)
+    {
+        for(int layer = 0; layer < resR; layer += layers)
+            addTask(P_InscatterS, order, layer, _mi(layer + layers, resR));
+
+        addTask(P_IrradianceN, order);
+
+        for(int layer = 0; layer < resR; layer += layers)
+            addTask(P_InscatterN, order, layer, _mi(layer + layers, resR));
+
+        // copies are not split, so that published tables are never partially updated
+        addTask(P_CopyIrradiance, order);
+        addTask(P_CopyInscatterN, order, 0, resR);
+    }
+}
+
+
+void AtmospherePrecompute::addTask(
+    const e_Pass pass
+,   const int order
+,   const int begin
+,   const int end)
+{
+    t_task task;
+
+    task.pass  = pass;
+    task.order = order;
+    task.begin = begin;
+    task.end   = end;
+
+    m_tasks.push_back(task);
+}
+
+
+const bool AtmospherePrecompute::computeStep()
+{
+    assert(m_computing);
+    assert(m_nextTask < m_tasks.size());
+
+    const t_task &task(m_tasks[m_nextTask++]);
+
+    const osg::Timer_t t = osg::Timer::instance()->tick();
+
+    computeTask(task);
+
+    m_passTimes[task.pass] += osg::Timer::instance()->delta_s(t, osg::Timer::instance()->tick());
+
+    bool changed = false;
+
+    switch(task.pass)
+    {
+    case P_Transmittance:
+        completeStage(S_Transmittance);
+        changed = true;
+        break;
+
+    case P_Irradiance1:
+        completeStage(S_Irradiance1);
+        break;
+
+    case P_Inscatter1:
+        if(task.end == m_preTexCfg.resR)
+            completeStage(S_Inscatter1);
+        break;
+
+    case P_CopyInscatter1:
+    case P_CopyInscatterN:
+        m_order = task.order;
+        changed = true;
+        break;
+
+    default:
+        break;
+    }
+
+    if(m_nextTask == m_tasks.size())
+        endCompute();
+
+    return changed;
+}
+
+
+void AtmospherePrecompute::completeStage(const e_Stage stage)
+{
+    m_validStages |= 1 << stage;
+    m_stageModelCfgs[stage] = m_computeModelCfg;
+}
+
+
+void AtmospherePrecompute::endCompute()
+{
+    endTables();
+
+    m_computing = false;
+    m_tasks.clear();
+
+    completeStage(S_MultipleScattering);
+
+    OSG_NOTICE << "Atmopshere Precomputed (took " 
+        << osg::Timer::instance()->delta_s(m_computeStart,  osg::Timer::instance()->tick()) << " s)" << std::endl;
+
+    for(int i = 0; i < NUM_PASSES; ++i)
+        OSG_INFO << "  " << PASS_NAMES[i] << ": " << m_passTimes[i] << " s" << std::endl;
+
+    storeToCache();
+}
+
+
+void AtmospherePrecompute::abortCompute()
+{
+    if(!m_computing)
+        return;
+
+    endTables();
+
+    m_computing = false;
+    m_tasks.clear();
+
+    // the tables are partially updated (the retained results of completed stages stay valid)
+    m_validStages &= ~(1 << S_MultipleScattering);
+}
+
+
+const unsigned int AtmospherePrecompute::stageParameters(const e_Stage stage)
+{
+    assert(stage < NUM_STAGES);
+    return STAGE_PARAMETERS[stage];
+}
+
+const unsigned int AtmospherePrecompute::stageInputs(const e_Stage stage)
+{
+    assert(stage < NUM_STAGES);
+    return STAGE_INPUTS[stage];
+}
+
+
+const unsigned int AtmospherePrecompute::getComputedStages() const
+{
+    return m_stages;
+}
+
+
+const AtmospherePrecompute::t_preTexCfg &AtmospherePrecompute::getComputedTextureConfig() const
+{
+    return m_computedPreTexCfg;
+}
+
+const AtmospherePrecompute::t_modelCfg &AtmospherePrecompute::getComputedModelConfig() const
+{
+    return m_computeModelCfg;
+}
+
+
+const bool AtmospherePrecompute::isStageRequired(const e_Stage stage) const
+{
+    return 0 != (m_stages & 1 << stage);
+}
+
+
+const unsigned int AtmospherePrecompute::changedParameters(
+    const t_modelCfg &a
+,   const t_modelCfg &b)
+{
+    unsigned int parameters = 0;
+
+    if(a.avgGroundReflectance != b.avgGroundReflectance)
+        parameters |= MP_AvgGroundReflectance;
+    if(a.HR != b.HR)
+        parameters |= MP_HR;
+    if(a.betaR != b.betaR)
+        parameters |= MP_BetaR;
+    if(a.HM != b.HM)
+        parameters |= MP_HM;
+    if(a.betaMSca != b.betaMSca)
+        parameters |= MP_BetaMSca;
+    if(a.betaMEx != b.betaMEx)
+        parameters |= MP_BetaMEx;
+    if(a.mieG != b.mieG)
+        parameters |= MP_MieG;
+
+    return parameters;
+}
+
+
+const unsigned int AtmospherePrecompute::requiredStages() const
+{
+    unsigned int stages = 0;
+
+    // stages reading a parameter changed since their last compute or the 
+    // result of a rerun stage (stages are ordered, so inputs are decided
+    // first), and multiple scattering if the tables are not up to date
+
+    for(int i = 0; i < NUM_STAGES; ++i)
+    {
+        const bool valid = 0 != (m_validStages & 1 << i);
+        const unsigned int parameters = changedParameters(m_modelCfg, m_stageModelCfgs[i]);
+
+        if((valid && (STAGE_PARAMETERS[i] & parameters)) || (STAGE_INPUTS[i] & stages)
+        || (!valid && S_MultipleScattering == i))
+            stages |= 1 << i;
+    }
+
+    // inputs of rerun stages that have no retained results
+
+    for(int i = NUM_STAGES - 1; i >= 0; --i)
+    {
+        if(stages & 1 << i)
+            stages |= STAGE_INPUTS[i] & ~m_validStages;
+    }
+    return stages;
+}
+
+
+void AtmospherePrecompute::setCacheDirectory(const std::string &directory)
+{
+    m_cacheDirectory = directory;
+}
+
+const std::string &AtmospherePrecompute::getCacheDirectory() const
+{
+    return m_cacheDirectory;
+}
+
+const std::string AtmospherePrecompute::getCacheFilePath() const
+{
+    if(m_cacheDirectory.empty())
+        return std::string();
+
+    return AtmosphereCache(m_cacheDirectory).filePath(m_preTexCfg, m_modelCfg);
+}
+
+
+const bool AtmospherePrecompute::loadFromCache()
+{
+    if(m_cacheDirectory.empty())
+        return false;
+
+    osg::Timer_t t = osg::Timer::instance()->tick();
+
+    const AtmosphereCache cache(m_cacheDirectory);
+
+    MemoryMappedFile *file = cache.load(m_preTexCfg, m_modelCfg
+        , m_transmittanceImage, m_irradianceImage, m_inscatterImage);
+
+    if(!file)
+        return false;
 
-    osg::Camera *camera = view->getCamera();
-    camera->setGraphicsContext(gc);
-    camera->setClearColor(osg::Vec4f(0.f, 0.f, 0.f, 0.f));
-    camera->setViewport(0, 0, 1, 1);
+    // release the previous mapping only after the images refer to the new one
+    m_cacheFile = file;
 
-    osg::Group *group(new osg::Group);
-    view->setSceneData(group);
+    // retained single scattering results belong to the previous config
 
-    osg::Geode *quad = genQuad();
+    m_stages = 0;
+    m_validStages = 0;
+    m_order = NUM_ORDERS;
 
-    osg::ref_ptr<osg::Uniform> u_common = Himmel::cmnUniform();
-    group->getOrCreateStateSet()->addUniform(u_common);
+    m_computeModelCfg = m_modelCfg;
 
+    completeStage(S_Transmittance);
+    completeStage(S_MultipleScattering);
+
+    m_computedPreTexCfg = m_preTexCfg;
+
+    OSG_NOTICE << "Atmosphere loaded from cache (took " 
+        << osg::Timer::instance()->delta_s(t,  osg::Timer::instance()->tick()) << " s)" << std::endl;
+
+    return true;
+}
+
+
+void AtmospherePrecompute::storeToCache()
+{
+    if(m_cacheDirectory.empty())
+        return;
+
+    const AtmosphereCache cache(m_cacheDirectory);
+
+    if(!cache.store(m_preTexCfg, m_computeModelCfg
+        , m_transmittanceImage, m_irradianceImage, m_inscatterImage))
+        OSG_WARN << "Atmosphere tables could not be cached in " << m_cacheDirectory << std::endl;
+}
 
-    // Render
+
+const bool AtmospherePrecompute::beginTables()
+{
+    // programs and targets depend on the texture config
+    if(m_viewer.valid() && memcmp(&m_preTexCfg, &m_pipelineTexCfg, sizeof(t_preTexCfg)) != 0)
+        releasePipeline();
+
+    if(!m_viewer.valid())
+    {
+        // Setup Viewer
+
+        m_viewer = new osgViewer::CompositeViewer;
+        osgViewer::View *view = new osgViewer::View();
+
+        m_viewer->addView(view);
+
+        // Setup Context and Camera
+
+        osg::GraphicsContext *gc(setupContext());
+
+        if(!gc || !gc->valid())
+        {
+            OSG_FATAL << "Initialize PBuffer graphics context failed" << std::endl;
+
+            m_viewer = NULL;
+
+            return false;
+        }
+
+
+        osg::Camera *camera = view->getCamera();
+        camera->setGraphicsContext(gc);
+        camera->setClearColor(osg::Vec4f(0.f, 0.f, 0.f, 0.f));
+        camera->setViewport(0, 0, 1, 1);
+
+        osg::Group *group(new osg::Group);
+        view->setSceneData(group);
+
+        m_quad = genQuad();
+
+        osg::ref_ptr<osg::Uniform> u_common = Himmel::cmnUniform();
+        group->getOrCreateStateSet()->addUniform(u_common);
+
+        m_pipelineTexCfg = m_preTexCfg;
+    }
+
+    osg::Group *root(dynamic_cast<osg::Group*>(m_viewer->getView(0)->getSceneData()));
+    setupModelUniforms(root->getOrCreateStateSet(), m_computeModelCfg);
+
+    return true;
+}
+
+
+void AtmospherePrecompute::computeTask(const t_task &task)
+{
+    assert(m_viewer.valid());
 
     t_tex2DsByUnit targets2D, samplers2D;
     t_tex3DsByUnit targets3D, samplers3D;
 
     t_uniforms uniforms;
 
+    // Note: skipped stages are read from the retained textures, which 
+    // live as long as the context of the pipeline (the transmittance is 
+    // uploaded from its image if sampled by a new context).
+
+    // the second order reads the retained single scattering results
+    osg::Texture2D *deltaE  = task.order == 2 ? m_deltaE1Texture  : m_deltaETexture;
+    osg::Texture3D *deltaSR = task.order == 2 ? m_deltaSR1Texture : m_deltaSRTexture;
+
+    const float first = task.order == 2 ? 1.f : 0.f;
+
+    switch(task.pass)
+    {
     // computes transmittance texture T (line 1 in algorithm 4.1)
-        
-    targets2D[0]  = m_transmittanceTexture;
 
-    render2D(viewer, quad, targets2D, samplers2D, samplers3D, uniforms, glsl_bruneton_f_transmittance().c_str());
+    case P_Transmittance:
+
+        targets2D[0]  = m_transmittanceTexture;
+
+        render2D(task.pass, targets2D, samplers2D, samplers3D, uniforms, glsl_bruneton_f_transmittance().c_str());
+        break;
 
     // computes irradiance texture deltaE (line 2 in algorithm 4.1)
 
-    targets2D[0]  = m_deltaETexture;
-    samplers2D[0] = m_transmittanceTexture;
+    case P_Irradiance1:
+
+        targets2D[0]  = m_deltaE1Texture;
+        samplers2D[0] = m_transmittanceTexture;
 
-    render2D(viewer, quad, targets2D, samplers2D, samplers3D, uniforms, glsl_bruneton_f_irradiance1().c_str());
+        render2D(task.pass, targets2D, samplers2D, samplers3D, uniforms, glsl_bruneton_f_irradiance1().c_str());
+        break;
 
     // computes single scattering texture deltaS (line 3 in algorithm 4.1)
 
-    targets3D[0]  = m_deltaSRTexture;
-    targets3D[1]  = m_deltaSMTexture;
-    samplers2D[0] = m_transmittanceTexture;
+    case P_Inscatter1:
 
-    render3D(viewer, quad, targets3D, samplers2D, samplers3D, uniforms, glsl_bruneton_f_inscatter1().c_str());
+        targets3D[0]  = m_deltaSR1Texture;
+        targets3D[1]  = m_deltaSMTexture;
+        samplers2D[0] = m_transmittanceTexture;
+
+        render3D(task.pass, targets3D, samplers2D, samplers3D, uniforms, glsl_bruneton_f_inscatter1().c_str(), task.begin, task.end);
+        break;
+
+    // zeroes irradiance texture E (line 4 in algorithm 4.1, k = 0), since E
+    // excludes the direct sun light (as in CpuAtmospherePrecompute)
+    // adds deltaE into irradiance texture E (line 10 in algorithm 4.1, k = 1)
 
-    // copies deltaE into irradiance texture E (line 4 in algorithm 4.1)
+    case P_CopyIrradiance:
 
-    // THIS PATH SEEMS UNREQUIRED - since k = 0 nothing gets copied? At least it would zero the texture...
+        targets2D[0]  = m_irradianceTexture;
+        samplers2D[0] = task.order == 1 ? m_deltaE1Texture : m_deltaETexture;
+
+        if(task.order > 1)
+            samplers2D[1] = m_irradianceTexture;
 
-    targets2D[0]  = m_irradianceTexture;
-    samplers2D[0] = m_deltaETexture;
-    uniforms.push_back(new osg::Uniform("k", 0.f));
+        uniforms.push_back(new osg::Uniform("k", task.order == 1 ? 0.f : 1.f));
 
-    render2D(viewer, quad, targets2D, samplers2D, samplers3D, uniforms, glsl_bruneton_f_copyIrradiance().c_str());
+        render2D(task.pass, targets2D, samplers2D, samplers3D, uniforms, glsl_bruneton_f_copyIrradiance().c_str());
+        break;
 
     // copies deltaS into inscatter texture S (line 5 in algorithm 4.1)
 
-    targets3D[0]  = m_inscatterTexture;
-    samplers3D[0] = m_deltaSRTexture;
-    samplers3D[1] = m_deltaSMTexture;
+    case P_CopyInscatter1:
+
+        targets3D[0]  = m_inscatterTexture;
+        samplers3D[0] = m_deltaSR1Texture;
+        samplers3D[1] = m_deltaSMTexture;
 
-    render3D(viewer, quad, targets3D, samplers2D, samplers3D, uniforms, glsl_bruneton_f_copyInscatter1().c_str());
-     
-    // loop for each scattering order (line 6 in algorithm 4.1)
+        render3D(task.pass, targets3D, samplers2D, samplers3D, uniforms, glsl_bruneton_f_copyInscatter1().c_str(), task.begin, task.end);
+        break;
 
-    for(int order = 2; order <= 4; ++order)
-    {
-        const float first = order == 2 ? 1.f : 0.f;
+    // computes deltaJ (line 7 in algorithm 4.1)
 
-        //// computes deltaJ (line 7 in algorithm 4.1)
+    case P_InscatterS:
 
         targets3D[0]  = m_deltaJTexture;
         samplers2D[0] = m_transmittanceTexture;
-        samplers2D[1] = m_deltaETexture;
-        samplers3D[2] = m_deltaSRTexture;
+        samplers2D[1] = deltaE;
+        samplers3D[2] = deltaSR;
         samplers3D[3] = m_deltaSMTexture;
         uniforms.push_back(new osg::Uniform("first", first));
 
-        render3D(viewer, quad, targets3D, samplers2D, samplers3D, uniforms, glsl_bruneton_f_inscatterS().c_str());
+        render3D(task.pass, targets3D, samplers2D, samplers3D, uniforms, glsl_bruneton_f_inscatterS().c_str(), task.begin, task.end);
+        break;
+
+    // computes deltaE (line 8 in algorithm 4.1)
 
-        // computes deltaE (line 8 in algorithm 4.1)
+    case P_IrradianceN:
 
         targets2D[0]  = m_deltaETexture;
         samplers2D[0] = m_transmittanceTexture;
-        samplers3D[1] = m_deltaSRTexture;
+        samplers3D[1] = deltaSR;
         samplers3D[2] = m_deltaSMTexture;
         uniforms.push_back(new osg::Uniform("first", first));
 
-        render2D(viewer, quad, targets2D, samplers2D, samplers3D, uniforms, glsl_bruneton_f_irradianceN().c_str());
+        render2D(task.pass, targets2D, samplers2D, samplers3D, uniforms, glsl_bruneton_f_irradianceN().c_str());
+        break;
 
-        // computes deltaS (line 9 in algorithm 4.1)
+    // computes deltaS (line 9 in algorithm 4.1)
+
+    case P_InscatterN:
 
         targets3D[0]  = m_deltaSRTexture;
         samplers2D[0] = m_transmittanceTexture;
         samplers3D[1] = m_deltaJTexture;
         uniforms.push_back(new osg::Uniform("first", first));
 
-        render3D(viewer, quad, targets3D, samplers2D, samplers3D, uniforms, glsl_bruneton_f_inscatterN().c_str());
-
-
-        // NOTE: http://www.opengl.org/wiki/GLSL_:_common_mistakes#Sampling_and_Rendering_to_the_Same_Texture
+        render3D(task.pass, targets3D, samplers2D, samplers3D, uniforms, glsl_bruneton_f_inscatterN().c_str(), task.begin, task.end);
+        break;
 
-        // adds deltaE into irradiance texture E (line 10 in algorithm 4.1)
+    // NOTE: http://www.opengl.org/wiki/GLSL_:_common_mistakes#Sampling_and_Rendering_to_the_Same_Texture
 
-        targets2D[0]  = m_irradianceTexture;
-        samplers2D[0] = m_deltaETexture;
-        samplers2D[1] = m_irradianceTexture;
-        uniforms.push_back(new osg::Uniform("k", 1.f));
+    // adds deltaS into inscatter texture S (line 11 in algorithm 4.1)
 
-        render2D(viewer, quad, targets2D, samplers2D, samplers3D, uniforms, glsl_bruneton_f_copyIrradiance().c_str());
+    case P_CopyInscatterN:
 
-        // adds deltaS into inscatter texture S (line 11 in algorithm 4.1)
-      
         targets3D[0]  = m_inscatterTexture;
         samplers3D[0] = m_deltaSRTexture;
         samplers3D[1] = m_inscatterTexture;
 
-        render3D(viewer, quad, targets3D, samplers2D, samplers3D, uniforms, glsl_bruneton_f_copyInscatterN().c_str());
+        render3D(task.pass, targets3D, samplers2D, samplers3D, uniforms, glsl_bruneton_f_copyInscatterN().c_str(), task.begin, task.end);
+        break;
+
+    default:
+        assert(false);
     }
+}
+
+
+void AtmospherePrecompute::endTables()
+{
+    // the pipeline is retained for subsequent computes
+}
+
+
+void AtmospherePrecompute::releasePipeline()
+{
+    abortCompute();
+
+    for(int i = 0; i < NUM_PASSES; ++i)
+        m_pipelines[i] = t_pipeline();
+
+    m_quad = NULL;
+
+    // the single scattering results are texture only targets, i.e., are
+    // retained by the context only (transmittance and the tables are read 
+    // back, and are uploaded again if sampled)
+
+    if(m_viewer.valid())
+        m_validStages &= ~(1 << S_Irradiance1 | 1 << S_Inscatter1);
 
     // Unref
 
-    delete viewer;
+    m_viewer = NULL;
+}
 
-    OSG_NOTICE << "Atmopshere Precomputed (took " 
-        << osg::Timer::instance()->delta_s(t,  osg::Timer::instance()->tick()) << " s)" << std::endl;
 
-    return true;
+const float AtmospherePrecompute::setIntegralTolerance(const float tolerance)
+{
+    const float t = _ma(0.f, tolerance);
+
+    if(t != m_preTexCfg.integralTolerance)
+    {
+        m_preTexCfg.integralTolerance = t;
+        dirty();
+    }
+    return getIntegralTolerance();
+}
+
+const float AtmospherePrecompute::getIntegralTolerance() const
+{
+    return m_preTexCfg.integralTolerance;
 }
 
 
@@ -296,11 +928,23 @@ osg::Texture2D *AtmospherePrecompute::getDeltaETexture()
     return setupTexture2D("deltaE", GL_RGB16F_ARB, GL_RGB, GL_FLOAT
         , getTextureConfig().skyWidth, getTextureConfig().skyHeight);
 }
+osg::Texture2D *AtmospherePrecompute::getDeltaE1Texture()
+{
+    // same sampler identifier as deltaE (read instead of deltaE for the second order)
+    return setupTexture2D("deltaE", GL_RGB16F_ARB, GL_RGB, GL_FLOAT
+        , getTextureConfig().skyWidth, getTextureConfig().skyHeight);
+}
 osg::Texture3D *AtmospherePrecompute::getDeltaSRTexture()
 {
     return setupTexture3D("deltaSR", GL_RGB16F_ARB, GL_RGB, GL_FLOAT
         , getTextureConfig().resMuS * getTextureConfig().resNu, getTextureConfig().resMu, getTextureConfig().resR);
 }
+osg::Texture3D *AtmospherePrecompute::getDeltaSR1Texture()
+{
+    // same sampler identifier as deltaSR (read instead of deltaSR for the second order)
+    return setupTexture3D("deltaSR", GL_RGB16F_ARB, GL_RGB, GL_FLOAT
+        , getTextureConfig().resMuS * getTextureConfig().resNu, getTextureConfig().resMu, getTextureConfig().resR);
+}
 osg::Texture3D *AtmospherePrecompute::getDeltaSMTexture()
 {
     return setupTexture3D("deltaSM", GL_RGB16F_ARB, GL_RGB, GL_FLOAT
@@ -500,8 +1144,11 @@ osg::Program *AtmospherePrecompute::setupProgram(
 
     if(!fragmentShaderSource.empty())
     {
-        std::string source(fragmentShaderSource);
-        substituteMacros(source);
+        // model parameters are uniforms (see setupModelUniforms), so 
+        // that the program can be reused for all model configs
+
+        std::string source(std::string() + ENABLE_IF(modelUniforms, true) + fragmentShaderSource);
+        substituteMacros(source, m_computeModelCfg);
         program->addShader(new osg::Shader(osg::Shader::FRAGMENT, source));
     }
 
@@ -527,17 +1174,69 @@ osg::Camera *AtmospherePrecompute::setupCamera(
 }
 
 
-osg::Group *AtmospherePrecompute::setupGroup(
-    osgViewer::CompositeViewer *viewer)
+AtmospherePrecompute::t_pipeline &AtmospherePrecompute::setupPipeline(
+    const e_Pass pass
+,   const char *fragmentShaderSource)
+{
+    assert(pass < NUM_PASSES);
+    t_pipeline &pipeline(m_pipelines[pass]);
+
+    if(pipeline.group.valid())
+        return pipeline;
+
+    pipeline.group = new osg::Group;
+
+    osg::Program *program(setupProgram(fragmentShaderSource));
+    pipeline.group->getOrCreateStateSet()->setAttributeAndModes(program);
+
+    return pipeline;
+}
+
+
+void AtmospherePrecompute::renderPipeline(t_pipeline &pipeline)
 {
-    osg::Group *root(dynamic_cast<osg::Group*>(viewer->getView(0)->getSceneData()));
+    osg::Group *root(dynamic_cast<osg::Group*>(m_viewer->getView(0)->getSceneData()));
         
     assert(root->getNumChildren() == 0);
+    root->addChild(pipeline.group.get());
+
+    m_viewer->frame(); // Render single frame
+
+    root->removeChildren(0, root->getNumChildren());
+    assert(root->getNumChildren() == 0);
+}
+
+
+namespace
+{
+    template<typename T>
+    void setUniform(
+        osg::StateSet *stateSet
+    ,   const char *name
+    ,   const T &value)
+    {
+        if(stateSet->getUniform(name))
+            stateSet->getUniform(name)->set(value);
+        else
+            stateSet->addUniform(new osg::Uniform(name, value));
+    }
+}
+
+void AtmospherePrecompute::setupModelUniforms(
+    osg::StateSet *stateSet
+,   const t_modelCfg &modelCfg)
+{
+    // (see glsl_bruneton_const_avgReflectance, _R, and _M)
+
+    setUniform(stateSet, "AVERAGE_GROUND_REFLECTANCE", modelCfg.avgGroundReflectance);
 
-    osg::ref_ptr<osg::Group> group(new osg::Group);
-    root->addChild(group.get());
+    setUniform(stateSet, "HR", modelCfg.HR);
+    setUniform(stateSet, "betaR", modelCfg.betaR);
 
-    return group;
+    setUniform(stateSet, "HM", modelCfg.HM);
+    setUniform(stateSet, "betaMSca", modelCfg.betaMSca);
+    setUniform(stateSet, "betaMEx", modelCfg.betaMEx);
+    setUniform(stateSet, "mieG", modelCfg.mieG);
 }
 
 
@@ -567,15 +1266,6 @@ void AtmospherePrecompute::dirtyTargets(t_tex3DsByUnit &targets3D)
 }
 
 
-void AtmospherePrecompute::cleanUp(
-    osgViewer::CompositeViewer *viewer)
-{
-    osg::Group *root(dynamic_cast<osg::Group*>(viewer->getView(0)->getSceneData()));
-    root->removeChildren(0, root->getNumChildren());
-    assert(root->getNumChildren() == 0);
-}
-
-
 void AtmospherePrecompute::assignUniforms(
     osg::StateSet *stateSet
 ,   t_uniforms &uniforms)
@@ -596,6 +1286,21 @@ void AtmospherePrecompute::assignSamplers(
 ,   t_tex2DsByUnit &samplers2D
 ,   t_tex3DsByUnit &samplers3D)
 {
+    // the state set of a pass is retained, so the samplers of its former
+    // tasks (e.g., the irradiance of higher orders) are released first
+
+    const unsigned int units(static_cast<unsigned int>(stateSet->getTextureAttributeList().size()));
+
+    for(unsigned int unit = 0; unit < units; ++unit)
+    {
+        const osg::StateAttribute *texture(stateSet->getTextureAttribute(unit, osg::StateAttribute::TEXTURE));
+        if(!texture)
+            continue;
+
+        stateSet->removeUniform(texture->getName() + "Sampler");
+        stateSet->removeTextureAttribute(unit, osg::StateAttribute::TEXTURE);
+    }
+
     t_tex2DsByUnit::const_iterator i2;
     const t_tex2DsByUnit::const_iterator s2End = samplers2D.end();
 
@@ -628,8 +1333,7 @@ void AtmospherePrecompute::assignSamplers(
 // it is required that all targets have the same dimensions.
     
 void AtmospherePrecompute::render2D(
-    osgViewer::CompositeViewer *viewer
-,   osg::Geode *geode
+    const e_Pass pass
 ,   t_tex2DsByUnit &targets2D
 ,   t_tex2DsByUnit &samplers2D
 ,   t_tex3DsByUnit &samplers3D
@@ -645,43 +1349,52 @@ void AtmospherePrecompute::render2D(
     const int width  = i2->second->getTextureWidth();
     const int height = i2->second->getTextureHeight();
 
+    std::vector<const unsigned char*> data;
+
     for(i2 = targets2D.begin(); i2 != t2End; ++i2)
     {
         assert(i2->second->getTextureWidth()  == width);
         assert(i2->second->getTextureHeight() == height);
+
+        data.push_back(i2->second->getImage() ? i2->second->getImage()->data() : NULL);
     }
         
     // Setup graph
 
-    osg::Group *group = setupGroup(viewer);
-    osg::Program *program(setupProgram(fragmentShaderSource));
+    t_pipeline &pipeline(setupPipeline(pass, fragmentShaderSource));
 
-    osg::StateSet *ss(group->getOrCreateStateSet());
-    ss->setAttributeAndModes(program);
+    // Setup local camera (again, if the image targets were reallocated)
 
-    assignSamplers(ss, samplers2D, samplers3D);
-    assignUniforms(ss, uniforms);
+    if(pipeline.cameras.empty() || pipeline.data != data)
+    {
+        pipeline.group->removeChildren(0, pipeline.group->getNumChildren());
+        pipeline.cameras.clear();
 
-    // Setup local camera
+        osg::ref_ptr<osg::Camera> camera = setupCamera(width, height, m_quad, 0);
+        pipeline.group->addChild(camera.get());
 
-    osg::ref_ptr<osg::Camera> camera = setupCamera(width, height, geode, 0);
-    group->addChild(camera.get());
-        
+        // Assign Textures and Samplers
 
-    // Assign Textures and Samplers
+        for(i2 = targets2D.begin(); i2 != t2End; ++i2)
+        {
+            if(i2->second->getImage())
+                camera->attach(static_cast<osg::Camera::BufferComponent>(osg::Camera::COLOR_BUFFER0 + i2->first), i2->second->getImage());
+            else
+                camera->attach(static_cast<osg::Camera::BufferComponent>(osg::Camera::COLOR_BUFFER0 + i2->first), i2->second);
+        }
 
-    for(i2 = targets2D.begin(); i2 != t2End; ++i2)
-    {
-        if(i2->second->getImage())
-            camera->attach(static_cast<osg::Camera::BufferComponent>(osg::Camera::COLOR_BUFFER0 + i2->first), i2->second->getImage());
-        else
-            camera->attach(static_cast<osg::Camera::BufferComponent>(osg::Camera::COLOR_BUFFER0 + i2->first), i2->second);
+        pipeline.cameras.push_back(camera);
+        pipeline.data = data;
     }
 
+    osg::StateSet *ss(pipeline.group->getOrCreateStateSet());
+
+    assignSamplers(ss, samplers2D, samplers3D);
+    assignUniforms(ss, uniforms);
+
     //
 
-    viewer->frame(); // Render single frame
-    cleanUp(viewer);
+    renderPipeline(pipeline);
 
     dirtyTargets(targets2D);
     targets2D.clear();
@@ -689,13 +1402,14 @@ void AtmospherePrecompute::render2D(
 
 
 void AtmospherePrecompute::render3D(
-    osgViewer::CompositeViewer *viewer
-,   osg::Geode *geode
+    const e_Pass pass
 ,   t_tex3DsByUnit &targets3D
 ,   t_tex2DsByUnit &samplers2D
 ,   t_tex3DsByUnit &samplers3D
 ,   t_uniforms &uniforms
-,   const char *fragmentShaderSource)
+,   const char *fragmentShaderSource
+,   const int begin
+,   const int end)
 {
     assert(targets3D.size() > 0);
 
@@ -707,51 +1421,67 @@ void AtmospherePrecompute::render3D(
     const int height = i3->second->getTextureHeight();
     const int depth  = i3->second->getTextureDepth();
 
+    std::vector<const unsigned char*> data;
+
     for(i3 = targets3D.begin(); i3 != t3End; ++i3)
     {
         assert(i3->second->getTextureWidth()  == width);
         assert(i3->second->getTextureHeight() == height);
         assert(i3->second->getTextureDepth()  == depth);
-    }
 
-    // Setup graph
+        data.push_back(i3->second->getImage() ? i3->second->getImage()->data() : NULL);
+    }
 
-    osg::Group *group = setupGroup(viewer);
-    osg::Program *program(setupProgram(fragmentShaderSource));
+    assert(begin >= 0 && end <= depth);
 
-    osg::StateSet *ss(group->getOrCreateStateSet());
-    ss->setAttributeAndModes(program);
+    // Setup graph
 
-    assignSamplers(ss, samplers2D, samplers3D);
-    assignUniforms(ss, uniforms);
+    t_pipeline &pipeline(setupPipeline(pass, fragmentShaderSource));
 
-    // 
+    // Setup local cameras (again, if the image targets were reallocated)
 
-    for(int layer = 0; layer < depth; ++layer)
+    if(pipeline.cameras.empty() || pipeline.data != data)
     {
-        // Setup local camera
+        pipeline.group->removeChildren(0, pipeline.group->getNumChildren());
+        pipeline.cameras.clear();
 
-        osg::ref_ptr<osg::Camera> camera = setupCamera(width, height, geode, layer);
-        group->addChild(camera.get());
+        for(int layer = 0; layer < depth; ++layer)
+        {
+            osg::ref_ptr<osg::Camera> camera = setupCamera(width, height, m_quad, layer);
+            pipeline.group->addChild(camera.get());
 
-        setupLayerUniforms(camera->getOrCreateStateSet(), depth, layer);
+            setupLayerUniforms(camera->getOrCreateStateSet(), depth, layer);
 
-        // Assign Textures and Samplers
+            // Assign Textures and Samplers
 
-        for(i3 = targets3D.begin(); i3 != t3End; ++i3)
-        {
-            if(i3->second->getImage())
+            for(i3 = targets3D.begin(); i3 != t3End; ++i3)
             {
-                // workaround: use a slice here instead of the whole image, since osg does not support this directly...
-                osg::Image *slice = getLayerFrom3DImage(i3->second->getImage(), layer);
-                camera->attach(static_cast<osg::Camera::BufferComponent>(osg::Camera::COLOR_BUFFER0 + i3->first), slice);
+                if(i3->second->getImage())
+                {
+                    // workaround: use a slice here instead of the whole image, since osg does not support this directly...
+                    osg::Image *slice = getLayerFrom3DImage(i3->second->getImage(), layer);
+                    camera->attach(static_cast<osg::Camera::BufferComponent>(osg::Camera::COLOR_BUFFER0 + i3->first), slice);
+                }
+                else
+                    camera->attach(static_cast<osg::Camera::BufferComponent>(osg::Camera::COLOR_BUFFER0 + i3->first), i3->second, 0U, layer);
             }
-            else
-                camera->attach(static_cast<osg::Camera::BufferComponent>(osg::Camera::COLOR_BUFFER0 + i3->first), i3->second, 0U, layer);
+
+            pipeline.cameras.push_back(camera);
         }
+        pipeline.data = data;
     }
-    viewer->frame(); // Render single frame
-    cleanUp(viewer);
+
+    osg::StateSet *ss(pipeline.group->getOrCreateStateSet());
+
+    assignSamplers(ss, samplers2D, samplers3D);
+    assignUniforms(ss, uniforms);
+
+    // render the requested layers only
+
+    for(int layer = 0; layer < depth; ++layer)
+        pipeline.cameras[layer]->setNodeMask(layer >= begin && layer < end ? ~0u : 0u);
+
+    renderPipeline(pipeline);
 
     dirtyTargets(targets3D);
     targets3D.clear();
@@ -759,6 +1489,14 @@ void AtmospherePrecompute::render3D(
 
 
 void AtmospherePrecompute::substituteMacros(std::string &source)
+{
+    substituteMacros(source, getModelConfig());
+}
+
+
+void AtmospherePrecompute::substituteMacros(
+    std::string &source
+,   const t_modelCfg &modelCfg)
 {
     // Replace Precomputed Texture Config "MACROS"
 
@@ -779,10 +1517,11 @@ void AtmospherePrecompute::substituteMacros(std::string &source)
     replace(source, "%INSCATTER_INTEGRAL_SAMPLES%", tc.inscatterIntegralSamples);
     replace(source, "%IRRADIANCE_INTEGRAL_SAMPLES%", tc.irradianceIntegralSamples);
     replace(source, "%INSCATTER_SPHERICAL_INTEGRAL_SAMPLES%", tc.inscatterSphericalIntegralSamples);
+    replace(source, "%INTEGRAL_TOLERANCE%", tc.integralTolerance);
 
     // Replace Physical Model Config "MACROS"
 
-    const t_modelCfg &mc(getModelConfig());
+    const t_modelCfg &mc(modelCfg);
 
     replace(source, "%AVERAGE_GROUND_REFLECTANCE%", mc.avgGroundReflectance);
 
@@ -0,0 +1,359 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+// The queries mirror the inscatter and sunColor functions of the
+// AtmosphereGeode fragment shader and should be kept in sync.
+
+
+#include "atmospherequery.h"
+
+#include "atmosphereprecompute.h"
+#include "mathmacros.h"
+
+#include <osg/Image>
+
+#include <assert.h>
+#include <math.h>
+#include <cstring>
+
+
+namespace osgHimmel
+{
+
+namespace
+{
+    const float ISUN(100.f);
+
+    // ground clearance of the observer (see Himmel::setAltitude)
+    const float MIN_ALTITUDE(0.001f);
+
+    inline const float smoothstep(
+        const float edge0
+    ,   const float edge1
+    ,   const float x)
+    {
+        const float t = _clamp(0.f, 1.f, (x - edge0) / (edge1 - edge0));
+        return t * t * (3.f - 2.f * t);
+    }
+
+    inline const osg::Vec4f max0(const osg::Vec4f &v)
+    {
+        return osg::Vec4f(_ma(v[0], 0.f), _ma(v[1], 0.f), _ma(v[2], 0.f), _ma(v[3], 0.f));
+    }
+
+    osg::Image *copyImage(const osg::Image *image)
+    {
+        if(!image || !image->data())
+            return NULL;
+
+        osg::Image *copy(new osg::Image);
+        copy->allocateImage(image->s(), image->t(), image->r()
+            , image->getPixelFormat(), image->getDataType());
+
+        memcpy(copy->data(), image->data(), image->getTotalSizeInBytes());
+        return copy;
+    }
+
+    const AtmosphereModel::t_table table(osg::Image *image)
+    {
+        if(!image || !image->data() || GL_FLOAT != image->getDataType())
+            return AtmosphereModel::t_table();
+
+        return AtmosphereModel::t_table(reinterpret_cast<float*>(image->data())
+            , image->s(), image->t(), image->r()
+            , osg::Image::computeNumComponents(image->getPixelFormat()));
+    }
+
+    // Terms of an observer that are shared by all directions.
+
+    typedef struct Observer
+    {
+        Observer(
+            const AtmosphereModel &model
+        ,   const float altitude
+        ,   const osg::Vec3f &sun)
+        :   r(model.Rg() + _ma(altitude, MIN_ALTITUDE))
+        ,   rr(r * r)
+        ,   Rg2(model.Rg() * model.Rg())
+        ,   Rt2(model.Rt() * model.Rt())
+        ,   muS(sun[2])
+        {
+        }
+
+        const float r;
+        const float rr;
+
+        const float Rg2;
+        const float Rt2;
+
+        const float muS; // of the sun at the observer
+
+    } t_observer;
+
+
+    // S[L]-T(x,x0)S[L]|x0 along v, when sun in direction s (x at zenith)
+
+    const osg::Vec3f skyRadiance(
+        const AtmosphereModel &model
+    ,   const AtmosphereModel::t_table &transmittance
+    ,   const AtmosphereModel::t_table &inscatter
+    ,   const t_observer &o
+    ,   const osg::Vec3f &v
+    ,   const osg::Vec3f &s)
+    {
+        osg::Vec3f x(0.f, 0.f, o.r);
+
+        float r   = o.r;
+        float mu  = v[2];
+        float muS = o.muS;
+
+        // distance to the ground (negative if not intersecting)
+
+        const float deltaG = o.rr * (mu * mu - 1.f) + o.Rg2;
+        float t = deltaG >= 0.f ? -r * mu - sqrt(deltaG) : -1.f;
+
+        if(r > model.Rt())
+        {
+            // move x to nearest intersection of ray with top atmosphere boundary
+
+            const float deltaT = o.rr * (mu * mu - 1.f) + o.Rt2;
+            if(deltaT < 0.f)
+                return osg::Vec3f();
+
+            const float d = -r * mu - sqrt(deltaT);
+            if(d <= 0.f)
+                return osg::Vec3f();
+
+            x += v * d;
+            t -= d;
+            mu = (r * mu + d) / model.Rt();
+            r = model.Rt();
+
+            muS = (x * s) / r;
+        }
+
+        const float nu = v * s;
+
+        const float phaseR = model.phaseFunctionR(nu);
+        const float phaseM = model.phaseFunctionM(nu);
+
+        osg::Vec4f S(max0(model.texture4D(inscatter, r, mu, muS, nu)));
+
+        if(t > 0.f)
+        {
+            const osg::Vec3f x0(x + v * t);
+
+            const float r0   = x0.length();
+            const float mu0  = (x0 * v) / r0;
+            const float muS0 = (x0 * s) / r0;
+
+            if(r0 > model.Rg() + 0.01f)
+            {
+                const osg::Vec3f a(model.transmittance(transmittance, r, mu, t));
+                const osg::Vec4f S0(model.texture4D(inscatter, r0, mu0, muS0, nu));
+
+                S = max0(S - osg::Vec4f(a[0] * S0[0], a[1] * S0[1], a[2] * S0[2], a[0] * S0[3]));
+            }
+        }
+
+        // avoids imprecision problems in Mie scattering when sun is below horizon
+        S[3] *= smoothstep(0.f, 0.02f, muS);
+
+        const osg::Vec3f mie(model.mie(S));
+
+        return osg::Vec3f(
+            _ma(0.f, S[0] * phaseR + mie[0] * phaseM)
+        ,   _ma(0.f, S[1] * phaseR + mie[1] * phaseM)
+        ,   _ma(0.f, S[2] * phaseR + mie[2] * phaseM)) * ISUN;
+    }
+}
+
+
+AtmosphereQuery::AtmosphereQuery()
+:   m_model(NULL)
+,   m_revision(0)
+{
+}
+
+
+AtmosphereQuery::~AtmosphereQuery()
+{
+    delete m_model;
+}
+
+
+const bool AtmosphereQuery::update(AtmospherePrecompute *precompute)
+{
+    assert(precompute);
+
+    return update(precompute->getComputedTextureConfig(), precompute->getComputedModelConfig()
+        , precompute->getTransmittanceImage(), precompute->getIrradianceImage(), precompute->getInscatterImage());
+}
+
+
+const bool AtmosphereQuery::update(
+    const t_preTexCfg &preTexCfg
+,   const t_modelCfg &modelCfg
+,   osg::Image *transmittance
+,   osg::Image *irradiance
+,   osg::Image *inscatter)
+{
+    delete m_model;
+    m_model = NULL;
+
+    ++m_revision;
+
+    // retain the images, since the tables refer to their data
+
+    m_transmittanceImage = transmittance;
+    m_irradianceImage = irradiance;
+    m_inscatterImage = inscatter;
+
+    m_transmittance = table(transmittance);
+    m_irradiance = table(irradiance);
+    m_inscatter = table(inscatter);
+
+    if(!m_transmittance.data || !m_irradiance.data || !m_inscatter.data || m_inscatter.components != 4)
+        return false;
+
+    m_model = new AtmosphereModel(preTexCfg, modelCfg);
+    return true;
+}
+
+
+const bool AtmosphereQuery::copy(const AtmosphereQuery &query)
+{
+    if(!query.m_model)
+        return update(t_preTexCfg(), t_modelCfg(), NULL, NULL, NULL);
+
+    return update(query.m_model->preTexCfg(), query.m_model->modelCfg()
+        , copyImage(query.m_transmittanceImage.get())
+        , copyImage(query.m_irradianceImage.get())
+        , copyImage(query.m_inscatterImage.get()));
+}
+
+
+const bool AtmosphereQuery::isValid() const
+{
+    return NULL != m_model;
+}
+
+
+const unsigned int AtmosphereQuery::getRevision() const
+{
+    return m_revision;
+}
+
+
+const osg::Vec3f AtmosphereQuery::radiance(
+    const osg::Vec3f &direction
+,   const osg::Vec3f &sun
+,   const float altitude) const
+{
+    if(!m_model)
+        return osg::Vec3f();
+
+    const t_observer o(*m_model, altitude, sun);
+    return skyRadiance(*m_model, m_transmittance, m_inscatter, o, direction, sun);
+}
+
+
+void AtmosphereQuery::radiance(
+    const osg::Vec3f *directions
+,   osg::Vec3f *radiances
+,   const unsigned int count
+,   const osg::Vec3f &sun
+,   const float altitude) const
+{
+    if(!m_model)
+    {
+        for(unsigned int i = 0; i < count; ++i)
+            radiances[i] = osg::Vec3f();
+        return;
+    }
+
+    const t_observer o(*m_model, altitude, sun);
+
+    for(unsigned int i = 0; i < count; ++i)
+        radiances[i] = skyRadiance(*m_model, m_transmittance, m_inscatter, o, directions[i], sun);
+}
+
+
+const osg::Vec3f AtmosphereQuery::sunTransmittance(
+    const float altitude
+,   const osg::Vec3f &sun) const
+{
+    osg::Vec3f transmittance;
+    sunTransmittance(&altitude, &transmittance, 1, sun);
+
+    return transmittance;
+}
+
+
+void AtmosphereQuery::sunTransmittance(
+    const float *altitudes
+,   osg::Vec3f *transmittances
+,   const unsigned int count
+,   const osg::Vec3f &sun) const
+{
+    if(!m_model)
+    {
+        for(unsigned int i = 0; i < count; ++i)
+            transmittances[i] = osg::Vec3f();
+        return;
+    }
+
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        const float r = m_model->Rg() + _ma(altitudes[i], MIN_ALTITUDE);
+
+        transmittances[i] = r <= m_model->Rt() ?
+            m_model->transmittanceWithShadow(m_transmittance, r, sun[2]) : osg::Vec3f(1.f, 1.f, 1.f);
+    }
+}
+
+
+const osg::Vec3f AtmosphereQuery::irradiance(
+    const float altitude
+,   const osg::Vec3f &sun) const
+{
+    if(!m_model)
+        return osg::Vec3f();
+
+    const float r = m_model->Rg() + _clamp(MIN_ALTITUDE, m_model->Rt() - m_model->Rg(), altitude);
+    return m_model->irradiance(m_irradiance, r, sun[2]) * ISUN;
+}
+
+
+const float AtmosphereQuery::sunIntensity()
+{
+    return ISUN;
+}
+
+} // namespace osgHimmel
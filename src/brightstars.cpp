@@ -29,10 +29,15 @@
 
 #include "brightstars.h"
 
+#include "memorymappedfile.h"
+
 #include <fstream>
 #include <iostream>
 #include <iterator>
 #include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
 
 #include <assert.h>
 
@@ -40,6 +45,39 @@
 namespace
 {
     const unsigned int NUM_BRIGHTSTARS(9093);
+
+    const char MAGIC[4] = { 'O', 'H', 'B', 'S' };
+    const unsigned int VERSION(1);
+
+    // reads as SWAPPED_BYTE_ORDER on machines of the other endianness
+    const unsigned int BYTE_ORDER_MARK(0x01020304);
+    const unsigned int SWAPPED_BYTE_ORDER_MARK(0x04030201);
+
+    const std::size_t ALIGNMENT(64);
+
+    typedef struct FileHeader
+    {
+        char magic[4];
+        unsigned int version;
+        unsigned int byteOrder;
+        unsigned int recordSize; // in bytes per star
+
+        unsigned int numStars;
+        unsigned int offset;     // in bytes from the beginning of the file
+
+    } t_fileHeader;
+
+
+    const std::size_t align(const std::size_t offset)
+    {
+        return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    const unsigned int swapped(const unsigned int value)
+    {
+        return (value >> 24) | ((value >> 8) & 0xff00) 
+            | ((value << 8) & 0xff0000) | (value << 24);
+    }
 }
 
 
@@ -48,6 +86,8 @@ namespace osgHimmel
 
 BrightStars::BrightStars(const char *fileName)
 :   m_stars(NULL)
+,   m_file(NULL)
+,   m_data(NULL)
 ,   m_numStars(0)
 {
     fromFile(fileName);
@@ -55,14 +95,26 @@ BrightStars::BrightStars(const char *fileName)
 
 
 BrightStars::~BrightStars()
+{
+    clear();
+}
+
+
+void BrightStars::clear()
 {
     delete[] m_stars;
+    m_stars = NULL;
+
+    m_file = NULL;
+
+    m_data = NULL;
+    m_numStars = 0;
 }
 
 
 const BrightStars::s_BrightStar *BrightStars::stars() const
 {
-    return m_stars;
+    return m_data;
 }
 
 
@@ -72,37 +124,92 @@ const unsigned int BrightStars::numStars() const
 }
 
 
+const bool BrightStars::isMapped() const
+{
+    return m_file.valid() && NULL != m_data;
+}
+
+
+const unsigned int BrightStars::version()
+{
+    return VERSION;
+}
+
+
 unsigned int BrightStars::fromFile(const char *fileName)
 {
-    if(m_stars)
-        delete[] m_stars;
+    clear();
+
+    osg::ref_ptr<MemoryMappedFile> file(new MemoryMappedFile);
+
+    if(!file->open(fileName))
+        return 0;
+
+    const char *data(file->data());
+    const std::size_t size(file->size());
+
+    if(size < sizeof(t_fileHeader) || memcmp(data, MAGIC, sizeof(MAGIC)) != 0)
+    {
+        // raw star array of former versions
 
-    // Retrieve file size.
+        if(0 != size % sizeof(s_BrightStar))
+            return 0;
 
-    FILE *f;
-#ifdef __GNUC__
-    f = std::fopen(fileName, "r");
-#else // __GNUC__
-    fopen_s(&f, fileName, "r");
-#endif // __GNUC__
+        m_numStars = static_cast<unsigned int>(size / sizeof(s_BrightStar));
+        //assert(NUM_BRIGHTSTARS == numStars);
 
-    if(!f)
+        m_stars = new s_BrightStar[m_numStars];
+        memcpy(m_stars, data, size);
+
+        m_data = m_stars;
+        return m_numStars;
+    }
+
+    t_fileHeader header;
+    memcpy(&header, data, sizeof(t_fileHeader));
+
+    const bool swap(SWAPPED_BYTE_ORDER_MARK == header.byteOrder);
+
+    if(swap)
+    {
+        header.version    = swapped(header.version);
+        header.recordSize = swapped(header.recordSize);
+        header.numStars   = swapped(header.numStars);
+        header.offset     = swapped(header.offset);
+    }
+    else if(BYTE_ORDER_MARK != header.byteOrder)
+        return 0;
+
+    if(header.version != VERSION
+    || header.recordSize != sizeof(s_BrightStar)
+    || header.offset % ALIGNMENT != 0
+    || header.offset > size
+    || (size - header.offset) / sizeof(s_BrightStar) < header.numStars)
         return 0;
-    
-    std::fseek(f, 0, SEEK_END);
-    const long fileSize = std::ftell(f);
 
-    std::fclose(f);
+    const s_BrightStar *stars(reinterpret_cast<const s_BrightStar*>(data + header.offset));
 
+    m_numStars = header.numStars;
 
-    m_numStars = fileSize / sizeof(s_BrightStar);
-    //assert(NUM_BRIGHTSTARS == numStars);
+    if(swap)
+    {
+        // all members are 4 byte floats
+
+        m_stars = new s_BrightStar[m_numStars];
+        memcpy(m_stars, stars, m_numStars * sizeof(s_BrightStar));
 
-    m_stars = new s_BrightStar[m_numStars];
+        unsigned int *words(reinterpret_cast<unsigned int*>(m_stars));
+        const std::size_t numWords(m_numStars * sizeof(s_BrightStar) / sizeof(unsigned int));
 
-    std::ifstream instream(fileName, std::ios::binary);
+        for(std::size_t i = 0; i < numWords; ++i)
+            words[i] = swapped(words[i]);
 
-    instream.read(reinterpret_cast<char*>(m_stars), fileSize);
+        m_data = m_stars;
+        return m_numStars;
+    }
+
+    m_file = file;
+    m_data = stars;
 
     return m_numStars;
 }
@@ -110,19 +217,67 @@ unsigned int BrightStars::fromFile(const char *fileName)
 
 unsigned int BrightStars::toFile(const char *fileName) const
 {
-    std::ofstream outstream(fileName, std::ios::binary);
+    if(!m_data)
+        return 0;
 
-    outstream.write((char*)&m_stars, sizeof(m_stars) * m_numStars);
-    outstream.close();
+    t_fileHeader header = t_fileHeader();
+
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version    = VERSION;
+    header.byteOrder  = BYTE_ORDER_MARK;
+    header.recordSize = sizeof(s_BrightStar);
+    header.numStars   = m_numStars;
+    header.offset     = static_cast<unsigned int>(align(sizeof(t_fileHeader)));
+
+    const std::string path(fileName);
+    const std::string temp(path + ".tmp");
+
+    std::ofstream stream(temp.c_str(), std::ios::binary);
+    if(!stream)
+        return 0;
 
+    const char padding[ALIGNMENT] = { 0 };
+
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(t_fileHeader));
+    stream.write(padding, header.offset - sizeof(t_fileHeader));
+    stream.write(reinterpret_cast<const char*>(m_data), m_numStars * sizeof(s_BrightStar));
+    stream.close();
+
+    if(stream.fail())
+    {
+        std::remove(temp.c_str());
+        return 0;
+    }
+
+    if(!MemoryMappedFile::replace(temp.c_str(), path.c_str()))
+    {
+        std::remove(temp.c_str());
+        return 0;
+    }
     return m_numStars;
 }
 
 
+unsigned int BrightStars::convert(
+    const char *sourceFileName
+,   const char *targetFileName)
+{
+    const BrightStars stars(sourceFileName);
+
+    if(0 == stars.numStars())
+        return 0;
+
+    return stars.toFile(targetFileName);
+}
+
+
 #ifdef BRIGHTSTARS_INCLUDE_CATALOGUE
  
 BrightStars::BrightStars()
-:   m_numStars(NUM_BRIGHTSTARS)
+:   m_stars(NULL)
+,   m_file(NULL)
+,   m_data(NULL)
+,   m_numStars(NUM_BRIGHTSTARS)
 {
     float raw[NUM_BRIGHTSTARS][8] = 
 
@@ -9236,6 +9391,7 @@ BrightStars::BrightStars()
         m_stars[i].sRGB_G = raw[i][6];
         m_stars[i].sRGB_B = raw[i][7];
     }
+    m_data = m_stars;
 }
 
 #endif // BRIGHTSTARS_INCLUDE_CATALOGUE
@@ -0,0 +1,1167 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+// based on Brunetons free code (http://www-evasion.imag.fr/Members/Eric.Bruneton/PrecomputedAtmosphericScattering2.zip)
+
+// Each pass mirrors the main function of the corresponding glsl_bruneton_f_*
+// fragment (see shaderfragment/bruneton_*.cpp) and should be kept in sync.
+
+
+#include "cpuatmosphereprecompute.h"
+
+#include "mathmacros.h"
+
+#include <osg/Image>
+#include <osg/Vec2f>
+
+#include <OpenThreads/Thread>
+#include <OpenThreads/Atomic>
+
+#include <assert.h>
+#include <math.h>
+#include <cstring>
+
+
+namespace osgHimmel
+{
+
+class CpuAtmospherePrecompute::Worker : public OpenThreads::Thread
+{
+public:
+
+    Worker(
+        CpuAtmospherePrecompute &precompute
+    ,   const e_Pass pass
+    ,   const int end
+    ,   OpenThreads::Atomic &next)
+    :   OpenThreads::Thread()
+    ,   m_precompute(precompute)
+    ,   m_pass(pass)
+    ,   m_end(end)
+    ,   m_next(next)
+    {
+    }
+
+    virtual void run()
+    {
+        // fetch slices until all are taken
+        for(int slice = static_cast<int>(++m_next) - 1; slice < m_end; slice = static_cast<int>(++m_next) - 1)
+            m_precompute.computeSlice(m_pass, slice);
+    }
+
+protected:
+
+    CpuAtmospherePrecompute &m_precompute;
+    const e_Pass m_pass;
+    const int m_end;
+
+    OpenThreads::Atomic &m_next;
+};
+
+
+namespace
+{
+    inline const osg::Vec3f exp3(const osg::Vec3f &v)
+    {
+        return osg::Vec3f(exp(v[0]), exp(v[1]), exp(v[2]));
+    }
+
+    inline const osg::Vec3f rgb(const osg::Vec4f &v)
+    {
+        return osg::Vec3f(v[0], v[1], v[2]);
+    }
+
+    inline void store(float *texel, const osg::Vec3f &v)
+    {
+        texel[0] = v[0];
+        texel[1] = v[1];
+        texel[2] = v[2];
+    }
+
+    inline const float clampf(const float v, const float min, const float max)
+    {
+        return v < min ? min : (v > max ? max : v);
+    }
+
+    void allocate(
+        std::vector<float> &data
+    ,   const std::size_t size)
+    {
+        if(data.size() != size)
+            data.assign(size, 0.f);
+    }
+
+
+    // single scattering integrand (glsl_bruneton_f_inscatter1)
+
+    void inscatter1Integrand(
+        const AtmosphereModel &model
+    ,   const AtmosphereModel::t_table &transmittance
+    ,   const float r
+    ,   const float mu
+    ,   const float muS
+    ,   const float nu
+    ,   const float t
+    ,   osg::Vec3f &ray
+    ,   osg::Vec3f &mie)
+    {
+        const float Rg = model.Rg();
+
+        ray = osg::Vec3f();
+        mie = osg::Vec3f();
+
+        float ri = sqrt(r * r + t * t + 2.f * r * mu * t);
+        const float muSi = (nu * t + muS * r) / ri;
+        ri = _ma(Rg, ri);
+
+        if(muSi >= -sqrt(1.f - Rg * Rg / (ri * ri)))
+        {
+            const osg::Vec3f ti = osg::componentMultiply(
+                model.transmittance(transmittance, r, mu, t), model.transmittance(transmittance, ri, muSi));
+
+            ray = ti * exp(-(ri - Rg) / model.modelCfg().HR);
+            mie = ti * exp(-(ri - Rg) / model.modelCfg().HM);
+        }
+    }
+
+
+    // multiple scattering integrand (glsl_bruneton_f_inscatterN)
+
+    const osg::Vec3f inscatterNIntegrand(
+        const AtmosphereModel &model
+    ,   const AtmosphereModel::t_table &transmittance
+    ,   const AtmosphereModel::t_table &deltaJ
+    ,   const float r
+    ,   const float mu
+    ,   const float muS
+    ,   const float nu
+    ,   const float t)
+    {
+        const float ri = sqrt(r * r + t * t + 2.f * r * mu * t);
+        const float mui = (r * mu + t) / ri;
+        const float muSi = (nu * t + muS * r) / ri;
+
+        return osg::componentMultiply(rgb(model.texture4D(deltaJ, ri, mui, muSi, nu))
+            , model.transmittance(transmittance, r, mu, t));
+    }
+
+
+    // adaptive integration (see AtmospherePrecompute::setIntegralTolerance)
+
+    inline const float maxAbs(const osg::Vec3f &v)
+    {
+        return _ma(_ma(fabs(v[0]), fabs(v[1])), fabs(v[2]));
+    }
+
+    // the error of rgb values is relative to the largest channel
+
+    inline const bool converged(
+        const osg::Vec3f &error
+    ,   const osg::Vec3f &estimate
+    ,   const float tolerance)
+    {
+        return maxAbs(error) <= tolerance * maxAbs(estimate);
+    }
+
+    // the error of rayleigh and mie optical depth is relative to each
+
+    inline const bool converged(
+        const osg::Vec2f &error
+    ,   const osg::Vec2f &estimate
+    ,   const float tolerance)
+    {
+        return fabs(error[0]) <= tolerance * fabs(estimate[0])
+            && fabs(error[1]) <= tolerance * fabs(estimate[1]);
+    }
+
+
+    typedef struct RayMie
+    {
+        RayMie()
+        {
+        }
+
+        RayMie(
+            const osg::Vec3f &ray
+        ,   const osg::Vec3f &mie)
+        :   ray(ray)
+        ,   mie(mie)
+        {
+        }
+
+        const RayMie operator+(const RayMie &other) const
+        {
+            return RayMie(ray + other.ray, mie + other.mie);
+        }
+
+        const RayMie operator-(const RayMie &other) const
+        {
+            return RayMie(ray - other.ray, mie - other.mie);
+        }
+
+        const RayMie operator*(const float s) const
+        {
+            return RayMie(ray * s, mie * s);
+        }
+
+        osg::Vec3f ray;
+        osg::Vec3f mie;
+
+    } t_rayMie;
+
+    inline const bool converged(
+        const t_rayMie &error
+    ,   const t_rayMie &estimate
+    ,   const float tolerance)
+    {
+        return converged(error.ray, estimate.ray, tolerance)
+            && converged(error.mie, estimate.mie, tolerance);
+    }
+
+
+    // Trapezoidal rule over [0; length] with a 16th of the samples (as
+    // intervals), doubled until two successive Richardson error estimates
+    // are within tolerance (a single one agrees by chance for peaked 
+    // integrands along the horizon) or the samples are reached. Returns 
+    // the extrapolated result. Mirrors the *Adaptive functions of the 
+    // glsl_bruneton_f_* fragments.
+
+    template<typename T_integrand>
+    const typename T_integrand::t_value integrate(
+        const T_integrand &f
+    ,   const float length
+    ,   const int samples
+    ,   const float tolerance)
+    {
+        typedef typename T_integrand::t_value t_value;
+
+        int n = _ma(2, samples / 16);
+        float h = length / static_cast<float>(n);
+
+        t_value sum = (f(0.f) + f(length)) * 0.5f;
+        for(int i = 1; i < n; ++i)
+            sum = sum + f(i * h);
+
+        t_value coarse = sum * h;
+        t_value result = coarse;
+
+        int convergedEstimates = 0;
+
+        while(2 * n <= samples)
+        {
+            // midpoints of the current intervals
+            for(int i = 0; i < n; ++i)
+                sum = sum + f((i + 0.5f) * h);
+
+            n *= 2;
+            h *= 0.5f;
+
+            const t_value fine = sum * h;
+            const t_value error = (fine - coarse) * (1.f / 3.f);
+
+            result = fine + error;
+
+            if(!converged(error, fine, tolerance))
+                convergedEstimates = 0;
+            else if(++convergedEstimates == 2)
+                break;
+
+            coarse = fine;
+        }
+        return result;
+    }
+
+
+    // rayleigh and mie density (glsl_bruneton_f_transmittance)
+
+    typedef struct DensityIntegrand
+    {
+        typedef osg::Vec2f t_value;
+
+        DensityIntegrand(
+            const AtmosphereModel &model
+        ,   const float r
+        ,   const float mu)
+        :   r(r)
+        ,   mu(mu)
+        ,   Rg(model.Rg())
+        ,   HR(model.modelCfg().HR)
+        ,   HM(model.modelCfg().HM)
+        {
+        }
+
+        const t_value operator()(const float x) const
+        {
+            const float h = sqrt(r * r + x * x + 2.f * x * r * mu) - Rg;
+            return t_value(exp(-h / HR), exp(-h / HM));
+        }
+
+        const float r;
+        const float mu;
+        const float Rg;
+        const float HR;
+        const float HM;
+
+    } t_densityIntegrand;
+
+
+    typedef struct Inscatter1Integrand
+    {
+        typedef t_rayMie t_value;
+
+        Inscatter1Integrand(
+            const AtmosphereModel &model
+        ,   const AtmosphereModel::t_table &transmittance
+        ,   const float r
+        ,   const float mu
+        ,   const float muS
+        ,   const float nu)
+        :   model(model)
+        ,   transmittance(transmittance)
+        ,   r(r)
+        ,   mu(mu)
+        ,   muS(muS)
+        ,   nu(nu)
+        {
+        }
+
+        const t_value operator()(const float t) const
+        {
+            t_value value;
+            inscatter1Integrand(model, transmittance, r, mu, muS, nu, t, value.ray, value.mie);
+
+            return value;
+        }
+
+        const AtmosphereModel &model;
+        const AtmosphereModel::t_table &transmittance;
+
+        const float r;
+        const float mu;
+        const float muS;
+        const float nu;
+
+    } t_inscatter1Integrand;
+
+
+    typedef struct InscatterNIntegrand
+    {
+        typedef osg::Vec3f t_value;
+
+        InscatterNIntegrand(
+            const AtmosphereModel &model
+        ,   const AtmosphereModel::t_table &transmittance
+        ,   const AtmosphereModel::t_table &deltaJ
+        ,   const float r
+        ,   const float mu
+        ,   const float muS
+        ,   const float nu)
+        :   model(model)
+        ,   transmittance(transmittance)
+        ,   deltaJ(deltaJ)
+        ,   r(r)
+        ,   mu(mu)
+        ,   muS(muS)
+        ,   nu(nu)
+        {
+        }
+
+        const t_value operator()(const float t) const
+        {
+            return inscatterNIntegrand(model, transmittance, deltaJ, r, mu, muS, nu, t);
+        }
+
+        const AtmosphereModel &model;
+        const AtmosphereModel::t_table &transmittance;
+        const AtmosphereModel::t_table &deltaJ;
+
+        const float r;
+        const float mu;
+        const float muS;
+        const float nu;
+
+    } t_inscatterNIntegrand;
+
+
+    // Subsets of the azimuths of the irradiance integral, in the order
+    // taken by the adaptive integration: every fourth, the remaining 
+    // even, and the odd ones. All azimuths are taken at once otherwise.
+
+    typedef struct Azimuths
+    {
+        int first;
+        int stride;
+
+    } t_azimuths;
+
+    const t_azimuths ALL_AZIMUTHS[] = { { 0, 1 } };
+    const t_azimuths ADAPTIVE_AZIMUTHS[] = { { 0, 4 }, { 2, 4 }, { 1, 2 } };
+
+    // Called with the sum over the subsets taken so far, returns true if
+    // the sum over the half of the azimuths is within tolerance (compared
+    // to the quarter), scaling it to the complete integral.
+
+    const bool azimuthsConverged(
+        const int subset
+    ,   osg::Vec3f &sum
+    ,   osg::Vec3f &quarter
+    ,   const float tolerance)
+    {
+        if(0 == subset)
+            quarter = sum * 4.f;
+
+        else if(1 == subset && converged(sum * 2.f - quarter, sum * 2.f, tolerance))
+        {
+            sum *= 2.f;
+            return true;
+        }
+        return false;
+    }
+}
+
+
+CpuAtmospherePrecompute::CpuAtmospherePrecompute(const int numThreads)
+:   AtmospherePrecompute()
+,   m_numThreads(numThreads)
+,   m_model(NULL)
+,   m_first(true)
+,   m_k(0.f)
+{
+}
+
+
+CpuAtmospherePrecompute::~CpuAtmospherePrecompute()
+{
+    // endTables is not virtual within the base destructor
+    abortCompute();
+}
+
+
+void CpuAtmospherePrecompute::setNumThreads(const int numThreads)
+{
+    m_numThreads = numThreads;
+}
+
+const int CpuAtmospherePrecompute::getNumThreads() const
+{
+    return m_numThreads > 0 ? m_numThreads : OpenThreads::GetNumberOfProcessors();
+}
+
+
+const bool CpuAtmospherePrecompute::beginTables()
+{
+    assert(!m_model);
+    m_model = new AtmosphereModel(getTextureConfig(), m_computeModelCfg);
+
+    allocateTables();
+
+    // the image might have been loaded from cache
+    if(!isStageRequired(S_Transmittance))
+        copyFromImage(m_transmittanceImage, m_transmittance);
+
+    return true;
+}
+
+
+void CpuAtmospherePrecompute::computeTask(const t_task &task)
+{
+    const e_Pass pass(task.pass);
+
+    // the single scattering results (line 2 and 3 in algorithm 4.1) are 
+    // retained and read by the second order, all other orders use deltaEN 
+    // and deltaSRN (overwritten by each order)
+
+    const bool second = task.order == 2;
+
+    m_deltaE  = pass == P_Irradiance1 || (second && pass == P_InscatterS) ? m_deltaE1 : m_deltaEN;
+    m_deltaSR = pass == P_Inscatter1 || pass == P_CopyInscatter1
+        || (second && (pass == P_InscatterS || pass == P_IrradianceN)) ? m_deltaSR1 : m_deltaSRN;
+
+    m_first = second;
+    // clears E for the first order (line 4 in algorithm 4.1)
+    m_k = task.order == 1 ? 0.f : 1.f;
+
+    const bool layered = task.end > task.begin;
+    dispatch(pass, layered ? task.begin : 0, layered ? task.end : numSlices(pass));
+
+    // publish completed tables
+
+    switch(pass)
+    {
+    case P_Transmittance:
+        copyToImage(m_transmittance, m_transmittanceImage);
+        break;
+
+    case P_CopyInscatter1:
+    case P_CopyInscatterN:
+        copyToImage(m_irradiance, m_irradianceImage);
+        copyToImage(m_inscatter,  m_inscatterImage);
+        break;
+
+    default:
+        break;
+    }
+}
+
+
+void CpuAtmospherePrecompute::endTables()
+{
+    delete m_model;
+    m_model = NULL;
+}
+
+
+void CpuAtmospherePrecompute::allocateTables()
+{
+    const t_preTexCfg &tc(getTextureConfig());
+
+    const int tw = tc.transmittanceWidth;
+    const int th = tc.transmittanceHeight;
+
+    const int sw = tc.skyWidth;
+    const int sh = tc.skyHeight;
+
+    const int w = tc.resMuS * tc.resNu;
+    const int h = tc.resMu;
+    const int d = tc.resR;
+
+    // keeps the data of retained stages if the sizes are unchanged
+
+    allocate(m_transmittanceData, tw * th * 3);
+    allocate(m_deltaEData,        sw * sh * 3);
+    allocate(m_deltaE1Data,       sw * sh * 3);
+    allocate(m_irradianceData,    sw * sh * 3);
+    allocate(m_deltaSRData,       w * h * d * 3);
+    allocate(m_deltaSR1Data,      w * h * d * 3);
+    allocate(m_deltaSMData,       w * h * d * 3);
+    allocate(m_deltaJData,        w * h * d * 3);
+    allocate(m_inscatterData,     w * h * d * 4);
+
+    m_transmittance = AtmosphereModel::t_table(&m_transmittanceData.front(), tw, th, 1, 3);
+    m_deltaE1       = AtmosphereModel::t_table(&m_deltaE1Data      .front(), sw, sh, 1, 3);
+    m_deltaEN       = AtmosphereModel::t_table(&m_deltaEData       .front(), sw, sh, 1, 3);
+    m_irradiance    = AtmosphereModel::t_table(&m_irradianceData   .front(), sw, sh, 1, 3);
+    m_deltaSR1      = AtmosphereModel::t_table(&m_deltaSR1Data     .front(), w, h, d, 3);
+    m_deltaSRN      = AtmosphereModel::t_table(&m_deltaSRData      .front(), w, h, d, 3);
+    m_deltaSM       = AtmosphereModel::t_table(&m_deltaSMData      .front(), w, h, d, 3);
+    m_deltaJ        = AtmosphereModel::t_table(&m_deltaJData       .front(), w, h, d, 3);
+    m_inscatter     = AtmosphereModel::t_table(&m_inscatterData    .front(), w, h, d, 4);
+}
+
+
+void CpuAtmospherePrecompute::copyToImage(
+    const AtmosphereModel::t_table &table
+,   osg::Image *image)
+{
+    assert(image);
+
+    assert(image->s() == table.width);
+    assert(image->t() == table.height);
+    assert(image->r() == table.depth);
+    assert(image->getDataType() == GL_FLOAT);
+    assert(osg::Image::computeNumComponents(image->getPixelFormat()) == static_cast<unsigned int>(table.components));
+
+    memcpy(image->data(), table.data, table.width * table.height * table.depth * table.components * sizeof(float));
+    image->dirty();
+}
+
+
+void CpuAtmospherePrecompute::copyFromImage(
+    const osg::Image *image
+,   AtmosphereModel::t_table &table)
+{
+    assert(image);
+
+    assert(image->s() == table.width);
+    assert(image->t() == table.height);
+    assert(image->r() == table.depth);
+    assert(image->getDataType() == GL_FLOAT);
+    assert(osg::Image::computeNumComponents(image->getPixelFormat()) == static_cast<unsigned int>(table.components));
+
+    memcpy(table.data, image->data(), table.width * table.height * table.depth * table.components * sizeof(float));
+}
+
+
+const int CpuAtmospherePrecompute::numSlices(const e_Pass pass) const
+{
+    const t_preTexCfg &tc(m_preTexCfg);
+
+    switch(pass)
+    {
+    case P_Transmittance:
+        return tc.transmittanceHeight;
+
+    case P_Irradiance1:
+    case P_CopyIrradiance:
+    case P_IrradianceN:
+        return tc.skyHeight;
+
+    default:
+        return tc.resR;
+    }
+}
+
+
+void CpuAtmospherePrecompute::dispatch(
+    const e_Pass pass
+,   const int begin
+,   const int end)
+{
+    assert(begin >= 0 && end <= numSlices(pass));
+
+    const int numThreads = _mi(getNumThreads(), end - begin);
+
+    if(numThreads <= 1)
+    {
+        for(int slice = begin; slice < end; ++slice)
+            computeSlice(pass, slice);
+
+        return;
+    }
+
+    OpenThreads::Atomic next(begin);
+    std::vector<Worker*> workers(numThreads);
+
+    for(int i = 0; i < numThreads; ++i)
+    {
+        workers[i] = new Worker(*this, pass, end, next);
+        workers[i]->start();
+    }
+    for(int i = 0; i < numThreads; ++i)
+    {
+        workers[i]->join();
+        delete workers[i];
+    }
+}
+
+
+void CpuAtmospherePrecompute::computeSlice(
+    const e_Pass pass
+,   const int slice)
+{
+    switch(pass)
+    {
+    case P_Transmittance:
+        transmittance(slice);
+        break;
+    case P_Irradiance1:
+        irradiance1(slice);
+        break;
+    case P_Inscatter1:
+        inscatter1(slice);
+        break;
+    case P_CopyIrradiance:
+        copyIrradiance(slice);
+        break;
+    case P_CopyInscatter1:
+        copyInscatter1(slice);
+        break;
+    case P_InscatterS:
+        inscatterS(slice);
+        break;
+    case P_IrradianceN:
+        irradianceN(slice);
+        break;
+    case P_InscatterN:
+        inscatterN(slice);
+        break;
+    case P_CopyInscatterN:
+        copyInscatterN(slice);
+        break;
+    default:
+        assert(false);
+    }
+}
+
+
+// computes transmittance table T using Eq (5)
+
+void CpuAtmospherePrecompute::transmittance(const int y)
+{
+    assert(m_model);
+    const AtmosphereModel &m(*m_model);
+
+    const t_modelCfg &mc(m.modelCfg());
+    const int samples = m.preTexCfg().transmittanceIntegralSamples;
+    const float tolerance = m.preTexCfg().integralTolerance;
+
+    const float Rg = m.Rg();
+
+    for(int x = 0; x < m_transmittance.width; ++x)
+    {
+        float r, muS;
+        m.transmittanceRMu(x, y, r, muS);
+
+        // optical depth for rayleigh and mie, integrated along the same ray
+
+        float depthR = 1e9f;
+        float depthM = 1e9f;
+
+        const bool aboveHorizon = muS >= -sqrt(1.f - (Rg / r) * (Rg / r));
+
+        if(aboveHorizon && tolerance > 0.f)
+        {
+            const osg::Vec2f depth = integrate(t_densityIntegrand(m, r, muS), m.limit(r, muS), samples, tolerance);
+
+            depthR = depth[0];
+            depthM = depth[1];
+        }
+        else if(aboveHorizon)
+        {
+            depthR = 0.f;
+            depthM = 0.f;
+
+            const float dx = m.limit(r, muS) / static_cast<float>(samples);
+
+            float yiR = exp(-(r - Rg) / mc.HR);
+            float yiM = exp(-(r - Rg) / mc.HM);
+
+            for(int i = 1; i <= samples; ++i)
+            {
+                const float xj = i * dx;
+                const float hj = sqrt(r * r + xj * xj + 2.f * xj * r * muS) - Rg;
+
+                const float yjR = exp(-hj / mc.HR);
+                const float yjM = exp(-hj / mc.HM);
+
+                depthR += (yiR + yjR) / 2.f * dx;
+                depthM += (yiM + yjM) / 2.f * dx;
+
+                yiR = yjR;
+                yiM = yjM;
+            }
+        }
+
+        const osg::Vec3f depth = mc.betaR * depthR + mc.betaMEx * depthM;
+        store(m_transmittance.texel(x, y), exp3(-depth));
+    }
+}
+
+
+// computes ground irradiance due to direct sunlight E[L0]
+
+void CpuAtmospherePrecompute::irradiance1(const int y)
+{
+    assert(m_model);
+    const AtmosphereModel &m(*m_model);
+
+    for(int x = 0; x < m_deltaE.width; ++x)
+    {
+        float r, muS;
+        m.irradianceRMuS(x, y, r, muS);
+
+        store(m_deltaE.texel(x, y), m.transmittance(m_transmittance, r, muS) * _ma(muS, 0.f));
+    }
+}
+
+
+// computes single scattering
+
+void CpuAtmospherePrecompute::inscatter1(const int layer)
+{
+    assert(m_model);
+    const AtmosphereModel &m(*m_model);
+
+    const t_modelCfg &mc(m.modelCfg());
+    const int samples = m.preTexCfg().inscatterIntegralSamples;
+    const float tolerance = m.preTexCfg().integralTolerance;
+
+    float r;
+    osg::Vec4f dhdH;
+    m.layerRDhdH(layer, r, dhdH);
+
+    for(int y = 0; y < m_deltaSR.height; ++y)
+        for(int x = 0; x < m_deltaSR.width; ++x)
+        {
+            float mu, muS, nu;
+            m.muMuSNu(x, y, r, dhdH, mu, muS, nu);
+
+            osg::Vec3f ray;
+            osg::Vec3f mie;
+
+            if(tolerance > 0.f)
+            {
+                const t_rayMie raymie = integrate(t_inscatter1Integrand(m, m_transmittance, r, mu, muS, nu)
+                    , m.limit(r, mu), samples, tolerance);
+
+                store(m_deltaSR.texel(x, y, layer), osg::componentMultiply(raymie.ray, mc.betaR));
+                store(m_deltaSM.texel(x, y, layer), osg::componentMultiply(raymie.mie, mc.betaMSca));
+
+                continue;
+            }
+
+            const float dx = m.limit(r, mu) / static_cast<float>(samples);
+
+            osg::Vec3f rayi;
+            osg::Vec3f miei;
+            inscatter1Integrand(m, m_transmittance, r, mu, muS, nu, 0.f, rayi, miei);
+
+            for(int i = 1; i <= samples; ++i)
+            {
+                const float xj = i * dx;
+
+                osg::Vec3f rayj;
+                osg::Vec3f miej;
+                inscatter1Integrand(m, m_transmittance, r, mu, muS, nu, xj, rayj, miej);
+
+                ray += (rayi + rayj) * (0.5f * dx);
+                mie += (miei + miej) * (0.5f * dx);
+
+                rayi = rayj;
+                miei = miej;
+            }
+
+            // store separately Rayleigh and Mie contributions, WITHOUT the phase function factor
+            // (cf 'Angular precision')
+
+            store(m_deltaSR.texel(x, y, layer), osg::componentMultiply(ray, mc.betaR));
+            store(m_deltaSM.texel(x, y, layer), osg::componentMultiply(mie, mc.betaMSca));
+        }
+}
+
+
+// clears (k = 0) or adds deltaE into E (k = 1)
+// Note: for k = 0 the irradiance is zeroed, as in line 4 of algorithm 4.1
+
+void CpuAtmospherePrecompute::copyIrradiance(const int y)
+{
+    for(int x = 0; x < m_irradiance.width; ++x)
+    {
+        float *e = m_irradiance.texel(x, y);
+        const float *deltaE = m_deltaE.texel(x, y);
+
+        for(int c = 0; c < 3; ++c)
+            e[c] = m_k == 0.f ? 0.f : e[c] + m_k * deltaE[c];
+    }
+}
+
+
+// copies deltaS into S
+
+void CpuAtmospherePrecompute::copyInscatter1(const int layer)
+{
+    for(int y = 0; y < m_inscatter.height; ++y)
+        for(int x = 0; x < m_inscatter.width; ++x)
+        {
+            float *s = m_inscatter.texel(x, y, layer);
+
+            const float *ray = m_deltaSR.texel(x, y, layer);
+            const float *mie = m_deltaSM.texel(x, y, layer);
+
+            s[0] = ray[0];
+            s[1] = ray[1];
+            s[2] = ray[2];
+            s[3] = mie[0]; // store only red component of single Mie scattering (cf. 'Angular precision')
+        }
+}
+
+
+// computes deltaJ
+
+void CpuAtmospherePrecompute::inscatterS(const int layer)
+{
+    assert(m_model);
+    const AtmosphereModel &m(*m_model);
+
+    const t_modelCfg &mc(m.modelCfg());
+    const int samples = m.preTexCfg().inscatterSphericalIntegralSamples;
+
+    const float PI = static_cast<float>(_PI);
+
+    const float dphi   = PI / static_cast<float>(samples);
+    const float dtheta = PI / static_cast<float>(samples);
+
+    const float Rg = m.Rg();
+
+    float rl;
+    osg::Vec4f dhdH;
+    m.layerRDhdH(layer, rl, dhdH);
+
+    const float r = clampf(rl, Rg, m.Rt());
+
+    // directions w are the same for all texels of a layer
+
+    std::vector<float> sinPhi(2 * samples);
+    std::vector<float> cosPhi(2 * samples);
+
+    for(int iphi = 0; iphi < 2 * samples; ++iphi)
+    {
+        const float phi = (iphi + 0.5f) * dphi;
+
+        sinPhi[iphi] = sin(phi);
+        cosPhi[iphi] = cos(phi);
+    }
+
+    const osg::Vec3f scatterR = mc.betaR    * exp(-(r - Rg) / mc.HR);
+    const osg::Vec3f scatterM = mc.betaMSca * exp(-(r - Rg) / mc.HM);
+
+    const float cthetamin = -sqrt(1.f - (Rg / r) * (Rg / r));
+
+    for(int y = 0; y < m_deltaJ.height; ++y)
+        for(int x = 0; x < m_deltaJ.width; ++x)
+        {
+            float mu, muS, nu;
+            m.muMuSNu(x, y, rl, dhdH, mu, muS, nu);
+
+            mu  = clampf(mu,  -1.f, 1.f);
+            muS = clampf(muS, -1.f, 1.f);
+
+            const float var = sqrt(1.f - mu * mu) * sqrt(1.f - muS * muS);
+            nu = clampf(nu, muS * mu - var, muS * mu + var);
+
+            const osg::Vec3f v(sqrt(1.f - mu * mu), 0.f, mu);
+            const float sx = v[0] == 0.f ? 0.f : (nu - muS * mu) / v[0];
+            const osg::Vec3f s(sx, sqrt(_ma(0.f, 1.f - sx * sx - muS * muS)), muS);
+
+            osg::Vec3f raymie;
+
+            // integral over 4.PI around x with two nested loops over w directions (theta,phi) -- Eq (7)
+
+            for(int itheta = 0; itheta < samples; ++itheta)
+            {
+                const float theta = (itheta + 0.5f) * dtheta;
+                const float ctheta = cos(theta);
+                const float stheta = sin(theta);
+
+                float greflectance = 0.f;
+                float dground = 0.f;
+                osg::Vec3f gtransp;
+
+                if(ctheta < cthetamin) // if ground visible in direction w
+                {
+                    // compute transparency gtransp between x and ground
+                    greflectance = mc.avgGroundReflectance / PI;
+                    dground = -r * ctheta - sqrt(r * r * (ctheta * ctheta - 1.f) + Rg * Rg);
+                    gtransp = m.transmittance(m_transmittance, Rg, -(r * ctheta + dground) / Rg, dground);
+                }
+
+                const float dw = dtheta * dphi * stheta;
+
+                for(int iphi = 0; iphi < 2 * samples; ++iphi)
+                {
+                    const osg::Vec3f w(cosPhi[iphi] * stheta, sinPhi[iphi] * stheta, ctheta);
+
+                    const float nu1 = s * w;
+                    const float nu2 = v * w;
+                    const float pr2 = m.phaseFunctionR(nu2);
+                    const float pm2 = m.phaseFunctionM(nu2);
+
+                    // light arriving at x from direction w
+
+                    osg::Vec3f raymie1;
+
+                    // first term = light reflected from the ground and attenuated before reaching x, =T.alpha/PI.deltaE
+
+                    if(greflectance > 0.f)
+                    {
+                        // compute irradiance received at ground in direction w (if ground visible) =deltaE
+                        const osg::Vec3f gnormal = (osg::Vec3f(0.f, 0.f, r) + w * dground) / Rg;
+                        const osg::Vec3f girradiance = m.irradiance(m_deltaE, Rg, gnormal * s);
+
+                        raymie1 = osg::componentMultiply(girradiance, gtransp) * greflectance;
+                    }
+
+                    // second term = inscattered light, =deltaS
+
+                    if(m_first)
+                    {
+                        // first iteration is special because Rayleigh and Mie were stored separately,
+                        // without the phase functions factors; they must be reintroduced here
+                        const float pr1 = m.phaseFunctionR(nu1);
+                        const float pm1 = m.phaseFunctionM(nu1);
+                        const osg::Vec3f ray1 = rgb(m.texture4D(m_deltaSR, r, w[2], muS, nu1));
+                        const osg::Vec3f mie1 = rgb(m.texture4D(m_deltaSM, r, w[2], muS, nu1));
+
+                        raymie1 += ray1 * pr1 + mie1 * pm1;
+                    }
+                    else
+                        raymie1 += rgb(m.texture4D(m_deltaSR, r, w[2], muS, nu1));
+
+                    // light coming from direction w and scattered in direction v
+                    // = light arriving at x from direction w (raymie1) * SUM(scattering coefficient * phaseFunction)
+                    // see Eq (7)
+
+                    raymie += osg::componentMultiply(raymie1, scatterR * pr2 + scatterM * pm2) * dw;
+                }
+            }
+
+            // output raymie = J[T.alpha / PI.deltaE + deltaS] (line 7 in algorithm 4.1)
+            store(m_deltaJ.texel(x, y, layer), raymie);
+        }
+}
+
+
+// computes ground irradiance due to skylight E[deltaS]
+
+void CpuAtmospherePrecompute::irradianceN(const int y)
+{
+    assert(m_model);
+    const AtmosphereModel &m(*m_model);
+
+    const int samples = m.preTexCfg().irradianceIntegralSamples;
+    const float tolerance = m.preTexCfg().integralTolerance;
+
+    // the subsets require a multiple of 4 azimuths
+    const bool adaptive = tolerance > 0.f && 0 == samples % 2;
+
+    const t_azimuths *azimuths = adaptive ? ADAPTIVE_AZIMUTHS : ALL_AZIMUTHS;
+    const int numAzimuths = adaptive ? 3 : 1;
+
+    const float PI = static_cast<float>(_PI);
+
+    const float dphi   = PI / static_cast<float>(samples);
+    const float dtheta = PI / static_cast<float>(samples);
+
+    for(int x = 0; x < m_deltaE.width; ++x)
+    {
+        float r, muS;
+        m.irradianceRMuS(x, y, r, muS);
+
+        const osg::Vec3f s(_ma(sqrt(1.f - muS * muS), 0.f), 0.f, muS);
+
+        osg::Vec3f result;
+        osg::Vec3f quarter;
+
+        // integral over 2.PI around x with two nested loops over w directions (theta,phi) -- Eq (15)
+
+        for(int a = 0; a < numAzimuths; ++a)
+        {
+            for(int iphi = azimuths[a].first; iphi < 2 * samples; iphi += azimuths[a].stride)
+            {
+                const float phi = (iphi + 0.5f) * dphi;
+
+                for(int itheta = 0; itheta < samples / 2; ++itheta)
+                {
+                    const float theta = (itheta + 0.5f) * dtheta;
+                    const float dw = dtheta * dphi * sin(theta);
+
+                    const osg::Vec3f w(cos(phi) * sin(theta), sin(phi) * sin(theta), cos(theta));
+                    const float nu = s * w;
+
+                    if(m_first)
+                    {
+                        // first iteration is special because Rayleigh and Mie were stored separately,
+                        // without the phase functions factors; they must be reintroduced here
+                        const float pr1 = m.phaseFunctionR(nu);
+                        const float pm1 = m.phaseFunctionM(nu);
+                        const osg::Vec3f ray1 = rgb(m.texture4D(m_deltaSR, r, w[2], muS, nu));
+                        const osg::Vec3f mie1 = rgb(m.texture4D(m_deltaSM, r, w[2], muS, nu));
+
+                        result += (ray1 * pr1 + mie1 * pm1) * (w[2] * dw);
+                    }
+                    else
+                        result += rgb(m.texture4D(m_deltaSR, r, w[2], muS, nu)) * (w[2] * dw);
+                }
+            }
+
+            if(adaptive && azimuthsConverged(a, result, quarter, tolerance))
+                break;
+        }
+        store(m_deltaE.texel(x, y), result);
+    }
+}
+
+
+// computes higher order scattering
+
+void CpuAtmospherePrecompute::inscatterN(const int layer)
+{
+    assert(m_model);
+    const AtmosphereModel &m(*m_model);
+
+    const int samples = m.preTexCfg().inscatterIntegralSamples;
+    const float tolerance = m.preTexCfg().integralTolerance;
+
+    float r;
+    osg::Vec4f dhdH;
+    m.layerRDhdH(layer, r, dhdH);
+
+    for(int y = 0; y < m_deltaSR.height; ++y)
+        for(int x = 0; x < m_deltaSR.width; ++x)
+        {
+            float mu, muS, nu;
+            m.muMuSNu(x, y, r, dhdH, mu, muS, nu);
+
+            if(tolerance > 0.f)
+            {
+                store(m_deltaSR.texel(x, y, layer), integrate(t_inscatterNIntegrand(m, m_transmittance, m_deltaJ, r, mu, muS, nu)
+                    , m.limit(r, mu), samples, tolerance));
+
+                continue;
+            }
+
+            osg::Vec3f raymie;
+
+            const float dx = m.limit(r, mu) / static_cast<float>(samples);
+
+            osg::Vec3f raymiei = inscatterNIntegrand(m, m_transmittance, m_deltaJ, r, mu, muS, nu, 0.f);
+
+            for(int i = 1; i <= samples; ++i)
+            {
+                const float xj = i * dx;
+                const osg::Vec3f raymiej = inscatterNIntegrand(m, m_transmittance, m_deltaJ, r, mu, muS, nu, xj);
+
+                raymie += (raymiei + raymiej) * (0.5f * dx);
+                raymiei = raymiej;
+            }
+            store(m_deltaSR.texel(x, y, layer), raymie);
+        }
+}
+
+
+// adds deltaS into S
+
+void CpuAtmospherePrecompute::copyInscatterN(const int layer)
+{
+    assert(m_model);
+    const AtmosphereModel &m(*m_model);
+
+    float r;
+    osg::Vec4f dhdH;
+    m.layerRDhdH(layer, r, dhdH);
+
+    for(int y = 0; y < m_inscatter.height; ++y)
+        for(int x = 0; x < m_inscatter.width; ++x)
+        {
+            float mu, muS, nu;
+            m.muMuSNu(x, y, r, dhdH, mu, muS, nu);
+
+            float *s = m_inscatter.texel(x, y, layer);
+            const float *deltaS = m_deltaSR.texel(x, y, layer);
+
+            const float pr = m.phaseFunctionR(nu);
+
+            s[0] += deltaS[0] / pr;
+            s[1] += deltaS[1] / pr;
+            s[2] += deltaS[2] / pr;
+        }
+}
+
+} // namespace osgHimmel
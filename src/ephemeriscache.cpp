@@ -0,0 +1,531 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "ephemeriscache.h"
+
+#include "sun.h"
+#include "moon.h"
+#include "earth.h"
+#include "mathmacros.h"
+
+#include <fstream>
+#include <cstring>
+
+#include <assert.h>
+
+
+namespace
+{
+    const char MAGIC[4] = { 'O', 'H', 'E', 'C' };
+    const unsigned int VERSION(1);
+
+    // nodes of the fit (the degree is at most NUM_NODES - 1)
+    const unsigned int NUM_NODES(24);
+
+    // points per span between the nodes, where the error is measured
+    const unsigned int NUM_CHECKS(4);
+
+    typedef struct SeriesHeader
+    {
+        double span;
+        double maxError;
+
+        unsigned int degree;
+        unsigned int numSpans;
+
+    } t_seriesHeader;
+
+    typedef struct FileHeader
+    {
+        char magic[4];
+        unsigned int version;
+
+        double begin;
+        double end;
+        double tolerance;
+
+        t_seriesHeader series[osgHimmel::EphemerisCache::NUM_QUANTITIES];
+
+    } t_fileHeader;
+
+
+    const bool isLongitude(const osgHimmel::EphemerisCache::e_Quantity quantity)
+    {
+        return osgHimmel::EphemerisCache::Q_SunLongitude == quantity
+            || osgHimmel::EphemerisCache::Q_MoonLongitude == quantity;
+    }
+
+    const bool isDistance(const osgHimmel::EphemerisCache::e_Quantity quantity)
+    {
+        return osgHimmel::EphemerisCache::Q_SunDistance == quantity
+            || osgHimmel::EphemerisCache::Q_MoonDistance == quantity;
+    }
+
+    // difference of longitudes within [-180;180[
+
+    inline const double difference(
+        const double a
+    ,   const double b)
+    {
+        const double d = a - b;
+        return d - 360.0 * floor(d / 360.0 + 0.5);
+    }
+
+    const double direct(
+        const osgHimmel::EphemerisCache::e_Quantity quantity
+    ,   const osgHimmel::t_julianDay t)
+    {
+        using namespace osgHimmel;
+
+        switch(quantity)
+        {
+        case EphemerisCache::Q_SunLongitude:
+            return static_cast<double>(Sun::apparentLongitude(t));
+        case EphemerisCache::Q_SunObliquity:
+            return static_cast<double>(Sun::apparentObliquity(t));
+        case EphemerisCache::Q_SunDistance:
+            return static_cast<double>(Sun::distance(t));
+        case EphemerisCache::Q_MoonLongitude:
+            return static_cast<double>(Moon::position(t).longitude);
+        case EphemerisCache::Q_MoonLatitude:
+            return static_cast<double>(Moon::position(t).latitude);
+        case EphemerisCache::Q_MoonDistance:
+            return static_cast<double>(Moon::distance(t));
+        case EphemerisCache::Q_LongitudeNutation:
+            return static_cast<double>(Earth::longitudeNutation(t));
+        case EphemerisCache::Q_ObliquityNutation:
+            return static_cast<double>(Earth::obliquityNutation(t));
+        case EphemerisCache::Q_MeanObliquity:
+            return static_cast<double>(Earth::meanObliquity(t));
+        default:
+            assert(false);
+            return 0.0;
+        }
+    }
+
+    // Clenshaw's recurrence for the sum of c[k] * T_k(x), x in [-1;1]
+
+    inline const double clenshaw(
+        const double *c
+    ,   const unsigned int degree
+    ,   const double x)
+    {
+        const double x2 = 2.0 * x;
+
+        double b1 = 0.0;
+        double b2 = 0.0;
+
+        for(unsigned int k = degree; k > 0; --k)
+        {
+            const double b = x2 * b1 - b2 + c[k];
+
+            b2 = b1;
+            b1 = b;
+        }
+        return x * b1 - b2 + c[0];
+    }
+}
+
+
+namespace osgHimmel
+{
+
+EphemerisCache::EphemerisCache()
+:   osg::Referenced()
+,   m_tolerance(defaultTolerance())
+,   m_begin(0.0)
+,   m_end(0.0)
+{
+    for(int q = 0; q < NUM_QUANTITIES; ++q)
+    {
+        m_spans[q] = defaultSpan(static_cast<e_Quantity>(q));
+
+        m_series[q].span = m_spans[q];
+        m_series[q].degree = 0;
+        m_series[q].maxError = 0.0;
+    }
+}
+
+
+EphemerisCache::~EphemerisCache()
+{
+}
+
+
+const bool EphemerisCache::build(
+    const t_julianDay begin
+,   const t_julianDay end)
+{
+    assert(end > begin);
+
+    m_begin = static_cast<double>(begin);
+    m_end   = static_cast<double>(end);
+
+    bool accurate(true);
+
+    for(int q = 0; q < NUM_QUANTITIES; ++q)
+    {
+        const e_Quantity quantity(static_cast<e_Quantity>(q));
+
+        t_series &series(m_series[q]);
+        series.span = m_spans[q];
+
+        fit(quantity, series);
+
+        if(isDistance(quantity))
+            continue;
+
+        accurate &= series.maxError <= m_tolerance;
+    }
+    return accurate;
+}
+
+
+void EphemerisCache::fit(
+    const e_Quantity quantity
+,   t_series &series) const
+{
+    const double span(series.span);
+    const unsigned int numSpans(_ma(1u, static_cast<unsigned int>(ceil((m_end - m_begin) / span))));
+
+    // half of the tolerance is left for the error of the fit itself
+
+    const double tolerance(isDistance(quantity) 
+        ? _rad(m_tolerance / 3600.0) * 0.5 : m_tolerance / 3600.0 * 0.5);
+
+    double f[NUM_NODES];
+    std::vector<double> c(numSpans * NUM_NODES);
+
+    series.degree = 0;
+
+    for(unsigned int s = 0; s < numSpans; ++s)
+    {
+        const double center(m_begin + (s + 0.5) * span);
+
+        for(unsigned int k = 0; k < NUM_NODES; ++k)
+        {
+            const double x(cos(_PI * (k + 0.5) / NUM_NODES));
+            f[k] = direct(quantity, center + x * span * 0.5);
+
+            // unwrap longitudes within the span
+            if(isLongitude(quantity) && k > 0)
+                f[k] = f[0] + difference(f[k], f[0]);
+        }
+
+        double *cs(&c[s * NUM_NODES]);
+
+        for(unsigned int j = 0; j < NUM_NODES; ++j)
+        {
+            double sum(0.0);
+            for(unsigned int k = 0; k < NUM_NODES; ++k)
+                sum += f[k] * cos(_PI * j * (k + 0.5) / NUM_NODES);
+
+            cs[j] = sum * 2.0 / NUM_NODES;
+        }
+        cs[0] *= 0.5;
+
+        // truncate while the sum of the omitted coefficients (bounding 
+        // their contribution) is within the tolerance
+
+        const double t(isDistance(quantity) ? tolerance * fabs(cs[0]) : tolerance);
+
+        unsigned int degree(NUM_NODES - 1);
+        double omitted(fabs(cs[degree]));
+
+        while(degree > 0 && omitted <= t)
+            omitted += fabs(cs[--degree]);
+
+        series.degree = _ma(series.degree, degree);
+    }
+
+    const unsigned int n(series.degree + 1);
+
+    series.coefficients.resize(numSpans * n);
+    for(unsigned int s = 0; s < numSpans; ++s)
+        for(unsigned int j = 0; j < n; ++j)
+            series.coefficients[s * n + j] = c[s * NUM_NODES + j];
+
+    // measure the error between the nodes
+
+    series.maxError = 0.0;
+
+    for(unsigned int s = 0; s < numSpans; ++s)
+        for(unsigned int i = 0; i < NUM_CHECKS; ++i)
+        {
+            const double x(-1.0 + (2.0 * i + 1.0) / NUM_CHECKS);
+
+            const double v(clenshaw(&series.coefficients[s * n], series.degree, x));
+            const double d(direct(quantity, m_begin + (s + 0.5 + x * 0.5) * span));
+
+            const double e(isLongitude(quantity) ? difference(v, d) : v - d);
+            series.maxError = _ma(series.maxError, fabs(e));
+        }
+
+    if(!isDistance(quantity))
+        series.maxError *= 3600.0;
+}
+
+
+const bool EphemerisCache::isValid() const
+{
+    return m_end > m_begin;
+}
+
+
+const bool EphemerisCache::covers(const t_julianDay t) const
+{
+    return isValid() && t >= m_begin && t <= m_end;
+}
+
+
+const t_julianDay EphemerisCache::begin() const
+{
+    return m_begin;
+}
+
+const t_julianDay EphemerisCache::end() const
+{
+    return m_end;
+}
+
+
+const double EphemerisCache::setTolerance(const double arcsecs)
+{
+    m_tolerance = _ma(arcsecs, 1e-6);
+    return getTolerance();
+}
+
+const double EphemerisCache::getTolerance() const
+{
+    return m_tolerance;
+}
+
+const double EphemerisCache::defaultTolerance()
+{
+    return 0.01;
+}
+
+
+const double EphemerisCache::setSpan(
+    const e_Quantity quantity
+,   const double days)
+{
+    assert(quantity < NUM_QUANTITIES);
+
+    m_spans[quantity] = _ma(days, 1.0 / 24.0);
+    return getSpan(quantity);
+}
+
+const double EphemerisCache::getSpan(const e_Quantity quantity) const
+{
+    assert(quantity < NUM_QUANTITIES);
+    return m_spans[quantity];
+}
+
+const double EphemerisCache::defaultSpan(const e_Quantity quantity)
+{
+    switch(quantity)
+    {
+    case Q_SunLongitude:
+    case Q_SunDistance:
+        return 32.0;
+    case Q_SunObliquity:
+        return 16.0;
+    case Q_MoonLongitude:
+    case Q_MoonLatitude:
+    case Q_MoonDistance:
+        return 4.0;
+    case Q_LongitudeNutation:
+    case Q_ObliquityNutation:
+        return 16.0;
+    case Q_MeanObliquity:
+    default:
+        return 3652.5;
+    }
+}
+
+
+const unsigned int EphemerisCache::getDegree(const e_Quantity quantity) const
+{
+    assert(quantity < NUM_QUANTITIES);
+    return m_series[quantity].degree;
+}
+
+const double EphemerisCache::getMaxError(const e_Quantity quantity) const
+{
+    assert(quantity < NUM_QUANTITIES);
+    return m_series[quantity].maxError;
+}
+
+
+const double EphemerisCache::value(
+    const e_Quantity quantity
+,   const t_julianDay t) const
+{
+    assert(quantity < NUM_QUANTITIES);
+    assert(covers(t));
+
+    const t_series &series(m_series[quantity]);
+
+    const unsigned int n(series.degree + 1);
+    const unsigned int numSpans(static_cast<unsigned int>(series.coefficients.size()) / n);
+
+    const double d(_clamp(0.0, m_end - m_begin, static_cast<double>(t - m_begin)));
+    const unsigned int s(_mi(numSpans - 1, static_cast<unsigned int>(d / series.span)));
+
+    const double x(2.0 * (d - s * series.span) / series.span - 1.0);
+    const double v(clenshaw(&series.coefficients[s * n], series.degree, x));
+
+    return isLongitude(quantity) ? v - 360.0 * floor(v / 360.0) : v;
+}
+
+
+const t_ecld EphemerisCache::moonPosition(const t_julianDay t) const
+{
+    t_ecld ecl;
+
+    ecl.longitude = value(Q_MoonLongitude, t);
+    ecl.latitude = value(Q_MoonLatitude, t);
+
+    return ecl;
+}
+
+
+const t_equd EphemerisCache::moonApparentPosition(const t_julianDay t) const
+{
+    t_ecld ecl = moonPosition(t);
+    ecl.longitude += value(Q_LongitudeNutation, t);
+
+    return ecl.toEquatorial(value(Q_MeanObliquity, t));
+}
+
+
+const t_equd EphemerisCache::sunApparentPosition(const t_julianDay t) const
+{
+    t_equd equ;
+
+    const t_longf e = _rad(value(Q_SunObliquity, t));
+    const t_longf l = _rad(value(Q_SunLongitude, t));
+
+    const t_longf sinl = sin(l);
+
+    equ.right_ascension = _revd(_deg(atan2(cos(e) * sinl, cos(l))));
+    equ.declination = _deg(asin(sin(e) * sinl));
+
+    return equ;
+}
+
+
+const bool EphemerisCache::save(const std::string &filePath) const
+{
+    if(!isValid())
+        return false;
+
+    t_fileHeader header = t_fileHeader();
+
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version   = VERSION;
+    header.begin     = m_begin;
+    header.end       = m_end;
+    header.tolerance = m_tolerance;
+
+    for(int q = 0; q < NUM_QUANTITIES; ++q)
+    {
+        const t_series &series(m_series[q]);
+
+        header.series[q].span     = series.span;
+        header.series[q].maxError = series.maxError;
+        header.series[q].degree   = series.degree;
+        header.series[q].numSpans = static_cast<unsigned int>(series.coefficients.size()) / (series.degree + 1);
+    }
+
+    std::ofstream stream(filePath.c_str(), std::ios::binary);
+    if(!stream)
+        return false;
+
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(t_fileHeader));
+
+    for(int q = 0; q < NUM_QUANTITIES; ++q)
+        stream.write(reinterpret_cast<const char*>(&m_series[q].coefficients[0])
+            , m_series[q].coefficients.size() * sizeof(double));
+
+    stream.close();
+
+    return !stream.fail();
+}
+
+
+const bool EphemerisCache::load(const std::string &filePath)
+{
+    std::ifstream stream(filePath.c_str(), std::ios::binary);
+    if(!stream)
+        return false;
+
+    t_fileHeader header;
+    stream.read(reinterpret_cast<char*>(&header), sizeof(t_fileHeader));
+
+    if(stream.fail()
+    || memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0
+    || header.version != VERSION
+    || !(header.end > header.begin))
+        return false;
+
+    t_series series[NUM_QUANTITIES];
+
+    for(int q = 0; q < NUM_QUANTITIES; ++q)
+    {
+        const t_seriesHeader &h(header.series[q]);
+
+        if(h.degree >= NUM_NODES || h.numSpans == 0 || !(h.span > 0.0)
+        || h.numSpans < (header.end - header.begin) / h.span)
+            return false;
+
+        series[q].span     = h.span;
+        series[q].maxError = h.maxError;
+        series[q].degree   = h.degree;
+        series[q].coefficients.resize(h.numSpans * (h.degree + 1));
+
+        stream.read(reinterpret_cast<char*>(&series[q].coefficients[0])
+            , series[q].coefficients.size() * sizeof(double));
+
+        if(stream.fail())
+            return false;
+    }
+
+    for(int q = 0; q < NUM_QUANTITIES; ++q)
+        m_series[q] = series[q];
+
+    m_begin = header.begin;
+    m_end   = header.end;
+    m_tolerance = header.tolerance;
+
+    return true;
+}
+
+} // namespace osgHimmel
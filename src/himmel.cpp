@@ -219,14 +219,12 @@ void Himmel::update()
 
     if(isDirty())
     {
-        const t_aTime atime = t_aTime::fromTimeF(*getTime());
-        astro()->update(atime);
+        astro()->update(t_julianTime::fromTimeF(*getTime()));
 
-        osg::Vec3f sunv = astro()->getSunPosition(false);
-        u_sun->set(sunv);
+        const t_astronomySnapshot &snapshot(astro()->getSnapshot());
 
-        osg::Vec3f sunrv = astro()->getSunPosition(true);
-        u_sunr->set(sunrv);
+        u_sun->set(snapshot.sun);
+        u_sunr->set(snapshot.sunRefracted);
 
         u_time->set(static_cast<float>(getTime()->getf()));
 
@@ -271,9 +269,9 @@ const osg::Vec3f Himmel::getSunPosition() const
 }
 
 
-const osg::Vec3f Himmel::getSunPosition(const t_aTime &aTime) const
+const osg::Vec3f Himmel::getSunPosition(const t_julianTime &time) const
 {
-    return astro()->getSunPosition(aTime, m_astronomy->getLatitude(), m_astronomy->getLongitude(), false);
+    return astro()->getSunPosition(time, m_astronomy->getLatitude(), m_astronomy->getLongitude(), false);
 }
 
 
@@ -0,0 +1,472 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "himmelambient.h"
+
+#include "himmel.h"
+#include "abstractastronomy.h"
+#include "atmospheregeode.h"
+#include "atmospherequery.h"
+#include "moongeode.h"
+#include "mathmacros.h"
+
+#include <OpenThreads/Thread>
+#include <OpenThreads/ScopedLock>
+
+#include <vector>
+
+#include <assert.h>
+#include <math.h>
+
+
+namespace osgHimmel
+{
+
+namespace
+{
+    // marks m_middle as published but not yet taken by update
+    const unsigned int FRESH(4);
+
+    // real SH basis up to l = 2 (Sloan, Stupid Spherical Harmonics Tricks)
+
+    void basis(
+        const osg::Vec3f &d
+    ,   float Y[9])
+    {
+        const float x = d[0];
+        const float y = d[1];
+        const float z = d[2];
+
+        Y[0] = 0.282095f;
+
+        Y[1] = 0.488603f * y;
+        Y[2] = 0.488603f * z;
+        Y[3] = 0.488603f * x;
+
+        Y[4] = 1.092548f * x * y;
+        Y[5] = 1.092548f * y * z;
+        Y[6] = 0.315392f * (3.f * z * z - 1.f);
+        Y[7] = 1.092548f * x * z;
+        Y[8] = 0.546274f * (x * x - y * y);
+    }
+
+    // Day-Twilight-Night-Intensity Mapping of StarMapGeode
+
+    inline const float nightIntensity(const osg::Vec3f &sun)
+    {
+        return 1.f / sqrt(1.f + pow(sun[2] + 1.14f, 32.f));
+    }
+
+    inline const osg::Vec3f mul(
+        const osg::Vec3f &a
+    ,   const osg::Vec3f &b)
+    {
+        return osg::Vec3f(a[0] * b[0], a[1] * b[1], a[2] * b[2]);
+    }
+}
+
+
+class HimmelAmbient::Worker : public OpenThreads::Thread
+{
+public:
+
+    Worker(HimmelAmbient &ambient)
+    :   OpenThreads::Thread()
+    ,   m_ambient(ambient)
+    {
+    }
+
+    virtual void run()
+    {
+        // the tables are accessed by this thread only
+        AtmosphereQuery *query(NULL);
+
+        while(true)
+        {
+            t_request request;
+            {
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_ambient.m_mutex);
+
+                while(!m_ambient.m_hasPending && !m_ambient.m_quit)
+                    m_ambient.m_condition.wait(&m_ambient.m_mutex);
+
+                if(m_ambient.m_quit)
+                    break;
+
+                request = m_ambient.m_pending;
+
+                m_ambient.m_pending.query = NULL;
+                m_ambient.m_hasPending = false;
+            }
+
+            if(request.query)
+            {
+                delete query;
+                query = request.query;
+            }
+
+            if(!query)
+                continue;
+
+            t_sh9 sh;
+            m_ambient.project(sh, request, *query);
+            m_ambient.publish(sh);
+        }
+        delete query;
+    }
+
+protected:
+
+    HimmelAmbient &m_ambient;
+};
+
+
+HimmelAmbient::SphericalHarmonics::SphericalHarmonics()
+{
+    for(int i = 0; i < 9; ++i)
+        coefficients[i] = osg::Vec3f(0.f, 0.f, 0.f);
+}
+
+
+HimmelAmbient::Request::Request()
+:   altitude(0.f)
+,   query(NULL)
+{
+}
+
+
+HimmelAmbient::HimmelAmbient(const int resolution)
+:   m_resolution(resolution)
+
+,   m_threshold(defaultThreshold())
+,   m_moonEnabled(true)
+
+,   m_worker(NULL)
+
+,   m_requested(false)
+,   m_tablesRevision(0)
+
+,   m_hasPending(false)
+,   m_quit(false)
+
+,   m_back(0)
+,   m_middle(1)
+,   m_front(2)
+
+,   m_revision(0)
+{
+    assert(resolution > 0);
+}
+
+
+HimmelAmbient::~HimmelAmbient()
+{
+    if(m_worker)
+    {
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+
+            m_quit = true;
+            m_condition.signal();
+        }
+        m_worker->join();
+
+        delete m_worker;
+    }
+    delete m_pending.query;
+}
+
+
+void HimmelAmbient::update(const Himmel &himmel)
+{
+    const AtmosphereGeode *atmosphere(himmel.atmosphere());
+    if(!atmosphere || !atmosphere->getQuery()->isValid())
+        return;
+
+    const AtmosphereQuery *query(atmosphere->getQuery());
+    const AbstractAstronomy *astro(himmel.astro());
+
+    t_request request;
+
+    const t_astronomySnapshot &snapshot(astro->getSnapshot());
+
+    request.sun = snapshot.sunRefracted;
+    request.moon = snapshot.moonRefracted;
+    request.altitude = himmel.getAltitude();
+
+    if(m_moonEnabled && himmel.moon())
+    {
+        // sun shine of MoonGeode, scaled by the lit fraction and the solid angle
+
+        const float lit = (1.f - request.sun * request.moon) * 0.5f;
+        const float omega = _PI2 * (1.f - cos(snapshot.angularMoonRadius));
+
+        request.moonIntensity = himmel.moon()->getSunShineColor()
+            * himmel.moon()->getSunShineIntensity() * lit * omega;
+    }
+    request.starMapRadiance = m_starMapRadiance;
+
+    const bool tablesChanged = query->getRevision() != m_tablesRevision;
+
+    if(!tablesChanged && !isRequired(request))
+        return;
+
+    if(tablesChanged)
+    {
+        // the worker evaluates a copy, since the tables might be updated meanwhile
+
+        request.query = new AtmosphereQuery();
+        request.query->copy(*query);
+
+        m_tablesRevision = query->getRevision();
+    }
+
+    m_last = request;
+    m_last.query = NULL;
+    m_requested = true;
+
+    if(!m_worker)
+    {
+        m_worker = new Worker(*this);
+        m_worker->start();
+    }
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+
+    // a superseded request passes on its tables, unless there are newer ones
+
+    if(m_hasPending && m_pending.query)
+    {
+        if(request.query)
+            delete m_pending.query;
+        else
+            request.query = m_pending.query;
+    }
+
+    m_pending = request;
+    m_hasPending = true;
+
+    m_condition.signal();
+}
+
+
+const bool HimmelAmbient::isRequired(const t_request &request) const
+{
+    if(!m_requested)
+        return true;
+
+    const float cosThreshold = cos(_rad(m_threshold));
+
+    return request.sun * m_last.sun < cosThreshold
+        || request.moon * m_last.moon < cosThreshold
+        || request.altitude != m_last.altitude
+        || request.moonIntensity != m_last.moonIntensity
+        || request.starMapRadiance != m_last.starMapRadiance;
+}
+
+
+void HimmelAmbient::project(
+    t_sh9 &sh
+,   const t_request &request
+,   const AtmosphereQuery &query) const
+{
+    project(sh, query, request.sun, request.altitude, m_resolution);
+
+    if(request.moonIntensity != osg::Vec3f())
+    {
+        const osg::Vec3f transmittance(query.sunTransmittance(request.altitude, request.moon));
+        addDirectional(sh, request.moon, mul(request.moonIntensity, transmittance));
+    }
+
+    if(request.starMapRadiance != osg::Vec3f())
+    {
+        // uniform radiance of the upper hemisphere (the integral of Y[6] vanishes)
+
+        const osg::Vec3f L(request.starMapRadiance * nightIntensity(request.sun));
+
+        sh.coefficients[0] += L * (0.282095f * _PI2);
+        sh.coefficients[2] += L * (0.488603f * _PI);
+    }
+}
+
+
+void HimmelAmbient::publish(const t_sh9 &sh)
+{
+    m_buffers[m_back] = sh;
+
+    // the increment is a full barrier, ordering the buffer before the exchange
+    ++m_revision;
+
+    m_back = m_middle.exchange(m_back | FRESH) & ~FRESH;
+}
+
+
+const HimmelAmbient::t_sh9 &HimmelAmbient::getCoefficients()
+{
+    if(m_middle & FRESH)
+        m_front = m_middle.exchange(m_front) & ~FRESH;
+
+    return m_buffers[m_front];
+}
+
+
+const unsigned int HimmelAmbient::getRevision() const
+{
+    return m_revision;
+}
+
+
+const float HimmelAmbient::setThreshold(const float threshold)
+{
+    m_threshold = threshold;
+    return getThreshold();
+}
+
+const float HimmelAmbient::getThreshold() const
+{
+    return m_threshold;
+}
+
+const float HimmelAmbient::defaultThreshold()
+{
+    return 0.5f;
+}
+
+
+const bool HimmelAmbient::setMoonEnabled(const bool enabled)
+{
+    m_moonEnabled = enabled;
+    return isMoonEnabled();
+}
+
+const bool HimmelAmbient::isMoonEnabled() const
+{
+    return m_moonEnabled;
+}
+
+
+const osg::Vec3f HimmelAmbient::setStarMapRadiance(const osg::Vec3f &radiance)
+{
+    m_starMapRadiance = radiance;
+    return getStarMapRadiance();
+}
+
+const osg::Vec3f HimmelAmbient::getStarMapRadiance() const
+{
+    return m_starMapRadiance;
+}
+
+
+const osg::Vec3f HimmelAmbient::irradiance(
+    const t_sh9 &sh
+,   const osg::Vec3f &normal)
+{
+    // convolution with the clamped cosine per band
+    static const float A[9] = { _PI
+        , _PI * 2.0 / 3.0, _PI * 2.0 / 3.0, _PI * 2.0 / 3.0
+        , _PI_4, _PI_4, _PI_4, _PI_4, _PI_4 };
+
+    float Y[9];
+    basis(normal, Y);
+
+    osg::Vec3f E;
+    for(int i = 0; i < 9; ++i)
+        E += sh.coefficients[i] * (A[i] * Y[i]);
+
+    return E;
+}
+
+
+const osg::Vec3f HimmelAmbient::radiance(
+    const t_sh9 &sh
+,   const osg::Vec3f &direction)
+{
+    float Y[9];
+    basis(direction, Y);
+
+    osg::Vec3f L;
+    for(int i = 0; i < 9; ++i)
+        L += sh.coefficients[i] * Y[i];
+
+    return L;
+}
+
+
+void HimmelAmbient::addDirectional(
+    t_sh9 &sh
+,   const osg::Vec3f &direction
+,   const osg::Vec3f &intensity)
+{
+    float Y[9];
+    basis(direction, Y);
+
+    for(int i = 0; i < 9; ++i)
+        sh.coefficients[i] += intensity * Y[i];
+}
+
+
+void HimmelAmbient::project(
+    t_sh9 &sh
+,   const AtmosphereQuery &query
+,   const osg::Vec3f &sun
+,   const float altitude
+,   const int resolution)
+{
+    const int h = resolution;
+    const int w = resolution * 2;
+
+    std::vector<osg::Vec3f> directions(w);
+    std::vector<osg::Vec3f> radiances(w);
+
+    sh = t_sh9();
+
+    // midpoint rule over azimuth and elevation, one batched query per row
+
+    for(int y = 0; y < h; ++y)
+    {
+        const float e = static_cast<float>(_PI * (y + 0.5) / h - _PI_2);
+
+        const float cose = cos(e);
+        const float sine = sin(e);
+
+        const float omega = static_cast<float>(cose * (_PI / h) * (_PI2 / w));
+
+        for(int x = 0; x < w; ++x)
+        {
+            const float a = static_cast<float>(_PI2 * (x + 0.5) / w);
+            directions[x] = osg::Vec3f(cos(a) * cose, sin(a) * cose, sine);
+        }
+        query.radiance(&directions[0], &radiances[0], w, sun, altitude);
+
+        for(int x = 0; x < w; ++x)
+            addDirectional(sh, directions[x], radiances[x] * omega);
+    }
+}
+
+} // namespace osgHimmel
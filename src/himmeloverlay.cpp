@@ -31,6 +31,7 @@
 
 #include "atime.h"
 #include "julianday.h"
+#include "juliantime.h"
 #include "timef.h"
 #include "abstracthimmel.h"
 #include "himmel.h"
@@ -112,9 +113,10 @@ void HimmelOverlay::update()
     assert(m_himmel);
 
     AbstractAstronomy *astro(m_himmel->astro());
-    const t_aTime atime = t_aTime::fromTimeF(*m_himmel->getTime());
+    // the time the sky is computed for (see Himmel::update), whole seconds
+    const t_aTime atime = t_julianTime::fromTimeF(*m_himmel->getTime()).toATime();
 
-    const osg::Vec4f c = astro->getSunPosition(false).z() < 0.35 ? osg::Vec4f(246, 246, 246, 0.33) : osg::Vec4f(8, 8, 8, 0.33);
+    const osg::Vec4f c = astro->getSnapshot().sun.z() < 0.35 ? osg::Vec4f(246, 246, 246, 0.33) : osg::Vec4f(8, 8, 8, 0.33);
 
     m_text_time->setColor(c);
     m_text_geo->setColor(c);
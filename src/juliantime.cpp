@@ -0,0 +1,147 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "juliantime.h"
+
+#include "timef.h"
+
+#include <math.h>
+
+
+namespace osgHimmel
+{
+
+namespace
+{
+    const double SECONDS_PER_DAY(86400.0);
+
+    // julian day of 1970-01-01 00:00 (the epoch of time_t)
+    const double EPOCH(2440587.5);
+}
+
+
+s_JulianTime::s_JulianTime()
+:   day(-0.5)
+,   fraction(0.5)
+,   utcOffset(0)
+{
+}
+
+
+s_JulianTime::s_JulianTime(
+    const t_julianDay julianDate
+,   const long utcOffset)
+:   utcOffset(utcOffset)
+{
+    // both parts are exact, since the fraction needs no more mantissa
+    // than julianDate has below the integral day
+
+    const t_julianDay midnight(floor(julianDate - 0.5) + 0.5);
+
+    day = static_cast<double>(midnight);
+    fraction = static_cast<double>(julianDate - midnight);
+}
+
+
+s_JulianTime::s_JulianTime(const t_aTime &aTime)
+{
+    *this = s_JulianTime(osgHimmel::jd(aTime), aTime.utcOffset);
+}
+
+
+const s_JulianTime s_JulianTime::fromTimeT(
+    const time_t &time
+,   const long utcOffset
+,   const double fraction)
+{
+    const time_t local(time + utcOffset);
+
+    // days and seconds since the epoch, rounded down for times before
+
+    time_t days(local / 86400);
+    if(local % 86400 < 0)
+        --days;
+
+    const time_t seconds(local - days * 86400);
+
+    s_JulianTime t;
+
+    t.day = EPOCH + static_cast<double>(days);
+    t.fraction = (static_cast<double>(seconds) + fraction) / SECONDS_PER_DAY;
+    t.utcOffset = utcOffset;
+
+    return t;
+}
+
+
+const s_JulianTime s_JulianTime::fromTimeF(const TimeF &t)
+{
+    // the whole seconds are converted like t_aTime does, i.e., via the local
+    // time of the system, so the julian time matches the baseline conversion
+
+    const s_JulianTime whole(t_aTime::fromTimeF(t));
+
+    // the timer nudges its whole seconds up by a tenth, so the fraction
+    // might be slightly negative
+
+    double fraction(static_cast<double>(t.gettf() - static_cast<t_longf>(t.gett())));
+    if(fraction < 0.0)
+        fraction = 0.0;
+
+    return whole + fraction;
+}
+
+
+const t_aTime s_JulianTime::toATime() const
+{
+    return makeTime(jd(), static_cast<short>(utcOffset));
+}
+
+
+const s_JulianTime s_JulianTime::operator+(const double seconds) const
+{
+    const double f(fraction + seconds / SECONDS_PER_DAY);
+    const double d(floor(f));
+
+    s_JulianTime t(*this);
+
+    t.day += d;
+    t.fraction = f - d;
+
+    return t;
+}
+
+
+const double s_JulianTime::operator-(const s_JulianTime &other) const
+{
+    return ((day - other.day) + (fraction - other.fraction)) * SECONDS_PER_DAY
+        - (utcOffset - other.utcOffset);
+}
+
+} // namespace osgHimmel
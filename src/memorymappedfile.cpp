@@ -0,0 +1,216 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "memorymappedfile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else // _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif // _WIN32
+
+#include <cstdio>
+
+
+namespace osgHimmel
+{
+
+MemoryMappedFile::MemoryMappedFile()
+:   m_data(NULL)
+,   m_size(0)
+#ifdef _WIN32
+,   m_file(NULL)
+,   m_mapping(NULL)
+#endif // _WIN32
+{
+}
+
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+    close();
+}
+
+
+#ifdef _WIN32
+
+const bool MemoryMappedFile::open(
+    const char *fileName
+,   const bool copyOnWrite)
+{
+    close();
+
+    HANDLE file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE
+        , NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, NULL);
+
+    if(INVALID_HANDLE_VALUE == file)
+        return false;
+
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(file, &size) || 0 == size.QuadPart)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL
+        , copyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+
+    if(NULL == mapping)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    void *data = MapViewOfFile(mapping
+        , copyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+
+    if(NULL == data)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    m_file    = file;
+    m_mapping = mapping;
+
+    m_data = static_cast<char*>(data);
+    m_size = static_cast<std::size_t>(size.QuadPart);
+
+    return true;
+}
+
+
+void MemoryMappedFile::close()
+{
+    if(m_data)
+        UnmapViewOfFile(m_data);
+    if(m_mapping)
+        CloseHandle(m_mapping);
+    if(m_file)
+        CloseHandle(m_file);
+
+    m_data    = NULL;
+    m_mapping = NULL;
+    m_file    = NULL;
+
+    m_size = 0;
+}
+
+#else // _WIN32
+
+const bool MemoryMappedFile::open(
+    const char *fileName
+,   const bool copyOnWrite)
+{
+    close();
+
+    const int fd = ::open(fileName, O_RDONLY);
+    if(fd < 0)
+        return false;
+
+    struct stat status;
+    if(fstat(fd, &status) != 0 || 0 == status.st_size)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    const std::size_t size = static_cast<std::size_t>(status.st_size);
+
+    void *data = mmap(NULL, size
+        , copyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ
+        , MAP_PRIVATE, fd, 0);
+
+    // the mapping keeps its own reference to the file
+
+    ::close(fd);
+
+    if(MAP_FAILED == data)
+        return false;
+
+    m_data = static_cast<char*>(data);
+    m_size = size;
+
+    return true;
+}
+
+
+void MemoryMappedFile::close()
+{
+    if(m_data)
+        munmap(m_data, m_size);
+
+    m_data = NULL;
+    m_size = 0;
+}
+
+#endif // _WIN32
+
+
+const bool MemoryMappedFile::isOpen() const
+{
+    return NULL != m_data;
+}
+
+
+char *MemoryMappedFile::data()
+{
+    return m_data;
+}
+
+
+const char *MemoryMappedFile::data() const
+{
+    return m_data;
+}
+
+
+const std::size_t MemoryMappedFile::size() const
+{
+    return m_size;
+}
+
+
+const bool MemoryMappedFile::replace(
+    const char *source
+,   const char *target)
+{
+#ifdef _WIN32
+    std::remove(target);
+#endif // _WIN32
+
+    return 0 == std::rename(source, target);
+}
+
+} // namespace osgHimmel
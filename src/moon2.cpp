@@ -32,6 +32,7 @@
 #include "moon.h"
 #include "sun2.h"
 #include "earth2.h"
+#include "periodicterms.h"
 #include "siderealtime.h"
 #include "mathmacros.h"
 
@@ -41,6 +42,59 @@
 namespace osgHimmel
 {
 
+namespace
+{
+    // ("A Physically-Based Night Sky Model" - 2001 - Wann Jensen et al.)
+    // in radians and earth radii
+
+    const t_periodicTerm longitudeTerms[] =
+    {
+        // D   M  Mm   F   O        a    b  e
+        {  0,  0,  1,  0,  0, +0.1098, 0.0, 0 },
+        {  2,  0, -1,  0,  0, +0.0222, 0.0, 0 },
+        {  2,  0,  0,  0,  0, +0.0115, 0.0, 0 },
+        {  0,  0,  2,  0,  0, +0.0037, 0.0, 0 },
+        {  0,  1,  0,  0,  0, -0.0032, 0.0, 0 },
+        {  0,  0,  0,  2,  0, -0.0020, 0.0, 0 },
+        {  2,  0, -2,  0,  0, +0.0010, 0.0, 0 },
+        {  2, -1, -1,  0,  0, +0.0010, 0.0, 0 },
+        {  2,  0,  1,  0,  0, +0.0009, 0.0, 0 },
+        {  2, -1,  0,  0,  0, +0.0008, 0.0, 0 },
+        {  0,  1, -1,  0,  0, -0.0007, 0.0, 0 },
+        {  1,  0,  0,  0,  0, -0.0006, 0.0, 0 },
+        {  0,  1,  1,  0,  0, -0.0005, 0.0, 0 }
+    };
+    const unsigned int numLongitudeTerms(sizeof(longitudeTerms) / sizeof(t_periodicTerm));
+
+    const t_periodicTerm latitudeTerms[] =
+    {
+        // D   M  Mm   F   O        a    b  e
+        {  0,  0,  0,  1,  0, +0.0895, 0.0, 0 },
+        {  0,  0,  1,  1,  0, +0.0049, 0.0, 0 },
+        {  0,  0,  1, -1,  0, +0.0048, 0.0, 0 },
+        {  2,  0,  0, -1,  0, +0.0030, 0.0, 0 },
+        {  2,  0, -1,  1,  0, +0.0010, 0.0, 0 },
+        {  2,  0, -1, -1,  0, +0.0008, 0.0, 0 },
+        {  2,  0,  0,  1,  0, +0.0006, 0.0, 0 }
+    };
+    const unsigned int numLatitudeTerms(sizeof(latitudeTerms) / sizeof(t_periodicTerm));
+
+    // of the inverse distance
+
+    const t_periodicTerm distanceTerms[] =
+    {
+        // D   M  Mm   F   O         a    b  e
+        {  0,  0,  1,  0,  0, +0.000904, 0.0, 0 },
+        {  2,  0, -1,  0,  0, +0.000166, 0.0, 0 },
+        {  2,  0,  0,  0,  0, +0.000137, 0.0, 0 },
+        {  0,  0,  2,  0,  0, +0.000049, 0.0, 0 },
+        {  2,  0,  1,  0,  0, +0.000015, 0.0, 0 },
+        {  2, -1,  0,  0,  0, +0.000009, 0.0, 0 }
+    };
+    const unsigned int numDistanceTerms(sizeof(distanceTerms) / sizeof(t_periodicTerm));
+}
+
+
 // LOW ACCURACY
 
 const float Moon2::meanLongitude(const t_julianDay t)
@@ -121,40 +175,12 @@ const float Moon2::meanOrbitLongitude(const t_julianDay t)
 
 const t_eclf Moon2::position(const t_julianDay t)
 {
-    const float sM = _rad(Sun2::meanAnomaly(t));
+    const t_fundArgsf args(fundamentalArguments2(t));
 
     const float mL = _rad(meanLongitude(t));
-    const float mM = _rad(meanAnomaly(t));
-    const float mD = _rad(meanElongation(t));
-    const float mF = _rad(meanLatitude(t));
-
-    // ("A Physically-Based Night Sky Model" - 2001 - Wann Jensen et al.)
 
-    float Sl = mL;
-
-    Sl += 0.1098 * sin(                 + 1 * mM         );
-    Sl += 0.0222 * sin( 2 * mD          - 1 * mM         );
-    Sl += 0.0115 * sin( 2 * mD                           );
-    Sl += 0.0037 * sin(                 + 2 * mM         );
-    Sl -= 0.0032 * sin(        + 1 * sM                  );
-    Sl -= 0.0020 * sin(                          + 2 * mF);
-    Sl += 0.0010 * sin( 2 * mD          - 2 * mM         );
-    Sl += 0.0010 * sin( 2 * mD - 1 * sM - 1 * mM         );
-    Sl += 0.0009 * sin( 2 * mD          + 1 * mM         );
-    Sl += 0.0008 * sin( 2 * mD - 1 * sM                  );
-    Sl -= 0.0007 * sin(        + 1 * sM - 1 * mM         );
-    Sl -= 0.0006 * sin( 1 * mD                           );
-    Sl -= 0.0005 * sin(        + 1 * sM + 1 * mM         );
-
-    float Sb = 0.0;
-
-    Sb += 0.0895 * sin(                          + 1 * mF);
-    Sb += 0.0049 * sin(                 + 1 * mM + 1 * mF);
-    Sb += 0.0048 * sin(                 + 1 * mM - 1 * mF);
-    Sb += 0.0030 * sin( 2 * mD                   - 1 * mF);
-    Sb += 0.0010 * sin( 2 * mD          - 1 * mM + 1 * mF);
-    Sb += 0.0008 * sin( 2 * mD          - 1 * mM - 1 * mF);
-    Sb += 0.0006 * sin( 2 * mD                   + 1 * mF);
+    const float Sl = mL + sumSines(longitudeTerms, numLongitudeTerms, args);
+    const float Sb = sumSines(latitudeTerms, numLatitudeTerms, args);
 
     t_eclf ecl;
 
@@ -174,12 +200,12 @@ const t_equf Moon2::apparentPosition(const t_julianDay t)
 
 
 const t_horf Moon2::horizontalPosition(
-    const t_aTime &aTime
+    const t_julianTime &time
 ,   const float latitude
 ,   const float longitude)
 {
-    t_julianDay t(jd(aTime));
-    t_julianDay s(siderealTime(aTime));
+    t_julianDay t(time.jd());
+    t_julianDay s(siderealTime(time));
 
     t_equf equ = apparentPosition(t);
 
@@ -192,21 +218,8 @@ const t_horf Moon2::horizontalPosition(
 
 const float Moon2::distance(const t_julianDay t)
 {
-    const float sM = _rad(Sun2::meanAnomaly(t));
-
-    const float mM = _rad(meanAnomaly(t));
-    const float mD = _rad(meanElongation(t));
-
-    // ("A Physically-Based Night Sky Model" - 2001 - Wann Jensen et al.)
-
-    float Sr = 0.016593;
-
-    Sr += 0.000904 * cos(                 + 1 * mM);
-    Sr += 0.000166 * cos( 2 * mD          - 1 * mM);
-    Sr += 0.000137 * cos( 2 * mD                  );
-    Sr += 0.000049 * cos(                 + 2 * mM);
-    Sr += 0.000015 * cos( 2 * mD          + 1 * mM);
-    Sr += 0.000009 * cos( 2 * mD - 1 * sM         );
+    const float Sr = 0.016593f 
+        + sumCosines(distanceTerms, numDistanceTerms, fundamentalArguments2(t));
 
     return Earth2::meanRadius() / Sr;
 }
@@ -246,13 +259,13 @@ void Moon2::opticalLibrations(
 
 
 const float Moon2::parallacticAngle(
-    const t_aTime &aTime
+    const t_julianTime &time
 ,   const float latitude
 ,   const float longitude)
 {
     // (AA.13.1)
 
-    const t_julianDay t(jd(aTime));
+    const t_julianDay t(time.jd());
 
     const float la   = _rad(latitude);
     const float lo   = _rad(longitude);
@@ -261,7 +274,7 @@ const float Moon2::parallacticAngle(
     const float ra   = _rad(pos.right_ascension);
     const float de   = _rad(pos.declination);
 
-    const float s    = _rad(siderealTime(aTime));
+    const float s    = _rad(siderealTime(time));
 
     // (AA.p88) - local hour angle
 
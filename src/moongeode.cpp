@@ -107,20 +107,22 @@ MoonGeode::~MoonGeode()
 
 void MoonGeode::update(const Himmel &himmel)
 {
-    const osg::Vec3f moonv = himmel.astro()->getMoonPosition(false);
-    const osg::Vec3f sunv = himmel.astro()->getSunPosition(false);
+    const t_astronomySnapshot &snapshot(himmel.astro()->getSnapshot());
 
-    const float moons = tan(himmel.astro()->getAngularMoonRadius() * m_scale);
+    const osg::Vec3f moonv = snapshot.moon;
+    const osg::Vec3f sunv = snapshot.sun;
+
+    const float moons = tan(snapshot.angularMoonRadius * m_scale);
 
     u_moon->set(osg::Vec4f(moonv, moons));
 
-    const osg::Vec3f moonrv = himmel.astro()->getMoonPosition(true);
+    const osg::Vec3f moonrv = snapshot.moonRefracted;
     u_moonr->set(osg::Vec4f(moonrv, moonv[3]));
 
-    u_R->set(himmel.astro()->getMoonOrientation());
+    u_R->set(snapshot.moonOrientation);
 
     u_earthShine->set(m_earthShineColor 
-        * himmel.astro()->getEarthShineIntensity() * m_earthShineScale);
+        * snapshot.earthShineIntensity * m_earthShineScale);
 
 
     // TODO: starmap and planets  and stars also require / use this ... - find better place 
@@ -143,13 +145,13 @@ void MoonGeode::update(const Himmel &himmel)
     if(acos(sunv * moonv) > _PI_2)
     {
 
-        const float dm  = himmel.astro()->getMoonDistance();
-        const float ds  = himmel.astro()->getSunDistance();
+        const float dm  = snapshot.moonDistance;
+        const float ds  = snapshot.sunDistance;
 
         const float ids = 1.f / ds;
 
         // scale for the normalized earth-moon system
-        e0  = himmel.astro()->getMoonRadius() / dm;
+        e0  = snapshot.moonRadius / dm;
         e1  = 3.6676 - (397.0001 * dm) * ids;
         e2  = 3.6676 + (404.3354 * dm) * ids;
 
@@ -76,8 +76,10 @@ MoonGlareGeode::~MoonGlareGeode()
 
 void MoonGlareGeode::update(const Himmel &himmel)
 {
-    const osg::Vec3f moonv = himmel.astro()->getMoonPosition(false);
-    const osg::Vec3f sunv  = himmel.astro()->getSunPosition(false);
+    const t_astronomySnapshot &snapshot(himmel.astro()->getSnapshot());
+
+    const osg::Vec3f moonv = snapshot.moon;
+    const osg::Vec3f sunv  = snapshot.sun;
     
     u_phase->set(static_cast<float>(acos(moonv * sunv)));
 }
@@ -0,0 +1,198 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "nutationcache.h"
+
+#include "earth.h"
+#include "periodicterms.h"
+#include "mathmacros.h"
+
+#include <OpenThreads/ScopedLock>
+
+#include <math.h>
+
+
+namespace osgHimmel
+{
+
+namespace
+{
+    // Rates of the fundamental arguments D, M, Mm, F, and O in degrees
+    // per julian century (linear terms of the mean elements, see MoonT).
+
+    const double RATES[5] = { 445267.1115168, 35999.0502909
+        , 477198.8676313, 483202.0175273, -1934.136261 };
+
+    // Sum of the amplitudes times the squared angular frequencies of the
+    // terms of a series, in the unit of the series per day squared.
+
+    const double curvature(const t_periodicSeries &series)
+    {
+        const double perDay(_rad(1.0) / 36525.0);
+
+        double sum(0.0);
+
+        for(unsigned int i = 0; i < series.numTerms; ++i)
+        {
+            const t_periodicTerm &term(series.terms[i]);
+
+            const double w = (term.D * RATES[0] + term.M * RATES[1]
+                + term.Mm * RATES[2] + term.F * RATES[3] + term.O * RATES[4]) * perDay;
+
+            sum += (_abs(term.a) + _abs(term.b)) * w * w;
+        }
+        return sum;
+    }
+}
+
+
+NutationCache::Samples::Samples()
+:   node(0.0)
+,   valid(false)
+{
+    longitude[0] = longitude[1] = 0.0;
+    obliquity[0] = obliquity[1] = 0.0;
+}
+
+
+NutationCache::NutationCache(const double tolerance)
+:   m_tolerance(0.0)
+,   m_spacing(0.0)
+{
+    setTolerance(tolerance);
+}
+
+
+NutationCache::NutationCache(const NutationCache &other)
+:   m_tolerance(0.0)
+,   m_spacing(0.0)
+{
+    setTolerance(other.getTolerance());
+}
+
+
+NutationCache &NutationCache::operator=(const NutationCache &other)
+{
+    setTolerance(other.getTolerance());
+    return *this;
+}
+
+
+const double NutationCache::setTolerance(const double tolerance)
+{
+    m_tolerance = _ma(tolerance, 0.0);
+
+    // the error of the linear interpolation is at most h^2 / 8 times the
+    // bound of the second derivative
+
+    m_spacing = isEnabled() ? sqrt(8.0 * m_tolerance / curvatureBound()) : 0.0;
+
+    clear();
+
+    return getTolerance();
+}
+
+const double NutationCache::getTolerance() const
+{
+    return m_tolerance;
+}
+
+
+const double NutationCache::getSpacing() const
+{
+    return m_spacing;
+}
+
+
+void NutationCache::clear()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+    m_samples = t_samples();
+}
+
+
+void NutationCache::nutations(
+    const t_julianDay t
+,   const SeriesTruncation *truncation
+,   double &longitudeNutation
+,   double &obliquityNutation) const
+{
+    if(!isEnabled())
+    {
+        longitudeNutation = static_cast<double>(Earth::longitudeNutation(t, truncation));
+        obliquityNutation = static_cast<double>(Earth::obliquityNutation(t, truncation));
+
+        return;
+    }
+
+    const double u(static_cast<double>(jdSinceSE(t)) / m_spacing);
+    const double node(floor(u));
+
+    t_samples samples;
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+        samples = m_samples;
+    }
+
+    if(!samples.valid || samples.node != node)
+    {
+        // evaluated outside the lock, the samples of a node are the same
+        // for every thread
+
+        for(int i = 0; i < 2; ++i)
+        {
+            const t_julianDay s(standardEquinox() + (node + i) * m_spacing);
+
+            samples.longitude[i] = static_cast<double>(Earth::longitudeNutation(s, truncation));
+            samples.obliquity[i] = static_cast<double>(Earth::obliquityNutation(s, truncation));
+        }
+        samples.node = node;
+        samples.valid = true;
+
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+        m_samples = samples;
+    }
+
+    const double f(u - node);
+
+    longitudeNutation = samples.longitude[0] + (samples.longitude[1] - samples.longitude[0]) * f;
+    obliquityNutation = samples.obliquity[0] + (samples.obliquity[1] - samples.obliquity[0]) * f;
+}
+
+
+const double NutationCache::curvatureBound()
+{
+    const double l(curvature(SeriesTruncation::completeSeries(SeriesTruncation::S_LongitudeNutation)));
+    const double o(curvature(SeriesTruncation::completeSeries(SeriesTruncation::S_ObliquityNutation)));
+
+    // arcseconds to degrees
+    return _ma(l, o) / 3600.0;
+}
+
+} // namespace osgHimmel
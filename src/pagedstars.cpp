@@ -0,0 +1,754 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "pagedstars.h"
+
+#include "starsindex.h"
+#include "memorymappedfile.h"
+#include "mathmacros.h"
+
+#include <OpenThreads/Thread>
+#include <OpenThreads/ScopedLock>
+
+#include <osg/Notify>
+
+#include <fstream>
+#include <algorithm>
+#include <limits>
+#include <cstdio>
+#include <cstring>
+
+#include <math.h>
+
+
+namespace
+{
+    const char MAGIC[4] = { 'O', 'H', 'P', 'S' };
+    const unsigned int VERSION(1);
+
+    const unsigned int BYTE_ORDER_MARK(0x01020304);
+
+    const std::size_t ALIGNMENT(64);
+
+    // naked eye, binoculars, and telescopes of increasing aperture
+    const float LAYERS[] = { 6.5f, 9.f, 11.f, 13.f, 15.f };
+    const unsigned int NUM_LAYERS(sizeof(LAYERS) / sizeof(float) + 1);
+
+    typedef struct FileHeader
+    {
+        char magic[4];
+        unsigned int version;
+        unsigned int byteOrder;
+        unsigned int recordSize;  // in bytes per star
+        unsigned int tileSize;    // in bytes per tile
+
+        unsigned int numTiles;
+        unsigned int numStars;
+
+        unsigned int tilesOffset; // in bytes from the beginning of the file
+        unsigned int starsOffset;
+
+    } t_fileHeader;
+
+    typedef struct FileTile
+    {
+        float axis[3];
+        float radius;
+
+        float brightest;
+        float faintest;
+
+        unsigned int layer;
+        unsigned int first;
+        unsigned int count;
+
+    } t_fileTile;
+
+
+    const std::size_t align(const std::size_t offset)
+    {
+        return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+}
+
+
+namespace osgHimmel
+{
+
+class PagedStars::Loader : public OpenThreads::Thread
+{
+public:
+
+    Loader(PagedStars &paged)
+    :   OpenThreads::Thread()
+    ,   m_paged(paged)
+    {
+    }
+
+    virtual void run()
+    {
+        std::ifstream stream(m_paged.m_fileName.c_str(), std::ios::binary);
+
+        while(true)
+        {
+            unsigned int i;
+            {
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_paged.m_mutex);
+
+                while(!m_paged.m_quit && m_paged.m_queue.empty())
+                    m_paged.m_condition.wait(&m_paged.m_mutex);
+
+                if(m_paged.m_quit)
+                    return;
+
+                i = m_paged.m_queue.front();
+                m_paged.m_queue.pop_front();
+
+                m_paged.m_loading = true;
+            }
+
+            // the tiles do not change after open
+
+            const t_tile &tile(m_paged.m_tiles[i]);
+
+            BrightStars::s_BrightStar *stars(new BrightStars::s_BrightStar[tile.count]);
+
+            stream.clear();
+            stream.seekg(static_cast<std::streamoff>(m_paged.m_offset)
+                + static_cast<std::streamoff>(tile.first) * sizeof(BrightStars::s_BrightStar));
+            stream.read(reinterpret_cast<char*>(stars), tile.count * sizeof(BrightStars::s_BrightStar));
+
+            if(!stream)
+            {
+                delete[] stars;
+                stars = NULL;
+            }
+
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_paged.m_mutex);
+
+            m_paged.m_loaded.push_back(std::make_pair(i, stars));
+            m_paged.m_loading = false;
+
+            m_paged.m_condition.broadcast();
+        }
+    }
+
+protected:
+
+    PagedStars &m_paged;
+};
+
+
+PagedStars::Statistics::Statistics()
+:   residentBytes(0)
+,   residentTiles(0)
+,   pendingTiles(0)
+,   droppedTiles(0)
+,   loadedTiles(0)
+,   evictedTiles(0)
+,   lastLatency(0.0)
+,   meanLatency(0.0)
+,   maxLatency(0.0)
+{
+}
+
+
+PagedStars::Page::Page()
+:   stars(NULL)
+,   used(0)
+,   applied(0)
+,   requested(0)
+,   queued(false)
+,   failed(false)
+{
+}
+
+
+bool PagedStars::Candidate::operator<(const Candidate &other) const
+{
+    return layer < other.layer || (layer == other.layer && angle < other.angle);
+}
+
+
+PagedStars::PagedStars(
+    const char *fileName
+,   const std::size_t budget)
+:   m_offset(0)
+,   m_frame(1)
+,   m_budget(budget)
+,   m_loading(false)
+,   m_quit(false)
+,   m_loader(NULL)
+{
+    open(fileName);
+}
+
+
+PagedStars::~PagedStars()
+{
+    if(m_loader)
+    {
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+
+            m_quit = true;
+            m_condition.broadcast();
+        }
+        m_loader->join();
+
+        delete m_loader;
+    }
+
+    for(unsigned int i = 0; i < m_pages.size(); ++i)
+        delete[] m_pages[i].stars;
+
+    for(unsigned int i = 0; i < m_loaded.size(); ++i)
+        delete[] m_loaded[i].second;
+}
+
+
+void PagedStars::open(const char *fileName)
+{
+    std::ifstream stream(fileName, std::ios::binary);
+    if(!stream)
+        return;
+
+    t_fileHeader header;
+    stream.read(reinterpret_cast<char*>(&header), sizeof(t_fileHeader));
+
+    if(!stream || memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+        return;
+
+    stream.seekg(0, std::ios::end);
+    const std::streamoff size(stream.tellg());
+
+    if(header.version != VERSION
+    || header.byteOrder != BYTE_ORDER_MARK
+    || header.recordSize != sizeof(BrightStars::s_BrightStar)
+    || header.tileSize != sizeof(t_fileTile)
+    || header.starsOffset % ALIGNMENT != 0
+    || static_cast<std::streamoff>(header.tilesOffset) + header.numTiles * sizeof(t_fileTile) > header.starsOffset
+    || size < static_cast<std::streamoff>(header.starsOffset) 
+        + static_cast<std::streamoff>(header.numStars) * static_cast<std::streamoff>(sizeof(BrightStars::s_BrightStar)))
+    {
+        OSG_WARN << "Paged stars file \"" << fileName << "\" is invalid or of another version or byte order." << std::endl;
+        return;
+    }
+
+    std::vector<t_fileTile> tiles(header.numTiles);
+
+    stream.seekg(header.tilesOffset);
+    if(header.numTiles > 0)
+        stream.read(reinterpret_cast<char*>(&tiles[0]), header.numTiles * sizeof(t_fileTile));
+
+    if(!stream)
+        return;
+
+    m_tiles.resize(header.numTiles);
+
+    for(unsigned int i = 0; i < header.numTiles; ++i)
+    {
+        const t_fileTile &source(tiles[i]);
+
+        if(source.first > header.numStars || source.count > header.numStars - source.first)
+        {
+            m_tiles.clear();
+            return;
+        }
+
+        t_tile &tile(m_tiles[i]);
+
+        tile.axis = osg::Vec3f(source.axis[0], source.axis[1], source.axis[2]);
+        tile.radius = source.radius;
+        tile.brightest = source.brightest;
+        tile.faintest = source.faintest;
+        tile.layer = source.layer;
+        tile.first = source.first;
+        tile.count = source.count;
+    }
+
+    m_pages.resize(header.numTiles);
+
+    m_fileName = fileName;
+    m_offset = header.starsOffset;
+
+    m_loader = new Loader(*this);
+    m_loader->start();
+}
+
+
+const bool PagedStars::isOpen() const
+{
+    return NULL != m_loader;
+}
+
+
+const bool PagedStars::isPaged(const char *fileName)
+{
+    std::ifstream stream(fileName, std::ios::binary);
+
+    char magic[4];
+    stream.read(magic, sizeof(magic));
+
+    return stream && memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+
+const unsigned int PagedStars::toFile(
+    const BrightStars::s_BrightStar *stars
+,   const unsigned int numStars
+,   const char *fileName
+,   const unsigned int maxStarsPerTile)
+{
+    if(!stars || 0 == numStars)
+        return 0;
+
+    std::vector<t_fileTile> tiles;
+
+    std::vector<unsigned int> order;
+    order.reserve(numStars);
+
+    // per layer, the tiles of the cells of an index of its stars
+
+    for(unsigned int l = 0; l < NUM_LAYERS; ++l)
+    {
+        std::vector<unsigned int> indices;
+        for(unsigned int i = 0; i < numStars; ++i)
+        {
+            const float vmag(stars[i].Vmag);
+
+            if((l == 0 || !(vmag <= layer(l - 1))) && (l == NUM_LAYERS - 1 || vmag <= layer(l)))
+                indices.push_back(i);
+        }
+
+        if(indices.empty())
+            continue;
+
+        std::vector<BrightStars::s_BrightStar> layerStars(indices.size());
+        for(unsigned int i = 0; i < indices.size(); ++i)
+            layerStars[i] = stars[indices[i]];
+
+        StarsIndex index;
+        index.build(&layerStars[0], static_cast<unsigned int>(layerStars.size()), maxStarsPerTile);
+
+        for(unsigned int c = 0; c < index.numCells(); ++c)
+        {
+            const StarsIndex::t_cell &cell(index.cell(c));
+
+            t_fileTile tile;
+
+            tile.axis[0] = cell.axis[0];
+            tile.axis[1] = cell.axis[1];
+            tile.axis[2] = cell.axis[2];
+            tile.radius = cell.radius;
+
+            tile.brightest = cell.brightest;
+            tile.faintest = layerStars[index.order()[cell.first + cell.count - 1]].Vmag;
+
+            tile.layer = l;
+            tile.first = static_cast<unsigned int>(order.size());
+            tile.count = cell.count;
+
+            tiles.push_back(tile);
+
+            for(unsigned int i = cell.first; i < cell.first + cell.count; ++i)
+                order.push_back(indices[index.order()[i]]);
+        }
+    }
+
+    t_fileHeader header = t_fileHeader();
+
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version     = VERSION;
+    header.byteOrder   = BYTE_ORDER_MARK;
+    header.recordSize  = sizeof(BrightStars::s_BrightStar);
+    header.tileSize    = sizeof(t_fileTile);
+    header.numTiles    = static_cast<unsigned int>(tiles.size());
+    header.numStars    = static_cast<unsigned int>(order.size());
+    header.tilesOffset = static_cast<unsigned int>(align(sizeof(t_fileHeader)));
+    header.starsOffset = static_cast<unsigned int>(align(header.tilesOffset + tiles.size() * sizeof(t_fileTile)));
+
+    const std::string path(fileName);
+    const std::string temp(path + ".tmp");
+
+    std::ofstream stream(temp.c_str(), std::ios::binary);
+    if(!stream)
+        return 0;
+
+    const char padding[ALIGNMENT] = { 0 };
+
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(t_fileHeader));
+    stream.write(padding, header.tilesOffset - sizeof(t_fileHeader));
+    stream.write(reinterpret_cast<const char*>(&tiles[0]), tiles.size() * sizeof(t_fileTile));
+    stream.write(padding, header.starsOffset - header.tilesOffset - tiles.size() * sizeof(t_fileTile));
+
+    // in chunks, in the order of the tiles
+
+    std::vector<BrightStars::s_BrightStar> chunk;
+    chunk.reserve(4096);
+
+    for(unsigned int i = 0; i < order.size(); ++i)
+    {
+        chunk.push_back(stars[order[i]]);
+
+        if(chunk.size() == chunk.capacity() || i + 1 == order.size())
+        {
+            stream.write(reinterpret_cast<const char*>(&chunk[0]), chunk.size() * sizeof(BrightStars::s_BrightStar));
+            chunk.clear();
+        }
+    }
+    stream.close();
+
+    if(stream.fail())
+    {
+        std::remove(temp.c_str());
+        return 0;
+    }
+
+    if(!MemoryMappedFile::replace(temp.c_str(), path.c_str()))
+    {
+        std::remove(temp.c_str());
+        return 0;
+    }
+    return header.numStars;
+}
+
+
+const unsigned int PagedStars::convert(
+    const char *sourceFileName
+,   const char *targetFileName
+,   const unsigned int maxStarsPerTile)
+{
+    const BrightStars stars(sourceFileName);
+
+    return toFile(stars.stars(), stars.numStars(), targetFileName, maxStarsPerTile);
+}
+
+
+const unsigned int PagedStars::defaultMaxStarsPerTile()
+{
+    return 4096;
+}
+
+
+const std::size_t PagedStars::defaultBudget()
+{
+    return 64 * 1024 * 1024;
+}
+
+
+const unsigned int PagedStars::version()
+{
+    return VERSION;
+}
+
+
+const unsigned int PagedStars::numLayers()
+{
+    return NUM_LAYERS;
+}
+
+
+const float PagedStars::layer(const unsigned int i)
+{
+    return i < NUM_LAYERS - 1 ? LAYERS[i] : std::numeric_limits<float>::max();
+}
+
+
+const std::size_t PagedStars::setBudget(const std::size_t bytes)
+{
+    m_budget = bytes;
+    return getBudget();
+}
+
+const std::size_t PagedStars::getBudget() const
+{
+    return m_budget;
+}
+
+
+const unsigned int PagedStars::numStars() const
+{
+    return m_tiles.empty() ? 0 : m_tiles.back().first + m_tiles.back().count;
+}
+
+
+const unsigned int PagedStars::numTiles() const
+{
+    return static_cast<unsigned int>(m_tiles.size());
+}
+
+
+const PagedStars::t_tile &PagedStars::tile(const unsigned int i) const
+{
+    return m_tiles[i];
+}
+
+
+const unsigned int PagedStars::request(
+    const osg::Vec3f &direction
+,   const float halfAngle
+,   const float limitingMagnitude)
+{
+    unsigned int resident(0);
+
+    for(unsigned int i = 0; i < m_tiles.size(); ++i)
+    {
+        const t_tile &tile(m_tiles[i]);
+
+        if(tile.brightest > limitingMagnitude || m_pages[i].failed)
+            continue;
+
+        const float angle(acos(_clamp(-1.f, 1.f, tile.axis * direction)) - tile.radius);
+        if(angle > halfAngle)
+            continue;
+
+        t_candidate candidate;
+
+        candidate.tile = i;
+        candidate.layer = tile.layer;
+        candidate.angle = _ma(angle, 0.f);
+
+        m_candidates.push_back(candidate);
+
+        if(m_pages[i].stars)
+            ++resident;
+    }
+    return resident;
+}
+
+
+void PagedStars::update(
+    std::vector<unsigned int> &loaded
+,   std::vector<unsigned int> &evicted)
+{
+    loaded.clear();
+    evicted.clear();
+
+    const osg::Timer_t now(osg::Timer::instance()->tick());
+
+    // the tiles loaded since the last update
+
+    std::vector<std::pair<unsigned int, BrightStars::s_BrightStar*> > pages;
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+        pages.swap(m_loaded);
+    }
+
+    for(unsigned int p = 0; p < pages.size(); ++p)
+    {
+        const unsigned int i(pages[p].first);
+        t_page &page(m_pages[i]);
+
+        page.queued = false;
+
+        if(!pages[p].second)
+        {
+            OSG_WARN << "Paged stars file \"" << m_fileName << "\" is truncated." << std::endl;
+
+            page.failed = true;
+            continue;
+        }
+
+        page.stars = pages[p].second;
+        page.applied = m_frame;
+
+        m_statistics.residentBytes += m_tiles[i].count * sizeof(BrightStars::s_BrightStar);
+        ++m_statistics.residentTiles;
+        ++m_statistics.loadedTiles;
+
+        const double latency(osg::Timer::instance()->delta_s(page.requested, now));
+
+        m_statistics.lastLatency = latency;
+        m_statistics.meanLatency += (latency - m_statistics.meanLatency) / m_statistics.loadedTiles;
+        m_statistics.maxLatency = _ma(m_statistics.maxLatency, latency);
+
+        page.requested = 0;
+
+        loaded.push_back(i);
+    }
+
+    // the requested tiles by priority, as long as all fit the budget
+
+    std::sort(m_candidates.begin(), m_candidates.end());
+
+    std::vector<unsigned int> queue;
+
+    std::size_t bytes(0);
+    unsigned int dropped(0);
+
+    for(unsigned int c = 0; c < m_candidates.size(); ++c)
+    {
+        const unsigned int i(m_candidates[c].tile);
+        t_page &page(m_pages[i]);
+
+        // requested by several views
+        if(page.used == m_frame)
+            continue;
+
+        const std::size_t size(m_tiles[i].count * sizeof(BrightStars::s_BrightStar));
+        if(bytes + size > m_budget)
+        {
+            ++dropped;
+            continue;
+        }
+
+        bytes += size;
+        page.used = m_frame;
+
+        if(!page.stars)
+            queue.push_back(i);
+    }
+    m_candidates.clear();
+
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+
+        // Replaces the queue. Tiles that are still queued afterwards are
+        // loading or loaded (until the next update).
+
+        std::deque<unsigned int> former;
+        former.swap(m_queue);
+
+        for(unsigned int q = 0; q < former.size(); ++q)
+            m_pages[former[q]].queued = false;
+
+        for(unsigned int q = 0; q < queue.size(); ++q)
+        {
+            t_page &page(m_pages[queue[q]]);
+
+            if(page.queued)
+                continue;
+
+            // tiles still requested keep their first request
+            if(0 == page.requested)
+                page.requested = now;
+
+            page.queued = true;
+            m_queue.push_back(queue[q]);
+        }
+
+        for(unsigned int q = 0; q < former.size(); ++q)
+            if(!m_pages[former[q]].queued)
+                m_pages[former[q]].requested = 0;
+
+        m_statistics.pendingTiles = static_cast<unsigned int>(m_queue.size() + m_loaded.size()) + (m_loading ? 1 : 0);
+
+        if(!m_queue.empty())
+            m_condition.broadcast();
+    }
+
+    // evicts the least recently requested tiles beyond the budget, but 
+    // not the ones just returned as loaded (which might have been loaded 
+    // for a view that moved away meanwhile)
+
+    if(m_statistics.residentBytes > m_budget)
+    {
+        std::vector<std::pair<unsigned int, unsigned int> > lru;
+
+        for(unsigned int i = 0; i < m_pages.size(); ++i)
+            if(m_pages[i].stars && m_pages[i].used != m_frame && m_pages[i].applied != m_frame)
+                lru.push_back(std::make_pair(m_pages[i].used, i));
+
+        std::sort(lru.begin(), lru.end());
+
+        for(unsigned int l = 0; l < lru.size() && m_statistics.residentBytes > m_budget; ++l)
+        {
+            const unsigned int i(lru[l].second);
+
+            delete[] m_pages[i].stars;
+            m_pages[i].stars = NULL;
+
+            m_statistics.residentBytes -= m_tiles[i].count * sizeof(BrightStars::s_BrightStar);
+            --m_statistics.residentTiles;
+            ++m_statistics.evictedTiles;
+
+            evicted.push_back(i);
+        }
+    }
+
+    m_statistics.droppedTiles = dropped;
+
+    ++m_frame;
+}
+
+
+const bool PagedStars::isResident(const unsigned int i) const
+{
+    return NULL != m_pages[i].stars;
+}
+
+
+const BrightStars::s_BrightStar *PagedStars::stars(const unsigned int i) const
+{
+    return m_pages[i].stars;
+}
+
+
+const unsigned int PagedStars::numBrighter(
+    const unsigned int i
+,   const float limitingMagnitude) const
+{
+    const BrightStars::s_BrightStar *stars(m_pages[i].stars);
+    if(!stars)
+        return 0;
+
+    // binary search, the stars of the tile are sorted by magnitude
+
+    unsigned int lower(0);
+    unsigned int upper(m_tiles[i].count);
+
+    while(lower < upper)
+    {
+        const unsigned int middle((lower + upper) / 2);
+
+        if(stars[middle].Vmag <= limitingMagnitude)
+            lower = middle + 1;
+        else
+            upper = middle;
+    }
+    return lower;
+}
+
+
+const PagedStars::t_statistics &PagedStars::statistics() const
+{
+    return m_statistics;
+}
+
+
+void PagedStars::wait() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+
+    while(!m_queue.empty() || m_loading)
+        m_condition.wait(&m_mutex);
+}
+
+} // namespace osgHimmel
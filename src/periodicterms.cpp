@@ -0,0 +1,565 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "periodicterms.h"
+
+#include "sun.h"
+#include "sun2.h"
+#include "moon.h"
+#include "moon2.h"
+#include "mathmacros.h"
+
+#include <algorithm>
+
+
+namespace osgHimmel
+{
+
+namespace
+{
+    // (AA.45.A) and (AA.45.B) in 0.001 degrees and kilometers
+
+    const t_periodicTerm longitudeTerms[] =
+    {
+        // D   M  Mm   F   O          a    b  e
+        {  0,  0,  1,  0,  0, +6288.774, 0.0, 0 },
+        {  2,  0, -1,  0,  0, +1274.027, 0.0, 0 },
+        {  2,  0,  0,  0,  0,  +658.314, 0.0, 0 },
+        {  0,  0,  2,  0,  0,  +213.618, 0.0, 0 },
+        {  0,  1,  0,  0,  0,  -185.116, 0.0, 1 },
+        {  0,  0,  0,  2,  0,  -114.332, 0.0, 0 },
+        {  2,  0, -2,  0,  0,   +58.793, 0.0, 0 },
+        {  2, -1, -1,  0,  0,   +57.066, 0.0, 1 },
+        {  2,  0,  1,  0,  0,   +53.322, 0.0, 0 },
+        {  2, -1,  0,  0,  0,   +45.758, 0.0, 1 },
+        {  0,  1, -1,  0,  0,   -40.923, 0.0, 1 },
+        {  1,  0,  0,  0,  0,   -34.720, 0.0, 0 },
+        {  0,  1,  1,  0,  0,   -30.383, 0.0, 1 },
+        {  2,  0,  0, -2,  0,   +15.327, 0.0, 0 },
+        {  0,  0,  1,  2,  0,   -12.528, 0.0, 0 },
+        {  0,  0,  1, -2,  0,   +10.980, 0.0, 0 },
+        {  4,  0, -1,  0,  0,   +10.675, 0.0, 0 },
+        {  0,  0,  3,  0,  0,   +10.034, 0.0, 0 },
+        {  4,  0, -2,  0,  0,    +8.548, 0.0, 0 },
+        {  2,  1, -1,  0,  0,    -7.888, 0.0, 1 },
+        {  2,  1,  0,  0,  0,    -6.766, 0.0, 1 },
+        {  1,  0, -1,  0,  0,    -5.163, 0.0, 0 },
+        {  1,  1,  0,  0,  0,    +4.987, 0.0, 1 },
+        {  2, -1,  1,  0,  0,    +4.036, 0.0, 1 },
+        {  2,  0,  2,  0,  0,    +3.994, 0.0, 0 },
+        {  4,  0,  0,  0,  0,    +3.861, 0.0, 0 },
+        {  2,  0, -3,  0,  0,    +3.665, 0.0, 0 },
+        {  0,  1, -2,  0,  0,    -2.689, 0.0, 1 },
+        {  2,  0, -1,  2,  0,    -2.602, 0.0, 0 },
+        {  2, -1, -2,  0,  0,    +2.390, 0.0, 1 },
+        {  1,  0,  1,  0,  0,    -2.348, 0.0, 0 },
+        {  2, -2,  0,  0,  0,    +2.236, 0.0, 2 },
+        {  0,  1,  2,  0,  0,    -2.120, 0.0, 1 },
+        {  0,  2,  0,  0,  0,    -2.069, 0.0, 2 },
+        {  2, -2, -1,  0,  0,    +2.048, 0.0, 2 },
+        {  2,  0,  1, -2,  0,    -1.773, 0.0, 0 },
+        {  2,  0,  0,  2,  0,    -1.595, 0.0, 0 },
+        {  4, -1, -1,  0,  0,    +1.215, 0.0, 1 },
+        {  0,  0,  2,  2,  0,    -1.110, 0.0, 0 },
+        {  3,  0, -1,  0,  0,    -0.892, 0.0, 0 },
+        {  2,  1,  1,  0,  0,    -0.810, 0.0, 1 },
+        {  4, -1, -2,  0,  0,    +0.759, 0.0, 1 },
+        {  0,  2, -1,  0,  0,    -0.713, 0.0, 2 },
+        {  2,  2, -1,  0,  0,    -0.700, 0.0, 2 },
+        {  2,  1, -2,  0,  0,    +0.691, 0.0, 0 },
+        {  2, -1,  0, -2,  0,    +0.596, 0.0, 1 },
+        {  4,  0,  1,  0,  0,    +0.549, 0.0, 0 },
+        {  0,  0,  4,  0,  0,    +0.537, 0.0, 0 },
+        {  4, -1,  0,  0,  0,    +0.520, 0.0, 1 },
+        {  1,  0, -2,  0,  0,    -0.487, 0.0, 0 },
+        {  2,  1,  0, -2,  0,    -0.399, 0.0, 1 },
+        {  0,  0,  2, -2,  0,    -0.381, 0.0, 0 },
+        {  1,  1,  1,  0,  0,    +0.351, 0.0, 1 },
+        {  3,  0, -2,  0,  0,    -0.340, 0.0, 0 },
+        {  4,  0, -3,  0,  0,    +0.330, 0.0, 0 },
+        {  2, -1,  2,  0,  0,    +0.327, 0.0, 1 },
+        {  0,  2,  1,  0,  0,    -0.323, 0.0, 2 },
+        {  1,  1, -1,  0,  0,    +0.299, 0.0, 1 },
+        {  2,  0,  3,  0,  0,    +0.294, 0.0, 0 }
+    };
+
+    const unsigned int numLongitudeTerms(sizeof(longitudeTerms) / sizeof(t_periodicTerm));
+
+
+    const t_periodicTerm latitudeTerms[] =
+    {
+        // D   M  Mm   F   O          a    b  e
+        {  0,  0,  0,  1,  0, +5128.122, 0.0, 0 },
+        {  0,  0,  1,  1,  0,  +280.602, 0.0, 0 },
+        {  0,  0,  1, -1,  0,  +277.693, 0.0, 0 },
+        {  2,  0,  0, -1,  0,  +173.237, 0.0, 0 },
+        {  2,  0, -1,  1,  0,   +55.413, 0.0, 0 },
+        {  2,  0, -1, -1,  0,   +46.271, 0.0, 0 },
+        {  2,  0,  0,  1,  0,   +32.573, 0.0, 0 },
+        {  0,  0,  2,  1,  0,   +17.198, 0.0, 0 },
+        {  2,  0,  1, -1,  0,    +9.266, 0.0, 0 },
+        {  0,  0,  2, -1,  0,    +8.822, 0.0, 0 },
+        {  2, -1,  0, -1,  0,    +8.216, 0.0, 1 },
+        {  2,  0, -2, -1,  0,    +4.324, 0.0, 0 },
+        {  2,  0,  1,  1,  0,    +4.200, 0.0, 0 },
+        {  2,  1,  0, -1,  0,    -3.359, 0.0, 1 },
+        {  2, -1, -1,  1,  0,    +2.463, 0.0, 1 },
+        {  2, -1,  0,  1,  0,    +2.211, 0.0, 1 },
+        {  2, -1, -1, -1,  0,    +2.065, 0.0, 1 },
+        {  0,  1, -1, -1,  0,    -1.870, 0.0, 1 },
+        {  4,  0, -1, -1,  0,    +1.828, 0.0, 0 },
+        {  0,  1,  0,  1,  0,    -1.794, 0.0, 1 },
+        {  0,  0,  0,  3,  0,    -1.749, 0.0, 0 },
+        {  0,  1, -1,  1,  0,    -1.565, 0.0, 1 },
+        {  1,  0,  0,  1,  0,    -1.491, 0.0, 0 },
+        {  0,  1,  1,  1,  0,    -1.475, 0.0, 1 },
+        {  0,  1,  1, -1,  0,    -1.410, 0.0, 1 },
+        {  0,  1,  0, -1,  0,    -1.344, 0.0, 1 },
+        {  1,  0,  0, -1,  0,    -1.335, 0.0, 0 },
+        {  0,  0,  3,  1,  0,    +1.107, 0.0, 0 },
+        {  4,  0,  0, -1,  0,    +1.024, 0.0, 0 },
+        {  4,  0, -1,  1,  0,    +0.833, 0.0, 0 },
+        {  0,  0,  1, -3,  0,    +0.777, 0.0, 0 },
+        {  4,  0, -2,  1,  0,    +0.671, 0.0, 0 },
+        {  2,  0,  0, -3,  0,    +0.607, 0.0, 0 },
+        {  2,  0,  2, -1,  0,    +0.596, 0.0, 0 },
+        {  2, -1,  1, -1,  0,    +0.491, 0.0, 1 },
+        {  2,  0, -2,  1,  0,    -0.451, 0.0, 0 },
+        {  0,  0,  3, -1,  0,    +0.439, 0.0, 0 },
+        {  2,  0,  2,  1,  0,    +0.422, 0.0, 0 },
+        {  2,  0, -3, -1,  0,    +0.421, 0.0, 0 },
+        {  2,  1, -1,  1,  0,    -0.366, 0.0, 1 },
+        {  2,  1,  0,  1,  0,    -0.351, 0.0, 1 },
+        {  4,  0,  0,  1,  0,    +0.331, 0.0, 0 },
+        {  2, -1,  1,  1,  0,    +0.315, 0.0, 1 },
+        {  2, -2,  0, -1,  0,    +0.302, 0.0, 2 },
+        {  0,  0,  1,  3,  0,    -0.283, 0.0, 0 },
+        {  2,  1,  1, -1,  0,    -0.229, 0.0, 1 },
+        {  1,  1,  0, -1,  0,    +0.223, 0.0, 1 },
+        {  1,  1,  0,  1,  0,    +0.223, 0.0, 1 },
+        {  0,  1, -2, -1,  0,    -0.220, 0.0, 1 },
+        {  2,  1, -1, -1,  0,    -0.220, 0.0, 1 },
+        {  1,  0,  1,  1,  0,    -0.185, 0.0, 0 },
+        {  2, -1, -2, -1,  0,    +0.181, 0.0, 1 },
+        {  0,  1,  2,  1,  0,    -0.177, 0.0, 1 },
+        {  4,  0, -2, -1,  0,    +0.176, 0.0, 0 },
+        {  4, -1, -1, -1,  0,    +0.166, 0.0, 1 },
+        {  1,  0,  1, -1,  0,    -0.164, 0.0, 0 },
+        {  4,  0,  1, -1,  0,    +0.132, 0.0, 0 },
+        {  1,  0, -1, -1,  0,    -0.119, 0.0, 0 },
+        {  4, -1,  0, -1,  0,    +0.115, 0.0, 1 },
+        {  2, -2,  0,  1,  0,    +0.107, 0.0, 2 }
+    };
+
+    const unsigned int numLatitudeTerms(sizeof(latitudeTerms) / sizeof(t_periodicTerm));
+
+
+    const t_periodicTerm distanceTerms[] =
+    {
+        // D   M  Mm   F   O           a    b  e
+        {  0,  0,  1,  0,  0, -20905.355, 0.0, 0 },
+        {  2,  0, -1,  0,  0,  -3699.111, 0.0, 0 },
+        {  2,  0,  0,  0,  0,  -2955.968, 0.0, 0 },
+        {  0,  0,  2,  0,  0,   -569.925, 0.0, 0 },
+        {  0,  1,  0,  0,  0,    +48.888, 0.0, 1 },
+        {  0,  0,  0,  2,  0,     -3.149, 0.0, 0 },
+        {  2,  0, -2,  0,  0,   +246.158, 0.0, 0 },
+        {  2, -1, -1,  0,  0,   -152.138, 0.0, 1 },
+        {  2,  0,  1,  0,  0,   -170.733, 0.0, 0 },
+        {  2, -1,  0,  0,  0,   -204.586, 0.0, 1 },
+        {  0,  1, -1,  0,  0,   -129.620, 0.0, 1 },
+        {  1,  0,  0,  0,  0,   +108.743, 0.0, 0 },
+        {  0,  1,  1,  0,  0,   +104.755, 0.0, 1 },
+        {  2,  0,  0, -2,  0,    +10.321, 0.0, 0 },
+        {  0,  0,  1, -2,  0,    +79.661, 0.0, 0 },
+        {  4,  0, -1,  0,  0,    -34.782, 0.0, 0 },
+        {  0,  0,  3,  0,  0,    -23.210, 0.0, 0 },
+        {  4,  0, -2,  0,  0,    -21.636, 0.0, 0 },
+        {  2,  1, -1,  0,  0,    +24.208, 0.0, 1 },
+        {  2,  1,  0,  0,  0,    +30.824, 0.0, 1 },
+        {  1,  0, -1,  0,  0,     -8.379, 0.0, 0 },
+        {  1,  1,  0,  0,  0,    -16.675, 0.0, 1 },
+        {  2, -1,  1,  0,  0,    -12.831, 0.0, 1 },
+        {  2,  0,  2,  0,  0,    -10.445, 0.0, 0 },
+        {  4,  0,  0,  0,  0,    -11.650, 0.0, 0 },
+        {  2,  0, -3,  0,  0,    +14.403, 0.0, 0 },
+        {  0,  1, -2,  0,  0,     -7.003, 0.0, 1 },
+        {  2, -1, -2,  0,  0,    +10.056, 0.0, 1 },
+        {  1,  0,  1,  0,  0,     +6.322, 0.0, 0 },
+        {  2, -2,  0,  0,  0,     -9.884, 0.0, 2 },
+        {  0,  1,  2,  0,  0,     +5.751, 0.0, 1 },
+        {  2, -2, -1,  0,  0,     -4.950, 0.0, 2 },
+        {  2,  0,  1, -2,  0,     +4.130, 0.0, 0 },
+        {  4, -1, -1,  0,  0,     -3.958, 0.0, 1 },
+        {  3,  0, -1,  0,  0,     +3.258, 0.0, 0 },
+        {  2,  1,  1,  0,  0,     +2.616, 0.0, 1 },
+        {  4, -1, -2,  0,  0,     -1.897, 0.0, 1 },
+        {  0,  2, -1,  0,  0,     -2.117, 0.0, 2 },
+        {  2,  2, -1,  0,  0,     +2.354, 0.0, 2 },
+        {  4,  0,  1,  0,  0,     -1.423, 0.0, 0 },
+        {  0,  0,  4,  0,  0,     -1.117, 0.0, 0 },
+        {  4, -1,  0,  0,  0,     -1.571, 0.0, 1 },
+        {  1,  0, -2,  0,  0,     -1.739, 0.0, 0 },
+        {  0,  0,  2, -2,  0,     -4.421, 0.0, 0 },
+        {  0,  2,  1,  0,  0,     +1.165, 0.0, 2 },
+        {  2,  0, -1, -2,  0,     +8.752, 0.0, 0 }
+    };
+
+    const unsigned int numDistanceTerms(sizeof(distanceTerms) / sizeof(t_periodicTerm));
+
+
+    // (AA.21.A) in arcseconds
+
+    const t_periodicTerm longitudeNutationTerms[] =
+    {
+        // D   M  Mm   F   O         a         b  e
+        {  0,  0,  0,  0,  1, -17.1996, +0.01742, 0 },
+        { -2,  0,  0,  2,  2,  -1.3187, +0.00016, 0 },
+        {  0,  0,  0,  2,  2,  -0.2274, +0.00002, 0 },
+        {  0,  0,  0,  0,  2,  +0.2062, +0.00002, 0 },
+        {  0,  1,  0,  0,  0,  +0.1426, -0.00034, 0 },
+        {  0,  0,  1,  0,  0,  +0.0712, +0.00001, 0 },
+        { -2,  1,  0,  2,  2,  +0.0517, +0.00012, 0 },
+        {  0,  0,  0,  2,  1,  -0.0386, +0.00004, 0 },
+        {  0,  0,  1,  2,  2,  -0.0301,      0.0, 0 },
+        { -2, -1,  0,  2,  2,  +0.0217, -0.00005, 0 },
+        { -2,  0,  1,  0,  0,  -0.0158,      0.0, 0 },
+        { -2,  0,  0,  2,  1,  +0.0129, +0.00001, 0 },
+        {  0,  0, -1,  2,  2,  +0.0123,      0.0, 0 },
+        {  2,  0,  0,  0,  0,  +0.0063,      0.0, 0 },
+        {  0,  0,  1,  0,  1,  +0.0063, +0.00001, 0 },
+        {  2,  0, -1,  2,  2,  -0.0059,      0.0, 0 },
+        {  0,  0, -1,  0,  1,  -0.0058, +0.00001, 0 },
+        {  0,  0,  1,  2,  1,  -0.0051,      0.0, 0 },
+        { -2,  0,  2,  0,  0,  +0.0048,      0.0, 0 },
+        {  0,  0, -2,  2,  1,  +0.0046,      0.0, 0 },
+        {  2,  0,  0,  2,  2,  -0.0038,      0.0, 0 },
+        {  0,  0,  2,  2,  2,  -0.0031,      0.0, 0 },
+        {  0,  0,  2,  0,  0,  +0.0029,      0.0, 0 },
+        {  2,  0,  1,  2,  2,  +0.0029,      0.0, 0 },
+        {  0,  0,  0,  2,  0,  +0.0026,      0.0, 0 },
+        { -2,  0,  0,  2,  0,  -0.0022,      0.0, 0 },
+        {  0,  0, -1,  2,  1,  +0.0021,      0.0, 0 },
+        {  0,  2,  0,  0,  0,  +0.0017, -0.00001, 0 },
+        {  2,  0, -1,  0,  1,  +0.0016,      0.0, 0 },
+        { -2,  2,  0,  2,  2,  -0.0016, -0.00001, 0 },
+        {  0,  1,  0,  0,  1,  -0.0015,      0.0, 0 },
+        { -2,  0,  1,  0,  1,  -0.0013,      0.0, 0 },
+        {  0, -1,  0,  0,  1,  -0.0012,      0.0, 0 },
+        {  0,  0,  2, -2,  0,  +0.0011,      0.0, 0 },
+        {  2,  0, -1,  2,  1,  -0.0010,      0.0, 0 },
+        {  2,  0,  1,  2,  2,  -0.0008,      0.0, 0 },
+        {  0,  1,  0,  2,  2,  +0.0007,      0.0, 0 },
+        { -2,  1,  1,  0,  0,  +0.0007,      0.0, 0 },
+        {  0, -1,  0,  2,  2,  -0.0007,      0.0, 0 },
+        {  2,  0,  0,  2,  1,  -0.0007,      0.0, 0 },
+        {  2,  0,  1,  0,  0,  +0.0006,      0.0, 0 },
+        { -2,  0,  2,  2,  2,  +0.0006,      0.0, 0 },
+        { -2,  0,  1,  2,  1,  +0.0006,      0.0, 0 },
+        {  2,  0, -2,  0,  1,  -0.0006,      0.0, 0 },
+        {  2,  0,  0,  0,  1,  -0.0006,      0.0, 0 },
+        {  0, -1,  1,  0,  0,  +0.0005,      0.0, 0 },
+        { -2, -1,  0,  2,  1,  +0.0005,      0.0, 0 },
+        { -2,  0,  0,  0,  1,  -0.0005,      0.0, 0 },
+        {  0,  0,  2,  2,  1,  -0.0005,      0.0, 0 },
+        { -2,  0,  2,  0,  1,  +0.0004,      0.0, 0 },
+        { -2,  1,  0,  2,  1,  +0.0004,      0.0, 0 },
+        {  0,  0,  1, -2,  0,  +0.0004,      0.0, 0 },
+        { -1,  0,  1,  0,  0,  -0.0004,      0.0, 0 },
+        { -2,  1,  0,  0,  0,  -0.0004,      0.0, 0 },
+        {  1,  0,  0,  0,  0,  -0.0004,      0.0, 0 },
+        {  0,  0,  1,  2,  0,  +0.0003,      0.0, 0 },
+        {  0,  0, -2,  2,  2,  -0.0003,      0.0, 0 },
+        { -1, -1,  1,  0,  0,  -0.0003,      0.0, 0 },
+        {  0,  1,  1,  0,  0,  -0.0003,      0.0, 0 },
+        {  0, -1,  1,  2,  2,  -0.0003,      0.0, 0 },
+        {  2, -1, -1,  2,  2,  -0.0003,      0.0, 0 },
+        {  0,  0,  3,  2,  2,  -0.0003,      0.0, 0 },
+        {  2, -1,  0,  2,  2,  -0.0003,      0.0, 0 }
+    };
+
+    const unsigned int numLongitudeNutationTerms(sizeof(longitudeNutationTerms) / sizeof(t_periodicTerm));
+
+
+    const t_periodicTerm obliquityNutationTerms[] =
+    {
+        // D   M  Mm   F   O        a         b  e
+        {  0,  0,  0,  0,  1, +9.2025, +0.00089, 0 },
+        { -2,  0,  0,  2,  2, +0.5736, -0.00031, 0 },
+        {  0,  0,  0,  2,  2, +0.0977, -0.00005, 0 },
+        {  0,  0,  0,  0,  2, -0.0895, -0.00005, 0 },
+        {  0,  1,  0,  0,  0, +0.0054, -0.00001, 0 },
+        {  0,  0,  1,  0,  0, -0.0007,      0.0, 0 },
+        { -2,  1,  0,  2,  2, +0.0224, -0.00006, 0 },
+        {  0,  0,  0,  2,  1, +0.0200,      0.0, 0 },
+        {  0,  0,  1,  2,  2, +0.0129, -0.00001, 0 },
+        { -2, -1,  0,  2,  2, -0.0095, -0.00003, 0 },
+        { -2,  0,  0,  2,  1, -0.0070,      0.0, 0 },
+        {  0,  0, -1,  2,  2, -0.0053,      0.0, 0 },
+        {  0,  0,  1,  0,  1, -0.0033,      0.0, 0 },
+        {  2,  0, -1,  2,  2, +0.0026,      0.0, 0 },
+        {  0,  0, -1,  0,  1, +0.0032,      0.0, 0 },
+        {  0,  0,  1,  2,  1, +0.0027,      0.0, 0 },
+        {  0,  0, -2,  2,  1, -0.0024,      0.0, 0 },
+        {  2,  0,  0,  2,  2, +0.0016,      0.0, 0 },
+        {  0,  0,  2,  2,  2, +0.0013,      0.0, 0 },
+        {  2,  0,  1,  2,  2, -0.0012,      0.0, 0 },
+        {  0,  0, -1,  2,  1, -0.0010,      0.0, 0 },
+        {  2,  0, -1,  0,  1, -0.0008,      0.0, 0 },
+        { -2,  2,  0,  2,  2, +0.0007,      0.0, 0 },
+        {  0,  1,  0,  0,  1, +0.0009,      0.0, 0 },
+        { -2,  0,  1,  0,  1, +0.0007,      0.0, 0 },
+        {  0, -1,  0,  0,  1, +0.0006,      0.0, 0 },
+        {  2,  0, -1,  2,  1, +0.0005,      0.0, 0 },
+        {  2,  0,  1,  2,  2, +0.0003,      0.0, 0 },
+        {  0,  1,  0,  2,  2, -0.0003,      0.0, 0 },
+        {  0, -1,  0,  2,  2, +0.0003,      0.0, 0 },
+        {  2,  0,  0,  2,  1, +0.0003,      0.0, 0 },
+        { -2,  0,  2,  2,  2, -0.0003,      0.0, 0 },
+        { -2,  0,  1,  2,  1, -0.0003,      0.0, 0 },
+        {  2,  0, -2,  0,  1, +0.0003,      0.0, 0 },
+        {  2,  0,  0,  0,  1, +0.0003,      0.0, 0 },
+        { -2, -1,  0,  2,  1, +0.0003,      0.0, 0 },
+        { -2,  0,  0,  0,  1, +0.0003,      0.0, 0 },
+        {  0,  0,  2,  2,  1, +0.0003,      0.0, 0 }
+    };
+
+    const unsigned int numObliquityNutationTerms(sizeof(obliquityNutationTerms) / sizeof(t_periodicTerm));
+
+
+    // the series in the order of SeriesTruncation::e_Series
+
+    const t_periodicSeries seriesTable[] =
+    {
+        { longitudeTerms, numLongitudeTerms }
+    ,   { latitudeTerms, numLatitudeTerms }
+    ,   { distanceTerms, numDistanceTerms }
+    ,   { longitudeNutationTerms, numLongitudeNutationTerms }
+    ,   { obliquityNutationTerms, numObliquityNutationTerms }
+    };
+
+
+    // Upper bound of the magnitude of a term within a century of the 
+    // standard equinox (E^e is below 1.01 there).
+
+    inline const double amplitudeBound(const t_periodicTerm &term)
+    {
+        return (_abs(term.a) + _abs(term.b)) * (term.e ? 1.01 : 1.0);
+    }
+
+    typedef std::pair<double, unsigned int> t_boundAndIndex;
+}
+
+
+template<typename t_real>
+const s_FundamentalArguments<t_real> fundamentalArguments(const t_julianDay t)
+{
+    const t_real T(centuries<t_real>(t));
+
+    s_FundamentalArguments<t_real> args;
+
+    args.D  = rad(MoonT<t_real>::meanElongation(t));
+    args.M  = rad(SunT<t_real>::meanAnomaly(t));
+    args.Mm = rad(MoonT<t_real>::meanAnomaly(t));
+    args.F  = rad(MoonT<t_real>::meanLatitude(t));
+    args.O  = rad(MoonT<t_real>::meanOrbitLongitude(t));
+
+    args.centuries = T;
+
+    //const t_longf E = earth_orbitEccentricity(t);
+    // -> does not apply here - the eccentricity of the earths' orbit 
+    // in 45.6 is about 60. times the earth_orbitEccentricity...?
+
+    // Correction for eccentricity of the Earth's orbit around the sun.
+
+    // (AA.45.6)
+    static const t_real c[] = { 1.0, - 0.002516, - 0.0000074 };
+    const t_real E = polynomial(T, c, 3);
+
+    args.E[0] = 1;
+    args.E[1] = E;
+    args.E[2] = E * E;
+
+    return args;
+}
+
+template OSGH_API const s_FundamentalArguments<float> fundamentalArguments<float>(const t_julianDay t);
+template OSGH_API const s_FundamentalArguments<double> fundamentalArguments<double>(const t_julianDay t);
+template OSGH_API const s_FundamentalArguments<long double> fundamentalArguments<long double>(const t_julianDay t);
+
+
+const t_fundArgs fundamentalArguments(const t_julianDay t)
+{
+    return fundamentalArguments<t_longf>(t);
+}
+
+
+const t_fundArgsf fundamentalArguments2(const t_julianDay t)
+{
+    t_fundArgsf args;
+
+    args.D  = _rad(Moon2::meanElongation(t));
+    args.M  = _rad(Sun2::meanAnomaly(t));
+    args.Mm = _rad(Moon2::meanAnomaly(t));
+    args.F  = _rad(Moon2::meanLatitude(t));
+    args.O  = _rad(Moon2::meanOrbitLongitude(t));
+
+    args.centuries = static_cast<float>(jCenturiesSinceSE(t));
+
+    // the low accuracy series ignore the eccentricity
+    args.E[0] = 1.f;
+    args.E[1] = 1.f;
+    args.E[2] = 1.f;
+
+    return args;
+}
+
+
+// The mean elements are polynomials, cheap compared to the series, and 
+// are evaluated per instant.
+
+void fundamentalArguments(
+    const double *t
+,   const unsigned int count
+,   t_fundArgArrays &args)
+{
+    args.resize(count);
+
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        const t_fundArgs a(fundamentalArguments(t[i]));
+
+        args.D[i]  = static_cast<double>(a.D);
+        args.M[i]  = static_cast<double>(a.M);
+        args.Mm[i] = static_cast<double>(a.Mm);
+        args.F[i]  = static_cast<double>(a.F);
+        args.O[i]  = static_cast<double>(a.O);
+
+        args.centuries[i] = static_cast<double>(a.centuries);
+
+        args.E[1][i] = static_cast<double>(a.E[1]);
+        args.E[2][i] = static_cast<double>(a.E[2]);
+    }
+}
+
+
+SeriesTruncation::SeriesTruncation(const double maxError)
+:   m_maxError(-1.0)
+{
+    setMaxError(maxError);
+}
+
+
+const double SeriesTruncation::setMaxError(const double maxError)
+{
+    if(maxError == m_maxError)
+        return getMaxError();
+
+    m_maxError = maxError;
+
+    // maximum error in the units of the series
+
+    const double maxErrors[NUM_SERIES] = 
+    {
+        maxError * 1000.0
+    ,   maxError * 1000.0
+    ,   static_cast<double>(_rad(maxError)) * 385000.56
+    ,   maxError * 3600.0
+    ,   maxError * 3600.0
+    };
+
+    for(int s = 0; s < NUM_SERIES; ++s)
+    {
+        const t_periodicSeries complete(completeSeries(static_cast<e_Series>(s)));
+
+        // omit the smallest terms first
+
+        std::vector<t_boundAndIndex> bounds(complete.numTerms);
+        for(unsigned int i = 0; i < complete.numTerms; ++i)
+            bounds[i] = t_boundAndIndex(amplitudeBound(complete.terms[i]), i);
+
+        std::sort(bounds.begin(), bounds.end());
+
+        std::vector<bool> omitted(complete.numTerms, false);
+        m_errorBounds[s] = 0.0;
+
+        for(unsigned int i = 0; i < complete.numTerms; ++i)
+        {
+            if(m_errorBounds[s] + bounds[i].first > maxErrors[s])
+                break;
+
+            m_errorBounds[s] += bounds[i].first;
+            omitted[bounds[i].second] = true;
+        }
+
+        m_terms[s].clear();
+        for(unsigned int i = 0; i < complete.numTerms; ++i)
+            if(!omitted[i])
+                m_terms[s].push_back(complete.terms[i]);
+    }
+    return getMaxError();
+}
+
+const double SeriesTruncation::getMaxError() const
+{
+    return m_maxError;
+}
+
+
+const t_periodicSeries SeriesTruncation::series(const e_Series s) const
+{
+    const t_periodicSeries series = 
+    {
+        m_terms[s].empty() ? NULL : &m_terms[s][0]
+    ,   static_cast<unsigned int>(m_terms[s].size())
+    };
+    return series;
+}
+
+
+const double SeriesTruncation::errorBound(const e_Series s) const
+{
+    return m_errorBounds[s];
+}
+
+
+const t_periodicSeries SeriesTruncation::series(
+    const SeriesTruncation *truncation
+,   const e_Series s)
+{
+    return truncation ? truncation->series(s) : completeSeries(s);
+}
+
+
+const t_periodicSeries SeriesTruncation::completeSeries(const e_Series s)
+{
+    return seriesTable[s];
+}
+
+} // namespace osgHimmel
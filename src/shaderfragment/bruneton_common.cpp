@@ -170,7 +170,8 @@ const std::string glsl_bruneton_const_Samples()
         "const int TRANSMITTANCE_INTEGRAL_SAMPLES       = %TRANSMITTANCE_INTEGRAL_SAMPLES%;\n"
         "const int INSCATTER_INTEGRAL_SAMPLES           = %INSCATTER_INTEGRAL_SAMPLES%;\n"
         "const int IRRADIANCE_INTEGRAL_SAMPLES          = %IRRADIANCE_INTEGRAL_SAMPLES%;\n"
-        "const int INSCATTER_SPHERICAL_INTEGRAL_SAMPLES = %INSCATTER_SPHERICAL_INTEGRAL_SAMPLES%;"));
+        "const int INSCATTER_SPHERICAL_INTEGRAL_SAMPLES = %INSCATTER_SPHERICAL_INTEGRAL_SAMPLES%;\n"
+        "const float INTEGRAL_TOLERANCE                 = %INTEGRAL_TOLERANCE%;"));
 
     return source;
 };
@@ -188,6 +189,33 @@ const std::string glsl_bruneton_const_PI()
 };
 
 
+// error estimates of the adaptive integration (see AtmospherePrecompute::setIntegralTolerance)
+
+const std::string glsl_bruneton_converged() // requires: INTEGRAL_TOLERANCE
+{
+    static const std::string source(
+
+        PRAGMA_ONCE(converged,
+
+        "float maxAbs(vec3 v) {\n"
+        "    v = abs(v);\n"
+        "    return max(max(v.r, v.g), v.b);\n"
+        "}\n"
+        "\n"
+            // the error of rgb values is relative to the largest channel
+        "bool converged(vec3 error, vec3 estimate) {\n"
+        "    return maxAbs(error) <= INTEGRAL_TOLERANCE * maxAbs(estimate);\n"
+        "}\n"
+        "\n"
+            // the error of rayleigh and mie optical depth is relative to each
+        "bool converged(vec2 error, vec2 estimate) {\n"
+        "    return all(lessThanEqual(abs(error), INTEGRAL_TOLERANCE * abs(estimate)));\n"
+        "}"));
+
+    return source;
+};
+
+
 // PHYSICAL MODEL PARAMETERS
 
 const std::string glsl_bruneton_const_avgReflectance()
@@ -196,7 +224,9 @@ const std::string glsl_bruneton_const_avgReflectance()
 
         PRAGMA_ONCE(avgReflectance,
 
-        "const float AVERAGE_GROUND_REFLECTANCE = %AVERAGE_GROUND_REFLECTANCE%;"));
+        IF_ELSE_ENABLED(modelUniforms,
+        "uniform float AVERAGE_GROUND_REFLECTANCE;",
+        "const float AVERAGE_GROUND_REFLECTANCE = %AVERAGE_GROUND_REFLECTANCE%;")));
 
     return source;
 };
@@ -208,8 +238,11 @@ const std::string glsl_bruneton_const_R()
 
         PRAGMA_ONCE(const_R,
 
+        IF_ELSE_ENABLED(modelUniforms,
+        "uniform float HR; \n"
+        "uniform vec3 betaR;",
         "const float HR   = %HR%; \n"
-        "const vec3 betaR = %betaR%;"));
+        "const vec3 betaR = %betaR%;")));
 
     return source;
 };
@@ -221,10 +254,35 @@ const std::string glsl_bruneton_const_M()
 
         PRAGMA_ONCE(const_M,
 
+        IF_ELSE_ENABLED(modelUniforms,
+        "uniform float HM; \n"
+        "uniform vec3 betaMSca; \n"
+        "uniform vec3 betaMEx; \n"
+        "uniform float mieG;",
         "const float HM      = %HM%; \n"
         "const vec3 betaMSca = %betaMSca%; \n"
         "const vec3 betaMEx  = %betaMEx%; \n"
-        "const float mieG    = %mieG%;"));
+        "const float mieG    = %mieG%;")));
+
+    return source;
+};
+
+
+// PRESET ATLAS
+
+const std::string glsl_bruneton_atlas()
+{
+    static const std::string source(
+
+        PRAGMA_ONCE(atlas,
+
+        IF_ELSE_ENABLED(atlas,
+        "uniform vec4 atlasLayers; \n"  // transmittance (xy) and other layers (zw) of the blended presets
+        "uniform float atlasBlend; \n"
+        "uniform float atlasSize;",     // number of presets
+        "const vec4 atlasLayers = vec4(0.0); \n"
+        "const float atlasBlend = 0.0; \n"
+        "const float atlasSize  = 1.0;")));
 
     return source;
 };
@@ -238,7 +296,8 @@ const std::string glsl_bruneton_texture4D() // requires: RES_MU, RES_MU_S, RES_R
 
         PRAGMA_ONCE(texture4D,
 
-        "vec4 texture4D(sampler3D table, float r, float mu, float muS, float nu)\n"
+        // the table might contain layers of several presets, stacked in r
+        "vec4 texture4D(sampler3D table, float r, float mu, float muS, float nu, float layer, float layers)\n"
         "{\n"
         "    float H = sqrt(cmn[2] * cmn[2] - cmn[1] * cmn[1]);\n"
         "    float rho = sqrt(r * r - cmn[1] * cmn[1]);\n"
@@ -247,6 +306,7 @@ const std::string glsl_bruneton_texture4D() // requires: RES_MU, RES_MU_S, RES_R
         "    float delta = rmu * rmu - r * r + cmn[1] * cmn[1];\n"
         "    vec4 cst = rmu < 0.0 && delta > 0.0 ? vec4(1.0, 0.0, 0.0, 0.5 - 0.5 / float(RES_MU)) : vec4(-1.0, H * H, H, 0.5 + 0.5 / float(RES_MU));\n"
         "    float uR = 0.5 / float(RES_R) + rho / H * (1.0 - 1.0 / float(RES_R));\n"
+        "    uR = (uR + layer) / layers;\n"
         "    float uMu = cst.w + (rmu * cst.x + sqrt(delta + cst.y)) / (rho + cst.z) * (0.5 - 1.0 / float(RES_MU));\n"
         //    // paper formula
         //"    float uMuS = 0.5 / float(RES_MU_S) + max((1.0 - exp(-3.0 * muS - 0.6)) / (1.0 - exp(-3.6)), 0.0) * (1.0 - 1.0 / float(RES_MU_S));\n"
@@ -262,6 +322,11 @@ const std::string glsl_bruneton_texture4D() // requires: RES_MU, RES_MU_S, RES_R
         "    lerp = lerp - uNu;\n"
         "    return texture3D(table, vec3((uNu + uMuS) / float(RES_NU), uMu, uR)) * (1.0 - lerp) +\n"
         "           texture3D(table, vec3((uNu + uMuS + 1.0) / float(RES_NU), uMu, uR)) * lerp;\n"
+        "}\n\n"
+
+        "vec4 texture4D(sampler3D table, float r, float mu, float muS, float nu)\n"
+        "{\n"
+        "    return texture4D(table, r, mu, muS, nu, 0.0, 1.0);\n"
         "}"));
 
     return source;
@@ -389,13 +454,18 @@ const std::string glsl_bruneton_transmittance() // requires: transmittanceSample
 
         PRAGMA_ONCE(transmittance,
 
-        "uniform sampler2D transmittanceSampler;\n\n"   
+        IF_ELSE_ENABLED(atlas,
+        "uniform sampler2DArray transmittanceSampler;",
+        "uniform sampler2D transmittanceSampler;")
 
         // transmittance (=transparency) of atmosphere for infinite ray (r,mu)
         // (mu = cos(view zenith angle)), intersections with ground ignored
         "vec3 transmittance(float r, float mu) {\n"
         "    vec2 uv = getTransmittanceUV(r, mu);\n"
-        "    return texture2D(transmittanceSampler, uv).rgb;\n"
+        IF_ELSE_ENABLED(atlas,
+        "    vec3 a = texture(transmittanceSampler, vec3(uv, atlasLayers.x)).rgb;\n"
+        "    return atlasBlend > 0.0 ? mix(a, texture(transmittanceSampler, vec3(uv, atlasLayers.y)).rgb, atlasBlend) : a;",
+        "    return texture2D(transmittanceSampler, uv).rgb;")
         "}\n\n"
 
         // transmittance(=transparency) of atmosphere between x and x0
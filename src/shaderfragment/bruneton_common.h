@@ -50,13 +50,18 @@ const std::string glsl_bruneton_const_RSize();
 
 const std::string glsl_bruneton_const_Samples();
 const std::string glsl_bruneton_const_PI();
+const std::string glsl_bruneton_converged();           // requires: INTEGRAL_TOLERANCE
 
-// PHYSICAL MODEL PARAMETERS
+// PHYSICAL MODEL PARAMETERS (uniforms if modelUniforms is enabled)
 
 const std::string glsl_bruneton_const_avgReflectance();
 const std::string glsl_bruneton_const_R();
 const std::string glsl_bruneton_const_M();
 
+// PRESET ATLAS (uniforms if atlas is enabled, see AtmosphereAtlas)
+
+const std::string glsl_bruneton_atlas();
+
 // PARAMETERIZATION FUNCTIONS
 
 const std::string glsl_bruneton_texture4D();           // requires: RES_MU, RES_MU_S, RES_R, RES_NU, cmn
@@ -68,7 +73,7 @@ const std::string glsl_bruneton_irradianceRMuS();      // requires: SKY_H, SKY_W
 
 // UTILITY FUNCTIONS
 
-const std::string glsl_bruneton_transmittance();       // requires: transmittanceSampler, transmittanceUV
+const std::string glsl_bruneton_transmittance();       // requires: transmittanceSampler, transmittanceUV, atlas
 const std::string glsl_bruneton_transmittanceWithShadow(); // requires: cmn, transmittance()
 const std::string glsl_bruneton_limit();               // requires: RL, cmn
 const std::string glsl_bruneton_hdr();                 // requires: -
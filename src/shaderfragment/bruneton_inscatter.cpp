@@ -89,6 +89,7 @@ const std::string glsl_bruneton_f_inscatter1() // requires: r, dhdH
     +   glsl_bruneton_transmittanceUV()
     +   glsl_bruneton_transmittance()  
     +   glsl_bruneton_muMuSNu()
+    +   glsl_bruneton_converged()
 
     +   PRAGMA_ONCE(main,
 
@@ -130,13 +131,66 @@ const std::string glsl_bruneton_f_inscatter1() // requires: r, dhdH
         "    ray *= betaR;\n"
         "    mie *= betaMSca;\n"
         "}\n"
+        "\n"
+            // doubles the samples until converged (see CpuAtmospherePrecompute)
+        "void inscatterAdaptive(float r, float mu, float muS, float nu, out vec3 ray, out vec3 mie) {\n"
+        "    float L = limit(r, mu);\n"
+        "    int n = INSCATTER_INTEGRAL_SAMPLES / 16 < 2 ? 2 : INSCATTER_INTEGRAL_SAMPLES / 16;\n"
+        "    float h = L / float(n);\n"
+        "    vec3 rayi;\n"
+        "    vec3 miei;\n"
+        "    vec3 rayj;\n"
+        "    vec3 miej;\n"
+        "    integrand(r, mu, muS, nu, 0.0, rayi, miei);\n"
+        "    integrand(r, mu, muS, nu, L, rayj, miej);\n"
+        "    vec3 raySum = (rayi + rayj) * 0.5;\n"
+        "    vec3 mieSum = (miei + miej) * 0.5;\n"
+        "    for (int i = 1; i < n; ++i) {\n"
+        "        integrand(r, mu, muS, nu, float(i) * h, rayi, miei);\n"
+        "        raySum += rayi;\n"
+        "        mieSum += miei;\n"
+        "    }\n"
+        "    vec3 rayCoarse = raySum * h;\n"
+        "    vec3 mieCoarse = mieSum * h;\n"
+        "    ray = rayCoarse;\n"
+        "    mie = mieCoarse;\n"
+        "    int convergedEstimates = 0;\n"
+        "    while (2 * n <= INSCATTER_INTEGRAL_SAMPLES) {\n"
+        "        for (int i = 0; i < n; ++i) {\n"
+        "            integrand(r, mu, muS, nu, (float(i) + 0.5) * h, rayi, miei);\n"
+        "            raySum += rayi;\n"
+        "            mieSum += miei;\n"
+        "        }\n"
+        "        n *= 2;\n"
+        "        h *= 0.5;\n"
+        "        vec3 rayFine = raySum * h;\n"
+        "        vec3 mieFine = mieSum * h;\n"
+        "        vec3 rayError = (rayFine - rayCoarse) / 3.0;\n"
+        "        vec3 mieError = (mieFine - mieCoarse) / 3.0;\n"
+        "        ray = rayFine + rayError;\n"
+        "        mie = mieFine + mieError;\n"
+        "        if (!converged(rayError, rayFine) || !converged(mieError, mieFine)) {\n"
+        "            convergedEstimates = 0;\n"
+        "        } else if (++convergedEstimates == 2) {\n"
+        "            break;\n"
+        "        }\n"
+        "        rayCoarse = rayFine;\n"
+        "        mieCoarse = mieFine;\n"
+        "    }\n"
+        "    ray *= betaR;\n"
+        "    mie *= betaMSca;\n"
+        "}\n"
         "\n"
         "void main() {\n"
         "    vec3 ray;\n"
         "    vec3 mie;\n"
         "    float mu, muS, nu;\n"
         "    getMuMuSNu(r, dhdH, mu, muS, nu);\n"
-        "    inscatter(r, mu, muS, nu, ray, mie);\n"
+        "    if (INTEGRAL_TOLERANCE > 0.0) {\n"
+        "        inscatterAdaptive(r, mu, muS, nu, ray, mie);\n"
+        "    } else {\n"
+        "        inscatter(r, mu, muS, nu, ray, mie);\n"
+        "    }\n"
             // store separately Rayleigh and Mie contributions, WITHOUT the phase function factor
             // (cf 'Angular precision')
         "    gl_FragData[0].rgb = ray;\n"
@@ -164,6 +218,7 @@ const std::string glsl_bruneton_f_inscatterN() // requires: r, dhdH, deltaJSampl
     +   glsl_bruneton_muMuSNu()
     +   glsl_bruneton_transmittanceUV()
     +   glsl_bruneton_transmittance()
+    +   glsl_bruneton_converged()
 
     +   PRAGMA_ONCE(main,
 
@@ -193,11 +248,42 @@ const std::string glsl_bruneton_f_inscatterN() // requires: r, dhdH, deltaJSampl
         "    }\n"
         "    return raymie;\n"
         "}\n"
+        "\n"
+            // doubles the samples until converged (see CpuAtmospherePrecompute)
+        "vec3 inscatterAdaptive(float r, float mu, float muS, float nu) {\n"
+        "    float L = limit(r, mu);\n"
+        "    int n = INSCATTER_INTEGRAL_SAMPLES / 16 < 2 ? 2 : INSCATTER_INTEGRAL_SAMPLES / 16;\n"
+        "    float h = L / float(n);\n"
+        "    vec3 sum = (integrand(r, mu, muS, nu, 0.0) + integrand(r, mu, muS, nu, L)) * 0.5;\n"
+        "    for (int i = 1; i < n; ++i) {\n"
+        "        sum += integrand(r, mu, muS, nu, float(i) * h);\n"
+        "    }\n"
+        "    vec3 coarse = sum * h;\n"
+        "    vec3 raymie = coarse;\n"
+        "    int convergedEstimates = 0;\n"
+        "    while (2 * n <= INSCATTER_INTEGRAL_SAMPLES) {\n"
+        "        for (int i = 0; i < n; ++i) {\n"
+        "            sum += integrand(r, mu, muS, nu, (float(i) + 0.5) * h);\n"
+        "        }\n"
+        "        n *= 2;\n"
+        "        h *= 0.5;\n"
+        "        vec3 fine = sum * h;\n"
+        "        vec3 error = (fine - coarse) / 3.0;\n"
+        "        raymie = fine + error;\n"
+        "        if (!converged(error, fine)) {\n"
+        "            convergedEstimates = 0;\n"
+        "        } else if (++convergedEstimates == 2) {\n"
+        "            break;\n"
+        "        }\n"
+        "        coarse = fine;\n"
+        "    }\n"
+        "    return raymie;\n"
+        "}\n"
         "\n"
         "void main() {\n"
         "    float mu, muS, nu;\n"
         "    getMuMuSNu(r, dhdH, mu, muS, nu);\n"
-        "    gl_FragColor.rgb = inscatter(r, mu, muS, nu);\n"
+        "    gl_FragColor.rgb = INTEGRAL_TOLERANCE > 0.0 ? inscatterAdaptive(r, mu, muS, nu) : inscatter(r, mu, muS, nu);\n"
         "}"));
 
     return source;
@@ -115,6 +115,7 @@ const std::string glsl_bruneton_f_irradianceN() // requires: deltaSRSampler, del
     +   glsl_bruneton_phaseFunctionR()
     +   glsl_bruneton_phaseFunctionM()
     +   glsl_bruneton_texture4D()
+    +   glsl_bruneton_converged()
 
     +   PRAGMA_ONCE(main,
 
@@ -131,26 +132,47 @@ const std::string glsl_bruneton_f_irradianceN() // requires: deltaSRSampler, del
         "    vec3 s = vec3(max(sqrt(1.0 - muS * muS), 0.0), 0.0, muS);\n"
         "\n"
         "    vec3 result = vec3(0.0);\n"
+        "\n"
+        "    bool adaptive = INTEGRAL_TOLERANCE > 0.0 && (IRRADIANCE_INTEGRAL_SAMPLES / 2) * 2 == IRRADIANCE_INTEGRAL_SAMPLES;\n"
+        "    vec3 quarter = vec3(0.0);\n"
+        "\n"
             // integral over 2.PI around x with two nested loops over w directions (theta,phi) -- Eq (15)
-        "    for (int iphi = 0; iphi < 2 * IRRADIANCE_INTEGRAL_SAMPLES; ++iphi) {\n"
-        "        float phi = (float(iphi) + 0.5) * dphi;\n"
-        "        for (int itheta = 0; itheta < IRRADIANCE_INTEGRAL_SAMPLES / 2; ++itheta) {\n"
-        "            float theta = (float(itheta) + 0.5) * dtheta;\n"
-        "            float dw = dtheta * dphi * sin(theta);\n"
-        "            vec3 w = vec3(cos(phi) * sin(theta), sin(phi) * sin(theta), cos(theta));\n"
-        "            float nu = dot(s, w);\n"
-        "            if (first == 1.0) {\n"
-                        // first iteration is special because Rayleigh and Mie were stored separately,
-                        // without the phase functions factors; they must be reintroduced here
-        "                float pr1 = phaseFunctionR(nu);\n"
-        "                float pm1 = phaseFunctionM(nu);\n"
-        "                vec3 ray1 = texture4D(deltaSRSampler, r, w.z, muS, nu).rgb;\n"
-        "                vec3 mie1 = texture4D(deltaSMSampler, r, w.z, muS, nu).rgb;\n"
-        "                result += (ray1 * pr1 + mie1 * pm1) * w.z * dw;\n"
-        "            } else {\n"
-        "                result += texture4D(deltaSRSampler, r, w.z, muS, nu).rgb * w.z * dw;\n"
+            // adaptively over subsets of the azimuths: every fourth, the remaining even, and the odd ones,
+            // unless the quarter and the half agree (see CpuAtmospherePrecompute)
+        "    for (int subset = 0; subset < 3; ++subset) {\n"
+        "        int phiFirst = adaptive ? (subset == 0 ? 0 : (subset == 1 ? 2 : 1)) : 0;\n"
+        "        int phiStride = adaptive ? (subset == 2 ? 2 : 4) : 1;\n"
+        "\n"
+        "        for (int iphi = phiFirst; iphi < 2 * IRRADIANCE_INTEGRAL_SAMPLES; iphi += phiStride) {\n"
+        "            float phi = (float(iphi) + 0.5) * dphi;\n"
+        "            for (int itheta = 0; itheta < IRRADIANCE_INTEGRAL_SAMPLES / 2; ++itheta) {\n"
+        "                float theta = (float(itheta) + 0.5) * dtheta;\n"
+        "                float dw = dtheta * dphi * sin(theta);\n"
+        "                vec3 w = vec3(cos(phi) * sin(theta), sin(phi) * sin(theta), cos(theta));\n"
+        "                float nu = dot(s, w);\n"
+        "                if (first == 1.0) {\n"
+                            // first iteration is special because Rayleigh and Mie were stored separately,
+                            // without the phase functions factors; they must be reintroduced here
+        "                    float pr1 = phaseFunctionR(nu);\n"
+        "                    float pm1 = phaseFunctionM(nu);\n"
+        "                    vec3 ray1 = texture4D(deltaSRSampler, r, w.z, muS, nu).rgb;\n"
+        "                    vec3 mie1 = texture4D(deltaSMSampler, r, w.z, muS, nu).rgb;\n"
+        "                    result += (ray1 * pr1 + mie1 * pm1) * w.z * dw;\n"
+        "                } else {\n"
+        "                    result += texture4D(deltaSRSampler, r, w.z, muS, nu).rgb * w.z * dw;\n"
+        "                }\n"
         "            }\n"
         "        }\n"
+        "\n"
+        "        if (!adaptive) {\n"
+        "            break;\n"
+        "        }\n"
+        "        if (subset == 0) {\n"
+        "            quarter = result * 4.0;\n"
+        "        } else if (subset == 1 && converged(result * 2.0 - quarter, result * 2.0)) {\n"
+        "            result *= 2.0;\n"
+        "            break;\n"
+        "        }\n"
         "    }\n"
         "\n"
         "    gl_FragColor = vec4(result, 0.0);\n"
@@ -176,8 +198,7 @@ const std::string glsl_bruneton_f_copyIrradiance() // requires: k, deltaESampler
         "\n"
         "void main() {\n"
         "    vec2 uv = gl_FragCoord.xy / vec2(SKY_W, SKY_H);\n"
-        "    gl_FragColor  = texture2D(irradianceSampler, uv);\n"
-        "    gl_FragColor += k * texture2D(deltaESampler, uv);\n" // k = 0 for line 4, k = 1 for line 10
+        "    gl_FragColor = k * (texture2D(irradianceSampler, uv) + texture2D(deltaESampler, uv));\n" // k = 0 for line 4, k = 1 for line 10
         "}"));
 
     return source;
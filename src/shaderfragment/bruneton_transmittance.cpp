@@ -86,6 +86,7 @@ const std::string glsl_bruneton_f_transmittance()
 
     +   glsl_bruneton_limit()
     +   glsl_bruneton_transmittanceRMu()
+    +   glsl_bruneton_converged()
 
     +   PRAGMA_ONCE(main,
     
@@ -104,10 +105,52 @@ const std::string glsl_bruneton_f_transmittance()
         "    return mu < -sqrt(1.0 - (cmn[1] / r) * (cmn[1] / r)) ? 1e9 : result;\n"
         "}\n"
         "\n"
+        "vec2 density(float r, float mu, float x) {\n"
+        "    float h = sqrt(r * r + x * x + 2.0 * x * r * mu) - cmn[1];\n"
+        "    return exp(-h / vec2(HR, HM));\n"
+        "}\n"
+        "\n"
+            // rayleigh and mie optical depth, doubling the samples until converged (see CpuAtmospherePrecompute)
+        "vec2 opticalDepthAdaptive(float r, float mu) {\n"
+        "    float L = limit(r, mu);\n"
+        "    int n = TRANSMITTANCE_INTEGRAL_SAMPLES / 16 < 2 ? 2 : TRANSMITTANCE_INTEGRAL_SAMPLES / 16;\n"
+        "    float h = L / float(n);\n"
+        "    vec2 sum = (density(r, mu, 0.0) + density(r, mu, L)) * 0.5;\n"
+        "    for (int i = 1; i < n; ++i) {\n"
+        "        sum += density(r, mu, float(i) * h);\n"
+        "    }\n"
+        "    vec2 coarse = sum * h;\n"
+        "    vec2 result = coarse;\n"
+        "    int convergedEstimates = 0;\n"
+        "    while (2 * n <= TRANSMITTANCE_INTEGRAL_SAMPLES) {\n"
+        "        for (int i = 0; i < n; ++i) {\n"
+        "            sum += density(r, mu, (float(i) + 0.5) * h);\n"
+        "        }\n"
+        "        n *= 2;\n"
+        "        h *= 0.5;\n"
+        "        vec2 fine = sum * h;\n"
+        "        vec2 error = (fine - coarse) / 3.0;\n"
+        "        result = fine + error;\n"
+        "        if (!converged(error, fine)) {\n"
+        "            convergedEstimates = 0;\n"
+        "        } else if (++convergedEstimates == 2) {\n"
+        "            break;\n"
+        "        }\n"
+        "        coarse = fine;\n"
+        "    }\n"
+        "    return mu < -sqrt(1.0 - (cmn[1] / r) * (cmn[1] / r)) ? vec2(1e9) : result;\n"
+        "}\n"
+        "\n"
         "void main() {\n"
         "    float r, muS;\n"
         "    getTransmittanceRMu(r, muS);\n"
-        "    vec3 depth = betaR * opticalDepth(HR, r, muS) + betaMEx * opticalDepth(HM, r, muS);\n"
+        "    vec3 depth;\n"
+        "    if (INTEGRAL_TOLERANCE > 0.0) {\n"
+        "        vec2 d = opticalDepthAdaptive(r, muS);\n"
+        "        depth = betaR * d.x + betaMEx * d.y;\n"
+        "    } else {\n"
+        "        depth = betaR * opticalDepth(HR, r, muS) + betaMEx * opticalDepth(HM, r, muS);\n"
+        "    }\n"
         "    gl_FragColor = vec4(exp(-depth), 0.0);\n" // Eq (5)
         "}"));
 
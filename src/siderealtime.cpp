@@ -36,10 +36,9 @@
 namespace osgHimmel
 {
 
-const t_longf siderealTime(const t_aTime &aTime)
+const t_longf siderealTime(const t_julianTime &time)
 {
-    const t_aTime gmt(makeUT(aTime));
-    const t_julianDay JD(jdUT(gmt));
+    const t_julianDay JD(time.jdUT());
 
     // (AA.11.4)
 
@@ -52,10 +51,9 @@ const t_longf siderealTime(const t_aTime &aTime)
 }
 
 
-const t_longf siderealTime2(const t_aTime &aTime)
+const t_longf siderealTime2(const t_julianTime &time)
 {
-    const t_aTime gmt(makeUT(aTime));
-    const t_julianDay JD(jdUT(aTime));
+    const t_julianDay JD(time.jdUT());
 
     // ("A Physically-Based Night Sky Model" - 2001 - Wann Jensen et al.)
 
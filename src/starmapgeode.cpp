@@ -92,7 +92,7 @@ void StarMapGeode::update(const Himmel &himmel)
     //u_q->set(static_cast<float>(tan(_rad(fov / 2)) / (height * 0.5)));
     u_q->set(static_cast<float>(sqrt(2.0) * 2.0 * tan(_rad(fov * 0.5)) / height));
 
-    u_R->set(himmel.astro()->getEquToHorTransform());
+    u_R->set(himmel.astro()->getSnapshot().equToHorTransform);
 }
 
 
@@ -31,6 +31,10 @@
 
 #include "mathmacros.h"
 #include "siderealtime.h"
+#include "earth.h"
+#include "sun.h"
+
+#include <limits>
 
 
 namespace osgHimmel
@@ -116,31 +120,70 @@ const osg::Vec3f Stars::sRgbColor(const osg::Vec3f xyzTristimulus)
 }
 
 
+const osg::Vec3d Stars::position(
+    const t_longf a2000
+,   const t_longf d2000)
+{
+    const double a(_rad(a2000));
+    const double d(_rad(d2000));
+
+    return osg::Vec3d(cos(d) * cos(a), cos(d) * sin(a), sin(d));
+}
+
+
+const osg::Vec3d Stars::properMotion(
+    const t_longf a2000
+,   const t_longf d2000
+,   const t_longf pma2000
+,   const t_longf pmd2000)
+{
+    const double a(_rad(a2000));
+    const double d(_rad(d2000));
+
+    // along the unit vectors towards increasing RA and DE
+
+    const double ma(_rad(pma2000 / 3600.0));
+    const double md(_rad(pmd2000 / 3600.0));
+
+    return osg::Vec3d(
+        - ma * sin(a) - md * sin(d) * cos(a)
+    ,     ma * cos(a) - md * sin(d) * sin(a)
+    ,                   md * cos(d));
+}
+
+
 const t_equd Stars::apparentPosition(
-    const t_julianDay /*t*/
-,   const t_longf /*a2000*/
-,   const t_longf /*d2000*/
-,   const t_longf /*mpa2000*/
-,   const t_longf /*mpd2000*/)
+    const t_julianDay t
+,   const t_longf a2000
+,   const t_longf d2000
+,   const t_longf mpa2000
+,   const t_longf mpd2000)
 {
-    //const t_julianDay T(jCenturiesSinceSE(t));
+    const osg::Vec3d p(position(a2000, d2000));
+    const osg::Vec3d pm(properMotion(a2000, d2000
+        , mpa2000 * cos(_rad(d2000)) * 3600.0, mpd2000 * 3600.0));
 
-    // (AA.20.1)
+    return apparentPosition(t_starsEpoch(t), p, pm);
+}
 
-    //const t_longf m  = (_decimal(0, 0, 3.07496)) + (_decimal(0, 0, 0.00186)) * T * 100.0;
-    //const t_longf n  = _arcsecs(_decimal(0, 0, 1.33621)) - _arcsecs(_decimal(0, 0, 0.00057)) * T * 100.0;
 
-    //const t_longf Da = m + n * sin(_rad(mpa2000)) * tan(_rad(mpd2000));
-    //const t_longf Db = n * cos(_rad(mpa2000));
+const t_equd Stars::apparentPosition(
+    const t_starsEpoch &epoch
+,   const osg::Vec3d &p2000
+,   const osg::Vec3d &pm2000)
+{
+    const osg::Vec3d p(epoch.apply(p2000, pm2000));
 
-    // TODO
+    t_equd equ;
+    equ.right_ascension = _revd(_deg(atan2(p.y(), p.x())));
+    equ.declination = _deg(asin(p.z() / p.length()));
 
-    return t_equd();
+    return equ;
 }
 
 
 const t_hord Stars::horizontalPosition(
-    const t_aTime &aTime
+    const t_julianTime &time
 ,   const t_longf latitude
 ,   const t_longf longitude
 ,   const t_longf a2000
@@ -148,12 +191,144 @@ const t_hord Stars::horizontalPosition(
 ,   const t_longf mpa2000
 ,   const t_longf mpd2000)
 {
-    t_julianDay t(jd(aTime));
-    t_julianDay s(siderealTime(aTime));
+    t_julianDay t(time.jd());
+    t_julianDay s(siderealTime(time));
 
     t_equd equ = apparentPosition(t, a2000, d2000, mpa2000, mpd2000);
 
     return equ.toHorizontal(s, latitude, longitude);
 }
 
+
+const osg::Matrixf Stars::equToHorTransform(
+    const t_longf siderealTime
+,   const t_longf latitude
+,   const t_longf longitude)
+{
+    return osg::Matrixf::scale(-1, 1, 1)
+        * osg::Matrixf::rotate( _rad(latitude) - _PI_2, 1, 0, 0)
+        * osg::Matrixf::rotate(-_rad(siderealTime + longitude), 0, 0, 1);
+}
+
+
+const float Stars::moonlight(
+    const osg::Vec3f &sun
+,   const osg::Vec3f &moon
+,   const float scale)
+{
+    if(moon.z() <= 0.f || scale <= 0.f)
+        return 0.f;
+
+    // phase angle from the elongation (geocentric, within 0.2 degrees)
+    const float i(180.f - _deg(acos(_clamp(-1.f, 1.f, sun * moon))));
+
+    // magnitude of the moon relative to full (Allen, 1976)
+    const float m(0.026f * i + 4e-9f * i * i * i * i);
+
+    const float brightening(25.f * scale * pow(10.f, -0.4f * m) * moon.z());
+
+    return 1.25f * log10(1.f + brightening);
+}
+
+
+const float Stars::limitingMagnitude(
+    const float apparentMagnitude
+,   const float q
+,   const osg::Vec3f &sun)
+{
+    if(q <= 0.f)
+        return std::numeric_limits<float>::max();
+
+    static const float _35OVER13PI(0.85698815511020565414014334123662f);
+
+    // resolution correlated intensity of a star of the apparent magnitude
+    const float c(_35OVER13PI * 4e-7f / (q * q));
+
+    // Day-Twilight-Night-Intensity Mapping (Butterworth-Filter)
+    const float b(1.f / sqrt(1.f + pow(sun.z() + 1.14f, 32.f)));
+
+    return apparentMagnitude - 0.4f - log(0.01f / (c * b)) / log(2.512f);
+}
+
+
+s_StarsEpoch::s_StarsEpoch(const t_julianDay t)
+:   t(t)
+{
+    const double T(static_cast<double>(jCenturiesSinceSE(t)));
+
+    years = T * 100.0;
+
+    // (AA.21.2) from J2000, in arcseconds
+
+    const double zeta (_rad((2306.2181 + (0.30188 + 0.017998 * T) * T) * T / 3600.0));
+    const double z    (_rad((2306.2181 + (1.09468 + 0.018203 * T) * T) * T / 3600.0));
+    const double theta(_rad((2004.3109 - (0.42665 + 0.041833 * T) * T) * T / 3600.0));
+
+    // (AA.21.4) as rotation
+
+    const double cZeta(cos(zeta)), sZeta(sin(zeta));
+    const double cz(cos(z)), sz(sin(z));
+    const double cTheta(cos(theta)), sTheta(sin(theta));
+
+    const double P[3][3] =
+    {
+        { cZeta * cTheta * cz - sZeta * sz, -sZeta * cTheta * cz - cZeta * sz, -sTheta * cz }
+    ,   { cZeta * cTheta * sz + sZeta * cz, -sZeta * cTheta * sz + cZeta * cz, -sTheta * sz }
+    ,   { cZeta * sTheta                  , -sZeta * sTheta                  ,  cTheta      }
+    };
+
+    // nutation: rotations about the mean equinox by the mean obliquity,
+    // about the ecliptic pole by the nutation in longitude, and back by
+    // the true obliquity
+
+    const double e0(_rad(Earth::meanObliquity(t)));
+    const double e (_rad(Earth::trueObliquity(t)));
+    const double Dr(_rad(Earth::longitudeNutation(t)));
+
+    const double ce0(cos(e0)), se0(sin(e0));
+    const double ce(cos(e)), se(sin(e));
+    const double cDr(cos(Dr)), sDr(sin(Dr));
+
+    const double N[3][3] =
+    {
+        {  cDr      , -sDr * ce0                   , -sDr * se0                    }
+    ,   {  sDr * ce ,  cDr * ce0 * ce + se0 * se   ,  cDr * se0 * ce - ce0 * se    }
+    ,   {  sDr * se ,  cDr * ce0 * se - se0 * ce   ,  cDr * se0 * se + ce0 * ce    }
+    };
+
+    for(int i = 0; i < 3; ++i)
+        for(int j = 0; j < 3; ++j)
+            rotation[i][j] = N[i][0] * P[0][j] + N[i][1] * P[1][j] + N[i][2] * P[2][j];
+
+    // (AA.23.3) the velocity of the earth in ecliptic coordinates, with 
+    // the constant of aberration, the true longitude of the sun, and the
+    // eccentricity and longitude of the perihelion of the earths orbit
+
+    const double k(_rad(20.49552 / 3600.0));
+
+    const double l(_rad(Sun::trueLongitude(t)));
+    const double ecc(Earth::orbitEccentricity(t));
+    const double pi(_rad(102.93735 + (1.71946 + 0.00046 * T) * T));
+
+    const double x(k * ( sin(l) - ecc * sin(pi)));
+    const double y(k * (-cos(l) + ecc * cos(pi)));
+
+    aberration[0] = x;
+    aberration[1] = y * ce;
+    aberration[2] = y * se;
+}
+
+
+const osg::Vec3d s_StarsEpoch::apply(
+    const osg::Vec3d &p2000
+,   const osg::Vec3d &pm2000) const
+{
+    const osg::Vec3d p(p2000 + pm2000 * years);
+
+    return osg::Vec3d(
+        rotation[0][0] * p.x() + rotation[0][1] * p.y() + rotation[0][2] * p.z() + aberration[0]
+    ,   rotation[1][0] * p.x() + rotation[1][1] * p.y() + rotation[1][2] * p.z() + aberration[1]
+    ,   rotation[2][0] * p.x() + rotation[2][1] * p.y() + rotation[2][2] * p.z() + aberration[2]);
+}
+
 } // namespace osgHimmel
\ No newline at end of file
@@ -48,16 +48,94 @@
 #include <osg/Texture1D>
 #include <osg/Depth>
 
+#include <osgUtil/CullVisitor>
+
+#include <OpenThreads/ScopedLock>
+
+#include <limits>
+
 
 namespace
 {
     const float TWO_TIMES_SQRT2(2.0 * sqrt(2.0));
+
+
+    // Half angle of the cone around the (unit) positions, and its axis.
+
+    const float bound(
+        const osg::Vec3f *positions
+    ,   const unsigned int count
+    ,   osg::Vec3f &axis)
+    {
+        axis = osg::Vec3f();
+        for(unsigned int i = 0; i < count; ++i)
+            axis += positions[i];
+
+        axis.normalize();
+
+        float minCos(1.f);
+        for(unsigned int i = 0; i < count; ++i)
+            minCos = _mi(minCos, axis * positions[i]);
+
+        // a little wider, for the rounding of the floats
+        return acos(_clamp(-1.f, 1.f, minCos)) + 1e-4f;
+    }
 }
 
 
 namespace osgHimmel
 {
 
+StarsGeode::CellCullCallback::CellCullCallback(
+    const StarsGeode *stars
+,   const unsigned int cell)
+:   osg::Drawable::CullCallback()
+,   m_stars(stars)
+,   m_cell(cell)
+{
+}
+
+
+bool StarsGeode::CellCullCallback::cull(
+    osg::NodeVisitor *nv
+,   osg::Drawable * /*drawable*/
+,   osg::RenderInfo * /*renderInfo*/) const
+{
+    return !m_stars->isVisible(m_cell, nv);
+}
+
+
+StarsGeode::TileCullCallback::TileCullCallback(
+    const StarsGeode *stars
+,   const unsigned int tile)
+:   osg::Drawable::CullCallback()
+,   m_stars(stars)
+,   m_tile(tile)
+{
+}
+
+
+bool StarsGeode::TileCullCallback::cull(
+    osg::NodeVisitor *nv
+,   osg::Drawable * /*drawable*/
+,   osg::RenderInfo * /*renderInfo*/) const
+{
+    return !m_stars->isTileVisible(m_tile, nv);
+}
+
+
+void StarsGeode::ViewCallback::operator()(
+    osg::Node *node
+,   osg::NodeVisitor *nv)
+{
+    StarsGeode *stars(dynamic_cast<StarsGeode*>(node));
+    if(stars)
+        stars->recordView(nv);
+
+    traverse(node, nv);
+}
+
+
 StarsGeode::StarsGeode(const char* brightStarsFilePath)
 :   osg::Geode()
 
@@ -66,6 +144,9 @@ StarsGeode::StarsGeode(const char* brightStarsFilePath)
 ,   m_gShader(new osg::Shader(osg::Shader::GEOMETRY))
 ,   m_fShader(new osg::Shader(osg::Shader::FRAGMENT))
 
+,   m_limitingMagnitude(std::numeric_limits<float>::max())
+,   m_moonlightScale(defaultMoonlightScale())
+
 ,   u_R(NULL)
 ,   u_q(NULL)
 ,   u_noise1(NULL)
@@ -74,6 +155,7 @@ StarsGeode::StarsGeode(const char* brightStarsFilePath)
 ,   u_glareIntensity(NULL)
 ,   u_glareScale(NULL)
 ,   u_apparentMagnitude(NULL)
+,   u_moonlight(NULL)
 ,   u_scattering(NULL)
 ,   u_scintillations(NULL)
 ,   u_scale(NULL)
@@ -101,9 +183,282 @@ void StarsGeode::update(const Himmel &himmel)
     const float height = himmel.getViewSizeHeightHint();
 
     //u_q->set(static_cast<float>(tan(_rad(fov / 2)) / (height * 0.5)));
-    u_q->set(static_cast<float>(4.0 * tan(_rad(fov * 0.5)) / height));
+    const float q(static_cast<float>(4.0 * tan(_rad(fov * 0.5)) / height));
+    u_q->set(q);
+
+    const t_astronomySnapshot &snapshot(himmel.astro()->getSnapshot());
+
+    // The vertices are apparent places of date, already precessed, thus 
+    // the transform of the snapshot (precessing J2000) does not apply.
+
+    if(m_apparentStars.update(snapshot.t))
+    {
+        const osg::Vec3f *positions(m_apparentStars.positions());
+        const unsigned int *order(m_index.order());
+
+        for(unsigned int c = 0; c < m_index.numCells(); ++c)
+        {
+            const StarsIndex::t_cell &cell(m_index.cell(c));
+            osg::Vec4Array &vertices(*m_vertices[c]);
+
+            for(unsigned int i = 0; i < cell.count; ++i)
+            {
+                const osg::Vec3f &p(positions[order[cell.first + i]]);
+                vertices[i].set(p.x(), p.y(), p.z(), vertices[i].w());
+            }
+            vertices.dirty();
+        }
+        m_index.bound(positions);
+    }
+
+    m_equToHor = Stars::equToHorTransform(snapshot.siderealTime, snapshot.latitude, snapshot.longitude);
+    u_R->set(m_equToHor);
+
+    const float moonlight(Stars::moonlight(snapshot.sun, snapshot.moon, m_moonlightScale));
+    u_moonlight->set(moonlight);
+
+    m_limitingMagnitude = Stars::limitingMagnitude(getApparentMagnitude() - moonlight, q, snapshot.sun);
+
+    // the stars of the cells are sorted by magnitude, thus the fainter ones
+    // are not submitted by drawing the first only
+
+    for(unsigned int c = 0; c < m_index.numCells(); ++c)
+    {
+        const unsigned int count(m_index.numBrighter(c, m_limitingMagnitude));
+
+        if(m_drawArrays[c]->getCount() != static_cast<int>(count))
+            m_drawArrays[c]->setCount(count);
+    }
+
+    if(m_paged.valid())
+        updatePagedTiles(snapshot.t);
+}
+
 
-    u_R->set(himmel.astro()->getEquToHorTransform());
+const bool StarsGeode::view(
+    osg::NodeVisitor *nv
+,   osg::Vec3f &direction
+,   float &halfAngle) const
+{
+    osgUtil::CullVisitor* cv = dynamic_cast<osgUtil::CullVisitor*>(nv);
+    if(!cv)
+        return false;
+
+    const osg::Matrix &projection(*cv->getProjectionMatrix());
+    const osg::Matrix &modelView(*cv->getModelViewMatrix());
+
+    // orthographic projections are not culled
+    if(projection(3, 3) != 0.0)
+        return false;
+
+    // The view direction (-z of the eye) in the horizontal frame of the 
+    // drawables, and in the frame of the stars by the transposed R (its
+    // inverse, R is orthogonal). Both are applied to row vectors.
+
+    const osg::Vec3f h(-modelView(0, 2), -modelView(1, 2), -modelView(2, 2));
+
+    for(int j = 0; j < 3; ++j)
+        direction[j] = h[0] * m_equToHor(j, 0) + h[1] * m_equToHor(j, 1) + h[2] * m_equToHor(j, 2);
+    direction.normalize();
+
+    // cone around the frustum (including off-center frustums)
+
+    const double tx((1.0 + _abs(projection(2, 0))) / projection(0, 0));
+    const double ty((1.0 + _abs(projection(2, 1))) / projection(1, 1));
+
+    halfAngle = atan(sqrt(tx * tx + ty * ty));
+
+    return true;
+}
+
+
+const bool StarsGeode::isVisible(
+    const osg::Vec3f &axis
+,   const float radius
+,   const float brightest
+,   osg::NodeVisitor *nv) const
+{
+    if(brightest > m_limitingMagnitude)
+        return false;
+
+    osg::Vec3f d;
+    float halfAngle;
+
+    if(!view(nv, d, halfAngle))
+        return true;
+
+    // The quads of the stars extend by k (see the geometry shader), by the
+    // glare of the brightest star at most.
+
+    float moonlight;
+    u_moonlight->get(moonlight);
+
+    const float m(brightest + 0.4f);
+    const float i_g(pow(2.512f, getApparentMagnitude() - moonlight - (m + 0.167f)) - 1.f);
+
+    float q;
+    u_q->get(q);
+
+    const float k(_ma(q, sqrt(_ma(i_g, 0.f)) * 2e-2f * getGlareScale()));
+
+    return acos(_clamp(-1.f, 1.f, axis * d)) <= radius + halfAngle + atan(k);
+}
+
+
+const bool StarsGeode::isVisible(
+    const unsigned int cell
+,   osg::NodeVisitor *nv) const
+{
+    const StarsIndex::t_cell &c(m_index.cell(cell));
+    return isVisible(c.axis, c.radius, c.brightest, nv);
+}
+
+
+const bool StarsGeode::isTileVisible(
+    const unsigned int tile
+,   osg::NodeVisitor *nv) const
+{
+    std::map<unsigned int, t_pagedTile>::const_iterator i(m_pagedTiles.find(tile));
+    if(i == m_pagedTiles.end())
+        return false;
+
+    return isVisible(i->second.axis, i->second.radius, i->second.brightest, nv);
+}
+
+
+void StarsGeode::recordView(osg::NodeVisitor *nv)
+{
+    t_view v;
+
+    if(!view(nv, v.direction, v.halfAngle))
+    {
+        v.direction = osg::Vec3f(0.f, 0.f, 1.f);
+        v.halfAngle = static_cast<float>(_PI);
+    }
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_viewsMutex);
+    m_views.push_back(v);
+}
+
+
+void StarsGeode::updatePagedTiles(const t_julianDay t)
+{
+    std::vector<t_view> views;
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_viewsMutex);
+        views.swap(m_views);
+    }
+
+    // all of the sky, until culled
+    if(views.empty())
+    {
+        views.resize(1);
+        views[0].direction = osg::Vec3f(0.f, 0.f, 1.f);
+        views[0].halfAngle = static_cast<float>(_PI);
+    }
+
+    // The tiles are bound in J2000, the views of date. The precession 
+    // since (about 50.3" per year) and a margin for nutation, aberration,
+    // and proper motions widen the views.
+
+    const float margin(static_cast<float>(_rad(_abs(jCenturiesSinceSE(t)) * 100.0 * 50.3 / 3600.0 + 0.1)));
+
+    for(unsigned int v = 0; v < views.size(); ++v)
+        m_paged->request(views[v].direction, views[v].halfAngle + margin, m_limitingMagnitude);
+
+    std::vector<unsigned int> loaded;
+    std::vector<unsigned int> evicted;
+
+    m_paged->update(loaded, evicted);
+
+    for(unsigned int i = 0; i < evicted.size(); ++i)
+    {
+        std::map<unsigned int, t_pagedTile>::iterator tile(m_pagedTiles.find(evicted[i]));
+        if(tile == m_pagedTiles.end())
+            continue;
+
+        removeDrawable(tile->second.geometry.get());
+        m_pagedTiles.erase(tile);
+    }
+
+    for(unsigned int i = 0; i < loaded.size(); ++i)
+        createPagedTile(loaded[i]);
+
+    // as for the cells of the index (see update)
+
+    std::map<unsigned int, t_pagedTile>::iterator i(m_pagedTiles.begin());
+    for(; i != m_pagedTiles.end(); ++i)
+    {
+        t_pagedTile &tile(i->second);
+
+        if(tile.apparentStars.update(t))
+        {
+            const osg::Vec3f *positions(tile.apparentStars.positions());
+            osg::Vec4Array &vertices(*tile.vertices);
+
+            for(unsigned int s = 0; s < vertices.size(); ++s)
+                vertices[s].set(positions[s].x(), positions[s].y(), positions[s].z(), vertices[s].w());
+
+            vertices.dirty();
+
+            tile.radius = bound(positions, tile.apparentStars.numStars(), tile.axis);
+        }
+
+        const unsigned int count(m_paged->numBrighter(i->first, m_limitingMagnitude));
+
+        if(tile.drawArrays->getCount() != static_cast<int>(count))
+            tile.drawArrays->setCount(count);
+    }
+}
+
+
+void StarsGeode::createPagedTile(const unsigned int i)
+{
+    const PagedStars::t_tile &pagedTile(m_paged->tile(i));
+    const BrightStars::s_BrightStar *stars(m_paged->stars(i));
+
+    if(!stars)
+        return;
+
+    t_pagedTile &tile(m_pagedTiles[i]);
+
+    tile.apparentStars.setTolerance(m_apparentStars.getTolerance());
+    tile.apparentStars.setStars(stars, pagedTile.count);
+
+    tile.axis = pagedTile.axis;
+    tile.radius = pagedTile.radius;
+    tile.brightest = pagedTile.brightest;
+
+    osg::ref_ptr<osg::Vec4Array> cAry = new osg::Vec4Array(pagedTile.count);
+    osg::ref_ptr<osg::Vec4Array> vAry = new osg::Vec4Array(pagedTile.count);
+
+    for(unsigned int s = 0; s < pagedTile.count; ++s)
+    {
+        // positions are propagated on update (see updatePagedTiles), w 
+        // keeps the index in the catalogue, for the scintillation noise
+        (*vAry)[s] = osg::Vec4f(0.f, 0.f, 0.f, pagedTile.first + s);
+
+        (*cAry)[s] = osg::Vec4f(stars[s].sRGB_R, stars[s].sRGB_G, stars[s].sRGB_B, stars[s].Vmag + 0.4);
+    }
+
+    osg::ref_ptr<osg::Geometry> g = new osg::Geometry;
+    addDrawable(g);
+
+    g->setDataVariance(osg::Object::DYNAMIC);
+    g->setUseDisplayList(false);
+    g->setUseVertexBufferObjects(true);
+
+    g->setColorBinding(osg::Geometry::BIND_PER_VERTEX);
+    g->setColorArray(cAry);
+    g->setVertexArray(vAry);
+
+    tile.drawArrays = new osg::DrawArrays(osg::PrimitiveSet::POINTS, 0, vAry->size());
+    g->addPrimitiveSet(tile.drawArrays);
+
+    g->setCullCallback(new TileCullCallback(this, i));
+
+    tile.geometry = g;
+    tile.vertices = vAry;
 }
 
 
@@ -132,6 +487,9 @@ void StarsGeode::setupUniforms(osg::StateSet* stateSet)
     u_apparentMagnitude = new osg::Uniform("apparentMagnitude", defaultApparentMagnitude());
     stateSet->addUniform(u_apparentMagnitude);
 
+    u_moonlight = new osg::Uniform("moonlight", 0.f);
+    stateSet->addUniform(u_moonlight);
+
     u_scintillations = new osg::Uniform("scintillations", defaultScintillation());
     stateSet->addUniform(u_scintillations);
 
@@ -148,33 +506,59 @@ void StarsGeode::createAndAddDrawable(const char* brightStarsFilePath)
     BrightStars bs(brightStarsFilePath);
     const BrightStars::s_BrightStar *stars = bs.stars();
 
-    osg::ref_ptr<osg::Vec4Array> cAry = new osg::Vec4Array(bs.numStars());
-    osg::ref_ptr<osg::Vec4Array> vAry = new osg::Vec4Array(bs.numStars());
+    m_apparentStars.setStars(stars, bs.numStars());
+    m_index.build(stars, bs.numStars());
+
+    const unsigned int *order(m_index.order());
+
+    m_vertices.resize(m_index.numCells());
+    m_drawArrays.resize(m_index.numCells());
 
-    for(unsigned int i = 0; i < bs.numStars(); ++i)
+    for(unsigned int c = 0; c < m_index.numCells(); ++c)
     {
-        t_equf equ;
-        equ.right_ascension = _rightascd(stars[i].RA, 0, 0);
-        equ.declination = stars[i].DE;
+        const StarsIndex::t_cell &cell(m_index.cell(c));
 
-        osg::Vec3f vec = equ.toEuclidean();
-        (*vAry)[i] = osg::Vec4f(vec.x(), vec.y(), vec.z(), i);
+        osg::ref_ptr<osg::Vec4Array> cAry = new osg::Vec4Array(cell.count);
+        osg::ref_ptr<osg::Vec4Array> vAry = new osg::Vec4Array(cell.count);
 
-        (*cAry)[i] = osg::Vec4f(stars[i].sRGB_R, stars[i].sRGB_G, stars[i].sRGB_B, stars[i].Vmag + 0.4);
-        // the 0.4 accounts for magnitude decrease due to the earth's atmosphere
-    }
+        for(unsigned int i = 0; i < cell.count; ++i)
+        {
+            const unsigned int s(order[cell.first + i]);
+
+            t_equf equ;
+            equ.right_ascension = _rightascd(stars[s].RA, 0, 0);
+            equ.declination = stars[s].DE;
+
+            // w keeps the catalogue index, for the scintillation noise
+            osg::Vec3f vec = equ.toEuclidean();
+            (*vAry)[i] = osg::Vec4f(vec.x(), vec.y(), vec.z(), s);
+
+            (*cAry)[i] = osg::Vec4f(stars[s].sRGB_R, stars[s].sRGB_G, stars[s].sRGB_B, stars[s].Vmag + 0.4);
+            // the 0.4 accounts for magnitude decrease due to the earth's atmosphere
+        }
       
-    osg::ref_ptr<osg::Geometry> g = new osg::Geometry;
-    addDrawable(g);
+        osg::ref_ptr<osg::Geometry> g = new osg::Geometry;
+        addDrawable(g);
 
-    g->setColorBinding(osg::Geometry::BIND_PER_VERTEX);
-    g->setColorArray(cAry);
-    g->setVertexArray(vAry);
+        // positions are propagated in place on update (see update)
 
-    g->addPrimitiveSet(new osg::DrawArrays(osg::PrimitiveSet::POINTS, 0, vAry->size()));
+        g->setDataVariance(osg::Object::DYNAMIC);
+        g->setUseDisplayList(false);
+        g->setUseVertexBufferObjects(true);
 
-    // If things go wrong, fall back to big point rendering without geometry shader.
-    g->getOrCreateStateSet()->setAttribute(new osg::Point(TWO_TIMES_SQRT2));
+        g->setColorBinding(osg::Geometry::BIND_PER_VERTEX);
+        g->setColorArray(cAry);
+        g->setVertexArray(vAry);
+
+        m_vertices[c] = vAry;
+
+        // the count follows the limiting magnitude (see update)
+
+        m_drawArrays[c] = new osg::DrawArrays(osg::PrimitiveSet::POINTS, 0, vAry->size());
+        g->addPrimitiveSet(m_drawArrays[c]);
+
+        g->setCullCallback(new CellCullCallback(this, c));
+    }
 }
 
 
@@ -182,7 +566,23 @@ void StarsGeode::setupNode(
     osg::StateSet* stateSet
 ,   const char *brightStarsFilePath)
 {
-    createAndAddDrawable(brightStarsFilePath);
+    if(PagedStars::isPaged(brightStarsFilePath))
+    {
+        // tiles are streamed for the views on update (see updatePagedTiles)
+
+        m_paged = new PagedStars(brightStarsFilePath);
+        setCullCallback(new ViewCallback);
+    }
+    else
+        createAndAddDrawable(brightStarsFilePath);
+
+    // If things go wrong, fall back to big point rendering without geometry shader.
+    stateSet->setAttribute(new osg::Point(TWO_TIMES_SQRT2));
+
+    // The bounds of the drawables are in the frame of the stars, which R
+    // rotates in the vertex shader, thus the cells are culled by their 
+    // callbacks instead (see isVisible).
+    setCullingActive(false);
 
     osg::Depth* depth = new osg::Depth(osg::Depth::LEQUAL, 1.0, 1.0);    
     stateSet->setAttributeAndModes(depth, osg::StateAttribute::ON);
@@ -389,6 +789,56 @@ const float StarsGeode::getScale() const
 }
 
 
+const double StarsGeode::setPositionTolerance(const double arcsecs)
+{
+    std::map<unsigned int, t_pagedTile>::iterator i(m_pagedTiles.begin());
+    for(; i != m_pagedTiles.end(); ++i)
+        i->second.apparentStars.setTolerance(arcsecs);
+
+    return m_apparentStars.setTolerance(arcsecs);
+}
+
+const double StarsGeode::getPositionTolerance() const
+{
+    return m_apparentStars.getTolerance();
+}
+
+
+const float StarsGeode::setMoonlightScale(const float scale)
+{
+    m_moonlightScale = _ma(scale, 0.f);
+    return getMoonlightScale();
+}
+
+const float StarsGeode::getMoonlightScale() const
+{
+    return m_moonlightScale;
+}
+
+const float StarsGeode::defaultMoonlightScale()
+{
+    return 1.f;
+}
+
+
+const float StarsGeode::getLimitingMagnitude() const
+{
+    return m_limitingMagnitude;
+}
+
+
+const StarsIndex &StarsGeode::index() const
+{
+    return m_index;
+}
+
+
+PagedStars *StarsGeode::pagedStars()
+{
+    return m_paged.get();
+}
+
+
 
 const std::string StarsGeode::getVertexShaderSource()
 {
@@ -415,6 +865,7 @@ const std::string StarsGeode::getVertexShaderSource()
         "\n"
         "uniform float q;\n"
         "uniform float apparentMagnitude;\n"
+        "uniform float moonlight;\n"
         "\n"
         "uniform sampler1D noise1;\n"
         "\n"
@@ -438,7 +889,7 @@ const std::string StarsGeode::getVertexShaderSource()
         "        return;\n"
         "\n"
         "    float m = gl_Color.w;\n"
-        "    float m_a = apparentMagnitude;\n"
+        "    float m_a = apparentMagnitude - moonlight;\n"
         "\n"
         "    float delta_m = pow(2.512, m_a - m);\n"
         "\n"
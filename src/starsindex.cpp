@@ -0,0 +1,378 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "starsindex.h"
+
+#include "coords.h"
+#include "mathmacros.h"
+
+#include <algorithm>
+#include <math.h>
+
+
+namespace
+{
+    // Orders the stars by their key, and within a key by catalogue index.
+
+    class KeyOrder
+    {
+    public:
+        KeyOrder(const std::vector<unsigned int> &keys)
+        :   m_keys(keys)
+        {
+        }
+
+        bool operator()(const unsigned int a, const unsigned int b) const
+        {
+            return m_keys[a] < m_keys[b] || (m_keys[a] == m_keys[b] && a < b);
+        }
+
+    protected:
+        const std::vector<unsigned int> &m_keys;
+    };
+
+
+    class MagnitudeOrder
+    {
+    public:
+        MagnitudeOrder(const std::vector<float> &vmags)
+        :   m_vmags(vmags)
+        {
+        }
+
+        bool operator()(const unsigned int a, const unsigned int b) const
+        {
+            return m_vmags[a] < m_vmags[b] || (m_vmags[a] == m_vmags[b] && a < b);
+        }
+
+    protected:
+        const std::vector<float> &m_vmags;
+    };
+
+
+    // Interleaves the bits of x (even) and y (odd).
+
+    const unsigned int morton(
+        const unsigned int x
+    ,   const unsigned int y)
+    {
+        unsigned int key(0);
+        for(unsigned int b = 0; b < 16; ++b)
+            key |= ((x >> b) & 1) << (2 * b) | ((y >> b) & 1) << (2 * b + 1);
+
+        return key;
+    }
+
+
+    // Face of the cube (by the largest component) and the position on it
+    // in [0;1[ per axis.
+
+    const unsigned int face(
+        const osg::Vec3f &p
+    ,   float &u
+    ,   float &v)
+    {
+        const float ax(_abs(p.x()));
+        const float ay(_abs(p.y()));
+        const float az(_abs(p.z()));
+
+        unsigned int f;
+        float a, b, m;
+
+        if(ax >= ay && ax >= az)
+        {
+            f = p.x() < 0.f ? 1 : 0;
+            a = p.y(); b = p.z(); m = ax;
+        }
+        else if(ay >= az)
+        {
+            f = p.y() < 0.f ? 3 : 2;
+            a = p.z(); b = p.x(); m = ay;
+        }
+        else
+        {
+            f = p.z() < 0.f ? 5 : 4;
+            a = p.x(); b = p.y(); m = az;
+        }
+
+        u = _clamp(0.f, 0.99999f, (a / m + 1.f) * 0.5f);
+        v = _clamp(0.f, 0.99999f, (b / m + 1.f) * 0.5f);
+
+        return f;
+    }
+}
+
+
+namespace osgHimmel
+{
+
+StarsIndex::StarsIndex()
+{
+}
+
+
+const unsigned int StarsIndex::defaultMaxStarsPerCell()
+{
+    return 2048;
+}
+
+
+const unsigned int StarsIndex::defaultMaxLevel()
+{
+    return 10;
+}
+
+
+void StarsIndex::build(
+    const BrightStars::s_BrightStar *stars
+,   const unsigned int numStars
+,   const unsigned int maxStarsPerCell
+,   const unsigned int maxLevel)
+{
+    const unsigned int levels(_mi(maxLevel, 12u));
+    const unsigned int resolution(1u << levels);
+
+    m_order.resize(numStars);
+    m_vmags.resize(numStars);
+    m_cells.clear();
+
+    std::vector<osg::Vec3f> positions(numStars);
+    std::vector<unsigned int> keys(numStars);
+
+    for(unsigned int i = 0; i < numStars; ++i)
+    {
+        t_equf equ;
+        equ.right_ascension = _rightascd(stars[i].RA, 0, 0);
+        equ.declination = stars[i].DE;
+
+        positions[i] = equ.toEuclidean();
+
+        float u, v;
+        const unsigned int f(face(positions[i], u, v));
+
+        const unsigned int x(static_cast<unsigned int>(u * resolution));
+        const unsigned int y(static_cast<unsigned int>(v * resolution));
+
+        // the face in the high bits, so that cells are contiguous per face
+        keys[i] = (f << (2 * levels)) | morton(x, y);
+
+        m_order[i] = i;
+        m_vmags[i] = stars[i].Vmag;
+    }
+
+    std::sort(m_order.begin(), m_order.end(), KeyOrder(keys));
+
+    // keys in the order of the stars, to split ranges by their prefixes
+
+    std::vector<unsigned int> sorted(numStars);
+    for(unsigned int i = 0; i < numStars; ++i)
+        sorted[i] = keys[m_order[i]] & ((1u << (2 * levels)) - 1);
+
+    unsigned int first(0);
+    for(unsigned int f = 0; f < 6; ++f)
+    {
+        unsigned int count(0);
+        while(first + count < numStars && keys[m_order[first + count]] >> (2 * levels) == f)
+            ++count;
+
+        if(count > 0)
+            split(numStars ? &sorted[0] : NULL, first, count, f, 0, _ma(maxStarsPerCell, 1u), levels);
+
+        first += count;
+    }
+
+    for(unsigned int c = 0; c < m_cells.size(); ++c)
+    {
+        const t_cell &cell(m_cells[c]);
+
+        std::sort(m_order.begin() + cell.first, m_order.begin() + cell.first + cell.count
+            , MagnitudeOrder(m_vmags));
+
+        m_cells[c].brightest = m_vmags[m_order[cell.first]];
+    }
+
+    if(numStars > 0)
+        bound(&positions[0]);
+}
+
+
+void StarsIndex::split(
+    const unsigned int *keys
+,   const unsigned int first
+,   const unsigned int count
+,   const unsigned int face
+,   const unsigned int level
+,   const unsigned int maxStarsPerCell
+,   const unsigned int maxLevel)
+{
+    if(count <= maxStarsPerCell || level == maxLevel)
+    {
+        t_cell cell;
+
+        cell.first = first;
+        cell.count = count;
+        cell.face  = face;
+        cell.level = level;
+
+        cell.brightest = 0.f;
+        cell.radius = 0.f;
+
+        m_cells.push_back(cell);
+        return;
+    }
+
+    // the keys are sorted, and the two bits below the prefix of the level
+    // select the quadrant
+
+    const unsigned int shift(2 * (maxLevel - level - 1));
+
+    unsigned int begin(first);
+    for(unsigned int q = 0; q < 4; ++q)
+    {
+        unsigned int end(begin);
+        while(end < first + count && ((keys[end] >> shift) & 3) == q)
+            ++end;
+
+        if(end > begin)
+            split(keys, begin, end - begin, face, level + 1, maxStarsPerCell, maxLevel);
+
+        begin = end;
+    }
+}
+
+
+const unsigned int StarsIndex::numStars() const
+{
+    return m_order.size();
+}
+
+
+const unsigned int StarsIndex::numCells() const
+{
+    return m_cells.size();
+}
+
+
+const StarsIndex::t_cell &StarsIndex::cell(const unsigned int i) const
+{
+    return m_cells[i];
+}
+
+
+const unsigned int *StarsIndex::order() const
+{
+    return m_order.empty() ? NULL : &m_order[0];
+}
+
+
+const unsigned int StarsIndex::numBrighter(
+    const unsigned int i
+,   const float limitingMagnitude) const
+{
+    const t_cell &cell(m_cells[i]);
+
+    // binary search, the stars of the cell are sorted by magnitude
+
+    unsigned int lower(0);
+    unsigned int upper(cell.count);
+
+    while(lower < upper)
+    {
+        const unsigned int middle((lower + upper) / 2);
+
+        if(m_vmags[m_order[cell.first + middle]] <= limitingMagnitude)
+            lower = middle + 1;
+        else
+            upper = middle;
+    }
+    return lower;
+}
+
+
+void StarsIndex::bound(const osg::Vec3f *positions)
+{
+    for(unsigned int c = 0; c < m_cells.size(); ++c)
+    {
+        t_cell &cell(m_cells[c]);
+
+        osg::Vec3f axis;
+        for(unsigned int i = cell.first; i < cell.first + cell.count; ++i)
+            axis += positions[m_order[i]];
+
+        axis.normalize();
+
+        float minCos(1.f);
+        for(unsigned int i = cell.first; i < cell.first + cell.count; ++i)
+            minCos = _mi(minCos, axis * positions[m_order[i]]);
+
+        cell.axis = axis;
+
+        // a little wider, for the rounding of the floats
+        cell.radius = acos(_clamp(-1.f, 1.f, minCos)) + 1e-4f;
+    }
+}
+
+
+const bool StarsIndex::isVisible(
+    const unsigned int i
+,   const osg::Vec3f &direction
+,   const float halfAngle
+,   const float limitingMagnitude) const
+{
+    const t_cell &cell(m_cells[i]);
+
+    if(cell.brightest > limitingMagnitude)
+        return false;
+
+    const float angle(acos(_clamp(-1.f, 1.f, cell.axis * direction)));
+    return angle <= cell.radius + halfAngle;
+}
+
+
+const unsigned int StarsIndex::cull(
+    const osg::Vec3f &direction
+,   const float halfAngle
+,   const float limitingMagnitude
+,   std::vector<unsigned int> &cells) const
+{
+    cells.clear();
+
+    unsigned int count(0);
+    for(unsigned int c = 0; c < m_cells.size(); ++c)
+    {
+        if(!isVisible(c, direction, halfAngle, limitingMagnitude))
+            continue;
+
+        cells.push_back(c);
+        count += m_cells[c].count;
+    }
+    return count;
+}
+
+} // namespace osgHimmel
@@ -63,7 +63,10 @@ void replace(
 {
     char buffer[64];
 
-    if(sprintf_s(buffer, 64, "%f", value))
+    // exponent notation, since fixed notation loses small values (e.g., 
+    // the integral tolerance), with the digits to restore the float
+
+    if(sprintf_s(buffer, 64, "%.8e", value))
         replace(string, search, buffer);
 }
 
@@ -75,7 +78,7 @@ void replace(
 {
     char buffer[202];
 
-    if(sprintf_s(buffer, 202, "vec3(%f, %f, %f)", value[0], value[1], value[2]))
+    if(sprintf_s(buffer, 202, "vec3(%.8e, %.8e, %.8e)", value[0], value[1], value[2]))
         replace(string, search, buffer);
 }
 
@@ -34,6 +34,8 @@
 #include "siderealtime.h"
 #include "mathmacros.h"
 
+#include <vector>
+
 #include <assert.h>
 
 
@@ -42,15 +44,14 @@ namespace osgHimmel
 
 // Mean anomaly (AA.45.3).
 
-const t_longf Sun::meanAnomaly(const t_julianDay t)
+template<typename t_real>
+const t_real SunT<t_real>::meanAnomaly(const t_julianDay t)
 {
-    const t_julianDay T(jCenturiesSinceSE(t));
+    const t_real T(centuries<t_real>(t));
 
     // seems most accurate... :o
-    const t_longf M = 357.5291092
-        + T * (+ 35999.0502909
-        + T * (-     0.0001536
-        + T * (+ 1.0 / 24490000.0)));
+    static const t_real c[] = { 357.5291092, + 35999.0502909, - 0.0001536, + 1.0 / 24490000.0 };
+    const t_real M = polynomial(T, c, 4);
 
     // AA uses different coefficients all over the book...
     // ...taken the (probably) most accurate above
@@ -67,40 +68,46 @@ const t_longf Sun::meanAnomaly(const t_julianDay t)
     //    + T * (-     0.0001559
     //    + T * (-     0.00000048)));
 
-    return _revd(M);
+    return revd(M);
 }
 
 
-const t_longf Sun::meanLongitude(const t_julianDay t)
+template<typename t_real>
+const t_real SunT<t_real>::meanLongitude(const t_julianDay t)
 {
-    const t_julianDay T(jCenturiesSinceSE(t));
+    const t_real T(centuries<t_real>(t));
 
-    const t_longf L0 = 280.46645
-        + T * (+ 36000.76983  
-        + T * (+     0.0003032));
+    static const t_real c[] = { 280.46645, + 36000.76983, + 0.0003032 };
+    const t_real L0 = polynomial(T, c, 3);
 
-    return _revd(L0);
+    return revd(L0);
 }
 
 
 // (AA p152)
 
-const t_longf Sun::center(const t_julianDay t)
+template<typename t_real>
+const t_real SunT<t_real>::center(const t_julianDay t)
 {
-    const t_julianDay T(jCenturiesSinceSE(t));
+    const t_real T(centuries<t_real>(t));
     
-    const t_longf M = _rad(meanAnomaly(t));
+    const t_real M = rad(meanAnomaly(t));
+
+    static const t_real c1[] = { 1.914600, - 0.004817, + 0.000014 };
+    static const t_real c2[] = { 0.019993, - 0.000101 };
+    static const t_real c3(0.000290);
 
-    const t_longf C = 
-        + (1.914600 - T * (0.004817 - T * 0.000014)) * sin(M)
-        + (0.019993 - T *  0.000101) * sin(2.0 * M)
-        +  0.000290 * sin(3.0 * M);
+    const t_real C = 
+        + polynomial(T, c1, 3) * sin(M)
+        + polynomial(T, c2, 2) * sin(2 * M)
+        +  c3 * sin(3 * M);
 
     return C;
 }
 
 
-const t_longf Sun::trueAnomaly(const t_julianDay t)
+template<typename t_real>
+const t_real SunT<t_real>::trueAnomaly(const t_julianDay t)
 {
     return meanAnomaly(t) + center(t); // v = M + C
 }
@@ -108,63 +115,172 @@ const t_longf Sun::trueAnomaly(const t_julianDay t)
 
 // True geometric longitude referred to the mean equinox of the date.
 
-const t_longf Sun::trueLongitude(const t_julianDay t)
+template<typename t_real>
+const t_real SunT<t_real>::trueLongitude(const t_julianDay t)
 {
     return meanLongitude(t) + center(t); // Θ
 }
 
 
-const t_equd Sun::apparentPosition(const t_julianDay t)
+// Apparent longitude corrected for nutation and aberration, and the 
+// obliquity corrected respectively (AA p152).
+
+template<typename t_real>
+const t_real SunT<t_real>::apparentLongitude(const t_julianDay t)
+{
+    const t_real O = rad(MoonT<t_real>::meanOrbitLongitude(t));
+
+    return trueLongitude(t) - static_cast<t_real>(0.00569) - static_cast<t_real>(0.00478) * sin(O);
+}
+
+template<typename t_real>
+const t_real SunT<t_real>::apparentObliquity(
+    const t_julianDay t
+,   const SeriesTruncation *truncation)
 {
-    t_equd equ;
+    const t_real O = rad(MoonT<t_real>::meanOrbitLongitude(t));
 
-    const t_longf O = _rad(Moon::meanOrbitLongitude(t));
-    const t_longf e = _rad(Earth::trueObliquity(t) + 0.00256 * cos(O));
-    const t_longf l = _rad(trueLongitude(t) - 0.00569 - 0.00478 * sin(O));
+    return EarthT<t_real>::trueObliquity(t, truncation) + static_cast<t_real>(0.00256) * cos(O);
+}
 
-    const t_longf sinl = sin(l);
 
-    equ.right_ascension = _revd(_deg(atan2(cos(e) * sinl, cos(l))));
-    equ.declination = _deg(asin(sin(e) * sinl));
+template<typename t_real>
+const s_EquatorialCoords<t_real> SunT<t_real>::apparentPosition(
+    const t_julianDay t
+,   const SeriesTruncation *truncation)
+{
+    return apparentPosition(t, EarthT<t_real>::meanObliquity(t)
+        , EarthT<t_real>::obliquityNutation(t, truncation));
+}
+
+
+template<typename t_real>
+const s_EquatorialCoords<t_real> SunT<t_real>::apparentPosition(
+    const t_julianDay t
+,   const t_real meanObliquity
+,   const t_real obliquityNutation)
+{
+    s_EquatorialCoords<t_real> equ;
+
+    // (see apparentObliquity)
+
+    const t_real O = rad(MoonT<t_real>::meanOrbitLongitude(t));
+
+    const t_real e = rad(meanObliquity + obliquityNutation + static_cast<t_real>(0.00256) * cos(O));
+    const t_real l = rad(apparentLongitude(t));
+
+    const t_real sinl = sin(l);
+
+    equ.right_ascension = revd(deg(atan2(cos(e) * sinl, cos(l))));
+    equ.declination = deg(asin(sin(e) * sinl));
 
     return equ;
 }
 
 
-const t_hord Sun::horizontalPosition(
-    const t_aTime &aTime
-,   const t_longf latitude
-,   const t_longf longitude)
+template<typename t_real>
+void SunT<t_real>::apparentPositions(
+    const double *t
+,   const unsigned int count
+,   double *rightAscensions
+,   double *declinations
+,   const SeriesTruncation *truncation)
 {
-    t_julianDay t(jd(aTime));
-    t_julianDay s(siderealTime(aTime));
+    if(0 == count)
+        return;
+
+    t_fundArgArrays args;
+    fundamentalArguments(t, count, args);
 
-    t_equd equ = Sun::apparentPosition(t);
+    std::vector<double> De(count);
+    EarthT<t_real>::obliquityNutations(args, &De[0], truncation);
+
+    std::vector<double> e0(count);
+    std::vector<double> L(count);
+
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        e0[i] = static_cast<double>(EarthT<t_real>::meanObliquity(t[i]));
+        L[i] = static_cast<double>(trueLongitude(t[i]));
+    }
+
+    const double rad(static_cast<double>(_rad(1.0)));
+    const double deg(static_cast<double>(_deg(1.0)));
+
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        const double O = args.O[i];
+        const double e = (e0[i] + De[i] + 0.00256 * cos(O)) * rad;
+        const double l = (L[i] - 0.00569 - 0.00478 * sin(O)) * rad;
+
+        const double sinl = sin(l);
+
+        const double a = deg * atan2(cos(e) * sinl, cos(l));
+
+        rightAscensions[i] = a - floor(a / 360.0) * 360.0;
+        declinations[i] = deg * asin(sin(e) * sinl);
+    }
+}
+
+
+template<typename t_real>
+const s_HorizontalCoords<t_real> SunT<t_real>::horizontalPosition(
+    const t_julianTime &time
+,   const t_real latitude
+,   const t_real longitude
+,   const SeriesTruncation *truncation)
+{
+    t_julianDay t(time.jd());
+    t_julianDay s(siderealTime(time));
+
+    s_EquatorialCoords<t_real> equ = apparentPosition(t, truncation);
 
     return equ.toHorizontal(s, latitude, longitude);
 }
 
 
+template<typename t_real>
+void SunT<t_real>::horizontalPositions(
+    const t_julianTime &time
+,   const t_real *latitudes
+,   const t_real *longitudes
+,   const unsigned int count
+,   t_real *altitudes
+,   t_real *azimuths
+,   const SeriesTruncation *truncation)
+{
+    const s_EquatorialCoords<t_real> equ(apparentPosition(time.jd(), truncation));
+    equ.toHorizontal(siderealTime(time), latitudes, longitudes, count, altitudes, azimuths);
+}
+
+
 // NOTE: This gives the distance from the center of the sun to the
 // center of the earth.
 
-const t_longf Sun::distance(const t_julianDay t)
+template<typename t_real>
+const t_real SunT<t_real>::distance(const t_julianDay t)
 {
     // (AA.24.5)
-    const t_longf e = Earth::orbitEccentricity(t);
+    const t_real e = EarthT<t_real>::orbitEccentricity(t);
 
-    const t_longf R = 1.000001018 * (1.0 - e * e) /
-        (1.0 + e * cos(_rad(trueAnomaly(t))));  // in AU
+    const t_real R = static_cast<t_real>(1.000001018) * (1 - e * e) /
+        (1 + e * cos(rad(trueAnomaly(t))));  // in AU
 
     return _kms(R);
 }
 
 
-const t_longf Sun::meanRadius()
+template<typename t_real>
+const t_real SunT<t_real>::meanRadius()
 {
     // http://nssdc.gsfc.nasa.gov/planetary/factsheet/sunfact.html
 
     return 0.696e+6; // in kilometers
 }
 
+
+template class SunT<float>;
+template class SunT<double>;
+template class SunT<long double>;
+
 } // namespace osgHimmel
\ No newline at end of file
@@ -88,12 +88,12 @@ const t_equf Sun2::apparentPosition(const t_julianDay t)
 
 
 const t_horf Sun2::horizontalPosition(
-    const t_aTime &aTime
+    const t_julianTime &time
 ,   const float latitude
 ,   const float longitude)
 {
-    t_julianDay t(jd(aTime));
-    t_julianDay s(siderealTime(aTime));
+    t_julianDay t(time.jd());
+    t_julianDay s(siderealTime(time));
 
     t_equf equ = apparentPosition(t);
 
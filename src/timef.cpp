@@ -94,6 +94,8 @@ void TimeF::initialize()
     m_time[0]  = 0;
     m_time[1]  = 0;
     m_time[2]  = 0;
+
+    m_seconds  = 0.0;
 }
 
 
@@ -112,6 +114,7 @@ void TimeF::update()
     m_timef[1] = _frac(m_timef[0] + elapsedTimef + m_offset);
 
     m_time[1] = fToSeconds(elapsedTimef + m_offset) + static_cast<t_longf>(m_time[0]);
+    m_seconds = (elapsedTimef + m_offset) * 60.0 * 60.0 * 24.0 + static_cast<t_longf>(m_time[0]);
 }
 
 
@@ -177,6 +180,15 @@ const time_t TimeF::gett(const bool updateFirst)
 }
 
 
+const t_longf TimeF::gettf(const bool updateFirst)
+{
+    if(updateFirst)
+        update();
+
+    return gettf();
+}
+
+
 const time_t TimeF::sett(
     const time_t &time
 ,   const bool forceUpdate)
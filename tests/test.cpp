@@ -105,9 +105,11 @@ const bool Test::assert_eq_not( \
 
 
 Test::t_reportsByFile Test::s_reportsByFile;
+Test::t_reportsByFile Test::s_skipsByFile;
 
 Test::t_intByFile Test::s_succeeded;
 Test::t_intByFile Test::s_failed;
+Test::t_intByFile Test::s_skipped;
 
 
 void Test::report(const std::string &file)
@@ -121,8 +123,9 @@ void Test::report(const std::string &file)
 
     const int failed = s_failed[file];
     const int succeeded = s_succeeded[file];
+    const int skipped = s_skipped[file];
 
-    if(succeeded + failed == 0)
+    if(succeeded + failed + skipped == 0)
         return;
 
     if(failed)
@@ -135,14 +138,38 @@ void Test::report(const std::string &file)
 
         t_report &report = s_reportsByFile[file];
 
-        if(report.empty())
-            return;
-
         for(int i = 0; i < report.size(); ++i)
             std::cout << report[i] << std::endl << std::endl;
     }
     else
         std::cout << std::endl << "---- All " << succeeded << " Tests Passed." << std::endl << std::endl;
+
+    if(skipped)
+    {
+        std::cout << "---- " << skipped << " Tests Skipped." << std::endl << std::endl;
+
+        const t_report &skips = s_skipsByFile[file];
+
+        for(int i = 0; i < skips.size(); ++i)
+            std::cout << skips[i] << std::endl << std::endl;
+    }
+}
+
+
+void Test::skip(
+    const std::string &file
+,   const int line
+,   const std::string &reason)
+{
+    test(file);
+    ++s_skipped[file];
+
+    std::cout << "s";
+
+    std::stringstream stream;
+    stream << "SKIPPED: " << reason << std::endl << "in " << file << "(" << line << ")";
+
+    s_skipsByFile[file].push_back(stream.str());
 }
 
 
@@ -156,6 +183,7 @@ void Test::test(const std::string &file)
 
     s_succeeded[file] = 0;
     s_failed[file] = 0;
+    s_skipped[file] = 0;
 }
 
 
@@ -40,6 +40,9 @@
 #define TEST_REPORT() \
     Test::report(__FILE__);
 
+#define TEST_SKIP(reason) \
+    Test::skip(__FILE__, __LINE__, reason);
+
 #define ASSERT_EQ(T, expected, actual) \
     Test::assert_eq(__FILE__, __LINE__, static_cast<T>(expected), #expected, static_cast<T>(actual), #actual)
 
@@ -88,6 +91,12 @@ public:
 
     static void report(const std::string &file);
 
+    // Counts and reports tests that cannot run in this environment.
+    static void skip(
+        const std::string &file
+    ,   const int line
+    ,   const std::string &reason);
+
     ASSERT_EQ_DECL(unsigned short);
     ASSERT_EQ_NOT_DECL(unsigned short);
 
@@ -157,9 +166,11 @@ protected:
     typedef std::map<std::string, unsigned int> t_intByFile;
 
     static t_reportsByFile s_reportsByFile;
+    static t_reportsByFile s_skipsByFile;
 
     static t_intByFile s_succeeded;
     static t_intByFile s_failed;
+    static t_intByFile s_skipped;
 };
 
 #endif // __TEST_H__
\ No newline at end of file
@@ -34,36 +34,86 @@
 #include "osgHimmel/mathmacros.h"
 #include "osgHimmel/atime.h"
 #include "osgHimmel/julianday.h"
+#include "osgHimmel/juliantime.h"
 #include "osgHimmel/siderealtime.h"
 #include "osgHimmel/coords.h"
 #include "osgHimmel/moon.h"
 #include "osgHimmel/sun.h"
 #include "osgHimmel/earth.h"
+#include "osgHimmel/sun2.h"
+#include "osgHimmel/moon2.h"
 #include "osgHimmel/stars.h"
+#include "osgHimmel/apparentstars.h"
+#include "osgHimmel/brightstars.h"
+#include "osgHimmel/starsindex.h"
+#include "osgHimmel/pagedstars.h"
+#include "osgHimmel/astronomy.h"
+#include "osgHimmel/astronomy2.h"
+#include "osgHimmel/ephemeriscache.h"
+#include "osgHimmel/astronomyevents.h"
+#include "osgHimmel/nutationcache.h"
+
+#include <OpenThreads/Thread>
+#include <OpenThreads/Atomic>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <vector>
+
+#include <assert.h>
 
 
 using namespace osgHimmel;
 
 void test_aTime();
 void test_jd();
+void test_julianTime();
 void test_sideralTime();
 void test_coords();
 void test_sun();
 void test_moon();
 void test_stars();
+void test_brightStars();
+void test_starsIndex();
+void test_pagedStars();
 void test_earth();
+void test_batched();
+void test_ephemerisCache();
+void test_snapshot();
+void test_precision();
+void test_seriesTruncation();
+void test_nutationCache();
+void test_observers();
+void test_threads();
+void test_events();
 
 void test_astronomy()
 {
     // Run Tests.
     test_aTime();
     test_jd();
+    test_julianTime();
     test_sideralTime();
     test_coords();
     test_sun();
     test_moon();
     test_stars();
+    test_brightStars();
+    test_starsIndex();
+    test_pagedStars();
     test_earth();
+    test_batched();
+    test_ephemerisCache();
+    test_snapshot();
+    test_precision();
+    test_seriesTruncation();
+    test_nutationCache();
+    test_observers();
+    test_threads();
+    test_events();
 
     TEST_REPORT();
 }
@@ -186,6 +236,80 @@ void test_jd()
 }
 
 
+void test_julianTime()
+{
+    // t_aTime converts exactly.
+
+    const t_aTime aTimes[] =
+    {
+        t_aTime(2012,  6, 21, 11, 59, 59)
+    ,   t_aTime(1987,  4, 10, 19, 21,  0, 7200)
+    ,   t_aTime( 333,  1, 27, 12,  0,  0)
+    ,   t_aTime(2049, 12, 31, 23, 59, 59, -3600)
+    };
+
+    for(int i = 0; i < 4; ++i)
+    {
+        const t_julianTime time(aTimes[i]);
+
+        ASSERT_EQ(long double, jd(aTimes[i]), time.jd());
+        ASSERT_EQ(long double, 0.0, _frac(time.day + 0.5));
+        ASSERT_EQ(int, 1, time.toATime() == aTimes[i]);
+        ASSERT_EQ(short, aTimes[i].utcOffset, time.toATime().utcOffset);
+    }
+
+    // time_t without the time zone of the system
+
+    t_julianTime time(t_julianTime::fromTimeT(1325376000, 3600)); // 2012-01-01 00:00 UTC
+
+    ASSERT_EQ(double, 2455927.5, time.day);
+    ASSERT_EQ(double, 1.0 / 24.0, time.fraction);
+    ASSERT_EQ(long double, 2455927.5, time.jdUT());
+
+    time = t_julianTime::fromTimeT(-1, 0, 0.25);
+
+    ASSERT_EQ(double, 2440586.5, time.day);
+    ASSERT_EQ(double, (86399.25) / 86400.0, time.fraction);
+
+    // arithmetic in seconds, across midnight
+
+    time = t_julianTime(t_aTime(2012, 6, 21, 23, 59, 59));
+    const t_julianTime later(time + 1.5);
+
+    ASSERT_EQ(double, time.day + 1.0, later.day);
+    ASSERT_AB(double, 0.5 / 86400.0, later.fraction, 1e-12);
+    ASSERT_AB(double, 1.5, later - time, 1e-6);
+    ASSERT_AB(double, -3600.0, t_julianTime(jd(aTimes[0]), 3600) - t_julianTime(jd(aTimes[0])), 1e-6);
+
+    // Sub-second instants move the sky steadily (the sun rises in the morning).
+
+    const t_julianTime morning(t_aTime(2012, 6, 21, 7, 0, 0));
+
+    ASSERT_AB(long double, 0.05 * 360.98564736629 / 86400.0
+        , siderealTime(morning + 0.05) - siderealTime(morning), 1e-9);
+
+    Astronomy astro;
+
+    const unsigned int count(21);
+
+    std::vector<t_julianTime> times(count);
+    for(unsigned int i = 0; i < count; ++i)
+        times[i] = morning + i * 0.05;
+
+    const std::vector<float> latitudes(count, 52.5f);
+    const std::vector<float> longitudes(count, 13.4f);
+
+    std::vector<float> x(count), y(count), z(count);
+    astro.getSunPositions(&times[0], &latitudes[0], &longitudes[0], count, false, &x[0], &y[0], &z[0]);
+
+    const float step((z[count - 1] - z[0]) / (count - 1));
+    ASSERT_EQ(int, 1, step > 0.f);
+
+    for(unsigned int i = 1; i < count; ++i)
+        ASSERT_AB(float, step, z[i] - z[i - 1], step * 0.1f);
+}
+
+
 void test_sideralTime()
 {
     ASSERT_AB(long double, _hour(13, 10, 46.3668), _hours(siderealTime(t_aTime(1987, 4, 10,  0,  0, 0))), 0.00000001);
@@ -386,11 +510,464 @@ void test_moon()
 
 void test_stars()
 {
-    const t_julianDay t(jd(t_aTime(1978, 1, 1)));
+    // Example 23.a - theta Persei
+
+    const t_julianDay t(2462088.69);
 
     const t_equd equ = Stars::apparentPosition(t
-        , _decimal(10, 8, 22.3), _decimal(11, 58,  2)
-        , _arcsecs(_decimal(0, 0, 0.248)), _decimal(0, 0, 0.006));
+        , _rightascd(2, 44, 11.986), _decimal(49, 13, 42.48)
+        , _rightascd(0, 0, 0.03425), _decimal(0, 0, -0.0895));
+
+    ASSERT_AB(long double, _rightascd(2, 46, 14.390), equ.right_ascension, _decimal(0, 0, 0.2));
+    ASSERT_AB(long double, _decimal(49, 21, 7.45), equ.declination, _decimal(0, 0, 0.2));
+
+    // all stars of an epoch at once
+
+    BrightStars::s_BrightStar stars[3] =
+    {
+        { 2.f, static_cast<float>(_hour(2, 44, 11.986)), static_cast<float>(_decimal(49, 13, 42.48))
+            , static_cast<float>(_rightascd(0, 0, 0.03425) * 3600.0 * _cosd(_decimal(49, 13, 42.48))), -0.0895f, 1.f, 1.f, 1.f }
+    ,   { 2.f, 0.4291944f, -77.25417f, 2.215f, 0.324f, 1.f, 1.f, 1.f }  // beta Hydri
+    ,   { 2.f, 18.f, 89.9f, 0.f, 0.f, 1.f, 1.f, 1.f }
+    };
+
+    ApparentStars apparent;
+    apparent.setStars(stars, 3);
+
+    ASSERT_EQ(int, 0, apparent.isValid());
+    ASSERT_EQ(int, 1, apparent.update(t));
+    ASSERT_EQ(int, 0, apparent.update(t + apparent.getInterval() * 0.5));
+    ASSERT_EQ(int, 1, apparent.update(t + apparent.getInterval() * 1.5));
+
+    apparent.propagate(t);
+
+    const osg::Vec3f p(equ.toEuclidean());
+    ASSERT_AB(float, 0.f, (apparent.positions()[0] - p).length(), _rad(0.01 / 3600.0) + 1e-6f);
+
+    // within the tolerance while the positions are kept
+
+    apparent.setTolerance(1.0);
+
+    ApparentStars exact;
+    exact.setStars(stars, 3);
+
+    float maxError(0.f);
+    for(int i = 0; i < 24 * 366; ++i)
+    {
+        const t_julianDay ti(t + i / 24.0);
+
+        apparent.update(ti);
+        exact.propagate(ti);
+
+        for(int s = 0; s < 3; ++s)
+            maxError = _ma(maxError, (apparent.positions()[s] - exact.positions()[s]).length());
+    }
+    ASSERT_EQ(int, 1, maxError < _rad(1.0 / 3600.0));
+
+    // moonlight, of a full moon in the zenith, a quarter, and a new moon
+
+    const osg::Vec3f zenith(0.f, 0.f, 1.f);
+    const osg::Vec3f night(0.f, 0.f, -1.f);
+
+    ASSERT_AB(float, 1.25f * log10(26.f), Stars::moonlight(night, zenith), 1e-4f);
+    ASSERT_AB(float, 0.65f, Stars::moonlight(osg::Vec3f(1.f, 0.f, 0.f), zenith), 0.05f);
+    ASSERT_AB(float, 0.f, Stars::moonlight(zenith, zenith), 0.01f);
+    ASSERT_EQ(float, 0.f, Stars::moonlight(zenith, night));
+    ASSERT_EQ(float, 0.f, Stars::moonlight(night, zenith, 0.f));
+
+    // stars at the limiting magnitude have an intensity of 0.01 (as in the
+    // vertex shader of StarsGeode), and the limit decreases with the sun
+
+    const float q(4.f * tan(_rad(30.f)) / 1080.f);
+
+    float limit(Stars::limitingMagnitude(7.f, q, night));
+
+    const float i_t(pow(2.512f, 7.f - (limit + 0.4f)) * 0.85698815f * 4e-7f / (q * q));
+    ASSERT_AB(float, 0.01f, i_t / sqrt(1.f + pow(-1.f + 1.14f, 32.f)), 1e-5f);
+
+    for(int altitude = -18; altitude <= 30; altitude += 6)
+    {
+        const float l(Stars::limitingMagnitude(7.f, q, osg::Vec3f(0.f, _cosd(altitude), _sind(altitude))));
+
+        ASSERT_EQ(int, 1, l <= limit);
+        limit = l;
+    }
+}
+
+
+void test_brightStars()
+{
+    BrightStars::s_BrightStar stars[3] =
+    {
+        { 2.06f, 0.1398056f, 29.09056f, 0.136f, -0.163f, 0.78f, 0.99f, 1.73f }
+    ,   { 2.27f, 0.1529722f, 59.14972f, 0.525f, -0.181f, 0.96f, 0.99f, 1.21f }
+    ,   { 2.80f, 0.4291944f, -77.25417f, 2.215f, 0.324f, 1.09f, 0.98f, 0.94f }
+    };
+
+    // raw star arrays of former versions are copied
+
+    {
+        std::ofstream raw("brightstars.raw", std::ios::binary);
+        raw.write(reinterpret_cast<const char*>(stars), sizeof(stars));
+    }
+
+    ASSERT_EQ(unsigned int, 3, BrightStars::convert("brightstars.raw", "brightstars.bin"));
+    {
+        const BrightStars raw("brightstars.raw");
+
+        ASSERT_EQ(unsigned int, 3, raw.numStars());
+        ASSERT_EQ(int, 0, raw.isMapped());
+        ASSERT_EQ(int, 0, memcmp(stars, raw.stars(), sizeof(stars)));
+    }
+
+    // the versioned format is mapped
+
+    {
+        BrightStars mapped("brightstars.bin");
+
+        ASSERT_EQ(unsigned int, 3, mapped.numStars());
+        ASSERT_EQ(int, 1, mapped.isMapped());
+        ASSERT_EQ(int, 0, memcmp(stars, mapped.stars(), sizeof(stars)));
+
+        // replaces the mapped file, and reads it back
+        ASSERT_EQ(unsigned int, 3, mapped.toFile("brightstars.bin"));
+        ASSERT_EQ(unsigned int, 3, mapped.fromFile("brightstars.bin"));
+        ASSERT_EQ(int, 0, memcmp(stars, mapped.stars(), sizeof(stars)));
+    }
+
+    std::vector<char> file;
+    {
+        std::ifstream stream("brightstars.bin", std::ios::binary);
+        file.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+    }
+    ASSERT_EQ(unsigned int, 64 + sizeof(stars), file.size());
+
+    // files of the other byte order are swapped
+
+    std::vector<char> swapped(file);
+    for(std::size_t i = 4; i < swapped.size(); i += 4)
+    {
+        std::swap(swapped[i], swapped[i + 3]);
+        std::swap(swapped[i + 1], swapped[i + 2]);
+    }
+    {
+        std::ofstream stream("brightstars.bin", std::ios::binary);
+        stream.write(&swapped[0], swapped.size());
+    }
+    {
+        const BrightStars other("brightstars.bin");
+
+        ASSERT_EQ(unsigned int, 3, other.numStars());
+        ASSERT_EQ(int, 0, other.isMapped());
+        ASSERT_EQ(int, 0, memcmp(stars, other.stars(), sizeof(stars)));
+    }
+
+    // unknown versions and truncated files are rejected
+
+    std::vector<char> invalid(file);
+    invalid[4] = 2;
+    {
+        std::ofstream stream("brightstars.bin", std::ios::binary);
+        stream.write(&invalid[0], invalid.size());
+    }
+    ASSERT_EQ(unsigned int, 0, BrightStars("brightstars.bin").numStars());
+
+    {
+        std::ofstream stream("brightstars.bin", std::ios::binary);
+        stream.write(&file[0], file.size() - 1);
+    }
+    ASSERT_EQ(unsigned int, 0, BrightStars("brightstars.bin").numStars());
+    ASSERT_EQ(int, 1, NULL == BrightStars("brightstars.bin").stars());
+
+    ASSERT_EQ(unsigned int, 0, BrightStars("brightstars.missing").numStars());
+
+    std::remove("brightstars.raw");
+    std::remove("brightstars.bin");
+}
+
+
+void test_starsIndex()
+{
+    static const unsigned int count(20000);
+
+    std::vector<BrightStars::s_BrightStar> stars(count);
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        stars[i].Vmag = (i * 7919 % 1300) * 0.01f - 1.5f;
+        stars[i].RA = (i * 104729 % count) * 24.f / count;
+        stars[i].DE = _deg(asin(2.0 * (i * 7907 % count) / count - 1.0));
+    }
+
+    StarsIndex index;
+    index.build(&stars[0], count, 256);
+
+    ASSERT_EQ(unsigned int, count, index.numStars());
+    ASSERT_EQ(int, 1, index.numCells() > 6);
+
+    // every star in exactly one cell, sorted by magnitude per cell
+
+    std::vector<unsigned int> hits(count, 0);
+
+    unsigned int first(0);
+    for(unsigned int c = 0; c < index.numCells(); ++c)
+    {
+        const StarsIndex::t_cell &cell(index.cell(c));
+
+        ASSERT_EQ(unsigned int, first, cell.first);
+        ASSERT_EQ(int, 1, cell.count > 0 && cell.count <= 256);
+        ASSERT_EQ(float, stars[index.order()[cell.first]].Vmag, cell.brightest);
+
+        for(unsigned int i = cell.first; i < cell.first + cell.count; ++i)
+        {
+            ++hits[index.order()[i]];
+
+            if(i > cell.first)
+                ASSERT_EQ(int, 1, stars[index.order()[i - 1]].Vmag <= stars[index.order()[i]].Vmag);
+        }
+        first += cell.count;
+    }
+    ASSERT_EQ(unsigned int, count, first);
+    ASSERT_EQ(int, 1, std::count(hits.begin(), hits.end(), 1u) == count);
+
+    // culling is conservative: stars within the view cone and brighter 
+    // than the limit lie in visible cells only
+
+    std::vector<osg::Vec3f> positions(count);
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        t_equf equ;
+        equ.right_ascension = _rightascd(stars[i].RA, 0, 0);
+        equ.declination = stars[i].DE;
+
+        positions[i] = equ.toEuclidean();
+    }
+
+    std::vector<int> cellOf(count);
+    for(unsigned int c = 0; c < index.numCells(); ++c)
+        for(unsigned int i = index.cell(c).first; i < index.cell(c).first + index.cell(c).count; ++i)
+            cellOf[index.order()[i]] = c;
+
+    std::vector<unsigned int> visible;
+
+    for(int v = 0; v < 64; ++v)
+    {
+        t_equf equ;
+        equ.right_ascension = v * 137.5f;
+        equ.declination = _deg(asin(v / 32.f - 1.f));
+
+        const osg::Vec3f d(equ.toEuclidean());
+        const float halfAngle(_rad(v % 2 ? 2.5f : 30.f));
+        const float limit(v % 4 < 2 ? 6.f : 20.f);
+
+        const unsigned int culled(index.cull(d, halfAngle, limit, visible));
+        ASSERT_EQ(int, 1, culled < count);
+
+        std::vector<bool> isVisible(index.numCells(), false);
+        for(unsigned int c = 0; c < visible.size(); ++c)
+            isVisible[visible[c]] = true;
+
+        for(unsigned int i = 0; i < count; ++i)
+        {
+            if(acos(_clamp(-1.f, 1.f, positions[i] * d)) > halfAngle || stars[i].Vmag > limit)
+                continue;
+
+            ASSERT_EQ(int, 1, isVisible[cellOf[i]]);
+        }
+    }
+
+    // the cones follow moved stars
+
+    for(unsigned int i = 0; i < count; ++i)
+        positions[i] = osg::Vec3f(-positions[i].x(), -positions[i].y(), positions[i].z());
+
+    index.bound(&positions[0]);
+
+    for(unsigned int i = 0; i < count; i += 97)
+        ASSERT_EQ(int, 1, index.isVisible(cellOf[i], positions[i], 0.f, 20.f));
+
+    // the brighter stars are the first of each cell
+
+    for(unsigned int c = 0; c < index.numCells(); ++c)
+    {
+        const StarsIndex::t_cell &cell(index.cell(c));
+
+        ASSERT_EQ(unsigned int, 0, index.numBrighter(c, cell.brightest - 0.01f));
+        ASSERT_EQ(unsigned int, cell.count, index.numBrighter(c, 20.f));
+
+        const unsigned int n(index.numBrighter(c, 4.f));
+        for(unsigned int i = 0; i < cell.count; ++i)
+            ASSERT_EQ(int, i < n, stars[index.order()[cell.first + i]].Vmag <= 4.f);
+    }
+}
+
+
+namespace
+{
+    bool starLess(
+        const BrightStars::s_BrightStar &a
+    ,   const BrightStars::s_BrightStar &b)
+    {
+        return memcmp(&a, &b, sizeof(BrightStars::s_BrightStar)) < 0;
+    }
+}
+
+
+void test_pagedStars()
+{
+    static const unsigned int count(20000);
+
+    std::vector<BrightStars::s_BrightStar> stars(count);
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        BrightStars::s_BrightStar &star(stars[i]);
+
+        star.Vmag = (i * 7919 % 1800) * 0.01f - 1.5f;
+        star.RA = (i * 104729 % count) * 24.f / count;
+        star.DE = _deg(asin(2.0 * (i * 7907 % count) / count - 1.0));
+        star.pmRA = star.pmDE = 0.f;
+        star.sRGB_R = star.sRGB_G = star.sRGB_B = i * 1e-4f;
+    }
+
+    ASSERT_EQ(unsigned int, count, PagedStars::toFile(&stars[0], count, "pagedstars.bin", 256));
+    ASSERT_EQ(int, 1, PagedStars::isPaged("pagedstars.bin"));
+
+    {
+        std::ofstream raw("pagedstars.raw", std::ios::binary);
+        raw.write(reinterpret_cast<const char*>(&stars[0]), count * sizeof(BrightStars::s_BrightStar));
+    }
+    ASSERT_EQ(int, 0, PagedStars::isPaged("pagedstars.raw"));
+    ASSERT_EQ(int, 0, PagedStars("pagedstars.raw").isOpen());
+    ASSERT_EQ(int, 0, PagedStars("pagedstars.missing").isOpen());
+
+    {
+        PagedStars paged("pagedstars.bin", count * sizeof(BrightStars::s_BrightStar));
+
+        ASSERT_EQ(int, 1, paged.isOpen());
+        ASSERT_EQ(unsigned int, count, paged.numStars());
+
+        // tiles by layer, within the magnitudes of their layer
+
+        unsigned int first(0);
+        for(unsigned int i = 0; i < paged.numTiles(); ++i)
+        {
+            const PagedStars::t_tile &tile(paged.tile(i));
+
+            ASSERT_EQ(unsigned int, first, tile.first);
+            ASSERT_EQ(int, 1, tile.count > 0 && tile.count <= 256);
+            ASSERT_EQ(int, 1, i == 0 || paged.tile(i - 1).layer <= tile.layer);
+            ASSERT_EQ(int, 1, tile.faintest <= PagedStars::layer(tile.layer));
+            ASSERT_EQ(int, 1, tile.layer == 0 || tile.brightest > PagedStars::layer(tile.layer - 1));
+
+            first += tile.count;
+        }
+
+        // all tiles, all stars
+
+        std::vector<unsigned int> loaded;
+        std::vector<unsigned int> evicted;
+
+        ASSERT_EQ(unsigned int, 0, paged.request(osg::Vec3f(0.f, 0.f, 1.f), static_cast<float>(_PI), 99.f));
+        paged.update(loaded, evicted);
+        paged.wait();
+        paged.update(loaded, evicted);
+
+        ASSERT_EQ(unsigned int, paged.numTiles(), loaded.size());
+        ASSERT_EQ(unsigned int, 0, evicted.size());
+
+        std::vector<BrightStars::s_BrightStar> read;
+        for(unsigned int i = 0; i < paged.numTiles(); ++i)
+        {
+            const BrightStars::s_BrightStar *tile(paged.stars(i));
+            ASSERT_EQ(int, 1, NULL != tile);
+
+            read.insert(read.end(), tile, tile + paged.tile(i).count);
+
+            ASSERT_EQ(unsigned int, 0, paged.numBrighter(i, paged.tile(i).brightest - 0.01f));
+            ASSERT_EQ(unsigned int, paged.tile(i).count, paged.numBrighter(i, 99.f));
+        }
+
+        std::vector<BrightStars::s_BrightStar> expected(stars);
+        std::sort(expected.begin(), expected.end(), starLess);
+        std::sort(read.begin(), read.end(), starLess);
+
+        ASSERT_EQ(int, 0, memcmp(&expected[0], &read[0], count * sizeof(BrightStars::s_BrightStar)));
+
+        const PagedStars::t_statistics &statistics(paged.statistics());
+
+        ASSERT_EQ(unsigned int, paged.numTiles(), statistics.residentTiles);
+        ASSERT_EQ(unsigned int, count * sizeof(BrightStars::s_BrightStar), statistics.residentBytes);
+        ASSERT_EQ(unsigned int, 0, statistics.pendingTiles);
+        ASSERT_EQ(int, 1, statistics.maxLatency >= statistics.meanLatency);
+
+        // narrow views evict the tiles of former views beyond the budget
+
+        const std::size_t budget(count * sizeof(BrightStars::s_BrightStar) / 8);
+        paged.setBudget(budget);
+
+        for(int v = 0; v < 16; ++v)
+        {
+            t_equf equ;
+            equ.right_ascension = v * 22.5f;
+            equ.declination = 0.f;
+
+            paged.request(equ.toEuclidean(), _rad(5.f), 99.f);
+            paged.update(loaded, evicted);
+            paged.wait();
+            paged.update(loaded, evicted);
+
+            ASSERT_EQ(int, 1, paged.statistics().residentBytes <= budget);
+        }
+        ASSERT_EQ(int, 1, paged.statistics().evictedTiles > 0);
+
+        // requests beyond the budget drop the fainter layers
+
+        paged.request(osg::Vec3f(0.f, 0.f, 1.f), static_cast<float>(_PI), 99.f);
+        paged.update(loaded, evicted);
+        paged.wait();
+
+        ASSERT_EQ(int, 1, paged.statistics().droppedTiles > 0);
+
+        paged.update(loaded, evicted);
+        for(unsigned int i = 0; i < loaded.size(); ++i)
+            ASSERT_EQ(int, 1, paged.tile(loaded[i]).layer < PagedStars::numLayers() - 1);
+
+        // tiles loaded after their view moved away are not evicted by the 
+        // update that returns them as loaded
+
+        const osg::Vec3f north(0.f, 0.f, 1.f);
+        const osg::Vec3f south(0.f, 0.f, -1.f);
+
+        paged.request(south, _rad(60.f), 99.f);
+        paged.update(loaded, evicted);
+        paged.wait();
+        paged.update(loaded, evicted);
+
+        paged.request(north, _rad(60.f), 99.f);
+        paged.update(loaded, evicted);
+        paged.wait();
+
+        paged.request(south, _rad(60.f), 99.f);
+        paged.update(loaded, evicted);
+
+        ASSERT_EQ(int, 0, loaded.empty());
+
+        for(unsigned int i = 0; i < loaded.size(); ++i)
+        {
+            ASSERT_EQ(int, 1, NULL != paged.stars(loaded[i]));
+            ASSERT_EQ(int, 1, evicted.end() == std::find(evicted.begin(), evicted.end(), loaded[i]));
+        }
+
+        // and are evicted by the next one
+
+        paged.request(south, _rad(60.f), 99.f);
+        paged.update(loaded, evicted);
+
+        ASSERT_EQ(int, 0, evicted.empty());
+        ASSERT_EQ(int, 1, paged.statistics().residentBytes <= budget);
+    }
+
+    std::remove("pagedstars.raw");
+    std::remove("pagedstars.bin");
 }
 
 
@@ -408,4 +985,930 @@ void test_earth()
         ,  6386.958059,   1.e-6);
     ASSERT_AB(long double, Earth::viewDistanceWithinAtmosphere(-1.0)
         , Earth::meanRadius() * 2 + Earth::atmosphereThickness(), 1.e-6);
-}
\ No newline at end of file
+}
+
+
+void test_batched(
+    const AbstractAstronomy &astro
+,   const bool refractionCorrected)
+{
+    static const unsigned int count(97);
+
+    t_aTime aTimes[count];
+    float latitudes[count];
+    float longitudes[count];
+
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        aTimes[i] = t_aTime(1850 + i * 3, 1 + i % 12, 1 + i % 28, i % 24, i * 7 % 60, i * 13 % 60);
+
+        latitudes[i]  = -89.f + i * 178.f / (count - 1);
+        longitudes[i] = -180.f + i * 360.f / (count - 1);
+    }
+
+    float x[count];
+    float y[count];
+    float z[count];
+
+    astro.getSunPositions(aTimes, latitudes, longitudes, count, refractionCorrected, x, y, z);
+
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        const osg::Vec3f sun = astro.getSunPosition(aTimes[i], latitudes[i], longitudes[i], refractionCorrected);
+
+        ASSERT_AB(float, sun[0], x[i], 1e-5);
+        ASSERT_AB(float, sun[1], y[i], 1e-5);
+        ASSERT_AB(float, sun[2], z[i], 1e-5);
+    }
+
+    astro.getMoonPositions(aTimes, latitudes, longitudes, count, refractionCorrected, x, y, z);
+
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        const osg::Vec3f moon = astro.getMoonPosition(aTimes[i], latitudes[i], longitudes[i], refractionCorrected);
+
+        ASSERT_AB(float, moon[0], x[i], 1e-5);
+        ASSERT_AB(float, moon[1], y[i], 1e-5);
+        ASSERT_AB(float, moon[2], z[i], 1e-5);
+    }
+}
+
+
+void test_batched()
+{
+    // Batched positions match the positions per instant.
+
+    const Astronomy astro;
+    const Astronomy2 astro2;
+
+    test_batched(astro, false);
+    test_batched(astro, true);
+
+    test_batched(astro2, false);
+    test_batched(astro2, true);
+}
+
+
+void test_ephemerisCache()
+{
+    const t_julianDay begin(jd(t_aTime(1992, 4, 1.0)));
+    const t_julianDay end(begin + 30.0);
+
+    osg::ref_ptr<EphemerisCache> cache(new EphemerisCache);
+
+    ASSERT_EQ(int, false, cache->isValid());
+    ASSERT_EQ(int, true, cache->build(begin, end));
+
+    ASSERT_EQ(int, true, cache->covers(begin));
+    ASSERT_EQ(int, true, cache->covers(end));
+    ASSERT_EQ(int, false, cache->covers(end + 0.1));
+
+    // within the tolerance of 0.01 arcseconds
+
+    const long double tolerance(_decimal(0, 0, cache->getTolerance()));
+
+    for(int i = 0; i <= 300; ++i)
+    {
+        const t_julianDay t(begin + i * 0.1);
+
+        const t_ecld moon(Moon::position(t));
+        const t_ecld cached(cache->moonPosition(t));
+
+        ASSERT_AB(long double, _revd(moon.longitude), cached.longitude, tolerance);
+        ASSERT_AB(long double, moon.latitude, cached.latitude, tolerance);
+
+        ASSERT_AB(long double, Earth::longitudeNutation(t)
+            , cache->value(EphemerisCache::Q_LongitudeNutation, t), tolerance);
+        ASSERT_AB(long double, Earth::obliquityNutation(t)
+            , cache->value(EphemerisCache::Q_ObliquityNutation, t), tolerance);
+
+        ASSERT_AB(long double, Sun::apparentPosition(t).declination
+            , cache->sunApparentPosition(t).declination, tolerance);
+        ASSERT_AB(long double, Moon::apparentPosition(t).declination
+            , cache->moonApparentPosition(t).declination, tolerance);
+
+        ASSERT_AB(long double, Moon::distance(t), cache->value(EphemerisCache::Q_MoonDistance, t), 0.05);
+        ASSERT_AB(long double, Sun::distance(t), cache->value(EphemerisCache::Q_SunDistance, t), 10.0);
+    }
+
+    // Astronomy uses the cache for covered julian days.
+
+    Astronomy astro;
+    Astronomy cached;
+    cached.setEphemerisCache(cache.get());
+
+    const t_aTime aTime(1992, 4, 12, 0, 0, 0);
+
+    const osg::Vec3f moon = astro.getMoonPosition(aTime, 52.5f, 13.4f, true);
+    const osg::Vec3f moonc = cached.getMoonPosition(aTime, 52.5f, 13.4f, true);
+
+    ASSERT_AB(float, moon[0], moonc[0], 1e-6);
+    ASSERT_AB(float, moon[1], moonc[1], 1e-6);
+    ASSERT_AB(float, moon[2], moonc[2], 1e-6);
+
+    ASSERT_AB(float, astro.getMoonDistance(aTime), cached.getMoonDistance(aTime), 0.05);
+
+    // Stored caches load as they were.
+
+    const std::string filePath("ephemeriscache_test.bin");
+    ASSERT_EQ(int, true, cache->save(filePath));
+
+    osg::ref_ptr<EphemerisCache> loaded(new EphemerisCache);
+    ASSERT_EQ(int, true, loaded->load(filePath));
+
+    std::remove(filePath.c_str());
+
+    ASSERT_EQ(unsigned int, cache->getDegree(EphemerisCache::Q_MoonLongitude)
+        , loaded->getDegree(EphemerisCache::Q_MoonLongitude));
+    ASSERT_EQ(double, cache->value(EphemerisCache::Q_MoonLongitude, begin + 11.3)
+        , loaded->value(EphemerisCache::Q_MoonLongitude, begin + 11.3));
+
+    ASSERT_EQ(int, false, loaded->load("ephemeriscache_missing.bin"));
+}
+
+
+void test_snapshot(AbstractAstronomy &astro)
+{
+    const t_aTime aTime(1992, 4, 12, 0, 0, 0);
+
+    astro.setLatitude(52.5f);
+    astro.setLongitude(13.4f);
+    astro.update(aTime);
+
+    const float lat(astro.getLatitude());
+    const float lon(astro.getLongitude());
+
+    const t_astronomySnapshot &snapshot(astro.getSnapshot());
+
+    ASSERT_EQ(long double, jd(aTime), snapshot.t);
+    ASSERT_EQ(float, 52.5f, snapshot.latitude);
+
+    const osg::Vec3f sun(astro.getSunPosition(aTime, lat, lon, false));
+    const osg::Vec3f sunr(astro.getSunPosition(aTime, lat, lon, true));
+    const osg::Vec3f moon(astro.getMoonPosition(aTime, lat, lon, false));
+    const osg::Vec3f moonr(astro.getMoonPosition(aTime, lat, lon, true));
+
+    for(int i = 0; i < 3; ++i)
+    {
+        ASSERT_AB(float, sun[i], snapshot.sun[i], 1e-6);
+        ASSERT_AB(float, sunr[i], snapshot.sunRefracted[i], 1e-6);
+        ASSERT_AB(float, moon[i], snapshot.moon[i], 1e-6);
+        ASSERT_AB(float, moonr[i], snapshot.moonRefracted[i], 1e-6);
+    }
+
+    ASSERT_AB(float, astro.getSunDistance(aTime), snapshot.sunDistance, 1e-6);
+    ASSERT_AB(float, astro.getMoonDistance(aTime), snapshot.moonDistance, 1e-6);
+    ASSERT_AB(float, astro.getAngularSunRadius(aTime), snapshot.angularSunRadius, 1e-6);
+    ASSERT_AB(float, astro.getAngularMoonRadius(aTime), snapshot.angularMoonRadius, 1e-6);
+    ASSERT_AB(float, astro.getEarthShineIntensity(aTime, lat, lon), snapshot.earthShineIntensity, 1e-6);
+
+    const osg::Matrixf R(astro.getMoonOrientation(aTime, lat, lon));
+    const osg::Matrixf T(astro.getEquToHorTransform(aTime, lat, lon));
+
+    for(int i = 0; i < 3; ++i)
+        for(int j = 0; j < 3; ++j)
+        {
+            ASSERT_AB(float, R(i, j), snapshot.moonOrientation(i, j), 1e-5);
+            ASSERT_AB(float, T(i, j), snapshot.equToHorTransform(i, j), 1e-5);
+        }
+
+    // The parameterless getters read the snapshot.
+
+    ASSERT_EQ(float, snapshot.sunRefracted[2], astro.getSunPosition(true)[2]);
+    ASSERT_EQ(float, snapshot.moonDistance, astro.getMoonDistance());
+
+    // Changing the observer updates the snapshot.
+
+    astro.setLatitude(-33.9f);
+
+    const osg::Vec3f south(astro.getSunPosition(aTime, -33.9f, lon, false));
+
+    ASSERT_EQ(float, -33.9f, snapshot.latitude);
+    ASSERT_AB(float, south[2], snapshot.sun[2], 1e-6);
+}
+
+
+void test_snapshot()
+{
+    const t_aTime aTime(1992, 4, 12, 0, 0, 0);
+    const t_julianDay t(jd(aTime));
+
+    // Snapshots match the results of the individual getters.
+
+    Astronomy astro;
+    test_snapshot(astro);
+
+    ASSERT_AB(long double, Sun::apparentPosition(t).right_ascension
+        , astro.getSnapshot().sunEquatorial.right_ascension, 1e-9);
+    ASSERT_AB(long double, Moon::apparentPosition(t).declination
+        , astro.getSnapshot().moonEquatorial.declination, 1e-9);
+
+    Astronomy2 astro2;
+    test_snapshot(astro2);
+
+    // the equatorial positions are restored from the horizontal ones
+
+    ASSERT_AB(long double, Sun2::apparentPosition(t).right_ascension
+        , astro2.getSnapshot().sunEquatorial.right_ascension, 1e-3);
+    ASSERT_AB(long double, Moon2::apparentPosition(t).declination
+        , astro2.getSnapshot().moonEquatorial.declination, 1e-3);
+}
+
+
+// Compares the apparent positions and distances of a precision policy
+// with the long double default, over two centuries (every 73 days).
+
+template<typename t_real>
+void test_precision(
+    const long double maxDegrees
+,   const long double maxKilometers)
+{
+    long double sunError(0.0);
+    long double moonError(0.0);
+    long double distanceError(0.0);
+
+    for(int i = 0; i < 1000; ++i)
+    {
+        const t_julianDay t(2415020.5 + i * 73.05);
+
+        const t_equd sun(Sun::apparentPosition(t));
+        const t_equd moon(Moon::apparentPosition(t));
+
+        const s_EquatorialCoords<t_real> sunT(SunT<t_real>::apparentPosition(t));
+        const s_EquatorialCoords<t_real> moonT(MoonT<t_real>::apparentPosition(t));
+
+        // right ascensions might be normalized to either side of 0 and 360 degrees
+
+        const long double dra0(_abs(_revd(sun.right_ascension - sunT.right_ascension + 180.0) - 180.0));
+        const long double dra1(_abs(_revd(moon.right_ascension - moonT.right_ascension + 180.0) - 180.0));
+
+        sunError = std::max(sunError, std::max(dra0, _abs(sun.declination - sunT.declination)));
+        moonError = std::max(moonError, std::max(dra1, _abs(moon.declination - moonT.declination)));
+
+        distanceError = std::max(distanceError, _abs(Sun::distance(t) - SunT<t_real>::distance(t)));
+        distanceError = std::max(distanceError, _abs(Moon::distance(t) - MoonT<t_real>::distance(t)));
+    }
+
+    ASSERT_AB(long double, 0.0, sunError, maxDegrees);
+    ASSERT_AB(long double, 0.0, moonError, maxDegrees);
+    ASSERT_AB(long double, 0.0, distanceError, maxKilometers);
+}
+
+
+void test_precision()
+{
+    test_precision<double>(1e-9, 1e-5);
+    test_precision<float>(0.1, 500.0);
+
+    // The long double instantiations are the defaults.
+
+    const t_julianDay t(jd(t_aTime(1992, 4, 12, 0, 0, 0)));
+
+    ASSERT_EQ(long double, Moon::apparentPosition(t).right_ascension
+        , MoonT<long double>::apparentPosition(t).right_ascension);
+
+    // Horizontal positions of AstronomyT are float vectors anyway.
+
+    const t_aTime aTime(1992, 4, 12, 0, 0, 0);
+
+    Astronomy astro;
+    AstronomyT<double> astroDouble;
+    AstronomyT<float> astroFloat;
+
+    const osg::Vec3f moon(astro.getMoonPosition(aTime, 52.5f, 13.4f, false));
+    const osg::Vec3f moonDouble(astroDouble.getMoonPosition(aTime, 52.5f, 13.4f, false));
+    const osg::Vec3f moonFloat(astroFloat.getMoonPosition(aTime, 52.5f, 13.4f, false));
+
+    for(int i = 0; i < 3; ++i)
+    {
+        ASSERT_AB(float, moon[i], moonDouble[i], 1e-6);
+        ASSERT_AB(float, moon[i], moonFloat[i], 2e-3);
+    }
+}
+
+
+void test_seriesTruncation()
+{
+    // Without a maximum error the series are complete.
+
+    const SeriesTruncation complete;
+
+    for(int s = 0; s < SeriesTruncation::NUM_SERIES; ++s)
+    {
+        const SeriesTruncation::e_Series series(static_cast<SeriesTruncation::e_Series>(s));
+
+        ASSERT_EQ(unsigned int, SeriesTruncation::completeSeries(series).numTerms
+            , complete.series(series).numTerms);
+        ASSERT_EQ(double, 0.0, complete.errorBound(series));
+    }
+
+    const t_julianDay t(jd(t_aTime(1992, 4, 12)));
+
+    ASSERT_EQ(long double, Moon::position(t).longitude, Moon::position(t, &complete).longitude);
+    ASSERT_EQ(long double, Moon::distance(t), Moon::distance(t, &complete));
+
+    // The errors of the truncated series remain within their bounds.
+
+    const double maxErrors[] = { 1e-5, 1e-4, 1e-3, 1e-2, 1e-1 };
+    unsigned int numTerms(~0u);
+
+    for(int i = 0; i < 5; ++i)
+    {
+        const SeriesTruncation truncation(maxErrors[i]);
+
+        unsigned int n(0);
+        for(int s = 0; s < SeriesTruncation::NUM_SERIES; ++s)
+            n += truncation.series(static_cast<SeriesTruncation::e_Series>(s)).numTerms;
+
+        ASSERT_EQ(bool, true, n < numTerms);
+        numTerms = n;
+
+        long double latitudeError(0.0);
+        long double distanceError(0.0);
+        long double nutationError(0.0);
+        long double obliquityError(0.0);
+
+        for(int j = 0; j < 200; ++j)
+        {
+            const t_julianDay tj(2415020.5 + j * 365.25);
+
+            latitudeError = std::max(latitudeError, _abs(Moon::position(tj).latitude
+                - Moon::position(tj, &truncation).latitude));
+            distanceError = std::max(distanceError, _abs(Moon::distance(tj) 
+                - Moon::distance(tj, &truncation)));
+            nutationError = std::max(nutationError, _abs(Earth::longitudeNutation(tj) 
+                - Earth::longitudeNutation(tj, &truncation)));
+            obliquityError = std::max(obliquityError, _abs(Earth::obliquityNutation(tj) 
+                - Earth::obliquityNutation(tj, &truncation)));
+        }
+
+        ASSERT_AB(long double, 0.0, latitudeError
+            , truncation.errorBound(SeriesTruncation::S_MoonLatitude) * 0.001 + 1e-12);
+        ASSERT_AB(long double, 0.0, distanceError
+            , truncation.errorBound(SeriesTruncation::S_MoonDistance) + 1e-9);
+        ASSERT_AB(long double, 0.0, nutationError
+            , truncation.errorBound(SeriesTruncation::S_LongitudeNutation) / 3600.0 + 1e-12);
+        ASSERT_AB(long double, 0.0, obliquityError
+            , truncation.errorBound(SeriesTruncation::S_ObliquityNutation) / 3600.0 + 1e-12);
+    }
+
+    // The expectations of test_moon hold for small maximum errors.
+
+    const SeriesTruncation truncation(1e-5);
+
+    const t_ecld ecl(Moon::position(t, &truncation));
+
+    ASSERT_AB(long double, 133.167269, ecl.longitude, 0.0001);
+    ASSERT_AB(long double,  -3.229127, ecl.latitude,  0.0001);
+
+    ASSERT_AB(long double, 368409.7, Moon::distance(t, &truncation), 0.02);
+
+    ASSERT_AB(long double, _decimal(0, 0, -3.788), Earth::longitudeNutation(
+        jd(t_aTime(1987, 4, 10)), &truncation), 0.0002);
+    ASSERT_AB(long double, _decimal(0, 0, +9.443), Earth::obliquityNutation(
+        jd(t_aTime(1987, 4, 10)), &truncation), 0.0002);
+
+    // Astronomy evaluates the truncated series.
+
+    const t_aTime aTime(1992, 4, 12, 0, 0, 0);
+
+    Astronomy astro;
+    Astronomy truncated;
+
+    ASSERT_EQ(double, 0.0, truncated.getMaxSeriesError());
+    ASSERT_EQ(double, 0.01, truncated.setMaxSeriesError(0.01));
+
+    const osg::Vec3f moon(astro.getMoonPosition(aTime, 52.5f, 13.4f, false));
+    const osg::Vec3f moonTruncated(truncated.getMoonPosition(aTime, 52.5f, 13.4f, false));
+
+    // the moon sums up the series of its position and the nutation twice
+
+    const float maxDistance(static_cast<float>(_rad(0.04)));
+
+    for(int i = 0; i < 3; ++i)
+        ASSERT_AB(float, moon[i], moonTruncated[i], maxDistance);
+
+    ASSERT_AB(float, astro.getMoonDistance(aTime), truncated.getMoonDistance(aTime)
+        , SeriesTruncation(0.01).errorBound(SeriesTruncation::S_MoonDistance) + 0.1);
+}
+
+
+void test_observers(
+    const AbstractAstronomy &astro
+,   const bool refractionCorrected)
+{
+    static const unsigned int count(97);
+
+    const t_aTime aTime(2012, 6, 21, 13, 37, 12);
+
+    float latitudes[count];
+    float longitudes[count];
+
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        latitudes[i]  = -89.f + i * 178.f / (count - 1);
+        longitudes[i] = -180.f + (i * 37 % count) * 360.f / (count - 1);
+    }
+
+    float x[count];
+    float y[count];
+    float z[count];
+
+    astro.getSunPositions(aTime, latitudes, longitudes, count, refractionCorrected, x, y, z);
+
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        const osg::Vec3f sun = astro.getSunPosition(aTime, latitudes[i], longitudes[i], refractionCorrected);
+
+        ASSERT_AB(float, sun[0], x[i], 1e-5);
+        ASSERT_AB(float, sun[1], y[i], 1e-5);
+        ASSERT_AB(float, sun[2], z[i], 1e-5);
+    }
+
+    astro.getMoonPositions(aTime, latitudes, longitudes, count, refractionCorrected, x, y, z);
+
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        const osg::Vec3f moon = astro.getMoonPosition(aTime, latitudes[i], longitudes[i], refractionCorrected);
+
+        ASSERT_AB(float, moon[0], x[i], 1e-5);
+        ASSERT_AB(float, moon[1], y[i], 1e-5);
+        ASSERT_AB(float, moon[2], z[i], 1e-5);
+    }
+}
+
+
+void test_nutationCache()
+{
+    // Disabled, the series are evaluated.
+
+    const NutationCache disabled;
+
+    const t_julianDay t(jd(t_aTime(1987, 4, 10)));
+    double Dr, De;
+
+    disabled.nutations(t, NULL, Dr, De);
+
+    ASSERT_EQ(double, 0.0, disabled.getSpacing());
+    ASSERT_EQ(double, static_cast<double>(Earth::longitudeNutation(t)), Dr);
+    ASSERT_EQ(double, static_cast<double>(Earth::obliquityNutation(t)), De);
+
+    // The interpolation stays within the tolerance, at a spacing of days.
+
+    const double tolerances[] = { 1e-6, 1e-5, 1e-4 };
+
+    for(int i = 0; i < 3; ++i)
+    {
+        const NutationCache cache(tolerances[i]);
+
+        ASSERT_EQ(int, 1, cache.getSpacing() > 0.5);
+
+        double maxError(0.0);
+        for(int j = 0; j < 2000; ++j)
+        {
+            const t_julianDay tj(t + j * 3.7131);
+
+            cache.nutations(tj, NULL, Dr, De);
+
+            maxError = _ma(maxError, _abs(Dr - static_cast<double>(Earth::longitudeNutation(tj))));
+            maxError = _ma(maxError, _abs(De - static_cast<double>(Earth::obliquityNutation(tj))));
+        }
+        ASSERT_EQ(int, 1, maxError <= tolerances[i]);
+    }
+
+    // The astronomy differs from the series by about the tolerance only.
+
+    Astronomy astro;
+    Astronomy interpolated;
+    interpolated.setNutationTolerance(1e-5);
+
+    for(int i = 0; i < 48; ++i)
+    {
+        const t_julianTime time(t_julianTime(t_aTime(1992, 4, 12, i % 24, 0, 0)) + i * 86400.0 * 3.1);
+
+        const t_astronomySnapshot s(astro.computeSnapshot(time, 52.5f, 13.4f));
+        const t_astronomySnapshot si(interpolated.computeSnapshot(time, 52.5f, 13.4f));
+
+        ASSERT_AB(double, s.sunEquatorial.right_ascension, si.sunEquatorial.right_ascension, 1e-4);
+        ASSERT_AB(double, s.sunEquatorial.declination, si.sunEquatorial.declination, 1e-4);
+        ASSERT_AB(double, s.moonEquatorial.right_ascension, si.moonEquatorial.right_ascension, 1e-4);
+        ASSERT_AB(double, s.moonEquatorial.declination, si.moonEquatorial.declination, 1e-4);
+
+        ASSERT_AB(float, s.moon[2], interpolated.getMoonPosition(time, 52.5f, 13.4f, false)[2], 1e-6f);
+        ASSERT_AB(float, s.sun[2], interpolated.getSunPosition(time, 52.5f, 13.4f, false)[2], 1e-6f);
+    }
+
+    // The samples follow the truncation of the series.
+
+    interpolated.setMaxSeriesError(0.01);
+
+    Astronomy truncated;
+    truncated.setNutationTolerance(1e-5);
+    truncated.setMaxSeriesError(0.01);
+
+    const t_julianTime time(t_aTime(1992, 4, 12, 12, 0, 0));
+
+    ASSERT_EQ(double, truncated.computeSnapshot(time, 52.5f, 13.4f).sunEquatorial.declination
+        , interpolated.computeSnapshot(time, 52.5f, 13.4f).sunEquatorial.declination);
+}
+
+
+void test_observers()
+{
+    // Positions for many observers match the positions per observer.
+
+    const Astronomy astro;
+    const Astronomy2 astro2;
+
+    test_observers(astro, false);
+    test_observers(astro, true);
+
+    test_observers(astro2, false);
+    test_observers(astro2, true);
+
+    static const unsigned int count(5);
+
+    const t_aTime aTime(1992, 4, 12, 0, 0, 0);
+
+    const t_longf latitudes[count]  = { -60.0, -12.5, 0.0, 52.5, 80.0 };
+    const t_longf longitudes[count] = { -170.0, -13.4, 0.0, 13.4, 120.0 };
+
+    t_longf altitudes[count];
+    t_longf azimuths[count];
+
+    Moon::horizontalPositions(aTime, latitudes, longitudes, count, altitudes, azimuths);
+
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        const t_hord moon(Moon::horizontalPosition(aTime, latitudes[i], longitudes[i]));
+
+        ASSERT_AB(long double, moon.altitude, altitudes[i], 1e-9);
+        ASSERT_AB(long double, moon.azimuth, azimuths[i], 1e-9);
+    }
+}
+
+// Queries of all time and observer taking getters and the snapshot, for
+// instants of about two months (partly covered by the cache below).
+
+namespace
+{
+    const unsigned int NUM_INSTANTS(256);
+    const unsigned int NUM_VALUES(38);
+
+    void queries(
+        const AbstractAstronomy &astro
+    ,   const unsigned int i
+    ,   float *values)
+    {
+        const t_aTime aTime(makeTime(jd(t_aTime(1992, 3, 20.0)) + i * 0.2137));
+
+        const float lat(-80.f + (i * 37 % 161));
+        const float lon(-180.f + (i * 53 % 360));
+
+        unsigned int v(0);
+
+        const osg::Vec3f sun(astro.getSunPosition(aTime, lat, lon, true));
+        const osg::Vec3f moon(astro.getMoonPosition(aTime, lat, lon, false));
+
+        for(int j = 0; j < 3; ++j)
+        {
+            values[v++] = sun[j];
+            values[v++] = moon[j];
+        }
+
+        values[v++] = astro.getEarthShineIntensity(aTime, lat, lon);
+        values[v++] = astro.getSunDistance(aTime);
+        values[v++] = astro.getAngularSunRadius(aTime);
+        values[v++] = astro.getMoonDistance(aTime);
+        values[v++] = astro.getAngularMoonRadius(aTime);
+
+        const osg::Matrixf R(astro.getMoonOrientation(aTime, lat, lon));
+        const osg::Matrixf T(astro.getEquToHorTransform(aTime, lat, lon));
+
+        for(int j = 0; j < 3; ++j)
+            for(int k = 0; k < 3; ++k)
+            {
+                values[v++] = R(j, k);
+                values[v++] = T(j, k);
+            }
+
+        float x, y, z;
+        astro.getMoonPositions(&aTime, &lat, &lon, 1, true, &x, &y, &z);
+
+        values[v++] = x;
+        values[v++] = y;
+        values[v++] = z;
+
+        const t_astronomySnapshot snapshot(astro.computeSnapshot(aTime, lat, lon));
+
+        for(int j = 0; j < 3; ++j)
+            values[v++] = snapshot.sunRefracted[j];
+
+        values[v++] = snapshot.moonDistance;
+        values[v++] = snapshot.earthShineIntensity;
+        values[v++] = snapshot.equToHorTransform(1, 2);
+
+        assert(v == NUM_VALUES);
+    }
+
+
+    // Queries all instants, starting at a different one per thread.
+
+    class QueryThread : public OpenThreads::Thread
+    {
+    public:
+
+        QueryThread(
+            const AbstractAstronomy &astro
+        ,   const unsigned int first
+        ,   OpenThreads::Atomic &done)
+        :   OpenThreads::Thread()
+        ,   m_astro(astro)
+        ,   m_first(first)
+        ,   m_done(done)
+        ,   m_values(NUM_INSTANTS * NUM_VALUES)
+        {
+        }
+
+        virtual void run()
+        {
+            for(unsigned int n = 0; n < NUM_INSTANTS; ++n)
+            {
+                const unsigned int i((m_first + n) % NUM_INSTANTS);
+                queries(m_astro, i, &m_values[i * NUM_VALUES]);
+            }
+            ++m_done;
+        }
+
+        inline const std::vector<float> &values() const
+        {
+            return m_values;
+        }
+
+    protected:
+
+        const AbstractAstronomy &m_astro;
+        const unsigned int m_first;
+
+        OpenThreads::Atomic &m_done;
+
+        std::vector<float> m_values;
+    };
+}
+
+
+void test_threads(AbstractAstronomy &astro)
+{
+    static const unsigned int numThreads(8);
+
+    std::vector<float> expected(NUM_INSTANTS * NUM_VALUES);
+
+    for(unsigned int i = 0; i < NUM_INSTANTS; ++i)
+        queries(astro, i, &expected[i * NUM_VALUES]);
+
+    OpenThreads::Atomic done;
+    std::vector<QueryThread *> threads(numThreads);
+
+    for(unsigned int t = 0; t < numThreads; ++t)
+    {
+        threads[t] = new QueryThread(astro, t * NUM_INSTANTS / numThreads, done);
+        threads[t]->start();
+    }
+
+    // the update traversal changes time and observer meanwhile
+
+    unsigned int updates(0);
+    do
+    {
+        astro.setLatitude(static_cast<float>(updates % 90));
+        astro.setLongitude(static_cast<float>(updates % 180));
+        astro.update(makeTime(jd(t_aTime(1992, 4, 1.0)) + updates * 0.01));
+
+        ++updates;
+    }
+    while(done != numThreads);
+
+    for(unsigned int t = 0; t < numThreads; ++t)
+    {
+        threads[t]->join();
+
+        // results are identical, not only close
+
+        const std::vector<float> &values(threads[t]->values());
+
+        unsigned int mismatches(0);
+        for(unsigned int i = 0; i < expected.size(); ++i)
+            if(values[i] != expected[i])
+                ++mismatches;
+
+        ASSERT_EQ(unsigned int, 0, mismatches);
+
+        delete threads[t];
+    }
+    ASSERT_EQ_NOT(unsigned int, 0, updates);
+}
+
+
+void test_threads()
+{
+    // Concurrent queries match the single threaded ones.
+
+    Astronomy astro;
+    test_threads(astro);
+
+    osg::ref_ptr<EphemerisCache> cache(new EphemerisCache);
+    cache->build(jd(t_aTime(1992, 4, 1.0)), jd(t_aTime(1992, 4, 1.0)) + 30.0);
+
+    astro.setEphemerisCache(cache.get());
+    test_threads(astro);
+
+    astro.setEphemerisCache(NULL);
+    astro.setMaxSeriesError(0.01);
+    test_threads(astro);
+
+    astro.setNutationTolerance(1e-5);
+    test_threads(astro);
+
+    AstronomyT<float> astrof;
+    test_threads(astrof);
+
+    Astronomy2 astro2;
+    test_threads(astro2);
+}
+
+
+namespace
+{
+    // Seconds of the first event of a kind after the begin of a day in UT
+    // (-1 if there is none).
+
+    const long eventSecond(
+        const AstronomyEvents &solver
+    ,   const AstronomyEvents::e_Body body
+    ,   const AstronomyEvents::e_Event event
+    ,   const t_aTime &day
+    ,   const float latitude
+    ,   const float longitude)
+    {
+        const t_julianDay begin(jd(day));
+
+        AstronomyEvents::t_events events;
+        solver.events(body, begin, begin + 1.0, latitude, longitude, events);
+
+        for(unsigned int i = 0; i < events.size(); ++i)
+            if(events[i].event == event)
+                return static_cast<long>(floor((events[i].t - begin) * 86400.0 + 0.5));
+
+        return -1;
+    }
+}
+
+
+void test_events()
+{
+    const Astronomy astro;
+    const AstronomyEvents solver(astro);
+
+    // Sun rise, transit, set, and twilights from the equations of the NOAA
+    // solar calculator (http://www.esrl.noaa.gov/gmd/grad/solcalc/), in UT
+    // and within a minute.
+
+    static const AstronomyEvents::e_Event sunEvents[] = 
+    {
+        AstronomyEvents::E_Rise,            AstronomyEvents::E_Set
+    ,   AstronomyEvents::E_CivilDawn,       AstronomyEvents::E_CivilDusk
+    ,   AstronomyEvents::E_NauticalDawn,    AstronomyEvents::E_NauticalDusk
+    ,   AstronomyEvents::E_AstronomicalDawn,AstronomyEvents::E_AstronomicalDusk
+    ,   AstronomyEvents::E_Transit
+    };
+
+    typedef struct SunTable
+    {
+        t_aTime day;
+        float latitude;
+        float longitude;
+
+        // hh, mm, ss per event of sunEvents (-1 if there is none)
+        int times[9][3];
+
+    } t_sunTable;
+
+    const t_sunTable sunTables[] =
+    {
+        // Berlin (no astronomical twilight at midsummer)
+        { t_aTime(2012, 6, 21, 0, 0, 0), 52.52f, 13.41f, {
+            {  2, 43,  8 }, { 19, 33, 19 }, {  1, 52, 53 }, { 20, 23, 33 }
+        ,   {  0, 29, 25 }, { 21, 46, 59 }, { -1, -1, -1 }, { -1, -1, -1 }, { 11,  8, 14 } } }
+    ,   { t_aTime(2012, 12, 21, 0, 0, 0), 52.52f, 13.41f, {
+            {  7, 15,  7 }, { 14, 54, 11 }, {  6, 33, 25 }, { 15, 35, 52 }
+        ,   {  5, 49,  2 }, { 16, 20, 16 }, {  5,  7, 14 }, { 17,  2,  4 }, { 11,  4, 39 } } }
+    ,   { t_aTime(2012, 3, 20, 0, 0, 0), 52.52f, 13.41f, {
+            {  5,  8, 18 }, { 17, 20,  9 }, {  4, 34, 16 }, { 17, 54, 18 }
+        ,   {  3, 53, 59 }, { 18, 34, 45 }, {  3, 11, 54 }, { 19, 17,  6 }, { 11, 13, 42 } } }
+        // Tromso
+    ,   { t_aTime(2012, 2, 1, 0, 0, 0), 69.65f, 18.96f, {
+            {  8, 27, 13 }, { 13, 29, 17 }, {  7,  3, 32 }, { 14, 53,  3 }
+        ,   {  5, 46, 30 }, { 16, 10, 15 }, {  4, 36, 28 }, { 17, 20, 30 }, { 10, 57, 41 } } }
+    };
+
+    for(unsigned int t = 0; t < sizeof(sunTables) / sizeof(t_sunTable); ++t)
+    {
+        const t_sunTable &table(sunTables[t]);
+
+        for(unsigned int e = 0; e < 9; ++e)
+        {
+            const long second(eventSecond(solver, AstronomyEvents::B_Sun, sunEvents[e]
+                , table.day, table.latitude, table.longitude));
+
+            if(table.times[e][0] < 0)
+            {
+                ASSERT_EQ(int, -1, second);
+                continue;
+            }
+            const long expected((table.times[e][0] * 60 + table.times[e][1]) * 60 + table.times[e][2]);
+            ASSERT_AB(int, expected, second, 60);
+        }
+    }
+
+    // Midnight sun and polar night in Tromso.
+
+    AstronomyEvents::t_events events;
+
+    solver.events(AstronomyEvents::B_Sun, jd(t_aTime(2012, 6, 10, 0, 0, 0))
+        , jd(t_aTime(2012, 7, 1, 0, 0, 0)), 69.65f, 18.96f, events);
+
+    ASSERT_EQ(unsigned int, 21, events.size());
+
+    for(unsigned int i = 0; i < events.size(); ++i)
+        ASSERT_EQ(int, AstronomyEvents::E_Transit, events[i].event);
+
+    events.clear();
+    solver.events(AstronomyEvents::B_Sun, jd(t_aTime(2012, 12, 10, 0, 0, 0))
+        , jd(t_aTime(2012, 12, 31, 0, 0, 0)), 69.65f, 18.96f, events);
+
+    unsigned int transits(0);
+    for(unsigned int i = 0; i < events.size(); ++i)
+    {
+        ASSERT_EQ_NOT(int, AstronomyEvents::E_Rise, events[i].event);
+        ASSERT_EQ_NOT(int, AstronomyEvents::E_Set, events[i].event);
+
+        if(AstronomyEvents::E_Transit == events[i].event)
+            ++transits;
+    }
+    ASSERT_EQ(unsigned int, 21, transits);
+
+    // Over a month, the moon rises and sets alternately, at its altitude
+    // of the event, and transits about every 24h50m.
+
+    const t_julianDay begin(jd(t_aTime(1992, 4, 1, 0, 0, 0)));
+
+    events.clear();
+    solver.events(AstronomyEvents::B_Moon, begin, begin + 30.0, 52.52f, 13.41f, events);
+
+    ASSERT_AB(unsigned int, 87, events.size(), 2);
+
+    int previous(-1);
+    t_julianDay previousTransit(0.0);
+
+    for(unsigned int i = 0; i < events.size(); ++i)
+    {
+        const AstronomyEvents::t_event &event(events[i]);
+        const t_aTime aTime(makeTime(event.t));
+
+        if(i > 0)
+            ASSERT_EQ(int, true, event.t >= events[i - 1].t);
+
+        if(AstronomyEvents::E_Transit == event.event)
+        {
+            if(previousTransit > 0.0)
+                ASSERT_AB(double, 1.035, event.t - previousTransit, 0.02);
+            previousTransit = event.t;
+
+            continue;
+        }
+        ASSERT_EQ_NOT(int, previous, event.event);
+        previous = event.event;
+
+        const double h0(AstronomyEvents::altitude(AstronomyEvents::B_Moon, event.event, astro.getMoonDistance(aTime)));
+        const osg::Vec3f moon(astro.getMoonPosition(aTime, 52.52f, 13.41f, false));
+
+        // within the altitude change of about a second
+        ASSERT_AB(double, h0, _deg(asin(moon[2])), 0.01);
+    }
+
+    // Events do not depend on the step, as long as they are further apart.
+
+    AstronomyEvents fine(astro);
+    fine.setStep(600);
+
+    AstronomyEvents::t_events fineEvents;
+    fine.events(AstronomyEvents::B_Moon, begin, begin + 30.0, 52.52f, 13.41f, fineEvents);
+
+    ASSERT_EQ(unsigned int, events.size(), fineEvents.size());
+
+    for(unsigned int i = 0; i < events.size() && i < fineEvents.size(); ++i)
+    {
+        ASSERT_EQ(int, events[i].event, fineEvents[i].event);
+        ASSERT_AB(double, events[i].t, fineEvents[i].t, 0.01 / 86400.0);
+    }
+}
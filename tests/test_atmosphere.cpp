@@ -0,0 +1,995 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "test_atmosphere.h"
+#include "test.h"
+
+#include "osgHimmel/mathmacros.h"
+#include "osgHimmel/atmospheremodel.h"
+#include "osgHimmel/cpuatmosphereprecompute.h"
+#include "osgHimmel/atmospherecache.h"
+#include "osgHimmel/atmospherequery.h"
+#include "osgHimmel/atmosphereformat.h"
+#include "osgHimmel/atmosphereatlas.h"
+#include "osgHimmel/himmelambient.h"
+#include "osgHimmel/memorymappedfile.h"
+#include "osgHimmel/strutils.h"
+
+#include <osg/Image>
+#include <osg/StateSet>
+#include <osg/Texture2D>
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+
+
+using namespace osgHimmel;
+
+void test_tables();
+void test_parameterization();
+void test_phaseFunctions();
+void test_cache();
+void test_stages();
+void test_query();
+void test_ambient();
+void test_formats();
+void test_atlas();
+void test_integration();
+void test_pipeline();
+void test_parity();
+
+void test_atmosphere()
+{
+    // Run Tests.
+    test_tables();
+    test_parameterization();
+    test_phaseFunctions();
+    test_cache();
+    test_stages();
+    test_query();
+    test_ambient();
+    test_formats();
+    test_atlas();
+    test_integration();
+    test_pipeline();
+    test_parity();
+
+    TEST_REPORT();
+}
+
+
+namespace
+{
+    const AtmosphereModel::t_preTexCfg defaultTexCfg()
+    {
+        AtmosphereModel::t_preTexCfg tc;
+
+        tc.transmittanceWidth  = 256;
+        tc.transmittanceHeight =  64;
+
+        tc.skyWidth  =  64;
+        tc.skyHeight =  16;
+
+        tc.resR   =  32;
+        tc.resMu  = 128;
+        tc.resMuS =  32;
+        tc.resNu  =   8;
+
+        tc.transmittanceIntegralSamples      = 500;
+        tc.inscatterIntegralSamples          =  50;
+        tc.irradianceIntegralSamples         =  32;
+        tc.inscatterSphericalIntegralSamples =  16;
+
+        tc.integralTolerance = 0.f;
+
+        return tc;
+    }
+
+    const AtmosphereModel::t_modelCfg defaultModelCfg()
+    {
+        AtmosphereModel::t_modelCfg mc;
+
+        mc.avgGroundReflectance = 0.1f;
+
+        mc.HR = 8.f;
+        mc.betaR = osg::Vec3f(5.8e-3f, 1.35e-2f, 3.31e-2f);
+
+        mc.HM = 6.f;
+        mc.betaMSca = osg::Vec3f(1.f, 1.f, 1.f) * 20e-3f;
+        mc.betaMEx = mc.betaMSca / 0.9f;
+        mc.mieG = 0.6f;
+
+        return mc;
+    }
+}
+
+
+void test_tables()
+{
+    // 2x2 single component table
+
+    float data2D[] = { 0.f, 1.f, 2.f, 3.f };
+    const AtmosphereModel::t_table t2D(data2D, 2, 2, 1, 1);
+
+    // texel centers
+
+    ASSERT_AB(float, 0.0, t2D.sample2D(0.25f, 0.25f)[0], 1e-6);
+    ASSERT_AB(float, 1.0, t2D.sample2D(0.75f, 0.25f)[0], 1e-6);
+    ASSERT_AB(float, 2.0, t2D.sample2D(0.25f, 0.75f)[0], 1e-6);
+    ASSERT_AB(float, 3.0, t2D.sample2D(0.75f, 0.75f)[0], 1e-6);
+
+    // linear filtering and clamp to edge
+
+    ASSERT_AB(float, 1.5, t2D.sample2D(0.50f, 0.50f)[0], 1e-6);
+    ASSERT_AB(float, 0.0, t2D.sample2D(0.00f, 0.00f)[0], 1e-6);
+    ASSERT_AB(float, 3.0, t2D.sample2D(1.00f, 1.00f)[0], 1e-6);
+
+    // 2x1x2 three component table
+
+    float data3D[] = { 0.f, 0.f, 0.f,  1.f, 1.f, 1.f,  2.f, 4.f, 6.f,  3.f, 5.f, 7.f };
+    const AtmosphereModel::t_table t3D(data3D, 2, 1, 2, 3);
+
+    ASSERT_AB(float, 2.0, t3D.sample3D(0.25f, 0.5f, 0.75f)[0], 1e-6);
+    ASSERT_AB(float, 5.0, t3D.sample3D(0.75f, 0.5f, 0.75f)[1], 1e-6);
+    ASSERT_AB(float, 3.5, t3D.sample3D(0.50f, 0.5f, 0.50f)[2], 1e-6);
+}
+
+
+void test_parameterization()
+{
+    const AtmosphereModel model(defaultTexCfg(), defaultModelCfg());
+    const AtmosphereModel::t_preTexCfg &tc(model.preTexCfg());
+
+    ASSERT_AB(float, 6371.0, model.Rg(), 1e-6);
+    ASSERT_AB(float, 6456.0, model.Rt(), 1e-6);
+
+    // transmittance uv hits the texel center of its r and mu (r close
+    // to the ground loses precision in single floating point)
+
+    const int tx[] = { 0, 17, 128, 255 };
+    const int ty[] = { 0,  5,  40,  63 };
+
+    for(int i = 0; i < 4; ++i)
+    {
+        float r, mu;
+        model.transmittanceRMu(tx[i], ty[i], r, mu);
+
+        const osg::Vec2f uv(model.transmittanceUV(r, mu));
+
+        ASSERT_AB(float, (tx[i] + 0.5) / tc.transmittanceWidth,  uv[0], 1e-4);
+        ASSERT_AB(float, (ty[i] + 0.5) / tc.transmittanceHeight, uv[1], 1e-3);
+    }
+
+    // irradiance uv maps the first and last texel to the table borders
+
+    float r, muS;
+    model.irradianceRMuS(0, 0, r, muS);
+
+    ASSERT_AB(float, model.Rg(), r,   1e-3);
+    ASSERT_AB(float, -0.2,       muS, 1e-6);
+
+    model.irradianceRMuS(tc.skyWidth - 1, tc.skyHeight - 1, r, muS);
+
+    ASSERT_AB(float, model.Rt(), r,   1e-3);
+    ASSERT_AB(float, 1.0,        muS, 1e-6);
+
+    const osg::Vec2f uv(model.irradianceUV(r, muS));
+
+    ASSERT_AB(float, 1.0, uv[0], 1e-6);
+    ASSERT_AB(float, 1.0, uv[1], 1e-6);
+
+    // distance to the top atmosphere boundary (+1km) and the ground
+
+    ASSERT_AB(float, 86.0, model.limit(model.Rg(), 1.f), 1e-2);
+    ASSERT_AB(float, 10.0, model.limit(model.Rg() + 10.f, -1.f), 1e-2);
+
+    // layers span ground to top of atmosphere
+
+    osg::Vec4f dhdH;
+
+    model.layerRDhdH(0, r, dhdH);
+    ASSERT_AB(float, model.Rg() + 0.01, r, 1e-3);
+
+    model.layerRDhdH(tc.resR - 1, r, dhdH);
+    ASSERT_AB(float, model.Rt() - 0.001, r, 1e-3);
+    ASSERT_AB(float, 0.001, dhdH[0], 1e-3);
+}
+
+
+void test_phaseFunctions()
+{
+    const AtmosphereModel model(defaultTexCfg(), defaultModelCfg());
+
+    // both phase functions are normalized over the unit sphere
+
+    const int n = 10000;
+
+    double r = 0.0;
+    double m = 0.0;
+
+    for(int i = 0; i < n; ++i)
+    {
+        const float mu = -1.f + (i + 0.5f) * 2.f / n;
+
+        r += model.phaseFunctionR(mu) * 2.0 * _PI * 2.0 / n;
+        m += model.phaseFunctionM(mu) * 2.0 * _PI * 2.0 / n;
+    }
+
+    ASSERT_AB(double, 1.0, r, 1e-4);
+    ASSERT_AB(double, 1.0, m, 1e-3);
+}
+
+
+namespace
+{
+    osg::Image *floatImage(
+        const int width
+    ,   const int height
+    ,   const int depth
+    ,   const GLenum pixelFormat
+    ,   const float offset)
+    {
+        osg::Image *image(new osg::Image);
+        image->allocateImage(width, height, depth, pixelFormat, GL_FLOAT);
+
+        float *data(reinterpret_cast<float*>(image->data()));
+        const int size = image->getTotalSizeInBytes() / sizeof(float);
+
+        for(int i = 0; i < size; ++i)
+            data[i] = offset + i;
+
+        return image;
+    }
+}
+
+
+void test_cache()
+{
+    const AtmosphereModel::t_preTexCfg tc(defaultTexCfg());
+    const AtmosphereModel::t_modelCfg mc(defaultModelCfg());
+
+    AtmosphereModel::t_modelCfg mc2(mc);
+    mc2.avgGroundReflectance = 0.2f;
+
+    // content addressing
+
+    ASSERT_EQ    (__int64, AtmosphereCache::hash(tc, mc), AtmosphereCache::hash(tc, defaultModelCfg()));
+    ASSERT_EQ_NOT(__int64, AtmosphereCache::hash(tc, mc), AtmosphereCache::hash(tc, mc2));
+
+    // store and map small tables
+
+    const AtmosphereCache cache(".");
+
+    osg::ref_ptr<osg::Image> t(floatImage(4, 2, 1, GL_RGB,  0.f));
+    osg::ref_ptr<osg::Image> e(floatImage(3, 2, 1, GL_RGB,  1.f));
+    osg::ref_ptr<osg::Image> s(floatImage(4, 3, 2, GL_RGBA, 2.f));
+
+    ASSERT_EQ(int, true, cache.store(tc, mc, t, e, s));
+
+    osg::ref_ptr<osg::Image> t2(floatImage(4, 2, 1, GL_RGB,  -1.f));
+    osg::ref_ptr<osg::Image> e2(floatImage(3, 2, 1, GL_RGB,  -1.f));
+    osg::ref_ptr<osg::Image> s2(floatImage(4, 3, 2, GL_RGBA, -1.f));
+
+    // a different model config misses
+
+    ASSERT_EQ(int, true, NULL == cache.load(tc, mc2, t2, e2, s2));
+
+    osg::ref_ptr<MemoryMappedFile> file(cache.load(tc, mc, t2, e2, s2));
+    ASSERT_EQ(int, true, file.valid());
+
+    if(file.valid())
+    {
+        ASSERT_AB(float, 5.f,  reinterpret_cast<float*>(t2->data())[5],  0.0);
+        ASSERT_AB(float, 18.f, reinterpret_cast<float*>(e2->data())[17], 0.0);
+        ASSERT_AB(float, 97.f, reinterpret_cast<float*>(s2->data())[95], 0.0);
+    }
+
+    // tables of other dimensions are rejected
+
+    osg::ref_ptr<osg::Image> s3(floatImage(4, 3, 3, GL_RGBA, -1.f));
+    ASSERT_EQ(int, true, NULL == cache.load(tc, mc, t2, e2, s3));
+
+    file = NULL;
+    std::remove(cache.filePath(tc, mc).c_str());
+}
+
+
+void test_stages()
+{
+    typedef AtmospherePrecompute AP;
+
+    // ground reflectance and mieG are read by multiple scattering only
+
+    const unsigned int multipleOnly = AP::MP_AvgGroundReflectance | AP::MP_MieG;
+
+    ASSERT_EQ(unsigned int, 0, AP::stageParameters(AP::S_Transmittance) & multipleOnly);
+    ASSERT_EQ(unsigned int, 0, AP::stageParameters(AP::S_Irradiance1)   & multipleOnly);
+    ASSERT_EQ(unsigned int, 0, AP::stageParameters(AP::S_Inscatter1)    & multipleOnly);
+    ASSERT_EQ(unsigned int, multipleOnly, AP::stageParameters(AP::S_MultipleScattering) & multipleOnly);
+
+    // extinction is read by transmittance only, which all other stages read
+
+    ASSERT_EQ(unsigned int, AP::MP_BetaMEx, AP::stageParameters(AP::S_Transmittance) & AP::MP_BetaMEx);
+    ASSERT_EQ(unsigned int, 0, AP::stageParameters(AP::S_MultipleScattering) & AP::MP_BetaMEx);
+
+    for(int i = AP::S_Irradiance1; i < AP::NUM_STAGES; ++i)
+        ASSERT_EQ(unsigned int, 1 << AP::S_Transmittance, AP::stageInputs(static_cast<AP::e_Stage>(i)) & 1 << AP::S_Transmittance);
+
+    // stages read earlier stages only
+
+    for(int i = 0; i < AP::NUM_STAGES; ++i)
+        ASSERT_EQ(unsigned int, 0, AP::stageInputs(static_cast<AP::e_Stage>(i)) >> i);
+}
+
+
+namespace
+{
+    osg::Image *constantImage(
+        const int width
+    ,   const int height
+    ,   const int depth
+    ,   const GLenum pixelFormat
+    ,   const osg::Vec4f &value)
+    {
+        osg::Image *image(new osg::Image);
+        image->allocateImage(width, height, depth, pixelFormat, GL_FLOAT);
+
+        const int components = osg::Image::computeNumComponents(pixelFormat);
+
+        float *data(reinterpret_cast<float*>(image->data()));
+        const int size = image->getTotalSizeInBytes() / sizeof(float);
+
+        for(int i = 0; i < size; ++i)
+            data[i] = value[i % components];
+
+        return image;
+    }
+}
+
+
+void test_query()
+{
+    const AtmosphereModel model(defaultTexCfg(), defaultModelCfg());
+    const AtmosphereModel::t_preTexCfg &tc(model.preTexCfg());
+
+    AtmosphereQuery query;
+
+    ASSERT_EQ(int, false, query.isValid());
+    ASSERT_AB(float, 0.0, query.sunTransmittance(1.f, osg::Vec3f(0.f, 0.f, 1.f))[0], 0.0);
+
+    // constant tables of rayleigh only inscatter
+
+    osg::ref_ptr<osg::Image> t(constantImage(tc.transmittanceWidth, tc.transmittanceHeight, 1, GL_RGB, osg::Vec4f(0.5f, 0.5f, 0.5f, 0.f)));
+    osg::ref_ptr<osg::Image> e(constantImage(tc.skyWidth, tc.skyHeight, 1, GL_RGB, osg::Vec4f(0.25f, 0.25f, 0.25f, 0.f)));
+    osg::ref_ptr<osg::Image> s(constantImage(tc.resMuS * tc.resNu, tc.resMu, tc.resR, GL_RGBA, osg::Vec4f(1.f, 2.f, 3.f, 0.f)));
+
+    ASSERT_EQ(int, true, query.update(tc, model.modelCfg(), t, e, s));
+    ASSERT_EQ(int, true, query.isValid());
+
+    const osg::Vec3f up(0.f, 0.f, 1.f);
+    const osg::Vec3f sun(0.f, 0.6f, 0.8f);
+
+    const float isun = AtmosphereQuery::sunIntensity();
+
+    // sun light is attenuated within the atmosphere, and occluded by the earth
+
+    ASSERT_AB(float, 0.5, query.sunTransmittance(1.f, sun)[1], 1e-6);
+    ASSERT_AB(float, 1.0, query.sunTransmittance(100.f, sun)[1], 1e-6);
+    ASSERT_AB(float, 0.0, query.sunTransmittance(1.f, osg::Vec3f(0.f, 0.6f, -0.8f))[1], 1e-6);
+
+    ASSERT_AB(float, 0.25 * isun, query.irradiance(1.f, sun)[2], 1e-4);
+
+    // looking up, the inscatter is S[L] weighted by the rayleigh phase function
+
+    const float phaseR = model.phaseFunctionR(up * sun);
+
+    ASSERT_AB(float, 1.0 * phaseR * isun, query.radiance(up, sun, 1.f)[0], 1e-4);
+    ASSERT_AB(float, 3.0 * phaseR * isun, query.radiance(up, sun, 1.f)[2], 1e-4);
+
+    // looking down, the inscatter up to the ground is S[L] as well
+
+    ASSERT_AB(float, 2.0 * model.phaseFunctionR(-up * sun) * isun, query.radiance(-up, sun, 1.f)[1], 1e-4);
+
+    // no inscatter towards space from outside the atmosphere
+
+    ASSERT_AB(float, 0.0, query.radiance(up, sun, 200.f)[2], 0.0);
+
+    // batched queries match single queries
+
+    osg::Vec3f directions[8];
+    osg::Vec3f radiances[8];
+
+    for(int i = 0; i < 8; ++i)
+    {
+        directions[i] = osg::Vec3f(cos(i * 0.8f), sin(i * 0.8f), -0.9f + i * 0.25f);
+        directions[i].normalize();
+    }
+    query.radiance(directions, radiances, 8, sun, 1.f);
+
+    for(int i = 0; i < 8; ++i)
+        ASSERT_AB(float, query.radiance(directions[i], sun, 1.f)[1], radiances[i][1], 0.0);
+}
+
+
+void test_ambient()
+{
+    typedef HimmelAmbient::t_sh9 t_sh9;
+
+    // uniform radiance of the upper hemisphere
+
+    const int n = 64;
+
+    t_sh9 sh;
+
+    for(int y = 0; y < n; ++y)
+        for(int x = 0; x < n * 4; ++x)
+        {
+            const float e = static_cast<float>(_PI_2 * (y + 0.5) / n);
+            const float a = static_cast<float>(_PI2 * (x + 0.5) / (n * 4));
+
+            const float omega = static_cast<float>(cos(e) * (_PI_2 / n) * (_PI2 / (n * 4)));
+
+            HimmelAmbient::addDirectional(sh, osg::Vec3f(cos(a) * cos(e), sin(a) * cos(e), sin(e)), osg::Vec3f(1.f, 2.f, 3.f) * omega);
+        }
+
+    // the cosine convolution of SH9 is exact for zenith and nadir
+
+    ASSERT_AB(float, 1.0 * _PI, HimmelAmbient::irradiance(sh, osg::Vec3f(0.f, 0.f,  1.f))[0], 1e-3);
+    ASSERT_AB(float, 3.0 * _PI, HimmelAmbient::irradiance(sh, osg::Vec3f(0.f, 0.f,  1.f))[2], 1e-3);
+    ASSERT_AB(float, 0.0,       HimmelAmbient::irradiance(sh, osg::Vec3f(0.f, 0.f, -1.f))[1], 1e-3);
+
+    // and rotationally symmetric around z
+
+    ASSERT_AB(float, HimmelAmbient::irradiance(sh, osg::Vec3f(1.f, 0.f, 0.f))[0]
+        , HimmelAmbient::irradiance(sh, osg::Vec3f(0.f, -1.f, 0.f))[0], 1e-4);
+
+    // the radiance of the band limited projection is the mean at the horizon
+
+    ASSERT_AB(float, 0.5, HimmelAmbient::radiance(sh, osg::Vec3f(1.f, 0.f, 0.f))[0], 1e-3);
+}
+
+void test_formats()
+{
+    const float rgba[8] = { 1.f, 0.5f, 0.25f, 0.125f,  3.1f, 0.07f, 1e-3f, 20.f };
+    float decoded[8];
+
+    unsigned short halfs[8];
+    unsigned int packed[2];
+
+    AtmosphereFormat::encodeRGBA16F(rgba, halfs, 2);
+    ASSERT_EQ(int, 0x3c00, halfs[0]);
+    ASSERT_EQ(int, 0x3800, halfs[1]);
+
+    AtmosphereFormat::decodeRGBA16F(halfs, decoded, 2);
+    for(int i = 0; i < 8; ++i)
+        ASSERT_AB(float, rgba[i], decoded[i], rgba[i] / 1024.0);
+
+    // powers of two are exact in the shared exponent and packed floats
+
+    AtmosphereFormat::encodeRGB9E5(rgba, packed, 2);
+    AtmosphereFormat::decodeRGB9E5(packed, decoded, 2);
+
+    ASSERT_EQ(float, 1.f, decoded[0]);
+    ASSERT_EQ(float, 0.25f, decoded[2]);
+    ASSERT_AB(float, 3.1, decoded[4], 3.1 / 256.0); // precision relative to the largest channel
+
+    AtmosphereFormat::encodeR11G11B10F(rgba, packed, 2);
+    AtmosphereFormat::decodeR11G11B10F(packed, decoded, 2);
+
+    ASSERT_EQ(float, 0.5f, decoded[1]);
+    ASSERT_AB(float, 3.1, decoded[4], 3.1 / 64.0);
+    ASSERT_AB(float, 1e-3, decoded[6], 1e-3 / 32.0);
+
+    // log encoding is exact at the bounds of the range
+
+    unsigned char bytes[2];
+
+    AtmosphereFormat::t_logRange range(AtmosphereFormat::logRange(rgba, 2, 3, 1));
+    ASSERT_EQ(float, -3.f, range.min);
+    ASSERT_EQ(float,  5.f, range.max);
+
+    AtmosphereFormat::encodeLog8(rgba, bytes, 2, 3, 1, range);
+    ASSERT_EQ(int,   0, bytes[0]);
+
+    AtmosphereFormat::decodeLog8(bytes, decoded, 2, 3, 1, range);
+    ASSERT_AB(float, 0.125, decoded[3], 1e-6);
+    ASSERT_AB(float, 20.0, decoded[7], 20.0 * 0.02);
+
+    // error reports of a smooth table, more bits are more precise
+
+    osg::ref_ptr<osg::Image> s(constantImage(16, 8, 4, GL_RGBA, osg::Vec4f(0.f, 0.f, 0.f, 0.f)));
+    float *data = reinterpret_cast<float*>(s->data());
+
+    for(int i = 0; i < 16 * 8 * 4; ++i)
+        for(int c = 0; c < 4; ++c)
+            data[i * 4 + c] = static_cast<float>(exp(-i * 0.01 - c * 0.5));
+
+    const AtmosphereFormat::t_errorReport half(AtmosphereFormat::errorReport(AtmosphereFormat::F_RGBA16F, s));
+    const AtmosphereFormat::t_errorReport r11(AtmosphereFormat::errorReport(AtmosphereFormat::F_R11G11B10F, s));
+    const AtmosphereFormat::t_errorReport log8(AtmosphereFormat::errorReport(AtmosphereFormat::F_Log8, s));
+
+    ASSERT_EQ(int, 8, half.bytesPerTexel);
+    ASSERT_EQ(int, 4, log8.bytesPerTexel);
+
+    ASSERT_EQ(int, true, half.maxRelativeError < 1.0 / 1024.0);
+    ASSERT_EQ(int, true, r11.maxRelativeError < 1.0 / 32.0);
+    ASSERT_EQ(int, true, half.meanRelativeError < r11.meanRelativeError);
+    ASSERT_EQ(int, true, log8.maxRelativeError < 0.05);
+}
+
+
+namespace
+{
+    // Backend that fills the tables with parameters of the model config
+    // instead of computing them, and counts the transmittance passes.
+
+    class ParameterPrecompute : public AtmospherePrecompute
+    {
+    public:
+
+        ParameterPrecompute()
+        :   AtmospherePrecompute()
+        ,   transmittancePasses(0)
+        {
+            setCacheDirectory("");
+        }
+
+        int transmittancePasses;
+
+    protected:
+
+        virtual const bool beginTables()
+        {
+            return true;
+        }
+
+        virtual void computeTask(const t_task &task)
+        {
+            switch(task.pass)
+            {
+            case P_Transmittance:
+                ++transmittancePasses;
+                fill(m_transmittanceImage.get(), m_computeModelCfg.HM);
+                break;
+
+            case P_CopyInscatter1:
+            case P_CopyInscatterN:
+                fill(m_irradianceImage.get(), m_computeModelCfg.avgGroundReflectance);
+                fill(m_inscatterImage.get(), m_computeModelCfg.mieG);
+                break;
+
+            default:
+                break;
+            }
+        }
+
+        virtual void endTables()
+        {
+        }
+
+        static void fill(
+            osg::Image *image
+        ,   const float value)
+        {
+            float *data(reinterpret_cast<float*>(image->data()));
+            const int size = image->getTotalSizeInBytes() / sizeof(float);
+
+            for(int i = 0; i < size; ++i)
+                data[i] = value;
+        }
+    };
+}
+
+
+void test_atlas()
+{
+    typedef AtmosphereAtlas::t_modelCfg t_modelCfg;
+
+    osg::ref_ptr<ParameterPrecompute> precompute(new ParameterPrecompute);
+    const t_modelCfg original(precompute->getModelConfig());
+
+    t_modelCfg clear(defaultModelCfg());
+
+    t_modelCfg hazy(clear);
+    hazy.HM = 3.f;
+
+    t_modelCfg forward(clear);
+    forward.mieG = 0.8f;
+
+    AtmosphereAtlas::t_modelCfgs presets;
+    presets.push_back(forward);
+    presets.push_back(hazy);
+    presets.push_back(clear);
+
+    AtmosphereAtlas atlas;
+
+    ASSERT_EQ(int, true, atlas.compute(precompute.get(), presets));
+    ASSERT_EQ(int, 3, atlas.getNumPresets());
+
+    // clear and forward differ in multiple scattering only, and are
+    // computed in succession sharing the transmittance
+
+    ASSERT_EQ(int, 2, precompute->transmittancePasses);
+    ASSERT_EQ(int, 2, atlas.getNumTransmittanceLayers());
+    ASSERT_EQ(int, atlas.getTransmittanceLayer(0), atlas.getTransmittanceLayer(2));
+    ASSERT_EQ_NOT(int, atlas.getTransmittanceLayer(0), atlas.getTransmittanceLayer(1));
+
+    ASSERT_EQ(unsigned int, 1 << AtmospherePrecompute::S_MultipleScattering, atlas.getComputedStages(0));
+
+    // tables of each preset, inscatter stacked in r
+
+    const AtmosphereAtlas::t_preTexCfg &tc(atlas.getTextureConfig());
+
+    ASSERT_EQ(int, 3 * tc.resR, atlas.getInscatterImage()->r());
+    ASSERT_EQ(int, tc.resR, atlas.getInscatterImage(1)->r());
+
+    for(int i = 0; i < 3; ++i)
+    {
+        ASSERT_EQ(float, presets[i].HM, *reinterpret_cast<float*>(atlas.getTransmittanceImage(i)->data()));
+        ASSERT_EQ(float, presets[i].mieG, *reinterpret_cast<float*>(atlas.getInscatterImage(i)->data()));
+        ASSERT_EQ(float, presets[i].mieG, *reinterpret_cast<float*>(atlas.getInscatterImage()->data(0, 0, i * tc.resR + tc.resR - 1)));
+    }
+
+    // the model config of the precompute is restored
+
+    ASSERT_EQ(float, original.HM, precompute->getModelConfig().HM);
+    ASSERT_EQ(float, original.mieG, precompute->getModelConfig().mieG);
+
+    // duplicates and presets equal to the current tables are not recomputed
+
+    AtmosphereAtlas::t_modelCfgs duplicates;
+    duplicates.push_back(hazy);
+    duplicates.push_back(hazy);
+
+    ASSERT_EQ(int, true, atlas.compute(precompute.get(), duplicates));
+    ASSERT_EQ(int, 2, atlas.getNumPresets());
+    ASSERT_EQ(unsigned int, 0, atlas.getComputedStages(0) & atlas.getComputedStages(1));
+    ASSERT_EQ(float, hazy.HM, *reinterpret_cast<float*>(atlas.getTransmittanceImage(1)->data()));
+
+    ASSERT_EQ(int, true, precompute->compute());
+    ASSERT_EQ(int, true, precompute->isUpToDate());
+
+    AtmosphereAtlas::t_modelCfgs current;
+    current.push_back(original);
+
+    const int passes(precompute->transmittancePasses);
+
+    ASSERT_EQ(int, true, atlas.compute(precompute.get(), current));
+    ASSERT_EQ(int, 1, atlas.getNumPresets());
+    ASSERT_EQ(unsigned int, 0, atlas.getComputedStages(0));
+    ASSERT_EQ(int, passes, precompute->transmittancePasses);
+
+    // blended parameters
+
+    ASSERT_AB(float, 0.7, AtmosphereAtlas::blend(clear, forward, 0.5f).mieG, 1e-6);
+    ASSERT_AB(float, 3.75, AtmosphereAtlas::blend(hazy, clear, 0.25f).HM, 1e-6);
+}
+
+
+namespace
+{
+    void smallTexCfg(AtmospherePrecompute::t_preTexCfg &tc)
+    {
+        tc.transmittanceWidth  = 64;
+        tc.transmittanceHeight = 16;
+
+        tc.skyWidth  = 16;
+        tc.skyHeight =  4;
+
+        tc.resR   =  4;
+        tc.resMu  = 16;
+        tc.resMuS =  8;
+        tc.resNu  =  4;
+
+        tc.inscatterSphericalIntegralSamples = 8;
+    }
+
+    // Cpu precompute of small tables.
+
+    class SmallPrecompute : public CpuAtmospherePrecompute
+    {
+    public:
+
+        SmallPrecompute(const float tolerance)
+        :   CpuAtmospherePrecompute(1)
+        {
+            smallTexCfg(getTextureConfig());
+
+            setIntegralTolerance(tolerance);
+            setCacheDirectory("");
+
+            // reallocate the images
+            getTransmittanceTexture();
+            getIrradianceTexture();
+            getInscatterTexture();
+        }
+    };
+
+    // Gpu precompute of small tables, with access to the pass state.
+
+    class SmallGpuPrecompute : public AtmospherePrecompute
+    {
+    public:
+
+        SmallGpuPrecompute()
+        :   AtmospherePrecompute()
+        {
+            smallTexCfg(getTextureConfig());
+
+            setCacheDirectory("");
+
+            getTransmittanceTexture();
+            getIrradianceTexture();
+            getInscatterTexture();
+        }
+
+        void assignSamplers2D(
+            osg::StateSet *stateSet
+        ,   osg::Texture2D *unit0
+        ,   osg::Texture2D *unit1)
+        {
+            t_tex2DsByUnit samplers2D;
+            t_tex3DsByUnit samplers3D;
+
+            samplers2D[0] = unit0;
+            if(unit1)
+                samplers2D[1] = unit1;
+
+            assignSamplers(stateSet, samplers2D, samplers3D);
+        }
+    };
+
+    const std::vector<float> floats(const osg::Image *image)
+    {
+        const float *data(reinterpret_cast<const float*>(image->data()));
+        return std::vector<float>(data, data + image->getTotalSizeInBytes() / sizeof(float));
+    }
+
+    // Largest difference of the rgb channels of a texel, relative to the
+    // largest channel of the reference texel (or 1e-3 of the tables maximum).
+
+    const double maxRelativeDifference(
+        const std::vector<float> &image
+    ,   const std::vector<float> &reference
+    ,   const int components)
+    {
+        const int size = static_cast<int>(reference.size()) / components;
+
+        const float *a(&image[0]);
+        const float *b(&reference[0]);
+
+        double maximum = 0.0;
+        for(int i = 0; i < size * components; ++i)
+            maximum = _ma(maximum, static_cast<double>(_abs(b[i])));
+
+        double result = 0.0;
+        for(int i = 0; i < size; ++i)
+        {
+            double value = 1e-3 * maximum;
+            double difference = 0.0;
+
+            for(int c = 0; c < _mi(components, 3); ++c)
+            {
+                value = _ma(value, static_cast<double>(_abs(b[i * components + c])));
+                difference = _ma(difference, static_cast<double>(_abs(a[i * components + c] - b[i * components + c])));
+            }
+            result = _ma(result, difference / value);
+        }
+        return result;
+    }
+
+    const double maxRelativeDifference(
+        const osg::Image *image
+    ,   const osg::Image *reference)
+    {
+        return maxRelativeDifference(floats(image), floats(reference)
+            , osg::Image::computeNumComponents(reference->getPixelFormat()));
+    }
+
+    typedef std::vector<std::vector<float> > t_tables;
+
+    // Irradiance and inscatter tables as published by a progressive 
+    // compute after each order of scattering.
+
+    void computeOrders(
+        AtmospherePrecompute *precompute
+    ,   t_tables &irradiance
+    ,   t_tables &inscatter)
+    {
+        int order = 0;
+
+        do
+        {
+            precompute->computeProgressive(0.0, false);
+
+            if(precompute->getScatteringOrder() != order)
+            {
+                order = precompute->getScatteringOrder();
+
+                irradiance.push_back(floats(precompute->getIrradianceImage()));
+                inscatter.push_back(floats(precompute->getInscatterImage()));
+            }
+        }
+        while(precompute->isComputing());
+    }
+}
+
+
+void test_integration()
+{
+    osg::ref_ptr<SmallPrecompute> fixed(new SmallPrecompute(0.f));
+    osg::ref_ptr<SmallPrecompute> adaptive(new SmallPrecompute(1e-3f));
+
+    ASSERT_AB(float, 1e-3, adaptive->getIntegralTolerance(), 1e-9);
+    ASSERT_EQ(float, 0.0, adaptive->setIntegralTolerance(-1.f));
+    adaptive->setIntegralTolerance(1e-3f);
+
+    // the tolerance is formatted for the shaders without loss
+
+    std::string source("%INTEGRAL_TOLERANCE%");
+    replace(source, "%INTEGRAL_TOLERANCE%", 1e-7f);
+    ASSERT_EQ(float, 1e-7f, static_cast<float>(atof(source.c_str())));
+
+    ASSERT_EQ(int, true, fixed->compute());
+    ASSERT_EQ(int, true, adaptive->compute());
+
+    // the fixed sample counts are no reference either, but both agree
+    // within the error of the fixed integration (largest at the horizon)
+
+    ASSERT_AB(double, 0.0, maxRelativeDifference(adaptive->getTransmittanceImage(), fixed->getTransmittanceImage()), 1e-3);
+    ASSERT_AB(double, 0.0, maxRelativeDifference(adaptive->getIrradianceImage(), fixed->getIrradianceImage()), 5e-2);
+
+    // compared to all samples (a negligible tolerance), the tables of each
+    // order of scattering are within a few times the tolerance (the errors
+    // of the passes accumulate)
+
+    osg::ref_ptr<SmallPrecompute> progressive(new SmallPrecompute(1e-3f));
+    osg::ref_ptr<SmallPrecompute> reference(new SmallPrecompute(1e-7f));
+
+    const float tolerance(progressive->getIntegralTolerance());
+
+    t_tables irradiance, inscatter;
+    t_tables referenceIrradiance, referenceInscatter;
+
+    computeOrders(progressive.get(), irradiance, inscatter);
+    computeOrders(reference.get(), referenceIrradiance, referenceInscatter);
+
+    ASSERT_AB(double, 0.0, maxRelativeDifference(progressive->getTransmittanceImage(), reference->getTransmittanceImage()), tolerance);
+
+    ASSERT_EQ(unsigned int, 4, inscatter.size());
+    ASSERT_EQ(unsigned int, referenceInscatter.size(), inscatter.size());
+
+    for(unsigned int i = 0; i < inscatter.size() && i < referenceInscatter.size(); ++i)
+    {
+        ASSERT_AB(double, 0.0, maxRelativeDifference(irradiance[i], referenceIrradiance[i], 3), 4.0 * tolerance);
+        ASSERT_AB(double, 0.0, maxRelativeDifference(inscatter[i], referenceInscatter[i], 4), 4.0 * tolerance);
+    }
+
+    // the tolerance is part of the configuration
+
+    ASSERT_EQ(int, false, adaptive->compute());
+    adaptive->setIntegralTolerance(1e-2f);
+    ASSERT_EQ(int, true, adaptive->compute());
+}
+
+
+void test_pipeline()
+{
+    osg::ref_ptr<SmallGpuPrecompute> gpu(new SmallGpuPrecompute);
+
+    // the retained state set of a pass releases the samplers of former
+    // tasks (e.g., the irradiance of order 2 in the copy of order 1)
+
+    osg::ref_ptr<osg::StateSet> stateSet(new osg::StateSet);
+
+    osg::ref_ptr<osg::Texture2D> deltaE(new osg::Texture2D);
+    osg::ref_ptr<osg::Texture2D> irradiance(new osg::Texture2D);
+
+    deltaE->setName("deltaE");
+    irradiance->setName("irradiance");
+
+    gpu->assignSamplers2D(stateSet.get(), deltaE.get(), irradiance.get());
+    ASSERT_EQ(int, true, NULL != stateSet->getUniform("irradianceSampler"));
+
+    gpu->assignSamplers2D(stateSet.get(), deltaE.get(), NULL);
+    ASSERT_EQ(int, true, NULL == stateSet->getUniform("irradianceSampler"));
+    ASSERT_EQ(int, true, NULL == stateSet->getTextureAttribute(1, osg::StateAttribute::TEXTURE));
+    ASSERT_EQ(int, true, NULL != stateSet->getUniform("deltaESampler"));
+
+    // recomputes with the retained pipeline yield the same tables
+
+    if(!gpu->compute())
+    {
+        TEST_SKIP("gpu pipeline, no pbuffer context");
+        return;
+    }
+
+    const std::vector<float> irradiance1(floats(gpu->getIrradianceImage()));
+    const std::vector<float> inscatter1(floats(gpu->getInscatterImage()));
+
+    ASSERT_EQ(int, true, gpu->compute(false));
+
+    ASSERT_EQ(int, true, irradiance1 == floats(gpu->getIrradianceImage()));
+    ASSERT_EQ(int, true, inscatter1 == floats(gpu->getInscatterImage()));
+
+    // the single scattering results are retained by the context only, so 
+    // they are reused with the pipeline, and recomputed after its release
+
+    const float reflectance(gpu->getModelConfig().avgGroundReflectance);
+
+    gpu->getModelConfig().avgGroundReflectance = 0.3f;
+    ASSERT_EQ(int, true, gpu->compute());
+    ASSERT_EQ(double, 0.0, gpu->getPassTime(AtmospherePrecompute::P_Inscatter1));
+
+    gpu->releasePipeline();
+
+    gpu->getModelConfig().avgGroundReflectance = reflectance;
+    ASSERT_EQ(int, true, gpu->compute());
+    ASSERT_EQ(int, true, gpu->getPassTime(AtmospherePrecompute::P_Inscatter1) > 0.0);
+
+    ASSERT_EQ(int, true, irradiance1 == floats(gpu->getIrradianceImage()));
+    ASSERT_EQ(int, true, inscatter1 == floats(gpu->getInscatterImage()));
+}
+
+
+void test_parity()
+{
+    osg::ref_ptr<SmallPrecompute> cpu(new SmallPrecompute(0.f));
+    osg::ref_ptr<SmallGpuPrecompute> gpu(new SmallGpuPrecompute);
+
+    // E excludes the direct sun light, i.e., is zero after the first order
+    // and gains the light reflected by the ground with the second
+
+    t_tables irradiance, inscatter;
+    computeOrders(cpu.get(), irradiance, inscatter);
+
+    ASSERT_EQ(unsigned int, 4, irradiance.size());
+
+    if(irradiance.size() > 1)
+    {
+        const std::vector<float> zero(irradiance[0].size(), 0.f);
+
+        ASSERT_EQ(int, true, zero == irradiance[0]);
+        ASSERT_EQ(int, false, zero == irradiance[1]);
+    }
+
+    // both backends compute the same tables
+
+    if(!gpu->compute())
+    {
+        TEST_SKIP("gpu parity, no pbuffer context");
+        return;
+    }
+
+    ASSERT_AB(double, 0.0, maxRelativeDifference(gpu->getTransmittanceImage(), cpu->getTransmittanceImage()), 1e-2);
+    ASSERT_AB(double, 0.0, maxRelativeDifference(gpu->getIrradianceImage(), cpu->getIrradianceImage()), 2e-2);
+}
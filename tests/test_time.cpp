@@ -34,13 +34,65 @@
 
 #include "osgHimmel/atime.h"
 #include "osgHimmel/timef.h"
+#include "osgHimmel/juliantime.h"
 #include "osgHimmel/mathmacros.h"
 
 #include <time.h>
+#include <stdlib.h>
+#include <string>
 
 
 using namespace osgHimmel;
 
+namespace
+{
+
+void setTimeZone(const char *tz)
+{
+#ifdef __GNUC__
+    if(tz)
+        setenv("TZ", tz, 1);
+    else
+        unsetenv("TZ");
+    tzset();
+#else // __GNUC__
+    _putenv_s("TZ", tz ? tz : "");
+    _tzset();
+#endif // __GNUC__
+}
+
+
+// The julian time of a timer has to match the time t_aTime reads from it,
+// i.e., the local time of the system including daylight saving.
+
+void test_julianTimeOfTimeF(
+    const time_t t
+,   const time_t utcOffset
+,   const short hour
+,   const short minute
+,   const short second)
+{
+    TimeF f(t, utcOffset);
+
+    const t_aTime a(t_aTime::fromTimeF(f));
+    const t_julianTime time(t_julianTime::fromTimeF(f));
+
+    ASSERT_EQ(short, hour,   a.hour);
+    ASSERT_EQ(short, minute, a.minute);
+    ASSERT_EQ(short, second, a.second);
+
+    ASSERT_AB(long double, t_julianTime(a).jd(), time.jd(), 1e-9);
+    ASSERT_EQ(__int64, utcOffset, time.utcOffset);
+
+    const t_aTime shown(time.toATime());
+
+    ASSERT_EQ(short, a.hour,   shown.hour);
+    ASSERT_EQ(short, a.minute, shown.minute);
+    ASSERT_EQ(short, a.second, shown.second);
+}
+
+} // namespace
+
 void test_time()
 {
     {
@@ -51,6 +103,12 @@ void test_time()
 
         ASSERT_EQ(float, 0.029444444, f.getf());
         ASSERT_EQ(__int64, t, f.gett());
+        ASSERT_EQ(long double, t, f.gettf());
+
+        const t_julianTime time(t_julianTime::fromTimeF(f));
+
+        ASSERT_AB(long double, t_julianTime(t_aTime::fromTimeF(f)).jd(), time.jd(), 1e-9);
+        ASSERT_EQ(short, 0, time.utcOffset);
 
         f.setf(0.0, true);
         ASSERT_EQ(__int64, t - 42 * 60 - 24, f.gett());
@@ -127,6 +185,35 @@ void test_time()
         ASSERT_EQ(short, a.minute, 16);
         ASSERT_EQ(short, a.second, 48);
     }
+
+    {
+        const char *tz(getenv("TZ"));
+        const std::string previous(tz ? tz : "");
+
+        // 2012-07-01 04:26:40 utc
+
+        const time_t t(1341116800);
+
+        setTimeZone("UTC");
+
+        test_julianTimeOfTimeF(t, 0, 4, 26, 40);
+        test_julianTimeOfTimeF(t, 3600, 4, 26, 40);
+        test_julianTimeOfTimeF(t, static_cast<time_t>(-3.33 * 3600), 4, 26, 40);
+
+        // central european summer time (utc+2)
+
+        setTimeZone("CET-1CEST,M3.5.0,M10.5.0/3");
+
+        test_julianTimeOfTimeF(t, 0, 6, 26, 40);
+        test_julianTimeOfTimeF(t, 3600, 6, 26, 40);
+        test_julianTimeOfTimeF(t, static_cast<time_t>(-3.33 * 3600), 6, 26, 40);
+
+        // ... and winter time (utc+1), 2012-01-01 04:26:40 utc
+
+        test_julianTimeOfTimeF(1325392000, 0, 5, 26, 40);
+
+        setTimeZone(tz ? previous.c_str() : NULL);
+    }
     
     TEST_REPORT();
 }
@@ -31,6 +31,7 @@
 #include "test_math.h"
 #include "test_astronomy.h"
 #include "test_astronomy2.h"
+#include "test_atmosphere.h"
 #include "test_time.h"
 #include "test_twounitschanger.h"
 
@@ -39,6 +40,7 @@ int main(int argc, char* argv[])
     test_math();
     test_astronomy();
     test_astronomy2();
+    test_atmosphere();
     test_time();
     test_twounitschanger();
 